@@ -40,6 +40,8 @@
 #include "mbframe.h"
 #include "mbproto.h"
 #include "mbfunc.h"
+#include "mbinstance.h"
+#include "mbtrace.h"
 
 #include "mbport.h"
 #if MB_RTU_ENABLED == 1
@@ -51,6 +53,9 @@
 #if MB_TCP_ENABLED == 1
 #include "mbtcp.h"
 #endif
+#if MB_GATEWAY_ENABLED > 0
+#include "mbgateway.h"
+#endif
 
 #ifndef MB_PORT_HAS_CLOSE
 #define MB_PORT_HAS_CLOSE 0
@@ -58,78 +63,113 @@
 
 /* ----------------------- Static variables ---------------------------------*/
 
-static UCHAR    ucMBAddress;
-static eMBMode  eMBCurrentMode;
+/* Pool of protocol stack instances. The first entry is the default instance
+ * which is used by the functions without an instance argument.
+ */
+static xMBInstance xMBInstances[MB_INSTANCES_MAX];
+
+#define MB_DEFAULT_INSTANCE     ( &xMBInstances[0] )
 
-static enum
-{
-    STATE_ENABLED,
-    STATE_DISABLED,
-    STATE_NOT_INITIALIZED
-} eMBState = STATE_NOT_INITIALIZED;
+#if MB_TCP_ENABLED > 0
+/* Instance used by eMBTCPInit( ). It runs next to the default instance so
+ * that the functions without an instance argument serve the serial line
+ * and Modbus TCP at the same time.
+ */
+static xMBInstance xMBTCPInstance;
+
+#define MB_TCP_INSTANCE         ( &xMBTCPInstance )
+#endif
+
+static BOOL     prvxMBDefaultByteReceived( void );
+static BOOL     prvxMBDefaultTransmitterEmpty( void );
+static BOOL     prvxMBDefaultTimerExpired( void );
 
-/* Functions pointer which are initialized in eMBInit( ). Depending on the
- * mode (RTU or ASCII) the are set to the correct implementations.
+/* Callback functions of the default instance for interrupt handlers which
+ * have no instance at hand. They are called when an external event has
+ * happend which includes a timeout or the reception or transmission of a
+ * character.
  */
-static peMBFrameSend peMBFrameSendCur;
-static pvMBFrameStart pvMBFrameStartCur;
-static pvMBFrameStop pvMBFrameStopCur;
-static peMBFrameReceive peMBFrameReceiveCur;
-static pvMBFrameClose pvMBFrameCloseCur;
-
-/* Callback functions required by the porting layer. They are called when
- * an external event has happend which includes a timeout or the reception
- * or transmission of a character.
+BOOL( *pxMBFrameCBByteReceived ) ( void ) = prvxMBDefaultByteReceived;
+BOOL( *pxMBFrameCBTransmitterEmpty ) ( void ) = prvxMBDefaultTransmitterEmpty;
+BOOL( *pxMBPortCBTimerExpired ) ( void ) = prvxMBDefaultTimerExpired;
+
+/* Register callbacks used for frames sent to the address given to eMBInit( )
+ * and for Modbus TCP frames without a virtual slave unit identifier.
  */
-BOOL( *pxMBFrameCBByteReceived ) ( void );
-BOOL( *pxMBFrameCBTransmitterEmpty ) ( void );
-BOOL( *pxMBPortCBTimerExpired ) ( void );
+static const xMBRegisterCB xMBDefaultRegisterCB = {
+    eMBRegInputCB, eMBRegHoldingCB, eMBRegCoilsCB, eMBRegDiscreteCB
+};
 
-BOOL( *pxMBFrameCBReceiveFSMCur ) ( void );
-BOOL( *pxMBFrameCBTransmitFSMCur ) ( void );
+const xMBRegisterCB *pxMBRegisterCBCur = &xMBDefaultRegisterCB;
+
+#if MB_VIRTUAL_SLAVES_MAX > 0
+/* Virtual slaves. aucMBSlaveIndex maps an address to its slot plus one or
+ * to zero if the address is not a virtual slave.
+ */
+static xMBRegisterCB xMBVirtualSlaves[MB_VIRTUAL_SLAVES_MAX];
+static UCHAR    aucMBVirtualSlaveAddress[MB_VIRTUAL_SLAVES_MAX];
+static UCHAR    aucMBSlaveIndex[256];
+#endif
 
-/* An array of Modbus functions handlers which associates Modbus function
- * codes with implementing functions.
+/* Modbus function handlers indexed by the function code, so a request is
+ * dispatched with a single lookup. Unused function codes are NULL.
  */
-static xMBFunctionHandler xFuncHandlers[MB_FUNC_HANDLERS_MAX] = {
+static pxMBFunctionHandler xFuncHandlers[MB_FUNC_CODE_MAX + 1] = {
 #if MB_FUNC_OTHER_REP_SLAVEID_ENABLED > 0
-    {MB_FUNC_OTHER_REPORT_SLAVEID, eMBFuncReportSlaveID},
+    [MB_FUNC_OTHER_REPORT_SLAVEID] = eMBFuncReportSlaveID,
 #endif
 #if MB_FUNC_READ_INPUT_ENABLED > 0
-    {MB_FUNC_READ_INPUT_REGISTER, eMBFuncReadInputRegister},
+    [MB_FUNC_READ_INPUT_REGISTER] = eMBFuncReadInputRegister,
 #endif
 #if MB_FUNC_READ_HOLDING_ENABLED > 0
-    {MB_FUNC_READ_HOLDING_REGISTER, eMBFuncReadHoldingRegister},
+    [MB_FUNC_READ_HOLDING_REGISTER] = eMBFuncReadHoldingRegister,
 #endif
 #if MB_FUNC_WRITE_MULTIPLE_HOLDING_ENABLED > 0
-    {MB_FUNC_WRITE_MULTIPLE_REGISTERS, eMBFuncWriteMultipleHoldingRegister},
+    [MB_FUNC_WRITE_MULTIPLE_REGISTERS] = eMBFuncWriteMultipleHoldingRegister,
 #endif
 #if MB_FUNC_WRITE_HOLDING_ENABLED > 0
-    {MB_FUNC_WRITE_REGISTER, eMBFuncWriteHoldingRegister},
+    [MB_FUNC_WRITE_REGISTER] = eMBFuncWriteHoldingRegister,
 #endif
 #if MB_FUNC_READWRITE_HOLDING_ENABLED > 0
-    {MB_FUNC_READWRITE_MULTIPLE_REGISTERS, eMBFuncReadWriteMultipleHoldingRegister},
+    [MB_FUNC_READWRITE_MULTIPLE_REGISTERS] = eMBFuncReadWriteMultipleHoldingRegister,
 #endif
 #if MB_FUNC_READ_COILS_ENABLED > 0
-    {MB_FUNC_READ_COILS, eMBFuncReadCoils},
+    [MB_FUNC_READ_COILS] = eMBFuncReadCoils,
 #endif
 #if MB_FUNC_WRITE_COIL_ENABLED > 0
-    {MB_FUNC_WRITE_SINGLE_COIL, eMBFuncWriteCoil},
+    [MB_FUNC_WRITE_SINGLE_COIL] = eMBFuncWriteCoil,
 #endif
 #if MB_FUNC_WRITE_MULTIPLE_COILS_ENABLED > 0
-    {MB_FUNC_WRITE_MULTIPLE_COILS, eMBFuncWriteMultipleCoils},
+    [MB_FUNC_WRITE_MULTIPLE_COILS] = eMBFuncWriteMultipleCoils,
 #endif
 #if MB_FUNC_READ_DISCRETE_INPUTS_ENABLED > 0
-    {MB_FUNC_READ_DISCRETE_INPUTS, eMBFuncReadDiscreteInputs},
+    [MB_FUNC_READ_DISCRETE_INPUTS] = eMBFuncReadDiscreteInputs,
 #endif
 };
 
+/* ----------------------- Static functions ---------------------------------*/
+#if MB_VIRTUAL_SLAVES_MAX > 0
+static eMBErrorCode prveMBRegInputNone( UCHAR * pucRegBuffer, USHORT usAddress, USHORT usNRegs );
+static eMBErrorCode prveMBRegHoldingNone( UCHAR * pucRegBuffer, USHORT usAddress, USHORT usNRegs,
+                                          eMBRegisterMode eMode );
+static eMBErrorCode prveMBRegCoilsNone( UCHAR * pucRegBuffer, USHORT usAddress, USHORT usNCoils,
+                                        eMBRegisterMode eMode );
+static eMBErrorCode prveMBRegDiscreteNone( UCHAR * pucRegBuffer, USHORT usAddress, USHORT usNDiscrete );
+#endif
+
+static eMBErrorCode prveMBInstTake( xMBInstance ** ppxInst, BOOL * pxTaken );
+static void     prvvMBInstRelease( xMBInstance * pxInst, BOOL xTaken );
+static BOOL     prvxMBInstIsPooled( xMBInstance * pxInst );
+
 /* ----------------------- Start implementation -----------------------------*/
-//20210429
-static UCHAR ucMBSerialAddress;
+eMBErrorCode
+eMBSwitchMode( eMBMode eMode )
+{
+    return eMBInstSwitchMode( MB_DEFAULT_INSTANCE, eMode );
+}
 
 eMBErrorCode
-eMBSwitchMode(eMBMode eMode)
+eMBInstSwitchMode( xMBInstance * pxInst, eMBMode eMode )
 {
   eMBErrorCode eStatus = MB_ENOERR;
 
@@ -137,41 +177,47 @@ eMBSwitchMode(eMBMode eMode)
   {
 #if MB_RTU_ENABLED > 0
     case MB_RTU:
-      pvMBFrameStartCur = eMBRTUStart;
-      pvMBFrameStopCur = eMBRTUStop;
-      peMBFrameSendCur = eMBRTUSend;
-      peMBFrameReceiveCur = eMBRTUReceive;
-      pvMBFrameCloseCur = MB_PORT_HAS_CLOSE ? vMBPortClose : NULL;
-      pxMBFrameCBByteReceived = xMBRTUReceiveFSM;
-      pxMBFrameCBTransmitterEmpty = xMBRTUTransmitFSM;
-      pxMBPortCBTimerExpired = xMBRTUTimerT35Expired;
-      ucMBAddress = ucMBSerialAddress;
-      eMBCurrentMode = MB_RTU;
+      pxInst->pvMBFrameStartCur = eMBRTUStart;
+      pxInst->pvMBFrameStopCur = eMBRTUStop;
+      pxInst->peMBFrameSendCur = eMBRTUSend;
+      pxInst->peMBFrameReceiveCur = eMBRTUReceive;
+      pxInst->pvMBFrameCloseCur = MB_PORT_HAS_CLOSE ? vMBPortClose : NULL;
+      pxInst->pxMBFrameCBByteReceived = xMBRTUReceiveFSM;
+#if MB_RTU_DMA_RX_ENABLED > 0
+      pxInst->pxMBFrameCBFrameReceived = xMBRTUReceiveFrame;
+#endif
+      pxInst->pxMBFrameCBTransmitterEmpty = xMBRTUTransmitFSM;
+#if MB_RTU_DMA_TX_ENABLED > 0
+      pxInst->pxMBFrameCBTransmitComplete = xMBRTUTransmitComplete;
+#endif
+      pxInst->pxMBPortCBTimerExpired = xMBRTUTimerT35Expired;
+      pxInst->ucMBAddress = pxInst->ucMBSerialAddress;
+      pxInst->eMBCurrentMode = MB_RTU;
       break;
 #endif
 #if MB_ASCII_ENABLED > 0
     case MB_ASCII:
-      pvMBFrameStartCur = eMBASCIIStart;
-      pvMBFrameStopCur = eMBASCIIStop;
-      peMBFrameSendCur = eMBASCIISend;
-      peMBFrameReceiveCur = eMBASCIIReceive;
-      pvMBFrameCloseCur = MB_PORT_HAS_CLOSE ? vMBPortClose : NULL;
-      pxMBFrameCBByteReceived = xMBASCIIReceiveFSM;
-      pxMBFrameCBTransmitterEmpty = xMBASCIITransmitFSM;
-      pxMBPortCBTimerExpired = xMBASCIITimerT1SExpired;
-      ucMBAddress = ucMBSerialAddress;
-      eMBCurrentMode = MB_ASCII;
+      pxInst->pvMBFrameStartCur = eMBASCIIStart;
+      pxInst->pvMBFrameStopCur = eMBASCIIStop;
+      pxInst->peMBFrameSendCur = eMBASCIISend;
+      pxInst->peMBFrameReceiveCur = eMBASCIIReceive;
+      pxInst->pvMBFrameCloseCur = MB_PORT_HAS_CLOSE ? vMBPortClose : NULL;
+      pxInst->pxMBFrameCBByteReceived = xMBASCIIReceiveFSM;
+      pxInst->pxMBFrameCBTransmitterEmpty = xMBASCIITransmitFSM;
+      pxInst->pxMBPortCBTimerExpired = xMBASCIITimerT1SExpired;
+      pxInst->ucMBAddress = pxInst->ucMBSerialAddress;
+      pxInst->eMBCurrentMode = MB_ASCII;
       break;
 #endif
 #if MB_TCP_ENABLED > 0
     case MB_TCP:
-      pvMBFrameStartCur = eMBTCPStart;
-      pvMBFrameStopCur = eMBTCPStop;
-      peMBFrameReceiveCur = eMBTCPReceive;
-      peMBFrameSendCur = eMBTCPSend;
-      pvMBFrameCloseCur = MB_PORT_HAS_CLOSE ? vMBTCPPortClose : NULL;
-      ucMBAddress = MB_TCP_PSEUDO_ADDRESS;
-      eMBCurrentMode = MB_TCP;
+      pxInst->pvMBFrameStartCur = eMBTCPStart;
+      pxInst->pvMBFrameStopCur = eMBTCPStop;
+      pxInst->peMBFrameReceiveCur = eMBTCPReceive;
+      pxInst->peMBFrameSendCur = eMBTCPSend;
+      pxInst->pvMBFrameCloseCur = MB_PORT_HAS_CLOSE ? eMBTCPClose : NULL;
+      pxInst->ucMBAddress = MB_TCP_PSEUDO_ADDRESS;
+      pxInst->eMBCurrentMode = MB_TCP;
       break;
 #endif
     default:
@@ -179,10 +225,22 @@ eMBSwitchMode(eMBMode eMode)
   }
   return eStatus;
 }
+
 eMBErrorCode
 eMBInit( eMBMode eMode, UCHAR ucSlaveAddress, UCHAR ucPort, ULONG ulBaudRate, eMBParity eParity )
+{
+    xMBInstance    *pxInst = MB_DEFAULT_INSTANCE;
+
+    return eMBInstInit( &pxInst, eMode, ucSlaveAddress, ucPort, ulBaudRate, eParity );
+}
+
+eMBErrorCode
+eMBInstInit( xMBInstance ** ppxInst, eMBMode eMode, UCHAR ucSlaveAddress, UCHAR ucPort,
+             ULONG ulBaudRate, eMBParity eParity )
 {
     eMBErrorCode    eStatus = MB_ENOERR;
+    xMBInstance    *pxInst;
+    BOOL            xTaken;
 
     /* check preconditions */
     if( ( ucSlaveAddress == MB_ADDRESS_BROADCAST ) ||
@@ -190,39 +248,28 @@ eMBInit( eMBMode eMode, UCHAR ucSlaveAddress, UCHAR ucPort, ULONG ulBaudRate, eM
     {
         eStatus = MB_EINVAL;
     }
-    else
+    else if( ( eStatus = prveMBInstTake( ppxInst, &xTaken ) ) == MB_ENOERR )
     {
-        ucMBAddress = ucSlaveAddress;
-        ucMBSerialAddress = ucSlaveAddress;//20210429
+        pxInst = *ppxInst;
+        pxInst->ucPort = ucPort;
+        pxInst->ucMBAddress = ucSlaveAddress;
+        pxInst->ucMBSerialAddress = ucSlaveAddress;//20210429
+#if MB_MASTER_ENABLED > 0
+        pxInst->xIsMaster = FALSE;
+#endif
 
         switch ( eMode )
         {
 #if MB_RTU_ENABLED > 0
         case MB_RTU:
-            pvMBFrameStartCur = eMBRTUStart;
-            pvMBFrameStopCur = eMBRTUStop;
-            peMBFrameSendCur = eMBRTUSend;
-            peMBFrameReceiveCur = eMBRTUReceive;
-            pvMBFrameCloseCur = MB_PORT_HAS_CLOSE ? vMBPortClose : NULL;
-            pxMBFrameCBByteReceived = xMBRTUReceiveFSM;
-            pxMBFrameCBTransmitterEmpty = xMBRTUTransmitFSM;
-            pxMBPortCBTimerExpired = xMBRTUTimerT35Expired;
-
-            eStatus = eMBRTUInit( ucMBAddress, ucPort, ulBaudRate, eParity );
+            ( void )eMBInstSwitchMode( pxInst, MB_RTU );
+            eStatus = eMBRTUInit( pxInst, pxInst->ucMBAddress, ucPort, ulBaudRate, eParity );
             break;
 #endif
 #if MB_ASCII_ENABLED > 0
         case MB_ASCII:
-            pvMBFrameStartCur = eMBASCIIStart;
-            pvMBFrameStopCur = eMBASCIIStop;
-            peMBFrameSendCur = eMBASCIISend;
-            peMBFrameReceiveCur = eMBASCIIReceive;
-            pvMBFrameCloseCur = MB_PORT_HAS_CLOSE ? vMBPortClose : NULL;
-            pxMBFrameCBByteReceived = xMBASCIIReceiveFSM;
-            pxMBFrameCBTransmitterEmpty = xMBASCIITransmitFSM;
-            pxMBPortCBTimerExpired = xMBASCIITimerT1SExpired;
-
-            eStatus = eMBASCIIInit( ucMBAddress, ucPort, ulBaudRate, eParity );
+            ( void )eMBInstSwitchMode( pxInst, MB_ASCII );
+            eStatus = eMBASCIIInit( pxInst, pxInst->ucMBAddress, ucPort, ulBaudRate, eParity );
             break;
 #endif
         default:
@@ -231,15 +278,26 @@ eMBInit( eMBMode eMode, UCHAR ucSlaveAddress, UCHAR ucPort, ULONG ulBaudRate, eM
 
         if( eStatus == MB_ENOERR )
         {
-            if( !xMBPortEventInit(  ) )
+            if( !xMBPortEventInit( pxInst ) )
             {
                 /* port dependent event module initalization failed. */
                 eStatus = MB_EPORTERR;
             }
             else
             {
-                eMBCurrentMode = eMode;
-                eMBState = STATE_DISABLED;
+                pxInst->eMBCurrentMode = eMode;
+                pxInst->eMBState = STATE_DISABLED;
+#if MB_TRACE_ENABLED > 0
+                vMBTraceInit(  );
+#endif
+            }
+        }
+        if( eStatus != MB_ENOERR )
+        {
+            prvvMBInstRelease( pxInst, xTaken );
+            if( xTaken )
+            {
+                *ppxInst = NULL;
             }
         }
     }
@@ -249,71 +307,113 @@ eMBInit( eMBMode eMode, UCHAR ucSlaveAddress, UCHAR ucPort, ULONG ulBaudRate, eM
 #if MB_TCP_ENABLED > 0
 eMBErrorCode
 eMBTCPInit( USHORT ucTCPPort )
+{
+    xMBInstance    *pxInst = MB_TCP_INSTANCE;
+
+    return eMBInstTCPInit( &pxInst, ucTCPPort );
+}
+
+eMBErrorCode
+eMBInstTCPInit( xMBInstance ** ppxInst, USHORT ucTCPPort )
 {
     eMBErrorCode    eStatus = MB_ENOERR;
+    xMBInstance    *pxInst;
+    BOOL            xTaken;
 
-    if( ( eStatus = eMBTCPDoInit( ucTCPPort ) ) != MB_ENOERR )
+    if( ( eStatus = prveMBInstTake( ppxInst, &xTaken ) ) != MB_ENOERR )
+    {
+        return eStatus;
+    }
+    pxInst = *ppxInst;
+    if( ( eStatus = eMBTCPDoInit( pxInst, ucTCPPort ) ) != MB_ENOERR )
     {
-        eMBState = STATE_DISABLED;
+        pxInst->eMBState = STATE_DISABLED;
     }
-    else if( !xMBPortEventInit(  ) )
+    else if( !xMBPortEventInit( pxInst ) )
     {
         /* Port dependent event module initalization failed. */
         eStatus = MB_EPORTERR;
     }
     else
     {
-        pvMBFrameStartCur = eMBTCPStart;
-        pvMBFrameStopCur = eMBTCPStop;
-        peMBFrameReceiveCur = eMBTCPReceive;
-        peMBFrameSendCur = eMBTCPSend;
-        pvMBFrameCloseCur = MB_PORT_HAS_CLOSE ? vMBTCPPortClose : NULL;
-        ucMBAddress = MB_TCP_PSEUDO_ADDRESS;
-        eMBCurrentMode = MB_TCP;
-        eMBState = STATE_DISABLED;
+        ( void )eMBInstSwitchMode( pxInst, MB_TCP );
+        pxInst->eMBState = STATE_DISABLED;
+#if MB_TRACE_ENABLED > 0
+        vMBTraceInit(  );
+#endif
+    }
+    if( ( eStatus != MB_ENOERR ) && xTaken )
+    {
+        prvvMBInstRelease( pxInst, xTaken );
+        *ppxInst = NULL;
     }
     return eStatus;
 }
 #endif
 
-eMBErrorCode
-eMBRegisterCB( UCHAR ucFunctionCode, pxMBFunctionHandler pxHandler )
+xMBInstance    *
+pxMBGetDefaultInstance( void )
+{
+    return MB_DEFAULT_INSTANCE;
+}
+
+static          eMBErrorCode
+prveMBInstTake( xMBInstance ** ppxInst, BOOL * pxTaken )
 {
     int             i;
-    eMBErrorCode    eStatus;
 
-    if( ( 0 < ucFunctionCode ) && ( ucFunctionCode <= 127 ) )
+    *pxTaken = FALSE;
+    if( *ppxInst == NULL )
     {
+        /* Take a free instance. The default instance is reserved. */
         ENTER_CRITICAL_SECTION(  );
-        if( pxHandler != NULL )
+        for( i = 1; i < MB_INSTANCES_MAX; i++ )
         {
-            for( i = 0; i < MB_FUNC_HANDLERS_MAX; i++ )
+            if( !xMBInstances[i].xInUse )
             {
-                if( ( xFuncHandlers[i].pxHandler == NULL ) ||
-                    ( xFuncHandlers[i].pxHandler == pxHandler ) )
-                {
-                    xFuncHandlers[i].ucFunctionCode = ucFunctionCode;
-                    xFuncHandlers[i].pxHandler = pxHandler;
-                    break;
-                }
+                xMBInstances[i].xInUse = TRUE;
+                *ppxInst = &xMBInstances[i];
+                *pxTaken = TRUE;
+                break;
             }
-            eStatus = ( i != MB_FUNC_HANDLERS_MAX ) ? MB_ENOERR : MB_ENORES;
         }
-        else
+        EXIT_CRITICAL_SECTION(  );
+        if( *ppxInst == NULL )
         {
-            for( i = 0; i < MB_FUNC_HANDLERS_MAX; i++ )
-            {
-                if( xFuncHandlers[i].ucFunctionCode == ucFunctionCode )
-                {
-                    xFuncHandlers[i].ucFunctionCode = 0;
-                    xFuncHandlers[i].pxHandler = NULL;
-                    break;
-                }
-            }
-            /* Remove can't fail. */
-            eStatus = MB_ENOERR;
+            return MB_ENORES;
         }
-        EXIT_CRITICAL_SECTION(  );
+    }
+    ( *ppxInst )->xInUse = TRUE;
+    return MB_ENOERR;
+}
+
+static          BOOL
+prvxMBInstIsPooled( xMBInstance * pxInst )
+{
+    /* The default and the TCP instance are never returned to the pool. */
+    return ( pxInst > MB_DEFAULT_INSTANCE ) && ( pxInst < &xMBInstances[MB_INSTANCES_MAX] );
+}
+
+static void
+prvvMBInstRelease( xMBInstance * pxInst, BOOL xTaken )
+{
+    pxInst->eMBState = STATE_NOT_INITIALIZED;
+    if( xTaken )
+    {
+        pxInst->xInUse = FALSE;
+    }
+}
+
+eMBErrorCode
+eMBRegisterCB( UCHAR ucFunctionCode, pxMBFunctionHandler pxHandler )
+{
+    eMBErrorCode    eStatus;
+
+    if( ( 0 < ucFunctionCode ) && ( ucFunctionCode <= MB_FUNC_CODE_MAX ) )
+    {
+        /* A NULL handler removes the function code. */
+        xFuncHandlers[ucFunctionCode] = pxHandler;
+        eStatus = MB_ENOERR;
     }
     else
     {
@@ -322,18 +422,131 @@ eMBRegisterCB( UCHAR ucFunctionCode, pxMBFunctionHandler pxHandler )
     return eStatus;
 }
 
+#if MB_VIRTUAL_SLAVES_MAX > 0
+eMBErrorCode
+eMBRegisterVirtualSlave( UCHAR ucSlaveAddress, const xMBRegisterCB * pxRegisterCB )
+{
+    int             i;
+    eMBErrorCode    eStatus = MB_ENOERR;
+
+    if( ( ucSlaveAddress < MB_ADDRESS_MIN ) || ( ucSlaveAddress > MB_ADDRESS_MAX ) )
+    {
+        return MB_EINVAL;
+    }
+
+    ENTER_CRITICAL_SECTION(  );
+    i = aucMBSlaveIndex[ucSlaveAddress] - 1;
+    if( pxRegisterCB == NULL )
+    {
+        if( i >= 0 )
+        {
+            aucMBVirtualSlaveAddress[i] = MB_ADDRESS_BROADCAST;
+            aucMBSlaveIndex[ucSlaveAddress] = 0;
+        }
+    }
+    else
+    {
+        /* Use the existing slot of this address or a free one. */
+        for( i = ( i >= 0 ) ? i : 0; i < MB_VIRTUAL_SLAVES_MAX; i++ )
+        {
+            if( ( aucMBVirtualSlaveAddress[i] == MB_ADDRESS_BROADCAST ) ||
+                ( aucMBVirtualSlaveAddress[i] == ucSlaveAddress ) )
+            {
+                break;
+            }
+        }
+        if( i < MB_VIRTUAL_SLAVES_MAX )
+        {
+            /* Missing callbacks answer with an illegal data address. */
+            xMBVirtualSlaves[i].peMBRegInputCB = pxRegisterCB->peMBRegInputCB != NULL ?
+                pxRegisterCB->peMBRegInputCB : prveMBRegInputNone;
+            xMBVirtualSlaves[i].peMBRegHoldingCB = pxRegisterCB->peMBRegHoldingCB != NULL ?
+                pxRegisterCB->peMBRegHoldingCB : prveMBRegHoldingNone;
+            xMBVirtualSlaves[i].peMBRegCoilsCB = pxRegisterCB->peMBRegCoilsCB != NULL ?
+                pxRegisterCB->peMBRegCoilsCB : prveMBRegCoilsNone;
+            xMBVirtualSlaves[i].peMBRegDiscreteCB = pxRegisterCB->peMBRegDiscreteCB != NULL ?
+                pxRegisterCB->peMBRegDiscreteCB : prveMBRegDiscreteNone;
+            aucMBVirtualSlaveAddress[i] = ucSlaveAddress;
+            aucMBSlaveIndex[ucSlaveAddress] = ( UCHAR )( i + 1 );
+        }
+        else
+        {
+            eStatus = MB_ENORES;
+        }
+    }
+    EXIT_CRITICAL_SECTION(  );
+    return eStatus;
+}
+
+BOOL
+xMBIsVirtualSlave( UCHAR ucAddress )
+{
+    return aucMBSlaveIndex[ucAddress] != 0;
+}
+
+static          eMBErrorCode
+prveMBRegInputNone( UCHAR * pucRegBuffer, USHORT usAddress, USHORT usNRegs )
+{
+    return MB_ENOREG;
+}
+
+static          eMBErrorCode
+prveMBRegHoldingNone( UCHAR * pucRegBuffer, USHORT usAddress, USHORT usNRegs,
+                      eMBRegisterMode eMode )
+{
+    return MB_ENOREG;
+}
+
+static          eMBErrorCode
+prveMBRegCoilsNone( UCHAR * pucRegBuffer, USHORT usAddress, USHORT usNCoils,
+                    eMBRegisterMode eMode )
+{
+    return MB_ENOREG;
+}
+
+static          eMBErrorCode
+prveMBRegDiscreteNone( UCHAR * pucRegBuffer, USHORT usAddress, USHORT usNDiscrete )
+{
+    return MB_ENOREG;
+}
+#else
+eMBErrorCode
+eMBRegisterVirtualSlave( UCHAR ucSlaveAddress, const xMBRegisterCB * pxRegisterCB )
+{
+    return MB_ENORES;
+}
+
+BOOL
+xMBIsVirtualSlave( UCHAR ucAddress )
+{
+    return FALSE;
+}
+#endif
 
 eMBErrorCode
 eMBClose( void )
+{
+#if MB_TCP_ENABLED > 0
+    if( MB_TCP_INSTANCE->eMBState != STATE_NOT_INITIALIZED )
+    {
+        ( void )eMBInstClose( MB_TCP_INSTANCE );
+    }
+#endif
+    return eMBInstClose( MB_DEFAULT_INSTANCE );
+}
+
+eMBErrorCode
+eMBInstClose( xMBInstance * pxInst )
 {
     eMBErrorCode    eStatus = MB_ENOERR;
 
-    if( eMBState == STATE_DISABLED )
+    if( pxInst->eMBState == STATE_DISABLED )
     {
-        if( pvMBFrameCloseCur != NULL )
+        if( pxInst->pvMBFrameCloseCur != NULL )
         {
-            pvMBFrameCloseCur(  );
+            pxInst->pvMBFrameCloseCur( pxInst );
         }
+        prvvMBInstRelease( pxInst, prvxMBInstIsPooled( pxInst ) );
     }
     else
     {
@@ -344,14 +557,26 @@ eMBClose( void )
 
 eMBErrorCode
 eMBEnable( void )
+{
+#if MB_TCP_ENABLED > 0
+    if( MB_TCP_INSTANCE->eMBState == STATE_DISABLED )
+    {
+        ( void )eMBInstEnable( MB_TCP_INSTANCE );
+    }
+#endif
+    return eMBInstEnable( MB_DEFAULT_INSTANCE );
+}
+
+eMBErrorCode
+eMBInstEnable( xMBInstance * pxInst )
 {
     eMBErrorCode    eStatus = MB_ENOERR;
 
-    if( eMBState == STATE_DISABLED )
+    if( pxInst->eMBState == STATE_DISABLED )
     {
         /* Activate the protocol stack. */
-        pvMBFrameStartCur(  );
-        eMBState = STATE_ENABLED;
+        pxInst->pvMBFrameStartCur( pxInst );
+        pxInst->eMBState = STATE_ENABLED;
     }
     else
     {
@@ -362,16 +587,28 @@ eMBEnable( void )
 
 eMBErrorCode
 eMBDisable( void )
+{
+#if MB_TCP_ENABLED > 0
+    if( MB_TCP_INSTANCE->eMBState != STATE_NOT_INITIALIZED )
+    {
+        ( void )eMBInstDisable( MB_TCP_INSTANCE );
+    }
+#endif
+    return eMBInstDisable( MB_DEFAULT_INSTANCE );
+}
+
+eMBErrorCode
+eMBInstDisable( xMBInstance * pxInst )
 {
     eMBErrorCode    eStatus;
 
-    if( eMBState == STATE_ENABLED )
+    if( pxInst->eMBState == STATE_ENABLED )
     {
-        pvMBFrameStopCur(  );
-        eMBState = STATE_DISABLED;
+        pxInst->pvMBFrameStopCur( pxInst );
+        pxInst->eMBState = STATE_DISABLED;
         eStatus = MB_ENOERR;
     }
-    else if( eMBState == STATE_DISABLED )
+    else if( pxInst->eMBState == STATE_DISABLED )
     {
         eStatus = MB_ENOERR;
     }
@@ -385,82 +622,211 @@ eMBDisable( void )
 eMBErrorCode
 eMBPoll( void )
 {
-    static UCHAR   *ucMBFrame;
-    static UCHAR    ucRcvAddress;
-    static UCHAR    ucFunctionCode;
-    static USHORT   usLength;
-    static eMBException eException;
+#if MB_TCP_ENABLED > 0
+    if( MB_TCP_INSTANCE->eMBState == STATE_ENABLED )
+    {
+        ( void )eMBInstPoll( MB_TCP_INSTANCE );
+    }
+#endif
+    return eMBInstPoll( MB_DEFAULT_INSTANCE );
+}
+
+eMBErrorCode
+eMBPollWait( ULONG ulTimeoutMs )
+{
+    return eMBInstPollWait( MB_DEFAULT_INSTANCE, ulTimeoutMs );
+}
+
+eMBErrorCode
+eMBInstPollWait( xMBInstance * pxInst, ULONG ulTimeoutMs )
+{
+    if( pxInst->eMBState != STATE_ENABLED )
+    {
+        return MB_EILLSTATE;
+    }
+    if( !xMBPortEventWait( pxInst, ulTimeoutMs ) )
+    {
+#if MB_MASTER_ENABLED > 0
+        /* A master also has to check its response timeout. */
+        if( pxInst->xIsMaster )
+        {
+            ( void )eMBMasterPoll( pxInst );
+        }
+#endif
+        return MB_ETIMEDOUT;
+    }
+    return eMBInstPoll( pxInst );
+}
+
+eMBErrorCode
+eMBInstPoll( xMBInstance * pxInst )
+{
+    UCHAR           ucFunctionCode;
+    eMBException    eException;
+    pxMBFunctionHandler pxHandler;
 
-    int             i;
     eMBErrorCode    eStatus = MB_ENOERR;
-    eMBEventType    eEvent;
+    xMBEvent        xEvent;
 
     /* Check if the protocol stack is ready. */
-    if( eMBState != STATE_ENABLED )
+    if( pxInst->eMBState != STATE_ENABLED )
     {
         return MB_EILLSTATE;
     }
+#if MB_MASTER_ENABLED > 0
+    if( pxInst->xIsMaster )
+    {
+        return eMBMasterPoll( pxInst );
+    }
+#endif
 
     /* Check if there is a event available. If not return control to caller.
      * Otherwise we will handle the event. */
-    if( xMBPortEventGet( &eEvent ) == TRUE )
+    if( xMBPortEventGet( pxInst, &xEvent ) == TRUE )
     {
-        switch ( eEvent )
+        switch ( xEvent.eEvent )
         {
         case EV_READY:
             break;
 
         case EV_FRAME_RECEIVED:
-            eStatus = peMBFrameReceiveCur( &ucRcvAddress, &ucMBFrame, &usLength );
+            eStatus = pxInst->peMBFrameReceiveCur( pxInst, &pxInst->ucRcvAddress,
+                                                   &pxInst->pucMBFrame, &pxInst->usLength );
             if( eStatus == MB_ENOERR )
             {
               /*20211021: modify for flow influence*/  
 							/* Check if the frame is for us. If not ignore the frame. */
-                if( ( ucRcvAddress != ucMBAddress ) && ( ucRcvAddress != MB_ADDRESS_BROADCAST ) )
+                pxMBRegisterCBCur = &xMBDefaultRegisterCB;
+#if MB_VIRTUAL_SLAVES_MAX > 0
+                if( aucMBSlaveIndex[pxInst->ucRcvAddress] != 0 )
                 {
-                    break;
+                    pxMBRegisterCBCur = &xMBVirtualSlaves[aucMBSlaveIndex[pxInst->ucRcvAddress] - 1];
                 }
-            }
-
-        case EV_EXECUTE:
-            ucFunctionCode = ucMBFrame[MB_PDU_FUNC_OFF];
-            eException = MB_EX_ILLEGAL_FUNCTION;
-            for( i = 0; i < MB_FUNC_HANDLERS_MAX; i++ )
-            {
-                /* No more function handlers registered. Abort. */
-                if( xFuncHandlers[i].ucFunctionCode == 0 )
+                else
+#endif
+#if MB_GATEWAY_ENABLED > 0
+                if( ( pxInst->eMBCurrentMode == MB_TCP ) && xMBGatewayIsRouted( pxInst->ucRcvAddress ) )
                 {
+                    /* The gateway answers when the RTU slave has responded.
+                     * Reads served from its cache and requests it can not
+                     * take are answered here. */
+                    ucFunctionCode = pxInst->pucMBFrame[MB_PDU_FUNC_OFF];
+                    eException = eMBGatewayForward( pxInst->pucMBFrame, &pxInst->usLength );
+                    if( eException != MB_EX_NONE )
+                    {
+                        pxInst->usLength = 0;
+                        pxInst->pucMBFrame[pxInst->usLength++] = ( UCHAR )( ucFunctionCode | MB_FUNC_ERROR );
+                        pxInst->pucMBFrame[pxInst->usLength++] = eException;
+                    }
+                    if( pxInst->usLength != 0 )
+                    {
+                        eStatus = pxInst->peMBFrameSendCur( pxInst, pxInst->ucRcvAddress,
+                                                            pxInst->pucMBFrame, pxInst->usLength );
+                    }
                     break;
                 }
-                else if( xFuncHandlers[i].ucFunctionCode == ucFunctionCode )
+                else
+#endif
+                if( ( pxInst->ucRcvAddress != pxInst->ucMBAddress ) &&
+                    ( pxInst->ucRcvAddress != MB_ADDRESS_BROADCAST ) )
                 {
-                    eException = xFuncHandlers[i].pxHandler( ucMBFrame, &usLength );
                     break;
                 }
             }
 
+        case EV_EXECUTE:
+            ucFunctionCode = pxInst->pucMBFrame[MB_PDU_FUNC_OFF];
+            pxHandler = ( ucFunctionCode <= MB_FUNC_CODE_MAX ) ? xFuncHandlers[ucFunctionCode] : NULL;
+            if( pxHandler != NULL )
+            {
+                MB_TRACE( MB_TRACE_DISPATCH );
+                eException = pxHandler( pxInst->pucMBFrame, &pxInst->usLength );
+            }
+            else
+            {
+                eException = MB_EX_ILLEGAL_FUNCTION;
+            }
+
             /* If the request was not sent to the broadcast address we
              * return a reply. */
-            if( ucRcvAddress != MB_ADDRESS_BROADCAST )
+            if( pxInst->ucRcvAddress != MB_ADDRESS_BROADCAST )
             {
                 if( eException != MB_EX_NONE )
                 {
                     /* An exception occured. Build an error frame. */
-                    usLength = 0;
-                    ucMBFrame[usLength++] = ( UCHAR )( ucFunctionCode | MB_FUNC_ERROR );
-                    ucMBFrame[usLength++] = eException;
+                    pxInst->usLength = 0;
+                    pxInst->pucMBFrame[pxInst->usLength++] = ( UCHAR )( ucFunctionCode | MB_FUNC_ERROR );
+                    pxInst->pucMBFrame[pxInst->usLength++] = eException;
                 }
-                if( ( eMBCurrentMode == MB_ASCII ) && MB_ASCII_TIMEOUT_WAIT_BEFORE_SEND_MS )
+                if( ( pxInst->eMBCurrentMode == MB_ASCII ) && MB_ASCII_TIMEOUT_WAIT_BEFORE_SEND_MS )
                 {
                     vMBPortTimersDelay( MB_ASCII_TIMEOUT_WAIT_BEFORE_SEND_MS );
                 }                
-                eStatus = peMBFrameSendCur( ucMBAddress, ucMBFrame, usLength );
+                /* Answer with the address the request was sent to. This is
+                 * either our own or the one of a virtual slave. */
+                eStatus = pxInst->peMBFrameSendCur( pxInst, pxInst->ucRcvAddress,
+                                                    pxInst->pucMBFrame, pxInst->usLength );
             }
             break;
 
         case EV_FRAME_SENT:
+            MB_TRACE( MB_TRACE_FRAME_SENT );
             break;
         }
     }
     return MB_ENOERR;
 }
+
+/* ----------------------- Callbacks for the porting layer ------------------*/
+BOOL
+xMBPortCBByteReceived( xMBInstance * pxInst )
+{
+    return ( pxInst->pxMBFrameCBByteReceived != NULL ) ?
+        pxInst->pxMBFrameCBByteReceived( pxInst ) : FALSE;
+}
+
+BOOL
+xMBPortCBFrameReceived( xMBInstance * pxInst, USHORT usLength )
+{
+    return ( pxInst->pxMBFrameCBFrameReceived != NULL ) ?
+        pxInst->pxMBFrameCBFrameReceived( pxInst, usLength ) : FALSE;
+}
+
+BOOL
+xMBPortCBTransmitterEmpty( xMBInstance * pxInst )
+{
+    return ( pxInst->pxMBFrameCBTransmitterEmpty != NULL ) ?
+        pxInst->pxMBFrameCBTransmitterEmpty( pxInst ) : FALSE;
+}
+
+BOOL
+xMBPortCBTransmitComplete( xMBInstance * pxInst )
+{
+    return ( pxInst->pxMBFrameCBTransmitComplete != NULL ) ?
+        pxInst->pxMBFrameCBTransmitComplete( pxInst ) : FALSE;
+}
+
+BOOL
+xMBPortCBTimerExpired( xMBInstance * pxInst )
+{
+    return ( pxInst->pxMBPortCBTimerExpired != NULL ) ?
+        pxInst->pxMBPortCBTimerExpired( pxInst ) : FALSE;
+}
+
+static          BOOL
+prvxMBDefaultByteReceived( void )
+{
+    return xMBPortCBByteReceived( MB_DEFAULT_INSTANCE );
+}
+
+static          BOOL
+prvxMBDefaultTransmitterEmpty( void )
+{
+    return xMBPortCBTransmitterEmpty( MB_DEFAULT_INSTANCE );
+}
+
+static          BOOL
+prvxMBDefaultTimerExpired( void )
+{
+    return xMBPortCBTimerExpired( MB_DEFAULT_INSTANCE );
+}
@@ -39,6 +39,7 @@
 #include "mbconfig.h"
 #include "mbascii.h"
 #include "mbframe.h"
+#include "mbinstance.h"
 
 #include "mbcrc.h"
 #include "mbport.h"
@@ -54,29 +55,6 @@
 #define MB_SER_PDU_ADDR_OFF     0       /*!< Offset of slave address in Ser-PDU. */
 #define MB_SER_PDU_PDU_OFF      1       /*!< Offset of Modbus-PDU in Ser-PDU. */
 
-/* ----------------------- Type definitions ---------------------------------*/
-typedef enum
-{
-    STATE_RX_IDLE,              /*!< Receiver is in idle state. */
-    STATE_RX_RCV,               /*!< Frame is beeing received. */
-    STATE_RX_WAIT_EOF           /*!< Wait for End of Frame. */
-} eMBRcvState;
-
-typedef enum
-{
-    STATE_TX_IDLE,              /*!< Transmitter is in idle state. */
-    STATE_TX_START,             /*!< Starting transmission (':' sent). */
-    STATE_TX_DATA,              /*!< Sending of data (Address, Data, LRC). */
-    STATE_TX_END,               /*!< End of transmission. */
-    STATE_TX_NOTIFY             /*!< Notify sender that the frame has been sent. */
-} eMBSndState;
-
-typedef enum
-{
-    BYTE_HIGH_NIBBLE,           /*!< Character for high nibble of byte. */
-    BYTE_LOW_NIBBLE             /*!< Character for low nibble of byte. */
-} eMBBytePos;
-
 /* ----------------------- Static functions ---------------------------------*/
 static UCHAR    prvucMBCHAR2BIN( UCHAR ucCharacter );
 
@@ -84,39 +62,23 @@ static UCHAR    prvucMBBIN2CHAR( UCHAR ucByte );
 
 static UCHAR    prvucMBLRC( UCHAR * pucFrame, USHORT usLen );
 
-/* ----------------------- Static variables ---------------------------------*/
-static volatile eMBSndState eSndState;
-static volatile eMBRcvState eRcvState;
-
-/* We reuse the Modbus RTU buffer because only one buffer is needed and the
- * RTU buffer is bigger. */
-extern volatile UCHAR ucRTUBuf[];
-static volatile UCHAR *ucASCIIBuf = ucRTUBuf;
-
-static volatile USHORT usRcvBufferPos;
-static volatile eMBBytePos eBytePos;
-
-static volatile UCHAR *pucSndBufferCur;
-static volatile USHORT usSndBufferCount;
-
-static volatile UCHAR ucLRC;
-static volatile UCHAR ucMBLFCharacter;
-
 /* ----------------------- Start implementation -----------------------------*/
 eMBErrorCode
-eMBASCIIInit( UCHAR ucSlaveAddress, UCHAR ucPort, ULONG ulBaudRate, eMBParity eParity )
+eMBASCIIInit( xMBInstance * pxInst, UCHAR ucSlaveAddress, UCHAR ucPort, ULONG ulBaudRate,
+              eMBParity eParity )
 {
+    xMBASCIIState  *pxASCII = &pxInst->xSer.xASCII;
     eMBErrorCode    eStatus = MB_ENOERR;
     ( void )ucSlaveAddress;
     
     ENTER_CRITICAL_SECTION(  );
-    ucMBLFCharacter = MB_ASCII_DEFAULT_LF;
+    pxASCII->ucMBLFCharacter = MB_ASCII_DEFAULT_LF;
 
-    if( xMBPortSerialInit( ucPort, ulBaudRate, 7, eParity ) != TRUE )
+    if( xMBPortSerialInit( pxInst, ucPort, ulBaudRate, 7, eParity ) != TRUE )
     {
         eStatus = MB_EPORTERR;
     }
-    else if( xMBPortTimersInit( MB_ASCII_TIMEOUT_SEC * 20000UL ) != TRUE )
+    else if( xMBPortTimersInit( pxInst, MB_ASCII_TIMEOUT_SEC * 20000UL ) != TRUE )
     {
         eStatus = MB_EPORTERR;
     }
@@ -127,50 +89,53 @@ eMBASCIIInit( UCHAR ucSlaveAddress, UCHAR ucPort, ULONG ulBaudRate, eMBParity eP
 }
 
 void
-eMBASCIIStart( void )
+eMBASCIIStart( xMBInstance * pxInst )
 {
+    xMBASCIIState  *pxASCII = &pxInst->xSer.xASCII;
+
     ENTER_CRITICAL_SECTION(  );
-    vMBPortSerialEnable( TRUE, FALSE );
-    eRcvState = STATE_RX_IDLE;
+    vMBPortSerialEnable( pxInst, TRUE, FALSE );
+    pxASCII->eRcvState = STATE_ASCII_RX_IDLE;
     EXIT_CRITICAL_SECTION(  );
 
     /* No special startup required for ASCII. */
-    ( void )xMBPortEventPost( EV_READY );
+    ( void )xMBPortEventPost( pxInst, EV_READY );
 }
 
 void
-eMBASCIIStop( void )
+eMBASCIIStop( xMBInstance * pxInst )
 {
     ENTER_CRITICAL_SECTION(  );
-    vMBPortSerialEnable( FALSE, FALSE );
-    vMBPortTimersDisable(  );
+    vMBPortSerialEnable( pxInst, FALSE, FALSE );
+    vMBPortTimersDisable( pxInst );
     EXIT_CRITICAL_SECTION(  );
 }
 
 eMBErrorCode
-eMBASCIIReceive( UCHAR * pucRcvAddress, UCHAR ** pucFrame, USHORT * pusLength )
+eMBASCIIReceive( xMBInstance * pxInst, UCHAR * pucRcvAddress, UCHAR ** pucFrame, USHORT * pusLength )
 {
+    xMBASCIIState  *pxASCII = &pxInst->xSer.xASCII;
     eMBErrorCode    eStatus = MB_ENOERR;
 
     ENTER_CRITICAL_SECTION(  );
-    assert( usRcvBufferPos < MB_SER_PDU_SIZE_MAX );
+    assert( pxASCII->usRcvBufferPos < MB_SER_PDU_SIZE_MAX );
 
     /* Length and CRC check */
-    if( ( usRcvBufferPos >= MB_SER_PDU_SIZE_MIN )
-        && ( prvucMBLRC( ( UCHAR * ) ucASCIIBuf, usRcvBufferPos ) == 0 ) )
+    if( ( pxASCII->usRcvBufferPos >= MB_SER_PDU_SIZE_MIN )
+        && ( prvucMBLRC( ( UCHAR * ) pxInst->ucSerBuf, pxASCII->usRcvBufferPos ) == 0 ) )
     {
         /* Save the address field. All frames are passed to the upper layed
          * and the decision if a frame is used is done there.
          */
-        *pucRcvAddress = ucASCIIBuf[MB_SER_PDU_ADDR_OFF];
+        *pucRcvAddress = pxInst->ucSerBuf[MB_SER_PDU_ADDR_OFF];
 
         /* Total length of Modbus-PDU is Modbus-Serial-Line-PDU minus
          * size of address field and CRC checksum.
          */
-        *pusLength = ( USHORT )( usRcvBufferPos - MB_SER_PDU_PDU_OFF - MB_SER_PDU_SIZE_LRC );
+        *pusLength = ( USHORT )( pxASCII->usRcvBufferPos - MB_SER_PDU_PDU_OFF - MB_SER_PDU_SIZE_LRC );
 
         /* Return the start of the Modbus PDU to the caller. */
-        *pucFrame = ( UCHAR * ) & ucASCIIBuf[MB_SER_PDU_PDU_OFF];
+        *pucFrame = ( UCHAR * ) & pxInst->ucSerBuf[MB_SER_PDU_PDU_OFF];
     }
     else
     {
@@ -181,8 +146,9 @@ eMBASCIIReceive( UCHAR * pucRcvAddress, UCHAR ** pucFrame, USHORT * pusLength )
 }
 
 eMBErrorCode
-eMBASCIISend( UCHAR ucSlaveAddress, const UCHAR * pucFrame, USHORT usLength )
+eMBASCIISend( xMBInstance * pxInst, UCHAR ucSlaveAddress, const UCHAR * pucFrame, USHORT usLength )
 {
+    xMBASCIIState  *pxASCII = &pxInst->xSer.xASCII;
     eMBErrorCode    eStatus = MB_ENOERR;
     UCHAR           usLRC;
 
@@ -191,23 +157,23 @@ eMBASCIISend( UCHAR ucSlaveAddress, const UCHAR * pucFrame, USHORT usLength )
      * slow with processing the received frame and the master sent another
      * frame on the network. We have to abort sending the frame.
      */
-    if( eRcvState == STATE_RX_IDLE )
+    if( pxASCII->eRcvState == STATE_ASCII_RX_IDLE )
     {
         /* First byte before the Modbus-PDU is the slave address. */
-        pucSndBufferCur = ( UCHAR * ) pucFrame - 1;
-        usSndBufferCount = 1;
+        pxASCII->pucSndBufferCur = ( UCHAR * ) pucFrame - 1;
+        pxASCII->usSndBufferCount = 1;
 
         /* Now copy the Modbus-PDU into the Modbus-Serial-Line-PDU. */
-        pucSndBufferCur[MB_SER_PDU_ADDR_OFF] = ucSlaveAddress;
-        usSndBufferCount += usLength;
+        pxASCII->pucSndBufferCur[MB_SER_PDU_ADDR_OFF] = ucSlaveAddress;
+        pxASCII->usSndBufferCount += usLength;
 
         /* Calculate LRC checksum for Modbus-Serial-Line-PDU. */
-        usLRC = prvucMBLRC( ( UCHAR * ) pucSndBufferCur, usSndBufferCount );
-        ucASCIIBuf[usSndBufferCount++] = usLRC;
+        usLRC = prvucMBLRC( ( UCHAR * ) pxASCII->pucSndBufferCur, pxASCII->usSndBufferCount );
+        pxInst->ucSerBuf[pxASCII->usSndBufferCount++] = usLRC;
 
         /* Activate the transmitter. */
-        eSndState = STATE_TX_START;
-        vMBPortSerialEnable( FALSE, TRUE );
+        pxASCII->eSndState = STATE_ASCII_TX_START;
+        vMBPortSerialEnable( pxInst, FALSE, TRUE );
     }
     else
     {
@@ -218,107 +184,108 @@ eMBASCIISend( UCHAR ucSlaveAddress, const UCHAR * pucFrame, USHORT usLength )
 }
 
 BOOL
-xMBASCIIReceiveFSM( void )
+xMBASCIIReceiveFSM( xMBInstance * pxInst )
 {
+    xMBASCIIState  *pxASCII = &pxInst->xSer.xASCII;
     BOOL            xNeedPoll = FALSE;
     UCHAR           ucByte;
     UCHAR           ucResult;
 
-    assert( eSndState == STATE_TX_IDLE );
+    assert( pxASCII->eSndState == STATE_ASCII_TX_IDLE );
 
-    ( void )xMBPortSerialGetByte( ( CHAR * ) & ucByte );
-    switch ( eRcvState )
+    ( void )xMBPortSerialGetByte( pxInst, ( CHAR * ) & ucByte );
+    switch ( pxASCII->eRcvState )
     {
         /* A new character is received. If the character is a ':' the input
          * buffer is cleared. A CR-character signals the end of the data
          * block. Other characters are part of the data block and their
          * ASCII value is converted back to a binary representation.
          */
-    case STATE_RX_RCV:
+    case STATE_ASCII_RX_RCV:
         /* Enable timer for character timeout. */
-        vMBPortTimersEnable(  );
+        vMBPortTimersEnable( pxInst );
         if( ucByte == ':' )
         {
             /* Empty receive buffer. */
-            eBytePos = BYTE_HIGH_NIBBLE;
-            usRcvBufferPos = 0;
+            pxASCII->eBytePos = BYTE_HIGH_NIBBLE;
+            pxASCII->usRcvBufferPos = 0;
         }
         else if( ucByte == MB_ASCII_DEFAULT_CR )
         {
-            eRcvState = STATE_RX_WAIT_EOF;
+            pxASCII->eRcvState = STATE_ASCII_RX_WAIT_EOF;
         }
         else
         {
             ucResult = prvucMBCHAR2BIN( ucByte );
-            switch ( eBytePos )
+            switch ( pxASCII->eBytePos )
             {
                 /* High nibble of the byte comes first. We check for
                  * a buffer overflow here. */
             case BYTE_HIGH_NIBBLE:
-                if( usRcvBufferPos < MB_SER_PDU_SIZE_MAX )
+                if( pxASCII->usRcvBufferPos < MB_SER_PDU_SIZE_MAX )
                 {
-                    ucASCIIBuf[usRcvBufferPos] = ( UCHAR )( ucResult << 4 );
-                    eBytePos = BYTE_LOW_NIBBLE;
+                    pxInst->ucSerBuf[pxASCII->usRcvBufferPos] = ( UCHAR )( ucResult << 4 );
+                    pxASCII->eBytePos = BYTE_LOW_NIBBLE;
                     break;
                 }
                 else
                 {
                     /* not handled in Modbus specification but seems
                      * a resonable implementation. */
-                    eRcvState = STATE_RX_IDLE;
+                    pxASCII->eRcvState = STATE_ASCII_RX_IDLE;
                     /* Disable previously activated timer because of error state. */
-                    vMBPortTimersDisable(  );
+                    vMBPortTimersDisable( pxInst );
                 }
                 break;
 
             case BYTE_LOW_NIBBLE:
-                ucASCIIBuf[usRcvBufferPos] |= ucResult;
-                usRcvBufferPos++;
-                eBytePos = BYTE_HIGH_NIBBLE;
+                pxInst->ucSerBuf[pxASCII->usRcvBufferPos] |= ucResult;
+                pxASCII->usRcvBufferPos++;
+                pxASCII->eBytePos = BYTE_HIGH_NIBBLE;
                 break;
             }
         }
         break;
 
-    case STATE_RX_WAIT_EOF:
-        if( ucByte == ucMBLFCharacter )
+    case STATE_ASCII_RX_WAIT_EOF:
+        if( ucByte == pxASCII->ucMBLFCharacter )
         {
             /* Disable character timeout timer because all characters are
              * received. */
-            vMBPortTimersDisable(  );
+            vMBPortTimersDisable( pxInst );
             /* Receiver is again in idle state. */
-            eRcvState = STATE_RX_IDLE;
+            pxASCII->eRcvState = STATE_ASCII_RX_IDLE;
 
             /* Notify the caller of eMBASCIIReceive that a new frame
              * was received. */
-            xNeedPoll = xMBPortEventPost( EV_FRAME_RECEIVED );
+            xNeedPoll = xMBPortEventPost( pxInst, EV_FRAME_RECEIVED );
         }
         else if( ucByte == ':' )
         {
             /* Empty receive buffer and back to receive state. */
-            eBytePos = BYTE_HIGH_NIBBLE;
-            usRcvBufferPos = 0;
-            eRcvState = STATE_RX_RCV;
+            pxASCII->eBytePos = BYTE_HIGH_NIBBLE;
+            pxASCII->usRcvBufferPos = 0;
+            pxASCII->eRcvState = STATE_ASCII_RX_RCV;
 
             /* Enable timer for character timeout. */
-            vMBPortTimersEnable(  );
+            vMBPortTimersEnable( pxInst );
         }
         else
         {
             /* Frame is not okay. Delete entire frame. */
-            eRcvState = STATE_RX_IDLE;
+            pxASCII->eRcvState = STATE_ASCII_RX_IDLE;
         }
         break;
 
-    case STATE_RX_IDLE:
+    case STATE_ASCII_RX_IDLE:
         if( ucByte == ':' )
         {
             /* Enable timer for character timeout. */
-            vMBPortTimersEnable(  );
+            vMBPortTimersEnable( pxInst );
             /* Reset the input buffers to store the frame. */
-            usRcvBufferPos = 0;;
-            eBytePos = BYTE_HIGH_NIBBLE;
-            eRcvState = STATE_RX_RCV;
+            pxASCII->usRcvBufferPos = 0;;
+            pxASCII->eBytePos = BYTE_HIGH_NIBBLE;
+            pxASCII->eRcvState = STATE_ASCII_RX_RCV;
         }
         break;
     }
@@ -327,79 +294,80 @@ xMBASCIIReceiveFSM( void )
 }
 
 BOOL
-xMBASCIITransmitFSM( void )
+xMBASCIITransmitFSM( xMBInstance * pxInst )
 {
+    xMBASCIIState  *pxASCII = &pxInst->xSer.xASCII;
     BOOL            xNeedPoll = FALSE;
     UCHAR           ucByte;
 
-    assert( eRcvState == STATE_RX_IDLE );
-    switch ( eSndState )
+    assert( pxASCII->eRcvState == STATE_ASCII_RX_IDLE );
+    switch ( pxASCII->eSndState )
     {
         /* Start of transmission. The start of a frame is defined by sending
          * the character ':'. */
-    case STATE_TX_START:
+    case STATE_ASCII_TX_START:
         ucByte = ':';
-        xMBPortSerialPutByte( ( CHAR )ucByte );
-        eSndState = STATE_TX_DATA;
-        eBytePos = BYTE_HIGH_NIBBLE;
+        xMBPortSerialPutByte( pxInst, ( CHAR )ucByte );
+        pxASCII->eSndState = STATE_ASCII_TX_DATA;
+        pxASCII->eBytePos = BYTE_HIGH_NIBBLE;
         break;
 
         /* Send the data block. Each data byte is encoded as a character hex
          * stream with the high nibble sent first and the low nibble sent
          * last. If all data bytes are exhausted we send a '\r' character
          * to end the transmission. */
-    case STATE_TX_DATA:
-        if( usSndBufferCount > 0 )
+    case STATE_ASCII_TX_DATA:
+        if( pxASCII->usSndBufferCount > 0 )
         {
-            switch ( eBytePos )
+            switch ( pxASCII->eBytePos )
             {
             case BYTE_HIGH_NIBBLE:
-                ucByte = prvucMBBIN2CHAR( ( UCHAR )( *pucSndBufferCur >> 4 ) );
-                xMBPortSerialPutByte( ( CHAR ) ucByte );
-                eBytePos = BYTE_LOW_NIBBLE;
+                ucByte = prvucMBBIN2CHAR( ( UCHAR )( *pxASCII->pucSndBufferCur >> 4 ) );
+                xMBPortSerialPutByte( pxInst, ( CHAR ) ucByte );
+                pxASCII->eBytePos = BYTE_LOW_NIBBLE;
                 break;
 
             case BYTE_LOW_NIBBLE:
-                ucByte = prvucMBBIN2CHAR( ( UCHAR )( *pucSndBufferCur & 0x0F ) );
-                xMBPortSerialPutByte( ( CHAR )ucByte );
-                pucSndBufferCur++;
-                eBytePos = BYTE_HIGH_NIBBLE;
-                usSndBufferCount--;
+                ucByte = prvucMBBIN2CHAR( ( UCHAR )( *pxASCII->pucSndBufferCur & 0x0F ) );
+                xMBPortSerialPutByte( pxInst, ( CHAR )ucByte );
+                pxASCII->pucSndBufferCur++;
+                pxASCII->eBytePos = BYTE_HIGH_NIBBLE;
+                pxASCII->usSndBufferCount--;
                 break;
             }
         }
         else
         {
-            xMBPortSerialPutByte( MB_ASCII_DEFAULT_CR );
-            eSndState = STATE_TX_END;
+            xMBPortSerialPutByte( pxInst, MB_ASCII_DEFAULT_CR );
+            pxASCII->eSndState = STATE_ASCII_TX_END;
         }
         break;
 
         /* Finish the frame by sending a LF character. */
-    case STATE_TX_END:
-        xMBPortSerialPutByte( ( CHAR )ucMBLFCharacter );
+    case STATE_ASCII_TX_END:
+        xMBPortSerialPutByte( pxInst, ( CHAR )pxASCII->ucMBLFCharacter );
         /* We need another state to make sure that the CR character has
          * been sent. */
-        eSndState = STATE_TX_NOTIFY;
+        pxASCII->eSndState = STATE_ASCII_TX_NOTIFY;
         break;
 
         /* Notify the task which called eMBASCIISend that the frame has
          * been sent. */
-    case STATE_TX_NOTIFY:
-        eSndState = STATE_TX_IDLE;
-        xNeedPoll = xMBPortEventPost( EV_FRAME_SENT );
+    case STATE_ASCII_TX_NOTIFY:
+        pxASCII->eSndState = STATE_ASCII_TX_IDLE;
+        xNeedPoll = xMBPortEventPost( pxInst, EV_FRAME_SENT );
 
         /* Disable transmitter. This prevents another transmit buffer
          * empty interrupt. */
-        vMBPortSerialEnable( TRUE, FALSE );
-        eSndState = STATE_TX_IDLE;
+        vMBPortSerialEnable( pxInst, TRUE, FALSE );
+        pxASCII->eSndState = STATE_ASCII_TX_IDLE;
         break;
 
         /* We should not get a transmitter event if the transmitter is in
          * idle state.  */
-    case STATE_TX_IDLE:
+    case STATE_ASCII_TX_IDLE:
         /* enable receiver/disable transmitter. */
-        vMBPortSerialEnable( TRUE, FALSE );
+        vMBPortSerialEnable( pxInst, TRUE, FALSE );
         break;
     }
 
@@ -407,23 +375,25 @@ xMBASCIITransmitFSM( void )
 }
 
 BOOL
-xMBASCIITimerT1SExpired( void )
+xMBASCIITimerT1SExpired( xMBInstance * pxInst )
 {
-    switch ( eRcvState )
+    xMBASCIIState  *pxASCII = &pxInst->xSer.xASCII;
+
+    switch ( pxASCII->eRcvState )
     {
         /* If we have a timeout we go back to the idle state and wait for
          * the next frame.
          */
-    case STATE_RX_RCV:
-    case STATE_RX_WAIT_EOF:
-        eRcvState = STATE_RX_IDLE;
+    case STATE_ASCII_RX_RCV:
+    case STATE_ASCII_RX_WAIT_EOF:
+        pxASCII->eRcvState = STATE_ASCII_RX_IDLE;
         break;
 
     default:
-        assert( ( eRcvState == STATE_RX_RCV ) || ( eRcvState == STATE_RX_WAIT_EOF ) );
+        assert( ( pxASCII->eRcvState == STATE_ASCII_RX_RCV ) || ( pxASCII->eRcvState == STATE_ASCII_RX_WAIT_EOF ) );
         break;
     }
-    vMBPortTimersDisable(  );
+    vMBPortTimersDisable( pxInst );
 
     /* no context switch required. */
     return FALSE;
@@ -39,6 +39,8 @@
 #include "mbframe.h"
 #include "mbproto.h"
 #include "mbconfig.h"
+#include "mbfunc.h"
+#include "mbtrace.h"
 
 /* ----------------------- Defines ------------------------------------------*/
 #define MB_PDU_FUNC_READ_ADDR_OFF           ( MB_PDU_DATA_OFF )
@@ -111,9 +113,10 @@ eMBFuncReadCoils( UCHAR * pucFrame, USHORT * usLen )
             *pucFrameCur++ = ucNBytes;
             *usLen += 1;
 
+            MB_TRACE( MB_TRACE_REG_CB );
             eRegStatus =
-                eMBRegCoilsCB( pucFrameCur, usRegAddress, usCoilCount,
-                               MB_REG_READ );
+                pxMBRegisterCBCur->peMBRegCoilsCB( pucFrameCur, usRegAddress, usCoilCount,
+                                                   MB_REG_READ );
 
             /* If an error occured convert it into a Modbus exception. */
             if( eRegStatus != MB_ENOERR )
@@ -171,8 +174,9 @@ eMBFuncWriteCoil( UCHAR * pucFrame, USHORT * usLen )
             {
                 ucBuf[0] = 0;
             }
+            MB_TRACE( MB_TRACE_REG_CB );
             eRegStatus =
-                eMBRegCoilsCB( &ucBuf[0], usRegAddress, 1, MB_REG_WRITE );
+                pxMBRegisterCBCur->peMBRegCoilsCB( &ucBuf[0], usRegAddress, 1, MB_REG_WRITE );
 
             /* If an error occured convert it into a Modbus exception. */
             if( eRegStatus != MB_ENOERR )
@@ -233,9 +237,10 @@ eMBFuncWriteMultipleCoils( UCHAR * pucFrame, USHORT * usLen )
             ( usCoilCnt <= MB_PDU_FUNC_WRITE_MUL_COILCNT_MAX ) &&
             ( ucByteCountVerify == ucByteCount ) )
         {
+            MB_TRACE( MB_TRACE_REG_CB );
             eRegStatus =
-                eMBRegCoilsCB( &pucFrame[MB_PDU_FUNC_WRITE_MUL_VALUES_OFF],
-                               usRegAddress, usCoilCnt, MB_REG_WRITE );
+                pxMBRegisterCBCur->peMBRegCoilsCB( &pucFrame[MB_PDU_FUNC_WRITE_MUL_VALUES_OFF],
+                                                   usRegAddress, usCoilCnt, MB_REG_WRITE );
 
             /* If an error occured convert it into a Modbus exception. */
             if( eRegStatus != MB_ENOERR )
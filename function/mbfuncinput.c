@@ -39,6 +39,8 @@
 #include "mbframe.h"
 #include "mbproto.h"
 #include "mbconfig.h"
+#include "mbfunc.h"
+#include "mbtrace.h"
 
 /* ----------------------- Defines ------------------------------------------*/
 #define MB_PDU_FUNC_READ_ADDR_OFF           ( MB_PDU_DATA_OFF )
@@ -91,8 +93,9 @@ eMBFuncReadInputRegister( UCHAR * pucFrame, USHORT * usLen )
             *pucFrameCur++ = ( UCHAR )( usRegCount * 2 );
             *usLen += 1;
 
+            MB_TRACE( MB_TRACE_REG_CB );
             eRegStatus =
-                eMBRegInputCB( pucFrameCur, usRegAddress, usRegCount );
+                pxMBRegisterCBCur->peMBRegInputCB( pucFrameCur, usRegAddress, usRegCount );
 
             /* If an error occured convert it into a Modbus exception. */
             if( eRegStatus != MB_ENOERR )
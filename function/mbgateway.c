@@ -0,0 +1,548 @@
+/* 
+ * FreeModbus Libary: A portable Modbus implementation for Modbus ASCII/RTU.
+ * Copyright (c) 2006-2018 Christian Walter <cwalter@embedded-solutions.at>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* ----------------------- System includes ----------------------------------*/
+#include "stdlib.h"
+#include "string.h"
+
+/* ----------------------- Platform includes --------------------------------*/
+#include "port.h"
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "mb.h"
+#include "mbconfig.h"
+#include "mbframe.h"
+#include "mbproto.h"
+#include "mbport.h"
+#include "mbtcp.h"
+#include "mbinstance.h"
+#include "mbmaster.h"
+#include "mbutils.h"
+#include "mbgateway.h"
+
+#if MB_GATEWAY_ENABLED > 0
+
+#if ( MB_TCP_ENABLED == 0 ) || ( MB_MASTER_ENABLED == 0 )
+#error "The Modbus gateway requires MB_TCP_ENABLED and MB_MASTER_ENABLED"
+#endif
+
+/* ----------------------- Defines ------------------------------------------*/
+#define MB_PDU_REQ_ADDR_OFF             ( MB_PDU_DATA_OFF + 0 )
+#define MB_PDU_REQ_CNT_OFF              ( MB_PDU_DATA_OFF + 2 )
+#define MB_PDU_REQ_READ_SIZE            ( 5 )
+#define MB_PDU_REQ_RW_WRITE_ADDR_OFF    ( MB_PDU_DATA_OFF + 4 )
+#define MB_PDU_REQ_RW_WRITE_CNT_OFF     ( MB_PDU_DATA_OFF + 6 )
+#define MB_PDU_RSP_BYTECNT_OFF          ( MB_PDU_DATA_OFF + 0 )
+#define MB_PDU_RSP_VALUES_OFF           ( MB_PDU_DATA_OFF + 1 )
+
+#define MB_GATEWAY_CACHE_BITS_MAX       ( 2000 )
+#define MB_GATEWAY_CACHE_REGS_MAX       ( 125 )
+
+/* ----------------------- Type definitions ---------------------------------*/
+typedef enum
+{
+    STATE_GW_FREE,              /*!< Entry is unused. */
+    STATE_GW_QUEUED,            /*!< Request is queued or sent by the master. */
+    STATE_GW_DONE,              /*!< Response waits for the TCP port. */
+    STATE_GW_DROP               /*!< Connection closed, discard the response. */
+} eMBGatewayState;
+
+typedef struct
+{
+    UCHAR           ucUnitId;
+    UCHAR           ucPriority;
+    USHORT          usTimeoutMs;
+} xMBGatewayRoute;
+
+/* The ADU buffer holds the request and is overwritten by the response. The
+ * MBAP header stays as received. */
+typedef struct
+{
+    eMBGatewayState eState;
+    UCHAR           ucConnection;       /*!< TCP connection the request came from. */
+    xMBMasterRequest xReq;
+    USHORT          usLength;
+    UCHAR           aucADU[MB_TCP_ADU_SIZE_MAX];
+} xMBGatewayEntry;
+
+#if MB_GATEWAY_CACHE_ENABLED > 0
+/* A snapshot of a range of one slave. The refresh request reads the whole
+ * range into the snapshot buffer. */
+typedef struct
+{
+    UCHAR           ucUnitId;
+    UCHAR           ucFunctionCode;
+    USHORT          usAddress;
+    USHORT          usCount;
+    USHORT          usMaxAgeMs;
+    BOOL            xValid;             /*!< Snapshot can be used. */
+    BOOL            xWanted;            /*!< Read by a client since the last refresh. */
+    BOOL            xStale;             /*!< Written while the refresh was in progress. */
+    ULONG           ulTimestamp;        /*!< Tick at the start of the refresh of the snapshot. */
+    ULONG           ulRefreshStart;
+    xMBMasterRequest xReq;
+    union
+    {
+        USHORT          ausRegs[MB_GATEWAY_CACHE_REGS_MAX];
+        UCHAR           aucBits[( MB_GATEWAY_CACHE_BITS_MAX + 7 ) / 8];
+    } xData;
+} xMBGatewayCacheRange;
+#endif
+
+/* ----------------------- Static variables ---------------------------------*/
+static xMBInstance *pxMBGatewayMaster;
+static xMBGatewayRoute xMBGatewayRoutes[MB_GATEWAY_ROUTES_MAX];
+static UCHAR    ucMBGatewayRoutes;
+static xMBGatewayEntry xMBGatewayEntries[MB_GATEWAY_QUEUE_SIZE];
+#if MB_GATEWAY_CACHE_ENABLED > 0
+static xMBGatewayCacheRange xMBGatewayCache[MB_GATEWAY_CACHE_RANGES];
+static UCHAR    ucMBGatewayCacheRanges;
+static xMBGatewayCacheStats xMBGatewayCacheCounters;
+#endif
+
+/* ----------------------- Static functions ---------------------------------*/
+static xMBGatewayRoute *prvpxMBGatewayFindRoute( UCHAR ucUnitId );
+static void     prvvMBGatewayDone( xMBMasterRequest * pxReq, eMBErrorCode eStatus );
+#if MB_GATEWAY_CACHE_ENABLED > 0
+static BOOL     prvxMBGatewayCacheRead( UCHAR ucUnitId, UCHAR * pucFrame, USHORT * pusLength );
+static void     prvvMBGatewayCacheWrite( UCHAR ucUnitId, const UCHAR * pucFrame );
+static void     prvvMBGatewayCacheRefresh( void );
+static void     prvvMBGatewayCacheDone( xMBMasterRequest * pxReq, eMBErrorCode eStatus );
+#endif
+
+/* ----------------------- Start implementation -----------------------------*/
+eMBErrorCode
+eMBGatewayInit( xMBInstance * pxMaster )
+{
+    if( ( pxMaster == NULL ) || !pxMaster->xIsMaster )
+    {
+        return MB_EINVAL;
+    }
+    pxMBGatewayMaster = pxMaster;
+    return MB_ENOERR;
+}
+
+eMBErrorCode
+eMBGatewayAddRoute( UCHAR ucUnitId, UCHAR ucPriority, USHORT usTimeoutMs )
+{
+    xMBGatewayRoute *pxRoute;
+
+    if( ( ucUnitId < MB_ADDRESS_MIN ) || ( ucUnitId > MB_ADDRESS_MAX ) )
+    {
+        return MB_EINVAL;
+    }
+    pxRoute = prvpxMBGatewayFindRoute( ucUnitId );
+    if( pxRoute == NULL )
+    {
+        if( ucMBGatewayRoutes >= MB_GATEWAY_ROUTES_MAX )
+        {
+            return MB_ENORES;
+        }
+        pxRoute = &xMBGatewayRoutes[ucMBGatewayRoutes++];
+        pxRoute->ucUnitId = ucUnitId;
+    }
+    pxRoute->ucPriority = ucPriority;
+    pxRoute->usTimeoutMs = usTimeoutMs;
+    return MB_ENOERR;
+}
+
+BOOL
+xMBGatewayIsRouted( UCHAR ucUnitId )
+{
+    return ( pxMBGatewayMaster != NULL ) && ( prvpxMBGatewayFindRoute( ucUnitId ) != NULL );
+}
+
+eMBException
+eMBGatewayForward( UCHAR * pucFrame, USHORT * pusLength )
+{
+    const UCHAR    *pucADU = pucFrame - MB_TCP_FUNC;
+    xMBGatewayRoute *pxRoute = prvpxMBGatewayFindRoute( pucADU[MB_TCP_UID] );
+    xMBGatewayEntry *pxEntry = NULL;
+    xMBMasterRequest *pxReq;
+    USHORT          usLength = *pusLength;
+    UCHAR           i;
+
+#if MB_GATEWAY_CACHE_ENABLED > 0
+    if( ( pxRoute != NULL ) && prvxMBGatewayCacheRead( pxRoute->ucUnitId, pucFrame, pusLength ) )
+    {
+        return MB_EX_NONE;
+    }
+#endif
+    *pusLength = 0;
+    for( i = 0; i < MB_GATEWAY_QUEUE_SIZE; i++ )
+    {
+        if( xMBGatewayEntries[i].eState == STATE_GW_FREE )
+        {
+            pxEntry = &xMBGatewayEntries[i];
+            break;
+        }
+    }
+    if( ( pxRoute == NULL ) || ( pxEntry == NULL ) || ( usLength > MB_PDU_SIZE_MAX ) )
+    {
+        return MB_EX_GATEWAY_PATH_FAILED;
+    }
+
+    memcpy( pxEntry->aucADU, pucADU, MB_TCP_FUNC + usLength );
+    pxReq = &pxEntry->xReq;
+    memset( pxReq, 0, sizeof( xMBMasterRequest ) );
+    pxReq->ucSlaveAddress = pxRoute->ucUnitId;
+    pxReq->pucPDU = &pxEntry->aucADU[MB_TCP_FUNC];
+    pxReq->usPDULength = usLength;
+    pxReq->usPDUSize = MB_PDU_SIZE_MAX;
+    pxReq->ucPriority = pxRoute->ucPriority;
+    pxReq->usTimeoutMs = pxRoute->usTimeoutMs;
+    pxReq->pvDone = prvvMBGatewayDone;
+    pxReq->pvArg = pxEntry;
+    if( eMBMasterSubmit( pxMBGatewayMaster, pxReq ) != MB_ENOERR )
+    {
+        return MB_EX_GATEWAY_PATH_FAILED;
+    }
+    pxEntry->eState = STATE_GW_QUEUED;
+    pxEntry->ucConnection = ucMBTCPPortGetConnection(  );
+#if MB_GATEWAY_CACHE_ENABLED > 0
+    prvvMBGatewayCacheWrite( pxRoute->ucUnitId, pucFrame );
+#endif
+    return MB_EX_NONE;
+}
+
+void
+vMBGatewayPoll( void )
+{
+    xMBGatewayEntry *pxEntry;
+    UCHAR           i;
+
+    for( i = 0; i < MB_GATEWAY_QUEUE_SIZE; i++ )
+    {
+        pxEntry = &xMBGatewayEntries[i];
+        if( ( pxEntry->eState == STATE_GW_DONE ) &&
+            xMBTCPPortSendResponseTo( pxEntry->ucConnection, pxEntry->aucADU, pxEntry->usLength ) )
+        {
+            pxEntry->eState = STATE_GW_FREE;
+        }
+    }
+#if MB_GATEWAY_CACHE_ENABLED > 0
+    prvvMBGatewayCacheRefresh(  );
+#endif
+}
+
+void
+vMBGatewayReset( UCHAR ucConnection )
+{
+    UCHAR           i;
+
+    for( i = 0; i < MB_GATEWAY_QUEUE_SIZE; i++ )
+    {
+        if( xMBGatewayEntries[i].ucConnection != ucConnection )
+        {
+            continue;
+        }
+        if( xMBGatewayEntries[i].eState == STATE_GW_DONE )
+        {
+            xMBGatewayEntries[i].eState = STATE_GW_FREE;
+        }
+        else if( xMBGatewayEntries[i].eState == STATE_GW_QUEUED )
+        {
+            xMBGatewayEntries[i].eState = STATE_GW_DROP;
+        }
+    }
+}
+
+#if MB_GATEWAY_CACHE_ENABLED > 0
+eMBErrorCode
+eMBGatewayCacheAddRange( UCHAR ucUnitId, UCHAR ucFunctionCode, USHORT usAddress,
+                         USHORT usCount, USHORT usMaxAgeMs )
+{
+    xMBGatewayCacheRange *pxRange;
+    USHORT          usMax;
+
+    switch ( ucFunctionCode )
+    {
+    case MB_FUNC_READ_COILS:
+    case MB_FUNC_READ_DISCRETE_INPUTS:
+        usMax = MB_GATEWAY_CACHE_BITS_MAX;
+        break;
+    case MB_FUNC_READ_HOLDING_REGISTER:
+    case MB_FUNC_READ_INPUT_REGISTER:
+        usMax = MB_GATEWAY_CACHE_REGS_MAX;
+        break;
+    default:
+        return MB_EINVAL;
+    }
+    if( ( prvpxMBGatewayFindRoute( ucUnitId ) == NULL ) || ( usCount < 1 ) || ( usCount > usMax ) ||
+        ( ( ULONG ) usAddress + usCount > 0x10000UL ) )
+    {
+        return MB_EINVAL;
+    }
+    if( ucMBGatewayCacheRanges >= MB_GATEWAY_CACHE_RANGES )
+    {
+        return MB_ENORES;
+    }
+    pxRange = &xMBGatewayCache[ucMBGatewayCacheRanges++];
+    memset( pxRange, 0, sizeof( xMBGatewayCacheRange ) );
+    pxRange->ucUnitId = ucUnitId;
+    pxRange->ucFunctionCode = ucFunctionCode;
+    pxRange->usAddress = usAddress;
+    pxRange->usCount = usCount;
+    pxRange->usMaxAgeMs = usMaxAgeMs;
+    return MB_ENOERR;
+}
+
+void
+vMBGatewayCacheGetStats( xMBGatewayCacheStats * pxStats )
+{
+    *pxStats = xMBGatewayCacheCounters;
+}
+#endif
+
+static xMBGatewayRoute *
+prvpxMBGatewayFindRoute( UCHAR ucUnitId )
+{
+    UCHAR           i;
+
+    for( i = 0; i < ucMBGatewayRoutes; i++ )
+    {
+        if( xMBGatewayRoutes[i].ucUnitId == ucUnitId )
+        {
+            return &xMBGatewayRoutes[i];
+        }
+    }
+    return NULL;
+}
+
+static void
+prvvMBGatewayDone( xMBMasterRequest * pxReq, eMBErrorCode eStatus )
+{
+    xMBGatewayEntry *pxEntry = ( xMBGatewayEntry * ) pxReq->pvArg;
+    USHORT          usLength;
+
+    if( pxEntry->eState == STATE_GW_DROP )
+    {
+        pxEntry->eState = STATE_GW_FREE;
+        return;
+    }
+
+    /* Exception responses of the slave are already in the buffer. No or an
+     * invalid response is reported as a failed target. */
+    if( ( eStatus != MB_ENOERR ) && ( pxReq->eException == MB_EX_NONE ) )
+    {
+        pxReq->pucPDU[MB_PDU_FUNC_OFF] = ( UCHAR )( pxReq->ucFunctionCode | MB_FUNC_ERROR );
+        pxReq->pucPDU[MB_PDU_DATA_OFF] = MB_EX_GATEWAY_TGT_FAILED;
+        pxReq->usPDULength = 2;
+    }
+
+    /* The length field counts the unit identifier and the PDU. */
+    usLength = pxReq->usPDULength + 1;
+    pxEntry->aucADU[MB_TCP_LEN] = ( UCHAR )( usLength >> 8 );
+    pxEntry->aucADU[MB_TCP_LEN + 1] = ( UCHAR )( usLength & 0xFF );
+    pxEntry->usLength = MB_TCP_FUNC + pxReq->usPDULength;
+    pxEntry->eState = STATE_GW_DONE;
+}
+
+#if MB_GATEWAY_CACHE_ENABLED > 0
+/* Answers a read from a snapshot. Returns FALSE if the read must go to the
+ * slave. */
+static          BOOL
+prvxMBGatewayCacheRead( UCHAR ucUnitId, UCHAR * pucFrame, USHORT * pusLength )
+{
+    xMBGatewayCacheRange *pxRange;
+    UCHAR           ucFunctionCode = pucFrame[MB_PDU_FUNC_OFF];
+    USHORT          usAddress;
+    USHORT          usCount;
+    USHORT          usOff;
+    USHORT          usBytes;
+    USHORT          i;
+    UCHAR           r;
+
+    if( ( *pusLength != MB_PDU_REQ_READ_SIZE ) || ( ucFunctionCode < MB_FUNC_READ_COILS ) ||
+        ( ucFunctionCode > MB_FUNC_READ_INPUT_REGISTER ) )
+    {
+        return FALSE;
+    }
+    usAddress = ( USHORT )( ( pucFrame[MB_PDU_REQ_ADDR_OFF] << 8 ) | pucFrame[MB_PDU_REQ_ADDR_OFF + 1] );
+    usCount = ( USHORT )( ( pucFrame[MB_PDU_REQ_CNT_OFF] << 8 ) | pucFrame[MB_PDU_REQ_CNT_OFF + 1] );
+
+    for( r = 0; r < ucMBGatewayCacheRanges; r++ )
+    {
+        pxRange = &xMBGatewayCache[r];
+        if( ( pxRange->ucUnitId == ucUnitId ) && ( pxRange->ucFunctionCode == ucFunctionCode ) &&
+            ( usCount >= 1 ) && ( usAddress >= pxRange->usAddress ) &&
+            ( ( ULONG ) usAddress + usCount <= ( ULONG ) pxRange->usAddress + pxRange->usCount ) )
+        {
+            break;
+        }
+    }
+    if( r == ucMBGatewayCacheRanges )
+    {
+        return FALSE;
+    }
+
+    pxRange->xWanted = TRUE;
+    if( !pxRange->xValid || ( ( MB_PORT_GET_TICK(  ) - pxRange->ulTimestamp ) > pxRange->usMaxAgeMs ) )
+    {
+        xMBGatewayCacheCounters.ulMisses++;
+        return FALSE;
+    }
+    xMBGatewayCacheCounters.ulHits++;
+
+    usOff = usAddress - pxRange->usAddress;
+    if( ucFunctionCode <= MB_FUNC_READ_DISCRETE_INPUTS )
+    {
+        usBytes = ( USHORT )( ( usCount + 7 ) / 8 );
+        for( i = 0; i < usBytes; i++ )
+        {
+            pucFrame[MB_PDU_RSP_VALUES_OFF + i] = xMBUtilGetBits( pxRange->xData.aucBits, usOff + i * 8,
+                                                                  ( UCHAR )( ( usCount - i * 8 ) >= 8 ? 8 : usCount - i * 8 ) );
+        }
+    }
+    else
+    {
+        usBytes = ( USHORT )( usCount * 2 );
+        for( i = 0; i < usCount; i++ )
+        {
+            pucFrame[MB_PDU_RSP_VALUES_OFF + 2 * i] = ( UCHAR )( pxRange->xData.ausRegs[usOff + i] >> 8 );
+            pucFrame[MB_PDU_RSP_VALUES_OFF + 2 * i + 1] = ( UCHAR )( pxRange->xData.ausRegs[usOff + i] & 0xFF );
+        }
+    }
+    pucFrame[MB_PDU_RSP_BYTECNT_OFF] = ( UCHAR )usBytes;
+    *pusLength = ( USHORT )( MB_PDU_RSP_VALUES_OFF + usBytes );
+    return TRUE;
+}
+
+/* Drops the snapshots a forwarded write overlaps. */
+static void
+prvvMBGatewayCacheWrite( UCHAR ucUnitId, const UCHAR * pucFrame )
+{
+    xMBGatewayCacheRange *pxRange;
+    UCHAR           ucReadFunctionCode;
+    ULONG           ulAddress;
+    ULONG           ulCount;
+    UCHAR           r;
+
+    ulAddress = ( ULONG )( ( pucFrame[MB_PDU_REQ_ADDR_OFF] << 8 ) | pucFrame[MB_PDU_REQ_ADDR_OFF + 1] );
+    ulCount = ( ULONG )( ( pucFrame[MB_PDU_REQ_CNT_OFF] << 8 ) | pucFrame[MB_PDU_REQ_CNT_OFF + 1] );
+    switch ( pucFrame[MB_PDU_FUNC_OFF] )
+    {
+    case MB_FUNC_WRITE_SINGLE_COIL:
+        ulCount = 1;
+        /* no break */
+    case MB_FUNC_WRITE_MULTIPLE_COILS:
+        ucReadFunctionCode = MB_FUNC_READ_COILS;
+        break;
+    case MB_FUNC_WRITE_REGISTER:
+        ulCount = 1;
+        ucReadFunctionCode = MB_FUNC_READ_HOLDING_REGISTER;
+        break;
+    case MB_FUNC_WRITE_MULTIPLE_REGISTERS:
+        ucReadFunctionCode = MB_FUNC_READ_HOLDING_REGISTER;
+        break;
+    case MB_FUNC_READWRITE_MULTIPLE_REGISTERS:
+        ulAddress = ( ULONG )( ( pucFrame[MB_PDU_REQ_RW_WRITE_ADDR_OFF] << 8 ) | pucFrame[MB_PDU_REQ_RW_WRITE_ADDR_OFF + 1] );
+        ulCount = ( ULONG )( ( pucFrame[MB_PDU_REQ_RW_WRITE_CNT_OFF] << 8 ) | pucFrame[MB_PDU_REQ_RW_WRITE_CNT_OFF + 1] );
+        ucReadFunctionCode = MB_FUNC_READ_HOLDING_REGISTER;
+        break;
+    default:
+        return;
+    }
+
+    for( r = 0; r < ucMBGatewayCacheRanges; r++ )
+    {
+        pxRange = &xMBGatewayCache[r];
+        if( ( pxRange->ucUnitId == ucUnitId ) && ( pxRange->ucFunctionCode == ucReadFunctionCode ) &&
+            ( ulAddress < ( ULONG ) pxRange->usAddress + pxRange->usCount ) &&
+            ( ulAddress + ulCount > pxRange->usAddress ) )
+        {
+            /* A refresh in progress may have read the old values. */
+            pxRange->xValid = FALSE;
+            pxRange->xStale = TRUE;
+            xMBGatewayCacheCounters.ulInvalidations++;
+        }
+    }
+}
+
+/* Reads ranges wanted by clients once their snapshot is half its maximum
+ * age old, so that the next read of a client is still a hit. */
+static void
+prvvMBGatewayCacheRefresh( void )
+{
+    xMBGatewayCacheRange *pxRange;
+    xMBGatewayRoute *pxRoute;
+    xMBMasterRequest *pxReq;
+    UCHAR           r;
+
+    for( r = 0; r < ucMBGatewayCacheRanges; r++ )
+    {
+        pxRange = &xMBGatewayCache[r];
+        pxReq = &pxRange->xReq;
+        if( pxReq->xBusy || !pxRange->xWanted ||
+            ( pxRange->xValid && ( ( MB_PORT_GET_TICK(  ) - pxRange->ulTimestamp ) < pxRange->usMaxAgeMs / 2U ) ) )
+        {
+            continue;
+        }
+        /* eMBGatewayCacheAddRange( ) only takes ranges of routed units and
+         * routes are never removed. Skip the range should that change. */
+        pxRoute = prvpxMBGatewayFindRoute( pxRange->ucUnitId );
+        if( pxRoute == NULL )
+        {
+            continue;
+        }
+        memset( pxReq, 0, sizeof( xMBMasterRequest ) );
+        pxReq->ucSlaveAddress = pxRange->ucUnitId;
+        pxReq->ucFunctionCode = pxRange->ucFunctionCode;
+        pxReq->usAddress = pxRange->usAddress;
+        pxReq->usCount = pxRange->usCount;
+        pxReq->pusRegs = pxRange->xData.ausRegs;
+        pxReq->pucBits = pxRange->xData.aucBits;
+        pxReq->usTimeoutMs = pxRoute->usTimeoutMs;
+        pxReq->pvDone = prvvMBGatewayCacheDone;
+        pxReq->pvArg = pxRange;
+        if( eMBMasterSubmit( pxMBGatewayMaster, pxReq ) == MB_ENOERR )
+        {
+            pxRange->xWanted = FALSE;
+            pxRange->xStale = FALSE;
+            pxRange->ulRefreshStart = MB_PORT_GET_TICK(  );
+            xMBGatewayCacheCounters.ulRefreshes++;
+        }
+    }
+}
+
+static void
+prvvMBGatewayCacheDone( xMBMasterRequest * pxReq, eMBErrorCode eStatus )
+{
+    xMBGatewayCacheRange *pxRange = ( xMBGatewayCacheRange * ) pxReq->pvArg;
+
+    /* On errors the old snapshot is used until it expires. */
+    if( ( eStatus == MB_ENOERR ) && !pxRange->xStale )
+    {
+        pxRange->xValid = TRUE;
+        pxRange->ulTimestamp = pxRange->ulRefreshStart;
+    }
+}
+#endif
+
+#endif
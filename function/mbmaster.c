@@ -0,0 +1,525 @@
+/* 
+ * FreeModbus Libary: A portable Modbus implementation for Modbus ASCII/RTU.
+ * Copyright (c) 2006-2018 Christian Walter <cwalter@embedded-solutions.at>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* ----------------------- System includes ----------------------------------*/
+#include "stdlib.h"
+#include "string.h"
+
+/* ----------------------- Platform includes --------------------------------*/
+#include "port.h"
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "mb.h"
+#include "mbconfig.h"
+#include "mbframe.h"
+#include "mbproto.h"
+#include "mbport.h"
+#include "mbrtu.h"
+#include "mbutils.h"
+#include "mbinstance.h"
+#include "mbmaster.h"
+
+#if MB_MASTER_ENABLED > 0
+
+#if MB_RTU_ENABLED == 0
+#error "The Modbus master requires MB_RTU_ENABLED"
+#endif
+
+/* ----------------------- Defines ------------------------------------------*/
+#define MB_SER_PDU_PDU_OFF              1       /*!< Offset of Modbus-PDU in Ser-PDU. */
+
+#define MB_PDU_REQ_ADDR_OFF             ( MB_PDU_DATA_OFF + 0 )
+#define MB_PDU_REQ_CNT_OFF              ( MB_PDU_DATA_OFF + 2 )
+#define MB_PDU_REQ_VALUE_OFF            ( MB_PDU_DATA_OFF + 2 )
+#define MB_PDU_REQ_BYTECNT_OFF          ( MB_PDU_DATA_OFF + 4 )
+#define MB_PDU_REQ_VALUES_OFF           ( MB_PDU_DATA_OFF + 5 )
+#define MB_PDU_REQ_RW_WRITE_ADDR_OFF    ( MB_PDU_DATA_OFF + 4 )
+#define MB_PDU_REQ_RW_WRITE_CNT_OFF     ( MB_PDU_DATA_OFF + 6 )
+#define MB_PDU_REQ_RW_BYTECNT_OFF       ( MB_PDU_DATA_OFF + 8 )
+#define MB_PDU_REQ_RW_VALUES_OFF        ( MB_PDU_DATA_OFF + 9 )
+
+#define MB_PDU_RSP_BYTECNT_OFF          ( MB_PDU_DATA_OFF + 0 )
+#define MB_PDU_RSP_VALUES_OFF           ( MB_PDU_DATA_OFF + 1 )
+#define MB_PDU_RSP_ECHO_SIZE            ( 5 )
+#define MB_PDU_RSP_EXCEPTION_SIZE       ( 2 )
+
+#define MB_MASTER_BITS_READ_MAX         ( 2000 )
+#define MB_MASTER_BITS_WRITE_MAX        ( 1968 )
+#define MB_MASTER_REGS_READ_MAX         ( 125 )
+#define MB_MASTER_REGS_WRITE_MAX        ( 123 )
+#define MB_MASTER_REGS_RW_WRITE_MAX     ( 121 )
+
+/* ----------------------- Static functions ---------------------------------*/
+static BOOL     prvxMBMasterValidate( const xMBMasterRequest * pxReq );
+static USHORT   prvusMBMasterBuild( const xMBMasterRequest * pxReq, UCHAR * pucFrame );
+static eMBErrorCode prveMBMasterParse( xMBMasterRequest * pxReq, const UCHAR * pucFrame,
+                                       USHORT usLength );
+static void     prvvMBMasterSend( xMBInstance * pxInst );
+static void     prvvMBMasterRetry( xMBInstance * pxInst );
+static void     prvvMBMasterComplete( xMBInstance * pxInst, eMBErrorCode eStatus );
+
+/* ----------------------- Start implementation -----------------------------*/
+eMBErrorCode
+eMBMasterInit( xMBInstance ** ppxInst, UCHAR ucPort, ULONG ulBaudRate, eMBParity eParity )
+{
+    eMBErrorCode    eStatus;
+
+    /* The slave address is not used by a master. */
+    eStatus = eMBInstInit( ppxInst, MB_RTU, MB_ADDRESS_MAX, ucPort, ulBaudRate, eParity );
+    if( eStatus == MB_ENOERR )
+    {
+        ( *ppxInst )->xIsMaster = TRUE;
+        ( *ppxInst )->xMaster.eState = STATE_M_IDLE;
+        ( *ppxInst )->xMaster.pxHead = NULL;
+    }
+    return eStatus;
+}
+
+eMBErrorCode
+eMBMasterSubmit( xMBInstance * pxInst, xMBMasterRequest * pxReq )
+{
+    xMBMasterState *pxMaster = &pxInst->xMaster;
+    xMBMasterRequest *pxPrev = NULL;
+    xMBMasterRequest *pxCur = pxMaster->pxHead;
+
+    if( !pxInst->xIsMaster )
+    {
+        return MB_EILLSTATE;
+    }
+    if( pxReq->xBusy || !prvxMBMasterValidate( pxReq ) )
+    {
+        return MB_EINVAL;
+    }
+    if( pxReq->pucPDU != NULL )
+    {
+        pxReq->ucFunctionCode = pxReq->pucPDU[MB_PDU_FUNC_OFF];
+    }
+    pxReq->xBusy = TRUE;
+    pxReq->eException = MB_EX_NONE;
+
+    /* The queue is ordered by priority and by arrival within a priority.
+     * A request in progress stays at the head. */
+    if( ( pxCur != NULL ) && ( pxMaster->eState != STATE_M_IDLE ) )
+    {
+        pxPrev = pxCur;
+        pxCur = pxCur->pxNext;
+    }
+    while( ( pxCur != NULL ) && ( pxCur->ucPriority >= pxReq->ucPriority ) )
+    {
+        pxPrev = pxCur;
+        pxCur = pxCur->pxNext;
+    }
+    pxReq->pxNext = pxCur;
+    if( pxPrev != NULL )
+    {
+        pxPrev->pxNext = pxReq;
+    }
+    else
+    {
+        pxMaster->pxHead = pxReq;
+    }
+    return MB_ENOERR;
+}
+
+eMBErrorCode
+eMBMasterPoll( xMBInstance * pxInst )
+{
+    xMBMasterState *pxMaster = &pxInst->xMaster;
+    xMBEvent        xEvent;
+    UCHAR           ucRcvAddress;
+    UCHAR          *pucFrame;
+    USHORT          usLength;
+    eMBErrorCode    eStatus;
+    ULONG           ulTimeout;
+
+    if( ( pxInst->eMBState != STATE_ENABLED ) || !pxInst->xIsMaster )
+    {
+        return MB_EILLSTATE;
+    }
+
+    if( xMBPortEventGet( pxInst, &xEvent ) == TRUE )
+    {
+        switch ( xEvent.eEvent )
+        {
+        case EV_FRAME_SENT:
+            if( pxMaster->eState == STATE_M_SENDING )
+            {
+                /* The response timeout starts with the end of the request. */
+                pxMaster->ulStart = MB_PORT_GET_TICK(  );
+                pxMaster->eState = ( pxMaster->pxHead->ucSlaveAddress == MB_ADDRESS_BROADCAST ) ?
+                    STATE_M_TURNAROUND : STATE_M_WAIT_REPLY;
+            }
+            break;
+
+        case EV_FRAME_RECEIVED:
+            if( pxMaster->eState != STATE_M_WAIT_REPLY )
+            {
+                /* Late response of a request which timed out. */
+                break;
+            }
+            eStatus = pxInst->peMBFrameReceiveCur( pxInst, &ucRcvAddress, &pucFrame, &usLength );
+            if( eStatus != MB_ENOERR )
+            {
+                /* Damaged response. The slave is there, ask again at once. */
+                prvvMBMasterRetry( pxInst );
+            }
+            else if( ucRcvAddress == pxMaster->pxHead->ucSlaveAddress )
+            {
+                prvvMBMasterComplete( pxInst, prveMBMasterParse( pxMaster->pxHead, pucFrame, usLength ) );
+            }
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    switch ( pxMaster->eState )
+    {
+    case STATE_M_WAIT_REPLY:
+        ulTimeout = pxMaster->pxHead->usTimeoutMs != 0 ? pxMaster->pxHead->usTimeoutMs : MB_MASTER_TIMEOUT_MS;
+        if( ( MB_PORT_GET_TICK(  ) - pxMaster->ulStart ) >= ulTimeout )
+        {
+            prvvMBMasterRetry( pxInst );
+        }
+        break;
+
+    case STATE_M_TURNAROUND:
+        /* Broadcasts have no response. Give the slaves time to process. */
+        if( ( MB_PORT_GET_TICK(  ) - pxMaster->ulStart ) >= MB_MASTER_TURNAROUND_MS )
+        {
+            prvvMBMasterComplete( pxInst, MB_ENOERR );
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    /* Keep the bus busy: the next request follows the previous one within
+     * the same call. The tries are only counted from zero for a new head
+     * request, not for one whose send was refused. */
+    if( pxMaster->eState == STATE_M_SEND_PENDING )
+    {
+        prvvMBMasterSend( pxInst );
+    }
+    else if( ( pxMaster->eState == STATE_M_IDLE ) && ( pxMaster->pxHead != NULL ) )
+    {
+        pxMaster->ucTries = 0;
+        prvvMBMasterSend( pxInst );
+    }
+    return MB_ENOERR;
+}
+
+static void
+prvvMBMasterSend( xMBInstance * pxInst )
+{
+    xMBMasterState *pxMaster = &pxInst->xMaster;
+    UCHAR          *pucFrame = ( UCHAR * ) & pxInst->ucSerBuf[MB_SER_PDU_PDU_OFF];
+    USHORT          usLength;
+
+    /* The request is built again for each try because the response is
+     * received into the same buffer. */
+    usLength = prvusMBMasterBuild( pxMaster->pxHead, pucFrame );
+    if( pxInst->peMBFrameSendCur( pxInst, pxMaster->pxHead->ucSlaveAddress, pucFrame, usLength ) == MB_ENOERR )
+    {
+        pxMaster->ucTries++;
+        pxMaster->eState = STATE_M_SENDING;
+    }
+    else
+    {
+        /* The receiver is not idle, e.g. t3.5 after startup or noise on the
+         * bus. Try again on the next poll. */
+        pxMaster->eState = STATE_M_SEND_PENDING;
+    }
+}
+
+static void
+prvvMBMasterRetry( xMBInstance * pxInst )
+{
+    xMBMasterState *pxMaster = &pxInst->xMaster;
+
+    if( pxMaster->ucTries > MB_MASTER_RETRIES )
+    {
+        prvvMBMasterComplete( pxInst, MB_ETIMEDOUT );
+    }
+    else
+    {
+        prvvMBMasterSend( pxInst );
+    }
+}
+
+static void
+prvvMBMasterComplete( xMBInstance * pxInst, eMBErrorCode eStatus )
+{
+    xMBMasterState *pxMaster = &pxInst->xMaster;
+    xMBMasterRequest *pxReq = pxMaster->pxHead;
+
+    pxMaster->pxHead = pxReq->pxNext;
+    pxMaster->eState = STATE_M_IDLE;
+
+    pxReq->eStatus = eStatus;
+    pxReq->xBusy = FALSE;
+    if( pxReq->pvDone != NULL )
+    {
+        pxReq->pvDone( pxReq, eStatus );
+    }
+}
+
+static          BOOL
+prvxMBMasterValidate( const xMBMasterRequest * pxReq )
+{
+    BOOL            xWrite = FALSE;
+    BOOL            xValid;
+
+    if( pxReq->ucSlaveAddress > MB_ADDRESS_MAX )
+    {
+        return FALSE;
+    }
+    if( pxReq->pucPDU != NULL )
+    {
+        /* Raw requests are checked by the slave. */
+        return ( pxReq->usPDULength >= MB_PDU_SIZE_MIN ) && ( pxReq->usPDULength <= MB_PDU_SIZE_MAX ) &&
+            ( pxReq->usPDUSize >= MB_PDU_RSP_EXCEPTION_SIZE );
+    }
+    switch ( pxReq->ucFunctionCode )
+    {
+    case MB_FUNC_READ_COILS:
+    case MB_FUNC_READ_DISCRETE_INPUTS:
+        xValid = ( pxReq->pucBits != NULL ) &&
+            ( pxReq->usCount >= 1 ) && ( pxReq->usCount <= MB_MASTER_BITS_READ_MAX );
+        break;
+    case MB_FUNC_READ_HOLDING_REGISTER:
+    case MB_FUNC_READ_INPUT_REGISTER:
+        xValid = ( pxReq->pusRegs != NULL ) &&
+            ( pxReq->usCount >= 1 ) && ( pxReq->usCount <= MB_MASTER_REGS_READ_MAX );
+        break;
+    case MB_FUNC_WRITE_SINGLE_COIL:
+        xValid = ( pxReq->pucBits != NULL );
+        xWrite = TRUE;
+        break;
+    case MB_FUNC_WRITE_REGISTER:
+        xValid = ( pxReq->pusRegs != NULL );
+        xWrite = TRUE;
+        break;
+    case MB_FUNC_WRITE_MULTIPLE_COILS:
+        xValid = ( pxReq->pucBits != NULL ) &&
+            ( pxReq->usCount >= 1 ) && ( pxReq->usCount <= MB_MASTER_BITS_WRITE_MAX );
+        xWrite = TRUE;
+        break;
+    case MB_FUNC_WRITE_MULTIPLE_REGISTERS:
+        xValid = ( pxReq->pusRegs != NULL ) &&
+            ( pxReq->usCount >= 1 ) && ( pxReq->usCount <= MB_MASTER_REGS_WRITE_MAX );
+        xWrite = TRUE;
+        break;
+    case MB_FUNC_READWRITE_MULTIPLE_REGISTERS:
+        xValid = ( pxReq->pusRegs != NULL ) && ( pxReq->pusWriteRegs != NULL ) &&
+            ( pxReq->usCount >= 1 ) && ( pxReq->usCount <= MB_MASTER_REGS_READ_MAX ) &&
+            ( pxReq->usWriteCount >= 1 ) && ( pxReq->usWriteCount <= MB_MASTER_REGS_RW_WRITE_MAX );
+        break;
+    default:
+        xValid = FALSE;
+        break;
+    }
+    /* Only writes can be broadcast. */
+    return xValid && ( xWrite || ( pxReq->ucSlaveAddress != MB_ADDRESS_BROADCAST ) );
+}
+
+static          USHORT
+prvusMBMasterBuild( const xMBMasterRequest * pxReq, UCHAR * pucFrame )
+{
+    USHORT          usLength;
+    USHORT          usValue;
+    USHORT          usBytes;
+    USHORT          i;
+
+    if( pxReq->pucPDU != NULL )
+    {
+        memcpy( pucFrame, pxReq->pucPDU, pxReq->usPDULength );
+        return pxReq->usPDULength;
+    }
+
+    pucFrame[MB_PDU_FUNC_OFF] = pxReq->ucFunctionCode;
+    pucFrame[MB_PDU_REQ_ADDR_OFF] = ( UCHAR )( pxReq->usAddress >> 8 );
+    pucFrame[MB_PDU_REQ_ADDR_OFF + 1] = ( UCHAR )( pxReq->usAddress & 0xFF );
+    pucFrame[MB_PDU_REQ_CNT_OFF] = ( UCHAR )( pxReq->usCount >> 8 );
+    pucFrame[MB_PDU_REQ_CNT_OFF + 1] = ( UCHAR )( pxReq->usCount & 0xFF );
+    usLength = MB_PDU_REQ_CNT_OFF + 2;
+
+    switch ( pxReq->ucFunctionCode )
+    {
+    case MB_FUNC_WRITE_SINGLE_COIL:
+        usValue = ( pxReq->pucBits[0] & 0x01 ) ? 0xFF00 : 0x0000;
+        pucFrame[MB_PDU_REQ_VALUE_OFF] = ( UCHAR )( usValue >> 8 );
+        pucFrame[MB_PDU_REQ_VALUE_OFF + 1] = ( UCHAR )( usValue & 0xFF );
+        break;
+
+    case MB_FUNC_WRITE_REGISTER:
+        pucFrame[MB_PDU_REQ_VALUE_OFF] = ( UCHAR )( pxReq->pusRegs[0] >> 8 );
+        pucFrame[MB_PDU_REQ_VALUE_OFF + 1] = ( UCHAR )( pxReq->pusRegs[0] & 0xFF );
+        break;
+
+    case MB_FUNC_WRITE_MULTIPLE_COILS:
+        usBytes = ( USHORT )( ( pxReq->usCount + 7 ) / 8 );
+        pucFrame[MB_PDU_REQ_BYTECNT_OFF] = ( UCHAR )usBytes;
+        memcpy( &pucFrame[MB_PDU_REQ_VALUES_OFF], pxReq->pucBits, usBytes );
+        /* Unused bits of the last byte must be zero. */
+        if( ( pxReq->usCount % 8 ) != 0 )
+        {
+            pucFrame[MB_PDU_REQ_VALUES_OFF + usBytes - 1] &= ( UCHAR )( ( 1U << ( pxReq->usCount % 8 ) ) - 1 );
+        }
+        usLength = ( USHORT )( MB_PDU_REQ_VALUES_OFF + usBytes );
+        break;
+
+    case MB_FUNC_WRITE_MULTIPLE_REGISTERS:
+        pucFrame[MB_PDU_REQ_BYTECNT_OFF] = ( UCHAR )( pxReq->usCount * 2 );
+        for( i = 0; i < pxReq->usCount; i++ )
+        {
+            pucFrame[MB_PDU_REQ_VALUES_OFF + 2 * i] = ( UCHAR )( pxReq->pusRegs[i] >> 8 );
+            pucFrame[MB_PDU_REQ_VALUES_OFF + 2 * i + 1] = ( UCHAR )( pxReq->pusRegs[i] & 0xFF );
+        }
+        usLength = ( USHORT )( MB_PDU_REQ_VALUES_OFF + pxReq->usCount * 2 );
+        break;
+
+    case MB_FUNC_READWRITE_MULTIPLE_REGISTERS:
+        pucFrame[MB_PDU_REQ_RW_WRITE_ADDR_OFF] = ( UCHAR )( pxReq->usWriteAddress >> 8 );
+        pucFrame[MB_PDU_REQ_RW_WRITE_ADDR_OFF + 1] = ( UCHAR )( pxReq->usWriteAddress & 0xFF );
+        pucFrame[MB_PDU_REQ_RW_WRITE_CNT_OFF] = ( UCHAR )( pxReq->usWriteCount >> 8 );
+        pucFrame[MB_PDU_REQ_RW_WRITE_CNT_OFF + 1] = ( UCHAR )( pxReq->usWriteCount & 0xFF );
+        pucFrame[MB_PDU_REQ_RW_BYTECNT_OFF] = ( UCHAR )( pxReq->usWriteCount * 2 );
+        for( i = 0; i < pxReq->usWriteCount; i++ )
+        {
+            pucFrame[MB_PDU_REQ_RW_VALUES_OFF + 2 * i] = ( UCHAR )( pxReq->pusWriteRegs[i] >> 8 );
+            pucFrame[MB_PDU_REQ_RW_VALUES_OFF + 2 * i + 1] = ( UCHAR )( pxReq->pusWriteRegs[i] & 0xFF );
+        }
+        usLength = ( USHORT )( MB_PDU_REQ_RW_VALUES_OFF + pxReq->usWriteCount * 2 );
+        break;
+
+    default:
+        /* Reads: address and count only. */
+        break;
+    }
+    return usLength;
+}
+
+static          eMBErrorCode
+prveMBMasterParse( xMBMasterRequest * pxReq, const UCHAR * pucFrame, USHORT usLength )
+{
+    UCHAR           ucFunctionCode = pucFrame[MB_PDU_FUNC_OFF];
+    USHORT          usValue;
+    USHORT          usBytes;
+    USHORT          i;
+
+    if( pxReq->pucPDU != NULL )
+    {
+        /* Raw requests get the response as it is, exceptions included. */
+        if( ( ( ucFunctionCode & ~MB_FUNC_ERROR ) != pxReq->ucFunctionCode ) ||
+            ( usLength > pxReq->usPDUSize ) )
+        {
+            return MB_EIO;
+        }
+        memcpy( pxReq->pucPDU, pucFrame, usLength );
+        pxReq->usPDULength = usLength;
+        if( ( ucFunctionCode & MB_FUNC_ERROR ) != 0 )
+        {
+            pxReq->eException = usLength >= MB_PDU_RSP_EXCEPTION_SIZE ?
+                ( eMBException ) pucFrame[MB_PDU_DATA_OFF] : MB_EX_SLAVE_DEVICE_FAILURE;
+            return MB_EIO;
+        }
+        return MB_ENOERR;
+    }
+    if( ( ucFunctionCode == ( pxReq->ucFunctionCode | MB_FUNC_ERROR ) ) &&
+        ( usLength == MB_PDU_RSP_EXCEPTION_SIZE ) )
+    {
+        pxReq->eException = ( eMBException ) pucFrame[MB_PDU_DATA_OFF];
+        return MB_EIO;
+    }
+    if( ucFunctionCode != pxReq->ucFunctionCode )
+    {
+        return MB_EIO;
+    }
+
+    switch ( ucFunctionCode )
+    {
+    case MB_FUNC_READ_COILS:
+    case MB_FUNC_READ_DISCRETE_INPUTS:
+        usBytes = ( USHORT )( ( pxReq->usCount + 7 ) / 8 );
+        if( ( pucFrame[MB_PDU_RSP_BYTECNT_OFF] != usBytes ) ||
+            ( usLength != MB_PDU_RSP_VALUES_OFF + usBytes ) )
+        {
+            return MB_EIO;
+        }
+        memcpy( pxReq->pucBits, &pucFrame[MB_PDU_RSP_VALUES_OFF], usBytes );
+        break;
+
+    case MB_FUNC_READ_HOLDING_REGISTER:
+    case MB_FUNC_READ_INPUT_REGISTER:
+    case MB_FUNC_READWRITE_MULTIPLE_REGISTERS:
+        usBytes = ( USHORT )( pxReq->usCount * 2 );
+        if( ( pucFrame[MB_PDU_RSP_BYTECNT_OFF] != usBytes ) ||
+            ( usLength != MB_PDU_RSP_VALUES_OFF + usBytes ) )
+        {
+            return MB_EIO;
+        }
+        for( i = 0; i < pxReq->usCount; i++ )
+        {
+            pxReq->pusRegs[i] = ( USHORT )( ( pucFrame[MB_PDU_RSP_VALUES_OFF + 2 * i] << 8 ) |
+                                            pucFrame[MB_PDU_RSP_VALUES_OFF + 2 * i + 1] );
+        }
+        break;
+
+    default:
+        /* Writes: the response repeats the address and the value or the
+         * count of the request. */
+        if( ucFunctionCode == MB_FUNC_WRITE_SINGLE_COIL )
+        {
+            usValue = ( pxReq->pucBits[0] & 0x01 ) ? 0xFF00 : 0x0000;
+        }
+        else if( ucFunctionCode == MB_FUNC_WRITE_REGISTER )
+        {
+            usValue = pxReq->pusRegs[0];
+        }
+        else
+        {
+            usValue = pxReq->usCount;
+        }
+        if( ( usLength != MB_PDU_RSP_ECHO_SIZE ) ||
+            ( pucFrame[MB_PDU_REQ_ADDR_OFF] != ( UCHAR )( pxReq->usAddress >> 8 ) ) ||
+            ( pucFrame[MB_PDU_REQ_ADDR_OFF + 1] != ( UCHAR )( pxReq->usAddress & 0xFF ) ) ||
+            ( pucFrame[MB_PDU_REQ_VALUE_OFF] != ( UCHAR )( usValue >> 8 ) ) ||
+            ( pucFrame[MB_PDU_REQ_VALUE_OFF + 1] != ( UCHAR )( usValue & 0xFF ) ) )
+        {
+            return MB_EIO;
+        }
+        break;
+    }
+    return MB_ENOERR;
+}
+
+#endif
@@ -0,0 +1,392 @@
+/* 
+ * FreeModbus Libary: A portable Modbus implementation for Modbus ASCII/RTU.
+ * Copyright (c) 2006-2018 Christian Walter <cwalter@embedded-solutions.at>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* ----------------------- System includes ----------------------------------*/
+#include "stdlib.h"
+#include "string.h"
+
+/* ----------------------- Platform includes --------------------------------*/
+#include "port.h"
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "mb.h"
+#include "mbconfig.h"
+#include "mbproto.h"
+#include "mbport.h"
+#include "mbinstance.h"
+#include "mbmaster.h"
+#include "mbplan.h"
+
+#if MB_MASTER_ENABLED > 0
+
+/* ----------------------- Defines ------------------------------------------*/
+#define MB_PLAN_UNASSIGNED              ( 0xFFFF )
+
+/* Characters on the wire of a read transaction: address, function code,
+ * start, count and CRC of the request, address, function code, byte count
+ * and CRC of the response. The t3.5 silence before each frame is counted
+ * as 4 characters. */
+#define MB_PLAN_REQ_CHARS               ( 8 )
+#define MB_PLAN_RSP_CHARS               ( 5 )
+#define MB_PLAN_SILENCE_CHARS           ( 2 * 4 )
+
+/* ----------------------- Static functions ---------------------------------*/
+static BOOL     prvxMBPlanIsBitTable( eMBTagTable eTable );
+static USHORT   prvusMBPlanTagWidth( const xMBTag * pxTag );
+static BOOL     prvxMBPlanValidate( const xMBTag * pxTag );
+static int      prviMBPlanCompare( const xMBTag * pxA, const xMBTag * pxB );
+static xMBTag  *prvpxMBPlanNextTag( xMBPlan * pxPlan, const xMBTag * pxSame );
+static ULONG    prvulMBPlanTransactionChars( eMBTagTable eTable, USHORT usCount );
+static void     prvvMBPlanSubmit( xMBPlan * pxPlan, USHORT usBlock );
+static void     prvvMBPlanDone( xMBMasterRequest * pxReq, eMBErrorCode eStatus );
+
+/* ----------------------- Start implementation -----------------------------*/
+eMBErrorCode
+eMBPlanInit( xMBPlan * pxPlan, xMBInstance * pxInst, xMBTag * pxTags, USHORT usTags,
+             xMBPlanBlock * pxBlocks, USHORT usBlocksMax, USHORT usGapMax )
+{
+    xMBPlanBlock   *pxBlock;
+    xMBTag         *pxFirst;
+    xMBTag         *pxLast;
+    xMBTag         *pxTag;
+    ULONG           ulEnd;
+    ULONG           ulTagEnd;
+    ULONG           ulGap;
+    USHORT          usMax;
+    USHORT          i;
+
+    memset( pxPlan, 0, sizeof( xMBPlan ) );
+    pxPlan->pxInst = pxInst;
+    pxPlan->pxTags = pxTags;
+    pxPlan->usTags = usTags;
+    pxPlan->pxBlocks = pxBlocks;
+
+    for( i = 0; i < usTags; i++ )
+    {
+        if( !prvxMBPlanValidate( &pxTags[i] ) )
+        {
+            return MB_EINVAL;
+        }
+        pxTags[i].usBlock = MB_PLAN_UNASSIGNED;
+        pxTags[i].pxNext = NULL;
+        pxTags[i].eStatus = MB_ETIMEDOUT;
+    }
+
+    /* Take the tags in the order of slave, table and address. A block grows
+     * while the next tag of the same slave and table is close enough and
+     * the block stays within the limits of a single read. */
+    while( ( pxFirst = prvpxMBPlanNextTag( pxPlan, NULL ) ) != NULL )
+    {
+        if( pxPlan->usBlocks >= usBlocksMax )
+        {
+            return MB_ENORES;
+        }
+        pxBlock = &pxBlocks[pxPlan->usBlocks];
+        pxBlock->ucSlaveAddress = pxFirst->ucSlaveAddress;
+        pxBlock->eTable = pxFirst->eTable;
+        pxBlock->usAddress = pxFirst->usAddress;
+        pxBlock->usCount = prvusMBPlanTagWidth( pxFirst );
+        pxBlock->usPeriodMs = pxFirst->usPeriodMs;
+        pxBlock->ulLastStart = 0;
+        pxBlock->xStarted = FALSE;
+        pxBlock->pxTags = pxFirst;
+        pxFirst->usBlock = pxPlan->usBlocks;
+        pxLast = pxFirst;
+
+        if( prvxMBPlanIsBitTable( pxBlock->eTable ) )
+        {
+            usMax = MB_PLAN_BITS_MAX;
+            ulGap = ( ULONG ) usGapMax * 16;
+        }
+        else
+        {
+            usMax = MB_PLAN_REGS_MAX;
+            ulGap = usGapMax;
+        }
+
+        while( ( pxTag = prvpxMBPlanNextTag( pxPlan, pxFirst ) ) != NULL )
+        {
+            ulEnd = ( ULONG ) pxBlock->usAddress + pxBlock->usCount;
+            ulTagEnd = ( ULONG ) pxTag->usAddress + prvusMBPlanTagWidth( pxTag );
+            if( ( pxTag->usAddress > ulEnd + ulGap ) ||
+                ( ulTagEnd - pxBlock->usAddress > usMax ) )
+            {
+                break;
+            }
+            if( ulTagEnd > ulEnd )
+            {
+                pxBlock->usCount = ( USHORT ) ( ulTagEnd - pxBlock->usAddress );
+            }
+            if( pxTag->usPeriodMs < pxBlock->usPeriodMs )
+            {
+                pxBlock->usPeriodMs = pxTag->usPeriodMs;
+            }
+            pxTag->usBlock = pxPlan->usBlocks;
+            pxLast->pxNext = pxTag;
+            pxLast = pxTag;
+        }
+        pxPlan->usBlocks++;
+    }
+    return MB_ENOERR;
+}
+
+void
+vMBPlanPoll( xMBPlan * pxPlan )
+{
+    xMBPlanBlock   *pxBlock;
+    ULONG           ulNow = MB_PORT_GET_TICK(  );
+    ULONG           ulElapsed;
+    ULONG           ulLate;
+    ULONG           ulLatest = 0;
+    USHORT          usNext = MB_PLAN_UNASSIGNED;
+    USHORT          i;
+
+    if( pxPlan->xBusy )
+    {
+        return;
+    }
+    for( i = 0; i < pxPlan->usBlocks; i++ )
+    {
+        pxBlock = &pxPlan->pxBlocks[i];
+        if( !pxBlock->xStarted )
+        {
+            /* Never read yet, this beats all others. */
+            usNext = i;
+            break;
+        }
+        ulElapsed = ulNow - pxBlock->ulLastStart;
+        if( ulElapsed >= pxBlock->usPeriodMs )
+        {
+            ulLate = ulElapsed - pxBlock->usPeriodMs;
+            if( ( usNext == MB_PLAN_UNASSIGNED ) || ( ulLate > ulLatest ) )
+            {
+                usNext = i;
+                ulLatest = ulLate;
+            }
+        }
+    }
+    if( usNext != MB_PLAN_UNASSIGNED )
+    {
+        prvvMBPlanSubmit( pxPlan, usNext );
+    }
+}
+
+void
+vMBPlanGetCost( const xMBPlan * pxPlan, xMBPlanCost * pxCost )
+{
+    const xMBPlanBlock *pxBlock;
+    const xMBTag   *pxTag;
+    ULONG           ulChars;
+    USHORT          i;
+
+    memset( pxCost, 0, sizeof( xMBPlanCost ) );
+    for( i = 0; i < pxPlan->usTags; i++ )
+    {
+        pxTag = &pxPlan->pxTags[i];
+        ulChars = prvulMBPlanTransactionChars( pxTag->eTable, prvusMBPlanTagWidth( pxTag ) );
+        pxCost->ulRequestsPerTag++;
+        pxCost->ulCharsPerTag += ulChars;
+        if( pxTag->usPeriodMs > 0 )
+        {
+            pxCost->ulCharsPerSecPerTag += ulChars * 1000UL / pxTag->usPeriodMs;
+        }
+    }
+    for( i = 0; i < pxPlan->usBlocks; i++ )
+    {
+        pxBlock = &pxPlan->pxBlocks[i];
+        ulChars = prvulMBPlanTransactionChars( pxBlock->eTable, pxBlock->usCount );
+        pxCost->ulRequestsMerged++;
+        pxCost->ulCharsMerged += ulChars;
+        if( pxBlock->usPeriodMs > 0 )
+        {
+            pxCost->ulCharsPerSecMerged += ulChars * 1000UL / pxBlock->usPeriodMs;
+        }
+    }
+}
+
+static          BOOL
+prvxMBPlanIsBitTable( eMBTagTable eTable )
+{
+    return ( eTable == MB_TAG_COIL ) || ( eTable == MB_TAG_DISCRETE ) ? TRUE : FALSE;
+}
+
+static          USHORT
+prvusMBPlanTagWidth( const xMBTag * pxTag )
+{
+    return ( pxTag->eType == MB_TAG_REG32 ) || ( pxTag->eType == MB_TAG_REG32_SWAPPED ) ? 2 : 1;
+}
+
+static          BOOL
+prvxMBPlanValidate( const xMBTag * pxTag )
+{
+    if( ( pxTag->ucSlaveAddress == MB_ADDRESS_BROADCAST ) ||
+        ( pxTag->ucSlaveAddress > MB_ADDRESS_MAX ) || ( pxTag->eTable > MB_TAG_INPUT ) )
+    {
+        return FALSE;
+    }
+    if( prvxMBPlanIsBitTable( pxTag->eTable ) != ( pxTag->eType == MB_TAG_BIT ? TRUE : FALSE ) )
+    {
+        return FALSE;
+    }
+    return ( ( ULONG ) pxTag->usAddress + prvusMBPlanTagWidth( pxTag ) ) <= 0x10000UL ? TRUE : FALSE;
+}
+
+static int
+prviMBPlanCompare( const xMBTag * pxA, const xMBTag * pxB )
+{
+    if( pxA->ucSlaveAddress != pxB->ucSlaveAddress )
+    {
+        return pxA->ucSlaveAddress < pxB->ucSlaveAddress ? -1 : 1;
+    }
+    if( pxA->eTable != pxB->eTable )
+    {
+        return pxA->eTable < pxB->eTable ? -1 : 1;
+    }
+    if( pxA->usAddress != pxB->usAddress )
+    {
+        return pxA->usAddress < pxB->usAddress ? -1 : 1;
+    }
+    return 0;
+}
+
+/* Returns the first unassigned tag in the order of slave, table and address.
+ * If pxSame is given only tags of its slave and table are considered. The
+ * tags are searched linearly instead of sorted so that the application keeps
+ * its array order. The plan is built once, so this is cheap enough. */
+static xMBTag  *
+prvpxMBPlanNextTag( xMBPlan * pxPlan, const xMBTag * pxSame )
+{
+    xMBTag         *pxBest = NULL;
+    xMBTag         *pxTag;
+    USHORT          i;
+
+    for( i = 0; i < pxPlan->usTags; i++ )
+    {
+        pxTag = &pxPlan->pxTags[i];
+        if( pxTag->usBlock != MB_PLAN_UNASSIGNED )
+        {
+            continue;
+        }
+        if( ( pxSame != NULL ) &&
+            ( ( pxTag->ucSlaveAddress != pxSame->ucSlaveAddress ) || ( pxTag->eTable != pxSame->eTable ) ) )
+        {
+            continue;
+        }
+        if( ( pxBest == NULL ) || ( prviMBPlanCompare( pxTag, pxBest ) < 0 ) )
+        {
+            pxBest = pxTag;
+        }
+    }
+    return pxBest;
+}
+
+static          ULONG
+prvulMBPlanTransactionChars( eMBTagTable eTable, USHORT usCount )
+{
+    ULONG           ulData;
+
+    ulData = prvxMBPlanIsBitTable( eTable ) ? ( ( ULONG ) usCount + 7 ) / 8 : ( ULONG ) usCount * 2;
+    return MB_PLAN_REQ_CHARS + MB_PLAN_RSP_CHARS + MB_PLAN_SILENCE_CHARS + ulData;
+}
+
+static void
+prvvMBPlanSubmit( xMBPlan * pxPlan, USHORT usBlock )
+{
+    static const UCHAR ucFunctionCodes[] = {
+        MB_FUNC_READ_COILS,
+        MB_FUNC_READ_DISCRETE_INPUTS,
+        MB_FUNC_READ_HOLDING_REGISTER,
+        MB_FUNC_READ_INPUT_REGISTER
+    };
+    xMBPlanBlock   *pxBlock = &pxPlan->pxBlocks[usBlock];
+    xMBMasterRequest *pxReq = &pxPlan->xReq;
+
+    pxReq->ucSlaveAddress = pxBlock->ucSlaveAddress;
+    pxReq->ucFunctionCode = ucFunctionCodes[pxBlock->eTable];
+    pxReq->usAddress = pxBlock->usAddress;
+    pxReq->usCount = pxBlock->usCount;
+    pxReq->pusRegs = pxPlan->xBuf.ausRegs;
+    pxReq->pucBits = pxPlan->xBuf.aucBits;
+    pxReq->pvDone = prvvMBPlanDone;
+    pxReq->pvArg = pxPlan;
+
+    /* A block which could not be queued stays due and is tried again on
+     * the next poll. */
+    if( eMBMasterSubmit( pxPlan->pxInst, pxReq ) == MB_ENOERR )
+    {
+        pxBlock->ulLastStart = MB_PORT_GET_TICK(  );
+        pxBlock->xStarted = TRUE;
+        pxPlan->usCurrent = usBlock;
+        pxPlan->xBusy = TRUE;
+    }
+}
+
+static void
+prvvMBPlanDone( xMBMasterRequest * pxReq, eMBErrorCode eStatus )
+{
+    xMBPlan        *pxPlan = ( xMBPlan * ) pxReq->pvArg;
+    xMBPlanBlock   *pxBlock = &pxPlan->pxBlocks[pxPlan->usCurrent];
+    const USHORT   *pusRegs = pxPlan->xBuf.ausRegs;
+    xMBTag         *pxTag;
+    USHORT          usOff;
+
+    /* Scatter the block to its tags. On errors the last values are kept. */
+    for( pxTag = pxBlock->pxTags; pxTag != NULL; pxTag = pxTag->pxNext )
+    {
+        pxTag->eStatus = eStatus;
+        if( eStatus != MB_ENOERR )
+        {
+            continue;
+        }
+        usOff = pxTag->usAddress - pxBlock->usAddress;
+        switch ( pxTag->eType )
+        {
+        case MB_TAG_BIT:
+            pxTag->ulValue = ( pxPlan->xBuf.aucBits[usOff / 8] >> ( usOff % 8 ) ) & 0x01;
+            break;
+        case MB_TAG_REG16:
+            pxTag->ulValue = pusRegs[usOff];
+            break;
+        case MB_TAG_REG32:
+            pxTag->ulValue = ( ( ULONG ) pusRegs[usOff] << 16 ) | pusRegs[usOff + 1];
+            break;
+        case MB_TAG_REG32_SWAPPED:
+            pxTag->ulValue = ( ( ULONG ) pusRegs[usOff + 1] << 16 ) | pusRegs[usOff];
+            break;
+        }
+        pxTag->ulTimestamp = MB_PORT_GET_TICK(  );
+    }
+
+    /* Queue the next due block now. The master sends it right after this
+     * callback returns, so the bus does not idle between blocks. */
+    pxPlan->xBusy = FALSE;
+    vMBPlanPoll( pxPlan );
+}
+
+#endif
@@ -36,11 +36,14 @@
 
 /* ----------------------- Modbus includes ----------------------------------*/
 #include "mb.h"
+#include "mbconfig.h"
 #include "mbrtu.h"
 #include "mbframe.h"
+#include "mbinstance.h"
 
 #include "mbcrc.h"
 #include "mbport.h"
+#include "mbtrace.h"
 
 /* ----------------------- Defines ------------------------------------------*/
 #define MB_SER_PDU_SIZE_MIN     4       /*!< Minimum size of a Modbus RTU frame. */
@@ -49,44 +52,57 @@
 #define MB_SER_PDU_ADDR_OFF     0       /*!< Offset of slave address in Ser-PDU. */
 #define MB_SER_PDU_PDU_OFF      1       /*!< Offset of Modbus-PDU in Ser-PDU. */
 
-/* ----------------------- Type definitions ---------------------------------*/
-typedef enum
-{
-    STATE_RX_INIT,              /*!< Receiver is in initial state. */
-    STATE_RX_IDLE,              /*!< Receiver is in idle state. */
-    STATE_RX_RCV,               /*!< Frame is beeing received. */
-    STATE_RX_ERROR              /*!< If the frame is invalid. */
-} eMBRcvState;
+#define MB_RTU_CRC_RUNNING      ( ( MB_RTU_CRC_RUNNING_ENABLED > 0 ) && ( MB_RTU_DMA_RX_ENABLED == 0 ) )
+#define MB_RTU_PREDICT_ENABLED  ( ( MB_RTU_LENGTH_PREDICT_ENABLED > 0 ) && MB_RTU_CRC_RUNNING )
+
+/* The time of the last byte is kept until the end of the frame is known. */
+#if MB_TRACE_ENABLED > 0
+#define MB_RTU_TRACE_RX_BYTE( pxRTU )   ( ( pxRTU )->ulTraceRxStamp = MB_TRACE_STAMP(  ) )
+#define MB_RTU_TRACE_RX_END( pxRTU )    do { MB_TRACE_AT( MB_TRACE_RX_BYTE, ( pxRTU )->ulTraceRxStamp ); \
+                                             MB_TRACE( MB_TRACE_RX_END ); } while( 0 )
+#else
+#define MB_RTU_TRACE_RX_BYTE( pxRTU )   ( ( void )0 )
+#define MB_RTU_TRACE_RX_END( pxRTU )    ( ( void )0 )
+#endif
+
+/* ----------------------- Static functions ---------------------------------*/
+static eMBErrorCode prveMBRTUStartTransmit( xMBInstance * pxInst );
+static BOOL     prvxMBRTUIsForUs( xMBInstance * pxInst, UCHAR ucAddress );
+
+#if MB_RTU_PREDICT_ENABLED
+static USHORT   prvusMBRTUPredictLength( xMBInstance * pxInst );
+#endif
+
+#if MB_MASTER_ENABLED > 0
+#define prvxMBRTUIsMaster( pxInst )     ( ( pxInst )->xIsMaster )
+#else
+#define prvxMBRTUIsMaster( pxInst )     ( FALSE )
+#endif
 
-typedef enum
+/* ----------------------- Start implementation -----------------------------*/
+static          BOOL
+prvxMBRTUIsForUs( xMBInstance * pxInst, UCHAR ucAddress )
 {
-    STATE_TX_IDLE,              /*!< Transmitter is in idle state. */
-    STATE_TX_XMIT               /*!< Transmitter is in transfer state. */
-} eMBSndState;
-
-/* ----------------------- Static variables ---------------------------------*/
-static volatile eMBSndState eSndState;
-static volatile eMBRcvState eRcvState;
-
-volatile UCHAR  ucRTUBuf[MB_SER_PDU_SIZE_MAX];
-
-static volatile UCHAR *pucSndBufferCur;
-static volatile USHORT usSndBufferCount;
-
-static volatile USHORT usRcvBufferPos;
+    /* A master receives the responses of all slaves. */
+    return prvxMBRTUIsMaster( pxInst ) || ( ucAddress == pxInst->xSer.xRTU.ucRTUAddress ) ||
+        ( ucAddress == MB_ADDRESS_BROADCAST ) || xMBIsVirtualSlave( ucAddress );
+}
 
-/* ----------------------- Start implementation -----------------------------*/
 eMBErrorCode
-eMBRTUInit( UCHAR ucSlaveAddress, UCHAR ucPort, ULONG ulBaudRate, eMBParity eParity )
+eMBRTUInit( xMBInstance * pxInst, UCHAR ucSlaveAddress, UCHAR ucPort, ULONG ulBaudRate,
+            eMBParity eParity )
 {
+    xMBRTUState    *pxRTU = &pxInst->xSer.xRTU;
     eMBErrorCode    eStatus = MB_ENOERR;
     ULONG           usTimerT35_50us;
 
-    ( void )ucSlaveAddress;
     ENTER_CRITICAL_SECTION(  );
+    /* Frames for other slaves are dropped by the receiver. */
+    pxRTU->ucRTUAddress = ucSlaveAddress;
+    pxRTU->ulSkippedFrames = 0;
 
     /* Modbus RTU uses 8 Databits. */
-    if( xMBPortSerialInit( ucPort, ulBaudRate, 8, eParity ) != TRUE )
+    if( xMBPortSerialInit( pxInst, ucPort, ulBaudRate, 8, eParity ) != TRUE )
     {
         eStatus = MB_EPORTERR;
     }
@@ -111,7 +127,7 @@ eMBRTUInit( UCHAR ucSlaveAddress, UCHAR ucPort, ULONG ulBaudRate, eMBParity ePar
              */
             usTimerT35_50us = ( 7UL * 220000UL ) / ( 2UL * ulBaudRate );
         }
-        if( xMBPortTimersInit( ( USHORT ) usTimerT35_50us ) != TRUE )
+        if( xMBPortTimersInit( pxInst, ( USHORT ) usTimerT35_50us ) != TRUE )
         {
             eStatus = MB_EPORTERR;
         }
@@ -122,70 +138,94 @@ eMBRTUInit( UCHAR ucSlaveAddress, UCHAR ucPort, ULONG ulBaudRate, eMBParity ePar
 }
 
 void
-eMBRTUStart( void )
+eMBRTUStart( xMBInstance * pxInst )
 {
+    xMBRTUState    *pxRTU = &pxInst->xSer.xRTU;
+
     ENTER_CRITICAL_SECTION(  );
     /* Initially the receiver is in the state STATE_RX_INIT. we start
      * the timer and if no character is received within t3.5 we change
      * to STATE_RX_IDLE. This makes sure that we delay startup of the
      * modbus protocol stack until the bus is free.
      */
-    eRcvState = STATE_RX_INIT;
-    vMBPortSerialEnable( TRUE, FALSE );
-    vMBPortTimersEnable(  );
+    pxRTU->eRcvState = STATE_RX_INIT;
+#if MB_RTU_DMA_RX_ENABLED > 0
+    /* Frames are stored directly into the RTU buffer by the port. */
+    ( void )xMBPortSerialStartReceive( pxInst, ( UCHAR * ) pxInst->ucSerBuf, MB_SER_PDU_SIZE_MAX );
+#else
+    vMBPortSerialEnable( pxInst, TRUE, FALSE );
+#endif
+    vMBPortTimersEnable( pxInst );
 
     EXIT_CRITICAL_SECTION(  );
 }
 
 void
-eMBRTUStop( void )
+eMBRTUStop( xMBInstance * pxInst )
 {
     ENTER_CRITICAL_SECTION(  );
-    vMBPortSerialEnable( FALSE, FALSE );
-    vMBPortTimersDisable(  );
+    vMBPortSerialEnable( pxInst, FALSE, FALSE );
+    vMBPortTimersDisable( pxInst );
     EXIT_CRITICAL_SECTION(  );
 }
 
 eMBErrorCode
-eMBRTUReceive( UCHAR * pucRcvAddress, UCHAR ** pucFrame, USHORT * pusLength )
+eMBRTUReceive( xMBInstance * pxInst, UCHAR * pucRcvAddress, UCHAR ** pucFrame, USHORT * pusLength )
 {
-    BOOL            xFrameReceived = FALSE;
+    xMBRTUState    *pxRTU = &pxInst->xSer.xRTU;
     eMBErrorCode    eStatus = MB_ENOERR;
+    USHORT          usFrameLength;
+    USHORT          usFrameCRC;
 
     ENTER_CRITICAL_SECTION(  );
-    assert( usRcvBufferPos < MB_SER_PDU_SIZE_MAX );
+    assert( pxRTU->usRcvBufferPos <= MB_SER_PDU_SIZE_MAX );
+    usFrameLength = pxRTU->usRcvBufferPos;
+#if MB_RTU_CRC_RUNNING
+    usFrameCRC = pxRTU->usRcvCRC;
+#elif MB_RTU_DMA_RX_ENABLED == 0
+    /* Without the running CRC the whole frame is checked here, with the
+     * receiver locked out. */
+    usFrameCRC = usMBCRC16( ( UCHAR * ) pxInst->ucSerBuf, usFrameLength );
+#endif
+    EXIT_CRITICAL_SECTION(  );
+
+#if MB_RTU_DMA_RX_ENABLED > 0
+    /* The frame was stored by DMA. Compute the CRC outside of the
+     * critical section. */
+    usFrameCRC = usMBCRC16( ( UCHAR * ) pxInst->ucSerBuf, usFrameLength );
+#endif
 
-    /* Length and CRC check */
-    if( ( usRcvBufferPos >= MB_SER_PDU_SIZE_MIN )
-        && ( usMBCRC16( ( UCHAR * ) ucRTUBuf, usRcvBufferPos ) == 0 ) )
+    /* Length and CRC check. The CRC over a frame including its own CRC
+     * field is zero. */
+    if( ( usFrameLength >= MB_SER_PDU_SIZE_MIN ) && ( usFrameCRC == 0 ) )
     {
         /* Save the address field. All frames are passed to the upper layed
          * and the decision if a frame is used is done there.
          */
-        *pucRcvAddress = ucRTUBuf[MB_SER_PDU_ADDR_OFF];
+        *pucRcvAddress = pxInst->ucSerBuf[MB_SER_PDU_ADDR_OFF];
 
         /* Total length of Modbus-PDU is Modbus-Serial-Line-PDU minus
          * size of address field and CRC checksum.
          */
-        *pusLength = ( USHORT )( usRcvBufferPos - MB_SER_PDU_PDU_OFF - MB_SER_PDU_SIZE_CRC );
+        *pusLength = ( USHORT )( usFrameLength - MB_SER_PDU_PDU_OFF - MB_SER_PDU_SIZE_CRC );
 
         /* Return the start of the Modbus PDU to the caller. */
-        *pucFrame = ( UCHAR * ) & ucRTUBuf[MB_SER_PDU_PDU_OFF];
-        xFrameReceived = TRUE;
-        HAL_GPIO_TogglePin(GPIOC, GPIO_PIN_13);
+        *pucFrame = ( UCHAR * ) & pxInst->ucSerBuf[MB_SER_PDU_PDU_OFF];
+        MB_TRACE( MB_TRACE_RX_CRC );
+        MB_PORT_FRAME_INDICATE(  );
     }
     else
     {
         eStatus = MB_EIO;
     }
 
-    EXIT_CRITICAL_SECTION(  );
     return eStatus;
 }
 
 eMBErrorCode
-eMBRTUSend( UCHAR ucSlaveAddress, const UCHAR * pucFrame, USHORT usLength )
+eMBRTUSend( xMBInstance * pxInst, UCHAR ucSlaveAddress, const UCHAR * pucFrame, USHORT usLength )
 {
+    xMBRTUState    *pxRTU = &pxInst->xSer.xRTU;
     eMBErrorCode    eStatus = MB_ENOERR;
     USHORT          usCRC16;
 
@@ -195,25 +235,48 @@ eMBRTUSend( UCHAR ucSlaveAddress, const UCHAR * pucFrame, USHORT usLength )
      * slow with processing the received frame and the master sent another
      * frame on the network. We have to abort sending the frame.
      */
-    if( eRcvState == STATE_RX_IDLE )
+#if MB_RTU_DMA_RX_ENABLED > 0
+    /* In DMA mode the receiver is rearmed as soon as a frame has been
+     * received. Any byte stored since then belongs to a new frame. */
+    if( ( pxRTU->eRcvState == STATE_RX_IDLE ) && ( usMBPortSerialRxCount( pxInst ) == 0 ) )
+#else
+    if( pxRTU->eRcvState == STATE_RX_IDLE )
+#endif
     {
         /* First byte before the Modbus-PDU is the slave address. */
-        pucSndBufferCur = ( UCHAR * ) pucFrame - 1;
-        usSndBufferCount = 1;
+        pxRTU->pucSndBufferCur = ( UCHAR * ) pucFrame - 1;
+        pxRTU->usSndBufferCount = 1;
 
         /* Now copy the Modbus-PDU into the Modbus-Serial-Line-PDU. */
-        pucSndBufferCur[MB_SER_PDU_ADDR_OFF] = ucSlaveAddress;
-        usSndBufferCount += usLength;
+        pxRTU->pucSndBufferCur[MB_SER_PDU_ADDR_OFF] = ucSlaveAddress;
+        pxRTU->usSndBufferCount += usLength;
 
         /* Calculate CRC16 checksum for Modbus-Serial-Line-PDU. */
-        usCRC16 = usMBCRC16( ( UCHAR * ) pucSndBufferCur, usSndBufferCount );
-        ucRTUBuf[usSndBufferCount++] = ( UCHAR )( usCRC16 & 0xFF );
-        ucRTUBuf[usSndBufferCount++] = ( UCHAR )( usCRC16 >> 8 );
+        usCRC16 = usMBCRC16( ( UCHAR * ) pxRTU->pucSndBufferCur, pxRTU->usSndBufferCount );
+        pxInst->ucSerBuf[pxRTU->usSndBufferCount++] = ( UCHAR )( usCRC16 & 0xFF );
+        pxInst->ucSerBuf[pxRTU->usSndBufferCount++] = ( UCHAR )( usCRC16 >> 8 );
+        MB_TRACE( MB_TRACE_TX_CRC );
 
         /* Activate the transmitter. */
-        eSndState = STATE_TX_XMIT;
-        vMBPortSerialEnable( FALSE, TRUE );
+        eStatus = prveMBRTUStartTransmit( pxInst );
     }
+#if MB_RTU_PREDICT_ENABLED
+    else if( pxRTU->eRcvState == STATE_RX_PREDICTED )
+    {
+        /* The request was detected by its length and t3.5 has not yet
+         * expired. Prepare the reply and let xMBRTUTimerT35Expired( )
+         * start the transmitter once the bus has been silent long enough.
+         */
+        pxRTU->pucSndBufferCur = ( UCHAR * ) pucFrame - 1;
+        pxRTU->pucSndBufferCur[MB_SER_PDU_ADDR_OFF] = ucSlaveAddress;
+        pxRTU->usSndBufferCount = ( USHORT )( 1 + usLength );
+        usCRC16 = usMBCRC16( ( UCHAR * ) pxRTU->pucSndBufferCur, pxRTU->usSndBufferCount );
+        pxInst->ucSerBuf[pxRTU->usSndBufferCount++] = ( UCHAR )( usCRC16 & 0xFF );
+        pxInst->ucSerBuf[pxRTU->usSndBufferCount++] = ( UCHAR )( usCRC16 >> 8 );
+        MB_TRACE( MB_TRACE_TX_CRC );
+        pxRTU->xSndDeferred = TRUE;
+    }
+#endif
     else
     {
         eStatus = MB_EIO;
@@ -223,30 +286,38 @@ eMBRTUSend( UCHAR ucSlaveAddress, const UCHAR * pucFrame, USHORT usLength )
 }
 
 BOOL
-xMBRTUReceiveFSM( void )
+xMBRTUReceiveFSM( xMBInstance * pxInst )
 {
+    xMBRTUState    *pxRTU = &pxInst->xSer.xRTU;
     BOOL            xTaskNeedSwitch = FALSE;
     UCHAR           ucByte;
 
-    assert( eSndState == STATE_TX_IDLE );
+    assert( pxRTU->eSndState == STATE_TX_IDLE );
 
     /* Always read the character. */
-    ( void )xMBPortSerialGetByte( ( CHAR * ) & ucByte );
+    ( void )xMBPortSerialGetByte( pxInst, ( CHAR * ) & ucByte );
 
-    switch ( eRcvState )
+    switch ( pxRTU->eRcvState )
     {
         /* If we have received a character in the init state we have to
          * wait until the frame is finished.
          */
     case STATE_RX_INIT:
-        vMBPortTimersEnable(  );
+        vMBPortTimersEnable( pxInst );
         break;
 
         /* In the error state we wait until all characters in the
          * damaged frame are transmitted.
          */
     case STATE_RX_ERROR:
-        vMBPortTimersEnable(  );
+        vMBPortTimersEnable( pxInst );
+        break;
+
+        /* The frame is addressed to another slave. Ignore the remaining
+         * characters until the bus is silent again.
+         */
+    case STATE_RX_SKIP:
+        vMBPortTimersEnable( pxInst );
         break;
 
         /* In the idle state we wait for a new character. If a character
@@ -254,12 +325,30 @@ xMBRTUReceiveFSM( void )
          * receiver is in the state STATE_RX_RECEIVCE.
          */
     case STATE_RX_IDLE:
-        usRcvBufferPos = 0;
-        ucRTUBuf[usRcvBufferPos++] = ucByte;
-        eRcvState = STATE_RX_RCV;
+        /* The first character is the address. Frames for other slaves
+         * are neither buffered nor checked. */
+        if( !prvxMBRTUIsForUs( pxInst, ucByte ) )
+        {
+            pxRTU->ulSkippedFrames++;
+            pxRTU->eRcvState = STATE_RX_SKIP;
+            vMBPortTimersEnable( pxInst );
+            break;
+        }
+        pxRTU->usRcvBufferPos = 0;
+        pxInst->ucSerBuf[pxRTU->usRcvBufferPos++] = ucByte;
+#if MB_RTU_CRC_RUNNING
+        pxRTU->usRcvCRC = usMBCRC16UpdateByte( MB_CRC16_INIT, ucByte );
+#endif
+        pxRTU->eRcvState = STATE_RX_RCV;
+        MB_RTU_TRACE_RX_BYTE( pxRTU );
+#if MB_RTU_PREDICT_ENABLED
+        /* The length of a response is not predicted, a master waits for
+         * t3.5. */
+        pxRTU->usRcvExpectedLen = prvxMBRTUIsMaster( pxInst ) ? MB_SER_PDU_SIZE_MAX + 1 : 0;
+#endif
 
         /* Enable t3.5 timers. */
-        vMBPortTimersEnable(  );
+        vMBPortTimersEnable( pxInst );
         break;
 
         /* We are currently receiving a frame. Reset the timer after
@@ -268,51 +357,128 @@ xMBRTUReceiveFSM( void )
          * ignored.
          */
     case STATE_RX_RCV:
-        if( usRcvBufferPos < MB_SER_PDU_SIZE_MAX )
+        if( pxRTU->usRcvBufferPos < MB_SER_PDU_SIZE_MAX )
         {
-            ucRTUBuf[usRcvBufferPos++] = ucByte;
+            pxInst->ucSerBuf[pxRTU->usRcvBufferPos++] = ucByte;
+#if MB_RTU_CRC_RUNNING
+            /* Fold the byte into the running CRC so that the frame can be
+             * validated with a single compare in eMBRTUReceive( ). */
+            pxRTU->usRcvCRC = usMBCRC16UpdateByte( pxRTU->usRcvCRC, ucByte );
+#endif
+            MB_RTU_TRACE_RX_BYTE( pxRTU );
+#if MB_RTU_PREDICT_ENABLED
+            if( pxRTU->usRcvExpectedLen == 0 )
+            {
+                pxRTU->usRcvExpectedLen = prvusMBRTUPredictLength( pxInst );
+            }
+            /* The frame is complete if the predicted length is reached
+             * and the CRC matches. Otherwise t3.5 decides as usual. */
+            if( ( pxRTU->usRcvBufferPos == pxRTU->usRcvExpectedLen ) && ( pxRTU->usRcvCRC == 0 ) )
+            {
+                pxRTU->eRcvState = STATE_RX_PREDICTED;
+                pxRTU->xSndDeferred = FALSE;
+                MB_RTU_TRACE_RX_END( pxRTU );
+                xTaskNeedSwitch = xMBPortEventPost( pxInst, EV_FRAME_RECEIVED );
+            }
+#endif
         }
         else
         {
-            eRcvState = STATE_RX_ERROR;
+            pxRTU->eRcvState = STATE_RX_ERROR;
         }
-        vMBPortTimersEnable(  );
+        vMBPortTimersEnable( pxInst );
         break;
+
+#if MB_RTU_PREDICT_ENABLED
+        /* More characters after a frame which was already complete by its
+         * length. The frame did not end where predicted, so any reply to
+         * it must not be sent. */
+    case STATE_RX_PREDICTED:
+        pxRTU->xSndDeferred = FALSE;
+        pxRTU->eRcvState = STATE_RX_ERROR;
+        vMBPortTimersEnable( pxInst );
+        break;
+#endif
     }
     return xTaskNeedSwitch;
 }
 
+#if MB_RTU_DMA_RX_ENABLED > 0
 BOOL
-xMBRTUTransmitFSM( void )
+xMBRTUReceiveFrame( xMBInstance * pxInst, USHORT usLength )
 {
+    xMBRTUState    *pxRTU = &pxInst->xSer.xRTU;
     BOOL            xNeedPoll = FALSE;
 
-    assert( eRcvState == STATE_RX_IDLE );
+    assert( pxRTU->eSndState == STATE_TX_IDLE );
 
-    switch ( eSndState )
+    switch ( pxRTU->eRcvState )
+    {
+        /* The idle line already guarantees the end of the frame. Hand it
+         * to the protocol stack which checks length and CRC.
+         */
+    case STATE_RX_IDLE:
+        if( ( usLength > 0 ) && !prvxMBRTUIsForUs( pxInst, pxInst->ucSerBuf[MB_SER_PDU_ADDR_OFF] ) )
+        {
+            /* Frame for another slave. Drop it without computing the CRC. */
+            pxRTU->ulSkippedFrames++;
+            break;
+        }
+        pxRTU->usRcvBufferPos = usLength;
+        MB_TRACE( MB_TRACE_RX_END );
+        xNeedPoll = xMBPortEventPost( pxInst, EV_FRAME_RECEIVED );
+        break;
+
+        /* Frames received during the startup phase are dropped. The t3.5
+         * timer is restarted to wait until the bus is free.
+         */
+    default:
+        vMBPortTimersEnable( pxInst );
+        break;
+    }
+
+    /* The port stopped reception. Rearm it for the next frame. */
+    vMBPortSerialEnable( pxInst, TRUE, FALSE );
+    return xNeedPoll;
+}
+#endif
+
+BOOL
+xMBRTUTransmitFSM( xMBInstance * pxInst )
+{
+    xMBRTUState    *pxRTU = &pxInst->xSer.xRTU;
+    BOOL            xNeedPoll = FALSE;
+
+    assert( pxRTU->eRcvState == STATE_RX_IDLE );
+
+    switch ( pxRTU->eSndState )
     {
         /* We should not get a transmitter event if the transmitter is in
          * idle state.  */
     case STATE_TX_IDLE:
         /* enable receiver/disable transmitter. */
-        vMBPortSerialEnable( TRUE, FALSE );
+        vMBPortSerialEnable( pxInst, TRUE, FALSE );
         break;
 
     case STATE_TX_XMIT:
         /* check if we are finished. */
-        if( usSndBufferCount != 0 )
+        if( pxRTU->usSndBufferCount != 0 )
         {
-            xMBPortSerialPutByte( ( CHAR )*pucSndBufferCur );
-            pucSndBufferCur++;  /* next byte in sendbuffer. */
-            usSndBufferCount--;
+            if( pxRTU->pucSndBufferCur == pxInst->ucSerBuf )
+            {
+                MB_TRACE( MB_TRACE_TX_START );
+            }
+            xMBPortSerialPutByte( pxInst, ( CHAR )*pxRTU->pucSndBufferCur );
+            pxRTU->pucSndBufferCur++;  /* next byte in sendbuffer. */
+            pxRTU->usSndBufferCount--;
         }
         else
         {
-            xNeedPoll = xMBPortEventPost( EV_FRAME_SENT );
+            xNeedPoll = xMBPortEventPost( pxInst, EV_FRAME_SENT );
             /* Disable transmitter. This prevents another transmit buffer
              * empty interrupt. */
-            vMBPortSerialEnable( TRUE, FALSE );
-            eSndState = STATE_TX_IDLE;
+            vMBPortSerialEnable( pxInst, TRUE, FALSE );
+            pxRTU->eSndState = STATE_TX_IDLE;
         }
         break;
     }
@@ -320,36 +486,164 @@ xMBRTUTransmitFSM( void )
     return xNeedPoll;
 }
 
+#if MB_RTU_DMA_TX_ENABLED > 0
+BOOL
+xMBRTUTransmitComplete( xMBInstance * pxInst )
+{
+    xMBRTUState    *pxRTU = &pxInst->xSer.xRTU;
+    BOOL            xNeedPoll = FALSE;
+
+    if( pxRTU->eSndState == STATE_TX_XMIT )
+    {
+        pxRTU->usSndBufferCount = 0;
+        xNeedPoll = xMBPortEventPost( pxInst, EV_FRAME_SENT );
+        pxRTU->eSndState = STATE_TX_IDLE;
+    }
+    /* Enable the receiver again. */
+    vMBPortSerialEnable( pxInst, TRUE, FALSE );
+    return xNeedPoll;
+}
+#endif
+
 BOOL
-xMBRTUTimerT35Expired( void )
+xMBRTUTimerT35Expired( xMBInstance * pxInst )
 {
+    xMBRTUState    *pxRTU = &pxInst->xSer.xRTU;
     BOOL            xNeedPoll = FALSE;
 
-    switch ( eRcvState )
+    switch ( pxRTU->eRcvState )
     {
         /* Timer t35 expired. Startup phase is finished. */
     case STATE_RX_INIT:
-        xNeedPoll = xMBPortEventPost( EV_READY );
+        xNeedPoll = xMBPortEventPost( pxInst, EV_READY );
         break;
 
         /* A frame was received and t35 expired. Notify the listener that
          * a new frame was received. */
     case STATE_RX_RCV:
-        xNeedPoll = xMBPortEventPost( EV_FRAME_RECEIVED );
+        MB_RTU_TRACE_RX_END( pxRTU );
+        xNeedPoll = xMBPortEventPost( pxInst, EV_FRAME_RECEIVED );
         break;
 
         /* An error occured while receiving the frame. */
     case STATE_RX_ERROR:
         break;
 
+        /* End of a frame for another slave. */
+    case STATE_RX_SKIP:
+        break;
+
+#if MB_RTU_PREDICT_ENABLED
+        /* The frame has already been passed on. The bus was silent for
+         * t3.5 now, so a deferred reply may be sent. */
+    case STATE_RX_PREDICTED:
+        vMBPortTimersDisable( pxInst );
+        pxRTU->eRcvState = STATE_RX_IDLE;
+        if( pxRTU->xSndDeferred )
+        {
+            pxRTU->xSndDeferred = FALSE;
+            ( void )prveMBRTUStartTransmit( pxInst );
+        }
+        return xNeedPoll;
+#endif
+
         /* Function called in an illegal state. */
     default:
-        assert( ( eRcvState == STATE_RX_INIT ) ||
-                ( eRcvState == STATE_RX_RCV ) || ( eRcvState == STATE_RX_ERROR ) );
+        assert( ( pxRTU->eRcvState == STATE_RX_INIT ) ||
+                ( pxRTU->eRcvState == STATE_RX_RCV ) || ( pxRTU->eRcvState == STATE_RX_ERROR ) );
     }
 
-    vMBPortTimersDisable(  );
-    eRcvState = STATE_RX_IDLE;
+    vMBPortTimersDisable( pxInst );
+    pxRTU->eRcvState = STATE_RX_IDLE;
 
     return xNeedPoll;
 }
+
+ULONG
+ulMBRTUGetSkippedFrames( xMBInstance * pxInst )
+{
+    return pxInst->xSer.xRTU.ulSkippedFrames;
+}
+
+static          eMBErrorCode
+prveMBRTUStartTransmit( xMBInstance * pxInst )
+{
+    xMBRTUState    *pxRTU = &pxInst->xSer.xRTU;
+    eMBErrorCode    eStatus = MB_ENOERR;
+
+    pxRTU->eSndState = STATE_TX_XMIT;
+#if MB_RTU_DMA_TX_ENABLED > 0
+    /* Hand the complete frame to the port. The receiver stays off
+     * until xMBRTUTransmitComplete( ) is called. */
+    vMBPortSerialEnable( pxInst, FALSE, FALSE );
+    MB_TRACE( MB_TRACE_TX_START );
+    if( xMBPortSerialPutBuffer( pxInst, ( UCHAR * ) pxRTU->pucSndBufferCur, pxRTU->usSndBufferCount ) != TRUE )
+    {
+        pxRTU->eSndState = STATE_TX_IDLE;
+        vMBPortSerialEnable( pxInst, TRUE, FALSE );
+        eStatus = MB_EIO;
+    }
+#else
+    vMBPortSerialEnable( pxInst, FALSE, TRUE );
+#endif
+    return eStatus;
+}
+
+#if MB_RTU_PREDICT_ENABLED
+static          USHORT
+prvusMBRTUPredictLength( xMBInstance * pxInst )
+{
+    /* Returns the length of the serial line PDU of a request including
+     * address and CRC, or 0 if it is not (yet) known. */
+    xMBRTUState    *pxRTU = &pxInst->xSer.xRTU;
+    USHORT          usLength = 0;
+
+    if( pxRTU->usRcvBufferPos < 2 )
+    {
+        return 0;
+    }
+    switch ( pxInst->ucSerBuf[MB_SER_PDU_PDU_OFF] )
+    {
+    case MB_FUNC_READ_COILS:
+    case MB_FUNC_READ_DISCRETE_INPUTS:
+    case MB_FUNC_READ_HOLDING_REGISTER:
+    case MB_FUNC_READ_INPUT_REGISTER:
+    case MB_FUNC_WRITE_SINGLE_COIL:
+    case MB_FUNC_WRITE_REGISTER:
+    case MB_FUNC_DIAG_DIAGNOSTIC:
+        /* Address, function code, 4 data bytes and CRC. */
+        usLength = 8;
+        break;
+
+    case MB_FUNC_DIAG_READ_EXCEPTION:
+    case MB_FUNC_DIAG_GET_COM_EVENT_CNT:
+    case MB_FUNC_DIAG_GET_COM_EVENT_LOG:
+    case MB_FUNC_OTHER_REPORT_SLAVEID:
+        usLength = 4;
+        break;
+
+    case MB_FUNC_WRITE_MULTIPLE_COILS:
+    case MB_FUNC_WRITE_MULTIPLE_REGISTERS:
+        /* Byte count follows address and quantity. */
+        if( pxRTU->usRcvBufferPos > 6 )
+        {
+            usLength = ( USHORT )( 9 + pxInst->ucSerBuf[6] );
+        }
+        break;
+
+    case MB_FUNC_READWRITE_MULTIPLE_REGISTERS:
+        /* Byte count follows read and write address and quantity. */
+        if( pxRTU->usRcvBufferPos > 10 )
+        {
+            usLength = ( USHORT )( 13 + pxInst->ucSerBuf[10] );
+        }
+        break;
+
+    default:
+        /* Custom function code. Wait for t3.5. */
+        usLength = MB_SER_PDU_SIZE_MAX + 1;
+        break;
+    }
+    return usLength;
+}
+#endif
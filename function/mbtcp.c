@@ -40,6 +40,9 @@
 #include "mbtcp.h"
 #include "mbframe.h"
 #include "mbport.h"
+#if MB_GATEWAY_ENABLED > 0
+#include "mbgateway.h"
+#endif
 
 #if MB_TCP_ENABLED > 0
 
@@ -64,24 +67,18 @@
  *
  * (1)  ... Modbus TCP/IP Application Data Unit
  * (1') ... Modbus Protocol Data Unit
+ *
+ * The offsets are defined in mbtcp.h.
  */
 
-#define MB_TCP_TID          0
-#define MB_TCP_PID          2
-#define MB_TCP_LEN          4
-#define MB_TCP_UID          6
-#define MB_TCP_FUNC         7
-
-#define MB_TCP_PROTOCOL_ID  0   /* 0 = Modbus Protocol */
-
 
 /* ----------------------- Start implementation -----------------------------*/
 eMBErrorCode
-eMBTCPDoInit( USHORT ucTCPPort )
+eMBTCPDoInit( xMBInstance * pxInst, USHORT ucTCPPort )
 {
     eMBErrorCode    eStatus = MB_ENOERR;
 
-    if( xMBTCPPortInit( ucTCPPort ) == FALSE )
+    if( xMBTCPPortInit( pxInst, ucTCPPort ) == FALSE )
     {
         eStatus = MB_EPORTERR;
     }
@@ -89,19 +86,25 @@ eMBTCPDoInit( USHORT ucTCPPort )
 }
 
 void
-eMBTCPStart( void )
+eMBTCPStart( xMBInstance * pxInst )
 {
 }
 
 void
-eMBTCPStop( void )
+eMBTCPStop( xMBInstance * pxInst )
 {
     /* Make sure that no more clients are connected. */
     vMBTCPPortDisable( );
 }
 
+void
+eMBTCPClose( xMBInstance * pxInst )
+{
+    vMBTCPPortClose( );
+}
+
 eMBErrorCode
-eMBTCPReceive( UCHAR * pucRcvAddress, UCHAR ** ppucFrame, USHORT * pusLength )
+eMBTCPReceive( xMBInstance * pxInst, UCHAR * pucRcvAddress, UCHAR ** ppucFrame, USHORT * pusLength )
 {
     eMBErrorCode    eStatus = MB_EIO;
     UCHAR          *pucMBTCPFrame;
@@ -120,9 +123,24 @@ eMBTCPReceive( UCHAR * pucRcvAddress, UCHAR ** ppucFrame, USHORT * pusLength )
             eStatus = MB_ENOERR;
 
             /* Modbus TCP does not use any addresses. Fake the source address such
-             * that the processing part deals with this frame.
+             * that the processing part deals with this frame. Only a unit
+             * identifier of a virtual slave selects that slave and one routed
+             * by the gateway selects a slave on the RTU bus.
              */
-            *pucRcvAddress = MB_TCP_PSEUDO_ADDRESS;
+            if( xMBIsVirtualSlave( pucMBTCPFrame[MB_TCP_UID] ) )
+            {
+                *pucRcvAddress = pucMBTCPFrame[MB_TCP_UID];
+            }
+#if MB_GATEWAY_ENABLED > 0
+            else if( xMBGatewayIsRouted( pucMBTCPFrame[MB_TCP_UID] ) )
+            {
+                *pucRcvAddress = pucMBTCPFrame[MB_TCP_UID];
+            }
+#endif
+            else
+            {
+                *pucRcvAddress = MB_TCP_PSEUDO_ADDRESS;
+            }
         }
     }
     else
@@ -133,7 +151,7 @@ eMBTCPReceive( UCHAR * pucRcvAddress, UCHAR ** ppucFrame, USHORT * pusLength )
 }
 
 eMBErrorCode
-eMBTCPSend( UCHAR _unused, const UCHAR * pucFrame, USHORT usLength )
+eMBTCPSend( xMBInstance * pxInst, UCHAR _unused, const UCHAR * pucFrame, USHORT usLength )
 {
     eMBErrorCode    eStatus = MB_ENOERR;
     UCHAR          *pucMBTCPFrame = ( UCHAR * ) pucFrame - MB_TCP_FUNC;
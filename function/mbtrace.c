@@ -0,0 +1,122 @@
+/* 
+ * FreeModbus Libary: A portable Modbus implementation for Modbus ASCII/RTU.
+ * Copyright (c) 2006-2018 Christian Walter <cwalter@embedded-solutions.at>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* ----------------------- Platform includes --------------------------------*/
+#include "port.h"
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "mb.h"
+#include "mbconfig.h"
+#include "mbtrace.h"
+
+#if MB_TRACE_ENABLED > 0
+
+/* ----------------------- Defines ------------------------------------------*/
+#define MB_TRACE_RING_MASK      ( MB_TRACE_RING_SIZE - 1U )
+
+/* ----------------------- Static variables ---------------------------------*/
+xMBTraceRing    xMBTraceBuffer;
+
+/* ----------------------- Start implementation -----------------------------*/
+void
+vMBTraceInit( void )
+{
+    USHORT          i;
+
+    if( xMBTraceBuffer.xHeader.ulMagic == MB_TRACE_MAGIC )
+    {
+        /* Another instance started the trace already. */
+        return;
+    }
+    MB_PORT_TRACE_INIT(  );
+    for( i = 0; i < MB_TRACE_RING_SIZE; i++ )
+    {
+        /* No record matches its position before it has been written. */
+        xMBTraceBuffer.xRecords[i].usSeq = ( uint16_t )( i + 1U );
+    }
+    xMBTraceBuffer.xHeader.ulHz = MB_PORT_TRACE_HZ(  );
+    xMBTraceBuffer.xHeader.ulSize = MB_TRACE_RING_SIZE;
+    xMBTraceBuffer.xHeader.ulHead = 0;
+    MB_PORT_MEMORY_BARRIER(  );
+    xMBTraceBuffer.xHeader.ulMagic = MB_TRACE_MAGIC;
+}
+
+void
+vMBTraceAt( eMBTraceStage eStage, uint32_t ulStamp )
+{
+    xMBTraceRecord *pxRecord;
+    uint32_t        ulPos;
+
+    if( xMBTraceBuffer.xHeader.ulMagic != MB_TRACE_MAGIC )
+    {
+        return;
+    }
+    /* An interrupt handler which traces between the claim and the store
+     * takes the next record. Its record is complete before ours. */
+    ulPos = MB_PORT_TRACE_CLAIM( &xMBTraceBuffer.xHeader.ulHead );
+    pxRecord = &xMBTraceBuffer.xRecords[ulPos & MB_TRACE_RING_MASK];
+    pxRecord->usSeq = ( uint16_t )( ulPos + 1U );
+    MB_PORT_MEMORY_BARRIER(  );
+    pxRecord->ulStamp = ulStamp;
+    pxRecord->ucStage = ( uint8_t )eStage;
+    MB_PORT_MEMORY_BARRIER(  );
+    pxRecord->usSeq = ( uint16_t )ulPos;
+}
+
+BOOL
+xMBTraceRead( ULONG * pulCursor, xMBTraceRecord * pxRecord )
+{
+    const xMBTraceRecord *pxSlot;
+    uint32_t        ulHead = xMBTraceBuffer.xHeader.ulHead;
+
+    if( xMBTraceBuffer.xHeader.ulMagic != MB_TRACE_MAGIC )
+    {
+        return FALSE;
+    }
+    if( ( uint32_t )( ulHead - *pulCursor ) > MB_TRACE_RING_SIZE )
+    {
+        *pulCursor = ulHead - MB_TRACE_RING_SIZE;
+    }
+    while( *pulCursor != ulHead )
+    {
+        pxSlot = &xMBTraceBuffer.xRecords[*pulCursor & MB_TRACE_RING_MASK];
+        *pxRecord = *pxSlot;
+        MB_PORT_MEMORY_BARRIER(  );
+        ( *pulCursor )++;
+        /* Skip records being written and records overwritten while they
+         * were copied. */
+        if( ( pxRecord->usSeq == ( uint16_t )( *pulCursor - 1U ) ) && ( pxSlot->usSeq == pxRecord->usSeq ) )
+        {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+#endif
@@ -21,40 +21,125 @@
 
 /* ----------------------- Modbus includes ----------------------------------*/
 #include "mbport.h"
+#include "mbinstance.h"
 
-/* ----------------------- Variables ----------------------------------------*/
-static eMBEventType eQueuedEvent;
-static BOOL     xEventInQueue;
+/* ----------------------- Defines ------------------------------------------*/
+#if ( MB_EVENT_QUEUE_SIZE & ( MB_EVENT_QUEUE_SIZE - 1 ) ) || ( MB_EVENT_QUEUE_SIZE > 128 )
+#error "MB_EVENT_QUEUE_SIZE must be a power of two not larger than 128"
+#endif
 
-//static eMBEventType eQueuedEventTCP;
-//static BOOL     xEventInQueueTCP;
+#define MB_EVENT_QUEUE_MASK     ( MB_EVENT_QUEUE_SIZE - 1 )
 
 /* ----------------------- Start implementation -----------------------------*/
 BOOL
-xMBPortEventInit( void )
+xMBPortEventInit( xMBInstance * pxInst )
 {
-    xEventInQueue = FALSE;
+    int             i;
+
+    for( i = 0; i < MB_EV_TRANSPORTS; i++ )
+    {
+        pxInst->xEventQueues[i].ucHead = 0;
+        pxInst->xEventQueues[i].ucTail = 0;
+        pxInst->xEventQueues[i].ulOverflows = 0;
+    }
     return TRUE;
 }
 
 BOOL
-xMBPortEventPost( eMBEventType eEvent )
+xMBPortEventPost( xMBInstance * pxInst, eMBEventType eEvent )
+{
+    /* The transmission layers post from the serial and timer interrupts. */
+    return xMBPortEventPostTransport( pxInst, MB_EV_TRANSPORT_SERIAL, eEvent );
+}
+
+BOOL
+xMBPortEventPostTransport( xMBInstance * pxInst, eMBEventTransport eTransport,
+                           eMBEventType eEvent )
 {
-    eQueuedEvent = eEvent;
-    xEventInQueue = TRUE;
+    xMBEventQueue  *pxQueue = &pxInst->xEventQueues[eTransport];
+    UCHAR           ucHead = pxQueue->ucHead;
+    xMBEvent       *pxEvent;
+
+    if( ( UCHAR )( ucHead - pxQueue->ucTail ) >= MB_EVENT_QUEUE_SIZE )
+    {
+        pxQueue->ulOverflows++;
+        return FALSE;
+    }
+    pxEvent = &pxQueue->xEvents[ucHead & MB_EVENT_QUEUE_MASK];
+    pxEvent->eEvent = eEvent;
+    pxEvent->eTransport = eTransport;
+    pxEvent->ulTimestamp = MB_PORT_GET_TICK(  );
+    /* The event must be complete before the consumer can see it. */
+    MB_PORT_MEMORY_BARRIER(  );
+    pxQueue->ucHead = ( UCHAR )( ucHead + 1 );
     return TRUE;
 }
 
+static xMBEventQueue *
+prvpxMBPortEventQueue( xMBInstance * pxInst )
+{
+    /* Only the queue of the active transport is served. Events of the
+     * serial line stay queued while the instance handles a TCP request. */
+    return &pxInst->xEventQueues[( pxInst->eMBCurrentMode == MB_TCP ) ?
+                                 MB_EV_TRANSPORT_TCP : MB_EV_TRANSPORT_SERIAL];
+}
+
 BOOL
-xMBPortEventGet( eMBEventType * eEvent )
+xMBPortEventGet( xMBInstance * pxInst, xMBEvent * pxEvent )
+{
+    xMBEventQueue  *pxQueue = prvpxMBPortEventQueue( pxInst );
+    UCHAR           ucTail = pxQueue->ucTail;
+
+    if( ucTail == pxQueue->ucHead )
+    {
+        return FALSE;
+    }
+    MB_PORT_MEMORY_BARRIER(  );
+    *pxEvent = pxQueue->xEvents[ucTail & MB_EVENT_QUEUE_MASK];
+    /* The slot must be read before the producer may reuse it. */
+    MB_PORT_MEMORY_BARRIER(  );
+    pxQueue->ucTail = ( UCHAR )( ucTail + 1 );
+    return TRUE;
+}
+
+BOOL
+xMBPortEventWait( xMBInstance * pxInst, ULONG ulTimeoutMs )
+{
+    xMBEventQueue  *pxQueue = prvpxMBPortEventQueue( pxInst );
+    ULONG           ulStart = MB_PORT_GET_TICK(  );
+    BOOL            xWoken = FALSE;
+    BOOL            xPending;
+
+    for( ;; )
+    {
+        ENTER_CRITICAL_SECTION(  );
+        xPending = ( pxQueue->ucTail != pxQueue->ucHead );
+        if( xPending || xWoken || ( ( ulTimeoutMs != MB_POLL_WAIT_FOREVER ) &&
+                                    ( ( MB_PORT_GET_TICK(  ) - ulStart ) >= ulTimeoutMs ) ) )
+        {
+            EXIT_CRITICAL_SECTION(  );
+            return xPending;
+        }
+        /* Interrupts are masked, so an event posted after the check above
+         * leaves its interrupt pending and WFI returns at once. */
+        MB_PORT_WAIT_FOR_INTERRUPT(  );
+        EXIT_CRITICAL_SECTION(  );
+        /* The interrupt which woke the core may have work for the caller,
+         * e.g. the W5500 or another peripheral served from the super-loop.
+         * Only a wait without timeout sleeps again. */
+        xWoken = ( ulTimeoutMs != MB_POLL_WAIT_FOREVER );
+    }
+}
+
+ULONG
+ulMBPortEventOverflows( xMBInstance * pxInst )
 {
-    BOOL xEventHappened = FALSE;
+    ULONG           ulOverflows = 0;
+    int             i;
 
-    if( xEventInQueue )
+    for( i = 0; i < MB_EV_TRANSPORTS; i++ )
     {
-        *eEvent = eQueuedEvent;
-        xEventInQueue = FALSE;
-        xEventHappened = TRUE;
+        ulOverflows += pxInst->xEventQueues[i].ulOverflows;
     }
-    return xEventHappened;
+    return ulOverflows;
 }
@@ -21,57 +21,388 @@
 
 /* ----------------------- Modbus includes ----------------------------------*/
 #include "mbport.h"
+#include "mbconfig.h"
+#include "mbinstance.h"
+
+#if ( MB_RTU_DMA_RX_ENABLED > 0 ) && ( MB_ASCII_ENABLED > 0 )
+#error "MB_RTU_DMA_RX_ENABLED can not be used together with Modbus ASCII"
+#endif
  
 /* -----------------------    variables     ---------------------------------*/
 extern UART_HandleTypeDef PORT_MODBUS;
+#ifdef PORT_MODBUS2
+extern UART_HandleTypeDef PORT_MODBUS2;
+#endif
+
+/* RS-485 driver enable pins. A board with a transceiver defines
+ * PORT_MODBUS_DE_GPIO_Port and PORT_MODBUS_DE_Pin (and the same for
+ * PORT_MODBUS2). The pin is high while the port transmits.
+ */
+#ifdef PORT_MODBUS_DE_GPIO_Port
+#define MB_PORT_SERIAL_DE1    PORT_MODBUS_DE_GPIO_Port, PORT_MODBUS_DE_Pin
+#else
+#define MB_PORT_SERIAL_DE1    NULL, 0
+#endif
+#ifdef PORT_MODBUS2_DE_GPIO_Port
+#define MB_PORT_SERIAL_DE2    PORT_MODBUS2_DE_GPIO_Port, PORT_MODBUS2_DE_Pin
+#else
+#define MB_PORT_SERIAL_DE2    NULL, 0
+#endif
+
+typedef struct
+{
+  UART_HandleTypeDef *huart;
+  xMBInstance *pxInst;
+  GPIO_TypeDef *pxDEPort;
+  uint16_t usDEPin;
+  volatile BOOL xTxBusy;            /* Per-byte transmission in progress. */
+  volatile uint32_t ulRxCycles;     /* DWT cycle counter at the last received data. */
+  volatile uint32_t ulDECycles;     /* DWT cycle counter when DE was asserted. */
+  xMBPortTurnaround xTurnaround;
+#if MB_RTU_DMA_RX_ENABLED > 0
+  UCHAR *pucRxBuffer;
+  USHORT usRxBufferSize;
+#endif
+} xMBPortSerial;
+
+/* Port 1 is PORT_MODBUS, port 2 is PORT_MODBUS2 if the board defines it.
+ * Port 0 is accepted as an alias for port 1.
+ */
+static xMBPortSerial xMBPortSerials[] = {
+  { &PORT_MODBUS, NULL, MB_PORT_SERIAL_DE1 },
+#ifdef PORT_MODBUS2
+  { &PORT_MODBUS2, NULL, MB_PORT_SERIAL_DE2 },
+#endif
+};
+
+#define MB_PORT_SERIAL_COUNT  ( sizeof( xMBPortSerials ) / sizeof( xMBPortSerials[0] ) )
+
+/* ----------------------- Static functions ---------------------------------*/
+static xMBPortSerial *
+prvpxMBPortSerialGet( xMBInstance * pxInst )
+{
+  return &xMBPortSerials[pxInst->ucPort > 0 ? pxInst->ucPort - 1 : 0];
+}
+
+static xMBPortSerial *
+prvpxMBPortSerialFind( UART_HandleTypeDef *huart )
+{
+  USHORT i;
+
+  for (i = 0; i < MB_PORT_SERIAL_COUNT; i++) {
+    if ((xMBPortSerials[i].huart == huart) && (xMBPortSerials[i].pxInst != NULL)) {
+      return &xMBPortSerials[i];
+    }
+  }
+  return NULL;
+}
+
+static uint32_t
+prvulMBPortSerialElapsedUs( uint32_t ulStartCycles )
+{
+  return (DWT->CYCCNT - ulStartCycles) / (SystemCoreClock / 1000000U);
+}
+
+static void
+prvvMBPortSerialDriverEnable( xMBPortSerial *pxPort )
+{
+  /* Switch the transceiver to transmit and record how long the reply took
+  * since the last request byte.
+  */
+  xMBPortTurnaround *pxTurnaround = &pxPort->xTurnaround;
+  uint32_t ulUs;
+
+  if (pxPort->pxDEPort == NULL) {
+    return;
+  }
+  HAL_GPIO_WritePin(pxPort->pxDEPort, pxPort->usDEPin, GPIO_PIN_SET);
+  pxPort->ulDECycles = DWT->CYCCNT;
+
+  ulUs = prvulMBPortSerialElapsedUs(pxPort->ulRxCycles);
+  pxTurnaround->ulLastUs = ulUs;
+  if ((pxTurnaround->ulCount == 0) || (ulUs < pxTurnaround->ulMinUs)) {
+    pxTurnaround->ulMinUs = ulUs;
+  }
+  if (ulUs > pxTurnaround->ulMaxUs) {
+    pxTurnaround->ulMaxUs = ulUs;
+  }
+  pxTurnaround->ulCount++;
+}
+
+static void
+prvvMBPortSerialDriverDisable( xMBPortSerial *pxPort )
+{
+  /* Only called once the last stop bit has left the shift register. */
+  if (pxPort->pxDEPort == NULL) {
+    return;
+  }
+  HAL_GPIO_WritePin(pxPort->pxDEPort, pxPort->usDEPin, GPIO_PIN_RESET);
+  pxPort->xTurnaround.ulDriveUs = prvulMBPortSerialElapsedUs(pxPort->ulDECycles);
+}
+
+#if MB_RTU_DMA_RX_ENABLED > 0
+static BOOL
+prvxMBPortSerialArmReceive( xMBPortSerial *pxPort )
+{
+  if (pxPort->pucRxBuffer == NULL) {
+    return FALSE;
+  }
+  /* Already receiving into the buffer. */
+  if (pxPort->huart->RxState != HAL_UART_STATE_READY) {
+    return TRUE;
+  }
+  if (HAL_UARTEx_ReceiveToIdle_DMA(pxPort->huart, pxPort->pucRxBuffer, pxPort->usRxBufferSize) != HAL_OK) {
+    return FALSE;
+  }
+  /* Only the idle line and the buffer full event end a frame. */
+  __HAL_DMA_DISABLE_IT(pxPort->huart->hdmarx, DMA_IT_HT);
+  return TRUE;
+}
+#endif
  
 /* ----------------------- Start implementation -----------------------------*/
 void
-vMBPortSerialEnable( BOOL xRxEnable, BOOL xTxEnable )
+vMBPortSerialEnable( xMBInstance * pxInst, BOOL xRxEnable, BOOL xTxEnable )
 {
   /* If xRXEnable enable serial receive interrupts. If xTxENable enable
   * transmitter empty interrupts.
   */
+  xMBPortSerial *pxPort = prvpxMBPortSerialGet(pxInst);
   
+#if MB_RTU_DMA_RX_ENABLED > 0
+  /* Frames are received by DMA, the receiver is (re)armed instead of
+   * enabling the per-byte RXNE interrupt. */
+  if (xRxEnable) {
+    (void)prvxMBPortSerialArmReceive(pxPort);
+  } else {
+    (void)HAL_UART_AbortReceive(pxPort->huart);
+  }
+#else
   if (xRxEnable) {        
-    __HAL_UART_ENABLE_IT(&PORT_MODBUS, UART_IT_RXNE);
+    __HAL_UART_ENABLE_IT(pxPort->huart, UART_IT_RXNE);
   } else {    
-    __HAL_UART_DISABLE_IT(&PORT_MODBUS, UART_IT_RXNE);
+    __HAL_UART_DISABLE_IT(pxPort->huart, UART_IT_RXNE);
   }
+#endif
   
   if (xTxEnable) {    
-    __HAL_UART_ENABLE_IT(&PORT_MODBUS, UART_IT_TXE);
+    prvvMBPortSerialDriverEnable(pxPort);
+    pxPort->xTxBusy = TRUE;
+    __HAL_UART_ENABLE_IT(pxPort->huart, UART_IT_TXE);
   } else {
-    __HAL_UART_DISABLE_IT(&PORT_MODBUS, UART_IT_TXE);
+    __HAL_UART_DISABLE_IT(pxPort->huart, UART_IT_TXE);
+    if (pxPort->xTxBusy) {
+      /* The last byte is still being shifted out. The driver is released
+      * by the transmit complete interrupt. */
+      pxPort->xTxBusy = FALSE;
+      if (pxPort->pxDEPort != NULL) {
+        __HAL_UART_ENABLE_IT(pxPort->huart, UART_IT_TC);
+      }
+    }
   }  
 }
  
-BOOL  xMBPortSerialInit( UCHAR ucPort,
+BOOL  xMBPortSerialInit( xMBInstance * pxInst,
+                         UCHAR ucPort,
                          ULONG ulBaudRate,
                          UCHAR ucDataBits,
                          eMBParity eParity )
 {
   /* 
-  Do nothing, Initialization is handled by MX_USART1_UART_Init() 
-  Fixed port, baudrate, databit and parity  
+  Do nothing, Initialization is handled by MX_USARTx_UART_Init() 
+  Fixed baudrate, databit and parity  
   */
+  xMBPortSerial *pxPort;
+
+  if (ucPort > MB_PORT_SERIAL_COUNT) {
+    return FALSE;
+  }
+  pxPort = &xMBPortSerials[ucPort > 0 ? ucPort - 1 : 0];
+#if MB_RTU_DMA_RX_ENABLED > 0
+  /* DMA reception requires a receive stream linked to the UART. */
+  if (pxPort->huart->hdmarx == NULL) {
+    return FALSE;
+  }
+#endif
+#if MB_RTU_DMA_TX_ENABLED > 0
+  if (pxPort->huart->hdmatx == NULL) {
+    return FALSE;
+  }
+#endif
+  if (pxPort->pxDEPort != NULL) {
+    /* Receive mode until the first reply. The cycle counter times the
+    * bus turnaround. */
+    HAL_GPIO_WritePin(pxPort->pxDEPort, pxPort->usDEPin, GPIO_PIN_RESET);
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+  }
+  pxPort->pxInst = pxInst;
   return TRUE;
 }
- 
+
+BOOL
+xMBPortSerialGetTurnaround( UCHAR ucPort, xMBPortTurnaround *pxTurnaround )
+{
+  xMBPortSerial *pxPort;
+
+  if (ucPort > MB_PORT_SERIAL_COUNT) {
+    return FALSE;
+  }
+  pxPort = &xMBPortSerials[ucPort > 0 ? ucPort - 1 : 0];
+  if (pxPort->pxDEPort == NULL) {
+    return FALSE;
+  }
+  ENTER_CRITICAL_SECTION();
+  *pxTurnaround = pxPort->xTurnaround;
+  EXIT_CRITICAL_SECTION();
+  return TRUE;
+}
+
 BOOL
-xMBPortSerialPutByte( UCHAR ucByte )
+xMBPortSerialPutByte( xMBInstance * pxInst, UCHAR ucByte )
 {
   /* Put a byte in the UARTs transmit buffer. This function is called
   * by the protocol stack if pxMBFrameCBTransmitterEmpty( ) has been
-  * called. */
-  return (HAL_UART_Transmit(&PORT_MODBUS, (uint8_t*)&ucByte, 1, 1) == HAL_OK);
+  * called, so the data register is empty. The end of the frame is
+  * detected with the transmit complete flag, there is no need to wait
+  * for each byte. */
+  prvpxMBPortSerialGet(pxInst)->huart->Instance->DR = ucByte;
+  return TRUE;
 }
  
 BOOL
-xMBPortSerialGetByte( CHAR * pucByte )
+xMBPortSerialGetByte( xMBInstance * pxInst, CHAR * pucByte )
 {
   /* Return the byte in the UARTs receive buffer. This function is called
   * by the protocol stack after pxMBFrameCBByteReceived( ) has been called.
   */  
-  return (HAL_UART_Receive(&PORT_MODBUS, (uint8_t*)pucByte, 1, 1) == HAL_OK);
+  xMBPortSerial *pxPort = prvpxMBPortSerialGet(pxInst);
+
+  pxPort->ulRxCycles = DWT->CYCCNT;
+  return (HAL_UART_Receive(pxPort->huart, (uint8_t*)pucByte, 1, 1) == HAL_OK);
+}
+
+void
+vMBPortSerialIRQHandler( UART_HandleTypeDef *huart )
+{
+  /* Per-byte interrupts of a Modbus UART. Call it from USARTx_IRQHandler( )
+  * of every UART used by an instance in addition to HAL_UART_IRQHandler( ),
+  * which is still needed for the DMA transfers. The order of the two calls
+  * does not matter.
+  */
+  xMBPortSerial *pxPort = prvpxMBPortSerialFind(huart);
+
+  if (pxPort == NULL) {
+    return;
+  }
+  if (__HAL_UART_GET_FLAG(huart, UART_FLAG_RXNE) && __HAL_UART_GET_IT_SOURCE(huart, UART_IT_RXNE)) {
+    (void)xMBPortCBByteReceived(pxPort->pxInst);
+  }
+  if (__HAL_UART_GET_FLAG(huart, UART_FLAG_TXE) && __HAL_UART_GET_IT_SOURCE(huart, UART_IT_TXE)) {
+    (void)xMBPortCBTransmitterEmpty(pxPort->pxInst);
+  }
+#if MB_RTU_DMA_TX_ENABLED == 0
+  /* With DMA transmission the HAL owns the transmit complete interrupt.
+  * Otherwise whichever handler runs first takes it and disables it, see
+  * HAL_UART_TxCpltCallback( ) for the case that it is the HAL. */
+  if (__HAL_UART_GET_FLAG(huart, UART_FLAG_TC) && __HAL_UART_GET_IT_SOURCE(huart, UART_IT_TC)) {
+    __HAL_UART_DISABLE_IT(huart, UART_IT_TC);
+    prvvMBPortSerialDriverDisable(pxPort);
+  }
+#endif
+}
+
+#if MB_RTU_DMA_TX_ENABLED > 0
+BOOL
+xMBPortSerialPutBuffer( xMBInstance * pxInst, const UCHAR * pucBuffer, USHORT usLength )
+{
+  /* Send the whole frame with one DMA transfer. The HAL calls
+  * HAL_UART_TxCpltCallback( ) once the last byte has been shifted out.
+  */
+  xMBPortSerial *pxPort = prvpxMBPortSerialGet(pxInst);
+
+  prvvMBPortSerialDriverEnable(pxPort);
+  if (HAL_UART_Transmit_DMA(pxPort->huart, (uint8_t*)pucBuffer, usLength) != HAL_OK) {
+    prvvMBPortSerialDriverDisable(pxPort);
+    return FALSE;
+  }
+  return TRUE;
+}
+#endif
+
+void
+HAL_UART_TxCpltCallback( UART_HandleTypeDef *huart )
+{
+  xMBPortSerial *pxPort = prvpxMBPortSerialFind(huart);
+
+  if (pxPort == NULL) {
+    return;
+  }
+#if MB_RTU_DMA_TX_ENABLED > 0
+  /* The HAL reports the end of the DMA transfer on transmit complete,
+  * i.e. after the stop bit of the last byte. */
+  prvvMBPortSerialDriverDisable(pxPort);
+  (void)xMBPortCBTransmitComplete(pxPort->pxInst);
+#else
+  /* HAL_UART_IRQHandler( ) ran before vMBPortSerialIRQHandler( ) and took
+  * the transmit complete interrupt enabled at the end of a frame. */
+  if (!pxPort->xTxBusy) {
+    prvvMBPortSerialDriverDisable(pxPort);
+  }
+#endif
+}
+
+#if MB_RTU_DMA_RX_ENABLED > 0
+BOOL
+xMBPortSerialStartReceive( xMBInstance * pxInst, UCHAR * pucBuffer, USHORT usSize )
+{
+  /* Remember the frame buffer. It is rearmed by vMBPortSerialEnable( )
+  * whenever the receiver is enabled again.
+  */
+  xMBPortSerial *pxPort = prvpxMBPortSerialGet(pxInst);
+
+  (void)HAL_UART_AbortReceive(pxPort->huart);
+  pxPort->pucRxBuffer = pucBuffer;
+  pxPort->usRxBufferSize = usSize;
+  return prvxMBPortSerialArmReceive(pxPort);
+}
+
+USHORT
+usMBPortSerialRxCount( xMBInstance * pxInst )
+{
+  /* Number of bytes the DMA has stored since the receiver was armed. */
+  xMBPortSerial *pxPort = prvpxMBPortSerialGet(pxInst);
+
+  if (pxPort->huart->RxState == HAL_UART_STATE_READY) {
+    return 0;
+  }
+  return (USHORT)(pxPort->usRxBufferSize - __HAL_DMA_GET_COUNTER(pxPort->huart->hdmarx));
+}
+
+void
+HAL_UARTEx_RxEventCallback( UART_HandleTypeDef *huart, uint16_t Size )
+{
+  /* Called by the HAL on idle line or when the buffer is full. In both
+  * cases the reception has been stopped and the frame is complete.
+  */
+  xMBPortSerial *pxPort = prvpxMBPortSerialFind(huart);
+
+  if (pxPort != NULL) {
+    pxPort->ulRxCycles = DWT->CYCCNT;
+    (void)xMBPortCBFrameReceived(pxPort->pxInst, Size);
+  }
+}
+
+void
+HAL_UART_ErrorCallback( UART_HandleTypeDef *huart )
+{
+  /* A framing, noise or overrun error aborts the DMA transfer. Drop the
+  * damaged frame and wait for the next one.
+  */
+  xMBPortSerial *pxPort = prvpxMBPortSerialFind(huart);
+
+  if (pxPort != NULL) {
+    (void)prvxMBPortSerialArmReceive(pxPort);
+  }
 }
+#endif
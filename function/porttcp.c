@@ -2,7 +2,12 @@
 #include <stdio.h>
 #include <string.h>
 #include "mb.h"
+#include "mbconfig.h"
 #include "mbport.h"
+#include "mbtcp.h"
+#if MB_GATEWAY_ENABLED > 0
+#include "mbgateway.h"
+#endif
 #include "network.h"
 #include "debug.h"
 
@@ -11,11 +16,38 @@ W5500Debugger_TypeDef stModbusW5500Debugger;
 W5500TcpSocket_TypeDef hW5500MBTCP;
 
 /*FreeMODBUS transmit and receive*/
-#define MB_TCP_BUF_SIZE 256
-uint8_t au8TCPRequestFrame[MB_TCP_BUF_SIZE]; //receive buffer
-uint16_t u16TCPRequestLen;
-uint8_t au8TCPResponseFrame[MB_TCP_BUF_SIZE]; //transmit buffer
-uint16_t u16TCPResponseLen;
+#define MB_TCP_BUF_SIZE MB_TCP_ADU_SIZE_MAX //MBAP header and the largest PDU
+#define MB_TCP_LEN_MIN 2                     //unit identifier and function code
+#define MB_TCP_LEN_MAX (MB_TCP_ADU_SIZE_MAX - MB_TCP_UID)
+
+/*One client connection on a W5500 socket*/
+typedef struct
+{
+  uint8_t u8Socket;
+  bool bIsConnected;
+  uint32_t u32LastRequest;                   //tick of the last request, for the idle timeout
+  uint8_t au8RequestFrame[MB_TCP_BUF_SIZE];  //receive buffer, the response is built in place
+  uint16_t u16RequestLen;                    //bytes received of the current ADU
+  uint16_t u16RequestExpectedLen;            //length of the ADU, 0 until the MBAP header is complete
+  uint16_t u16ResponseLen;
+  bool bIsTxEnable;                          //response in au8RequestFrame waits for room in the socket buffer
+  bool bIsServicePending;                    //socket has to be read, set by its interrupt or unfinished work
+} MBTCPConnection_TypeDef;
+
+static MBTCPConnection_TypeDef astMBTCPConnections[MB_TCP_PORT_CONNECTIONS];
+static uint8_t u8MBTCPCurConnection;  //connection of the request in progress
+static uint8_t u8MBTCPNextConnection; //first connection serviced by the next poll
+
+#if MB_TCP_PORT_INT_ENABLED > 0
+/*Socket events signalled by the INTn pin of the W5500. SEND_OK is left to
+  send() of the ioLibrary: it only clears its busy flag of the socket when it
+  sees SEND_OK itself, so the flag must never be cleared here.*/
+#define MB_TCP_SOCKET_EVENTS (Sn_IR_CON | Sn_IR_DISCON | Sn_IR_RECV | Sn_IR_TIMEOUT)
+
+static volatile bool bMBTCPIntPending;
+static uint32_t u32MBTCPLastScan;      //tick of the last service of all sockets
+static uint32_t u32MBTCPLastLinkCheck; //tick of the last PHY link check
+#endif
 
 static const uint16_t u16MBTCPPortDefined = 502;
 static const wiz_NetInfo stMBDefaultNetInfo =
@@ -30,6 +62,7 @@ static const wiz_NetInfo stMBDefaultNetInfo =
 W5500TcpSocketErr_TypeDef eW5500SPIMBTCP_TCPSocket_Init(void)
 {
   W5500TcpSocketErr_TypeDef stError = NOERR;
+  uint8_t i;
 
   vSetCurSpiPort(W5500SPIMBTCP);
 
@@ -43,11 +76,22 @@ W5500TcpSocketErr_TypeDef eW5500SPIMBTCP_TCPSocket_Init(void)
   hW5500MBTCP.bIsSocketTxSent = false;
   hW5500MBTCP.bIsSocketRxEnable = false;
   hW5500MBTCP.bIsSocketRxReceived = false;
-  hW5500MBTCP.pu8TxData = au8TCPResponseFrame;
+  hW5500MBTCP.pu8TxData = astMBTCPConnections[0].au8RequestFrame;
   hW5500MBTCP.u16TxSize = MB_TCP_BUF_SIZE;
-  hW5500MBTCP.pu8RxData = au8TCPRequestFrame;
+  hW5500MBTCP.pu8RxData = astMBTCPConnections[0].au8RequestFrame;
   hW5500MBTCP.u16RxSize = MB_TCP_BUF_SIZE;
 
+  //connection n is served by socket n
+  for (i = 0; i < MB_TCP_PORT_CONNECTIONS; i++)
+  {
+    astMBTCPConnections[i].u8Socket = i;
+    astMBTCPConnections[i].bIsConnected = false;
+    astMBTCPConnections[i].bIsTxEnable = false;
+    astMBTCPConnections[i].u16RequestLen = 0;
+    astMBTCPConnections[i].u16RequestExpectedLen = 0;
+    astMBTCPConnections[i].bIsServicePending = true;
+  }
+
   wiz_NetTimeout timeout;
   //retry times
   timeout.retry_cnt = 5;
@@ -55,10 +99,14 @@ W5500TcpSocketErr_TypeDef eW5500SPIMBTCP_TCPSocket_Init(void)
   timeout.time_100us = 2000;
   wizchip_settimeout(&timeout);
 
-  // WIZCHIP SOCKET Buffer initialize
-  uint8_t u8SocketBufSize[2][8] = {{16, 0, 0, 0, 0, 0, 0, 0},
-                                   {16, 0, 0, 0, 0, 0, 0, 0}};
-  int8_t tmp = ctlwizchip(CW_INIT_WIZCHIP, (void *)u8SocketBufSize);
+  // WIZCHIP SOCKET Buffer initialize, in KB per socket
+  uint8_t u8SocketBufSize[2][8] = {MB_TCP_PORT_TX_BUF_KB,
+                                   MB_TCP_PORT_RX_BUF_KB};
+  if (ctlwizchip(CW_INIT_WIZCHIP, (void *)u8SocketBufSize) == -1)
+  {
+    //more than 16KB in total or an invalid size
+    stError = INITIAL_ERR;
+  }
 
   ctlnetwork(CN_SET_NETINFO, (void *)&hW5500MBTCP.stWizNetinfo);
   wiz_NetInfo ref;
@@ -73,14 +121,33 @@ W5500TcpSocketErr_TypeDef eW5500SPIMBTCP_TCPSocket_Init(void)
   //TODO: test, sendto DISCARD_PORT 9, for arp table
   uint8_t broadcastIp[] = {255, 255, 255, 255};
   uint8_t discardport = 9;
-  sendto(SOCKN, (uint8_t *)"0", sizeof("0"), broadcastIp, discardport);
-  close(SOCKN);
+  sendto(astMBTCPConnections[0].u8Socket, (uint8_t *)"0", sizeof("0"), broadcastIp, discardport);
+  close(astMBTCPConnections[0].u8Socket);
+
+#if MB_TCP_PORT_INT_ENABLED > 0
+  //only the sockets of the connections raise INTn
+  uint8_t u8SocketMask = 0;
+  for (i = 0; i < MB_TCP_PORT_CONNECTIONS; i++)
+  {
+    setSn_IMR(astMBTCPConnections[i].u8Socket, MB_TCP_SOCKET_EVENTS);
+    setSn_IR(astMBTCPConnections[i].u8Socket, 0xFF);
+    u8SocketMask |= (uint8_t)(1 << astMBTCPConnections[i].u8Socket);
+  }
+  setSIMR(u8SocketMask);
+  bMBTCPIntPending = true;
+  u32MBTCPLastScan = HAL_GetTick();
+  u32MBTCPLastLinkCheck = u32MBTCPLastScan - MB_TCP_PORT_LINK_CHECK_MS;
+#endif
 
   return stError;
 }
 
-BOOL xMBTCPPortInit(USHORT usTCPPort)
+/*Protocol stack instance serving Modbus TCP*/
+static xMBInstance *pxMBTCPInstance;
+
+BOOL xMBTCPPortInit(xMBInstance *pxInst, USHORT usTCPPort)
 {
+  pxMBTCPInstance = pxInst;
   return true;
 }
 
@@ -96,85 +163,341 @@ void vMBTCPPortDisable(void)
 
 BOOL xMBTCPPortGetRequest(UCHAR **ppucMBTCPFrame, USHORT *usTCPLength)
 {
-  *ppucMBTCPFrame = hW5500MBTCP.pu8RxData;
-  *usTCPLength = hW5500MBTCP.u16RxSize;
-  /* Reset the buffer. */
-  //hW5500MBTCP.u16RxSize = 0;
+  *ppucMBTCPFrame = astMBTCPConnections[u8MBTCPCurConnection].au8RequestFrame;
+  *usTCPLength = astMBTCPConnections[u8MBTCPCurConnection].u16RequestLen;
   return TRUE;
 }
 
+UCHAR ucMBTCPPortGetConnection(void)
+{
+  return u8MBTCPCurConnection;
+}
+
 BOOL xMBTCPPortSendResponse(const UCHAR *pucMBTCPFrame, USHORT usTCPLength)
 {
-  hW5500MBTCP.u16TxSize = usTCPLength;
-  memcpy(hW5500MBTCP.pu8TxData, pucMBTCPFrame, hW5500MBTCP.u16TxSize);
-  //tx control flag
-  hW5500MBTCP.bIsSocketTxEnable = true;
+  return xMBTCPPortSendResponseTo(u8MBTCPCurConnection, pucMBTCPFrame, usTCPLength);
+}
+
+BOOL xMBTCPPortSendResponseTo(UCHAR ucConnection, const UCHAR *pucMBTCPFrame, USHORT usTCPLength)
+{
+  MBTCPConnection_TypeDef *pstConn;
+
+  if ((ucConnection >= MB_TCP_PORT_CONNECTIONS) || (usTCPLength > MB_TCP_BUF_SIZE))
+  {
+    return FALSE;
+  }
+  pstConn = &astMBTCPConnections[ucConnection];
+  //previous response not sent yet, the gateway offers its response again
+  if (!pstConn->bIsConnected || pstConn->bIsTxEnable)
+  {
+    return FALSE;
+  }
+  //written from the caller's buffer straight into the socket buffer of the W5500
+  if (send(pstConn->u8Socket, (uint8_t *)pucMBTCPFrame, usTCPLength) != SOCK_BUSY)
+  {
+    return TRUE;
+  }
+  //socket buffer full: a response built in the request frame stays there
+  //until it is sent, no further request is received meanwhile. Other
+  //buffers are not kept, the gateway offers its response again.
+  if (pucMBTCPFrame != pstConn->au8RequestFrame)
+  {
+    return FALSE;
+  }
+  pstConn->u16ResponseLen = usTCPLength;
+  pstConn->bIsTxEnable = true;
   return TRUE;
 }
 
-void vModbusTCPServerPoll(W5500TcpSocket_TypeDef *stMBW5500TcpSocket)
+static void vModbusTCPServerSend(MBTCPConnection_TypeDef *pstConn)
 {
-  if (stMBW5500TcpSocket->eSpiPort == W5500SPI_NONE)
+  if (pstConn->bIsTxEnable)
   {
-    eW5500SPIMBTCP_TCPSocket_Init();
+    //socket buffer full, keep the response for the next poll
+    if (send(pstConn->u8Socket, pstConn->au8RequestFrame, pstConn->u16ResponseLen) != SOCK_BUSY)
+    {
+      pstConn->bIsTxEnable = false;
+    }
   }
+}
 
-  vSetCurSpiPort(stMBW5500TcpSocket->eSpiPort);
+static void vModbusTCPServerDrop(MBTCPConnection_TypeDef *pstConn)
+{
+  //responses for a closed connection are not sent
+  pstConn->bIsConnected = false;
+  pstConn->bIsTxEnable = false;
+  pstConn->u16RequestLen = 0;
+  pstConn->u16RequestExpectedLen = 0;
+#if MB_GATEWAY_ENABLED > 0
+  vMBGatewayReset((UCHAR)(pstConn - astMBTCPConnections));
+#endif
+}
 
-  //vW5500Debugger(&stModbusW5500Debugger, eGetCurSpiPort());
+static bool bModbusTCPServerAccept(MBTCPConnection_TypeDef *pstConn)
+{
+  uint8_t au8ClientIp[4];
+  uint8_t au8OtherIp[4];
+  uint8_t u8Count = 0;
+  uint8_t i;
+
+  //limit the connections of one client so that others still get a socket
+  getSn_DIPR(pstConn->u8Socket, au8ClientIp);
+  for (i = 0; i < MB_TCP_PORT_CONNECTIONS; i++)
+  {
+    if (astMBTCPConnections[i].bIsConnected && (&astMBTCPConnections[i] != pstConn))
+    {
+      getSn_DIPR(astMBTCPConnections[i].u8Socket, au8OtherIp);
+      if (memcmp(au8ClientIp, au8OtherIp, sizeof(au8ClientIp)) == 0)
+      {
+        u8Count++;
+      }
+    }
+  }
+  return u8Count < MB_TCP_PORT_CONNECTIONS_PER_CLIENT;
+}
+
+static bool bModbusTCPServerIsIdle(MBTCPConnection_TypeDef *pstConn)
+{
+  return pstConn->bIsConnected && (MB_TCP_PORT_IDLE_TIMEOUT_MS > 0) &&
+         ((HAL_GetTick() - pstConn->u32LastRequest) >= MB_TCP_PORT_IDLE_TIMEOUT_MS);
+}
 
-  stMBW5500TcpSocket->bIsPhyConnected = (bool)(getPHYCFGR() & PHYCFGR_LNK_ON);
-  if (!(stMBW5500TcpSocket->bIsPhyConnected))
+static bool bModbusTCPServerReceive(MBTCPConnection_TypeDef *pstConn)
+{
+  uint16_t u16Avail = getSn_RX_RSR(pstConn->u8Socket);
+  uint16_t u16Need;
+  uint16_t u16Len;
+  int32_t i32Read;
+
+  //TCP is a stream: requests may arrive split into several segments or
+  //several in one segment. Read the MBAP header first and then exactly the
+  //rest of the ADU given by its length field, so the next request stays in
+  //the socket buffer.
+  while (u16Avail > 0)
   {
-    if (stMBW5500TcpSocket->bIsSocketConnected)
+    if (pstConn->u16RequestExpectedLen == 0)
+    {
+      u16Need = MB_TCP_FUNC - pstConn->u16RequestLen;
+    }
+    else
+    {
+      u16Need = pstConn->u16RequestExpectedLen - pstConn->u16RequestLen;
+    }
+    i32Read = recv(pstConn->u8Socket, &pstConn->au8RequestFrame[pstConn->u16RequestLen], (u16Avail < u16Need) ? u16Avail : u16Need);
+    if (i32Read <= 0)
+    {
+      return false;
+    }
+    pstConn->u16RequestLen += (uint16_t)i32Read;
+    pstConn->u32LastRequest = HAL_GetTick();
+    u16Avail -= (uint16_t)i32Read;
+
+    if ((pstConn->u16RequestExpectedLen == 0) && (pstConn->u16RequestLen == MB_TCP_FUNC))
+    {
+      u16Len = (uint16_t)((pstConn->au8RequestFrame[MB_TCP_LEN] << 8) | pstConn->au8RequestFrame[MB_TCP_LEN + 1]);
+      if ((pstConn->au8RequestFrame[MB_TCP_PID] != 0) || (pstConn->au8RequestFrame[MB_TCP_PID + 1] != MB_TCP_PROTOCOL_ID) ||
+          (u16Len < MB_TCP_LEN_MIN) || (u16Len > MB_TCP_LEN_MAX))
+      {
+        //not Modbus or out of step, the stream can not be resynchronized
+        vModbusTCPServerDrop(pstConn);
+        disconnect(pstConn->u8Socket);
+        return false;
+      }
+      pstConn->u16RequestExpectedLen = MB_TCP_UID + u16Len;
+    }
+    if (pstConn->u16RequestLen == pstConn->u16RequestExpectedLen)
     {
-      vReleaseSocket();
-      stMBW5500TcpSocket->bIsSocketConnected = false;
+      return true;
     }
   }
-  stMBW5500TcpSocket->eSockState = (SocketState_TypeDef)getSn_SR(SOCKN);
-  //get status of socket N
-  switch (stMBW5500TcpSocket->eSockState)
+  return false;
+}
+
+//returns true if the socket has to be serviced again without an interrupt
+static bool bModbusTCPServerPollConnection(W5500TcpSocket_TypeDef *stMBW5500TcpSocket, MBTCPConnection_TypeDef *pstConn)
+{
+  uint8_t u8Socket = pstConn->u8Socket;
+  uint8_t u8Requests;
+  bool bPending = true;
+
+  //get status of the socket
+  switch ((SocketState_TypeDef)getSn_SR(u8Socket))
   {
   case SOCK_CLOSED:
-    stMBW5500TcpSocket->bIsSocketConnected = false;
-    socket(SOCKN, Sn_MR_TCP, stMBW5500TcpSocket->u16Port, SF_TCP_NODELAY | SF_IO_NONBLOCK);
+    if (pstConn->bIsConnected)
+    {
+      vModbusTCPServerDrop(pstConn);
+    }
+    socket(u8Socket, Sn_MR_TCP, stMBW5500TcpSocket->u16Port, SF_TCP_NODELAY | SF_IO_NONBLOCK);
     break;
   case SOCK_INIT:
-    listen(SOCKN);
+    listen(u8Socket);
     break;
   case SOCK_LISTEN:
+    bPending = false;
     break;
   case SOCK_ESTABLISHED:
-    stMBW5500TcpSocket->bIsSocketConnected = true;
-
-    stMBW5500TcpSocket->u16RxSize = getSn_RX_RSR(SOCKN);
-    if (stMBW5500TcpSocket->u16RxSize > 0)
+    if (!pstConn->bIsConnected)
     {
-      //Modbus TCP request received
-      eMBEventType eQueuedEventToStore;
-      xMBPortEventGet(&eQueuedEventToStore);
-      recv(SOCKN, stMBW5500TcpSocket->pu8RxData, stMBW5500TcpSocket->u16RxSize);
-      eMBSwitchMode(MB_TCP);
-      xMBPortEventPost(EV_FRAME_RECEIVED);
-      eMBPoll();
-      //Modbus TCP response send
-      if (stMBW5500TcpSocket->bIsSocketTxEnable)
+      //new client
+      if (!bModbusTCPServerAccept(pstConn))
       {
-        send(SOCKN, stMBW5500TcpSocket->pu8TxData, stMBW5500TcpSocket->u16TxSize);
-        stMBW5500TcpSocket->bIsSocketTxSent = true;
-        stMBW5500TcpSocket->bIsSocketTxEnable = false;
+        disconnect(u8Socket);
+        break;
       }
-      eMBSwitchMode(MB_RTU);
-      xMBPortEventPost(eQueuedEventToStore);
+      pstConn->bIsConnected = true;
+      pstConn->u32LastRequest = HAL_GetTick();
+      // set auto keepalive 5sec(1*5)
+      setSn_KPALVTR(u8Socket, 1);
+    }
+
+    //response which did not fit into the socket buffer
+    vModbusTCPServerSend(pstConn);
+
+    //all complete requests of a client which pipelines its requests, as
+    //long as the responses can be sent
+    for (u8Requests = 0; (u8Requests < MB_TCP_PORT_REQUESTS_PER_POLL) && (pxMBTCPInstance != NULL) &&
+                         pstConn->bIsConnected && !pstConn->bIsTxEnable && bModbusTCPServerReceive(pstConn);
+         u8Requests++)
+    {
+      //Modbus TCP request received
+      //The TCP instance has its own frame buffer, the serial line keeps running
+      u8MBTCPCurConnection = (uint8_t)(pstConn - astMBTCPConnections);
+      xMBPortEventPostTransport(pxMBTCPInstance, MB_EV_TRANSPORT_TCP, EV_FRAME_RECEIVED);
+      eMBInstPoll(pxMBTCPInstance);
+      //Modbus TCP response sent by xMBTCPPortSendResponse(), forwarded
+      //requests are answered later
+      pstConn->u16RequestLen = 0;
+      pstConn->u16RequestExpectedLen = 0;
+    }
+    //requests left in the socket buffer or a response waiting for room
+    bPending = !pstConn->bIsConnected || pstConn->bIsTxEnable || (u8Requests == MB_TCP_PORT_REQUESTS_PER_POLL);
+    if (bModbusTCPServerIsIdle(pstConn))
+    {
+      //make room for other clients
+      vModbusTCPServerDrop(pstConn);
+      disconnect(u8Socket);
+      bPending = true;
     }
-    // set auto keepalive 5sec(1*5)
-    setSn_KPALVTR(SOCKN, 1);
     break;
   case SOCK_CLOSE_WAIT:
-    disconnect(SOCKN);
+    vModbusTCPServerDrop(pstConn);
+    disconnect(u8Socket);
     break;
   default:
     break;
   } //switch end
+  return bPending;
+}
+
+#if MB_TCP_PORT_INT_ENABLED > 0
+void vMBTCPPortIRQHandler(uint16_t u16GpioPin)
+{
+  //the registers are read by vModbusTCPServerPoll(), not in the interrupt
+  if (u16GpioPin == MB_TCP_PORT_INT_GPIO_PIN)
+  {
+    bMBTCPIntPending = true;
+  }
+}
+
+static void vModbusTCPServerReadInterrupts(void)
+{
+  uint8_t u8Sir;
+  uint8_t u8Ir;
+  uint8_t i;
+
+  //INTn stays low while a flag is set, so a flag raised while the others
+  //are cleared gives no new edge, but the pin is still low
+  if (!bMBTCPIntPending &&
+      (HAL_GPIO_ReadPin(MB_TCP_PORT_INT_GPIO_PORT, MB_TCP_PORT_INT_GPIO_PIN) != GPIO_PIN_RESET))
+  {
+    return;
+  }
+  bMBTCPIntPending = false;
+
+  u8Sir = getSIR();
+  for (i = 0; i < MB_TCP_PORT_CONNECTIONS; i++)
+  {
+    if (u8Sir & (1 << astMBTCPConnections[i].u8Socket))
+    {
+      u8Ir = getSn_IR(astMBTCPConnections[i].u8Socket);
+      setSn_IR(astMBTCPConnections[i].u8Socket, u8Ir & (uint8_t)~Sn_IR_SEND_OK);
+      astMBTCPConnections[i].bIsServicePending = true;
+    }
+  }
+}
+#endif
+
+void vModbusTCPServerPoll(W5500TcpSocket_TypeDef *stMBW5500TcpSocket)
+{
+  MBTCPConnection_TypeDef *pstConn;
+  uint8_t i;
+
+  if (stMBW5500TcpSocket->eSpiPort == W5500SPI_NONE)
+  {
+    eW5500SPIMBTCP_TCPSocket_Init();
+  }
+
+  vSetCurSpiPort(stMBW5500TcpSocket->eSpiPort);
+
+  //vW5500Debugger(&stModbusW5500Debugger, eGetCurSpiPort());
+
+#if MB_TCP_PORT_INT_ENABLED > 0
+  //without an event only the link is checked now and then, and all sockets
+  //are serviced once in a while in case an edge of INTn was missed
+  vModbusTCPServerReadInterrupts();
+  if ((HAL_GetTick() - u32MBTCPLastScan) >= MB_TCP_PORT_INT_SCAN_MS)
+  {
+    u32MBTCPLastScan = HAL_GetTick();
+    for (i = 0; i < MB_TCP_PORT_CONNECTIONS; i++)
+    {
+      astMBTCPConnections[i].bIsServicePending = true;
+    }
+  }
+  if ((HAL_GetTick() - u32MBTCPLastLinkCheck) >= MB_TCP_PORT_LINK_CHECK_MS)
+#endif
+  {
+#if MB_TCP_PORT_INT_ENABLED > 0
+    u32MBTCPLastLinkCheck = HAL_GetTick();
+#endif
+    stMBW5500TcpSocket->bIsPhyConnected = (bool)(getPHYCFGR() & PHYCFGR_LNK_ON);
+    if (!(stMBW5500TcpSocket->bIsPhyConnected))
+    {
+      for (i = 0; i < MB_TCP_PORT_CONNECTIONS; i++)
+      {
+        if (astMBTCPConnections[i].bIsConnected)
+        {
+          vModbusTCPServerDrop(&astMBTCPConnections[i]);
+          close(astMBTCPConnections[i].u8Socket);
+          astMBTCPConnections[i].bIsServicePending = true;
+        }
+      }
+    }
+  }
+
+#if MB_GATEWAY_ENABLED > 0
+  vMBGatewayPoll();
+#endif
+
+  //requests of every connection, starting with the next connection
+  //each time so that no client is preferred
+  stMBW5500TcpSocket->bIsSocketConnected = false;
+  for (i = 0; i < MB_TCP_PORT_CONNECTIONS; i++)
+  {
+    pstConn = &astMBTCPConnections[(u8MBTCPNextConnection + i) % MB_TCP_PORT_CONNECTIONS];
+#if MB_TCP_PORT_INT_ENABLED > 0
+    //sockets without an event are left alone
+    if (pstConn->bIsServicePending || bModbusTCPServerIsIdle(pstConn))
+    {
+      pstConn->bIsServicePending = bModbusTCPServerPollConnection(stMBW5500TcpSocket, pstConn);
+    }
+#else
+    (void)bModbusTCPServerPollConnection(stMBW5500TcpSocket, pstConn);
+#endif
+    if (pstConn->bIsConnected)
+    {
+      stMBW5500TcpSocket->bIsSocketConnected = true;
+    }
+  }
+  u8MBTCPNextConnection = (u8MBTCPNextConnection + 1) % MB_TCP_PORT_CONNECTIONS;
 }
@@ -21,50 +21,148 @@
 
 /* ----------------------- Modbus includes ----------------------------------*/
 #include "mbport.h"
+#include "mbinstance.h"
   
 /* -----------------------    variables     ---------------------------------*/
 extern TIM_HandleTypeDef TIMER_MODBUS;
-uint16_t timeout = 0;
+#ifdef TIMER_MODBUS2
+extern TIM_HandleTypeDef TIMER_MODBUS2;
+#endif
+/* The timer fires once per timeout, so the update interrupt handler only
+ * has to count down a single tick before calling pxMBPortCBTimerExpired( ).
+ * Only used for TIMER_MODBUS, see vMBPortTimersIRQHandler( ) for the others.
+ */
 uint16_t downcounter = 0;
+
+/* Timers of the serial ports in the same order as in portserial.c. */
+static TIM_HandleTypeDef *const pxMBPortTimers[] = {
+  &TIMER_MODBUS,
+#ifdef TIMER_MODBUS2
+  &TIMER_MODBUS2,
+#endif
+};
+
+static xMBInstance *pxMBPortTimerInst[sizeof(pxMBPortTimers) / sizeof(pxMBPortTimers[0])];
+
+#define MB_PORT_TIMER_COUNT   ( sizeof( pxMBPortTimers ) / sizeof( pxMBPortTimers[0] ) )
+#define MB_PORT_TIMER_INDEX( pxInst ) ( ( ULONG )( ( pxInst )->ucPort > 0 ? ( pxInst )->ucPort - 1 : 0 ) )
+
+/* ----------------------- Static functions ---------------------------------*/
+static uint32_t
+prvulMBPortTimerClock( TIM_HandleTypeDef *htim )
+{
+  /* TIM1 and TIM9 to TIM11 are clocked from APB2, the others from APB1.
+  * The timers run at twice the bus clock if the bus is divided.
+  */
+  uint32_t ulPCLK;
+
+  if ((htim->Instance == TIM1) || (htim->Instance == TIM9) ||
+      (htim->Instance == TIM10) || (htim->Instance == TIM11)) {
+    ulPCLK = HAL_RCC_GetPCLK2Freq();
+  } else {
+    ulPCLK = HAL_RCC_GetPCLK1Freq();
+  }
+  return (HAL_RCC_GetHCLKFreq() == ulPCLK) ? ulPCLK : 2 * ulPCLK;
+}
+
+static uint32_t
+prvulMBPortTimerMaxPeriod( TIM_HandleTypeDef *htim )
+{
+  /* TIM2 and TIM5 have 32-bit counters, the others 16-bit ones. */
+  if ((htim->Instance == TIM2) || (htim->Instance == TIM5)) {
+    return 0xFFFFFFFFU;
+  }
+  return 0xFFFFU;
+}
  
 /* ----------------------- Start implementation -----------------------------*/
 BOOL
-xMBPortTimersInit( USHORT usTim1Timerout50us )
+xMBPortTimersInit( xMBInstance * pxInst, USHORT usTim1Timerout50us )
 {
   TIM_MasterConfigTypeDef sMasterConfig = {0};
+  TIM_HandleTypeDef *htim;
+  uint32_t ulTimeoutUs = (uint32_t)usTim1Timerout50us * 50;
+  uint32_t ulTickUs = 1;
+
+  if (MB_PORT_TIMER_INDEX(pxInst) >= MB_PORT_TIMER_COUNT)
+  {
+    return FALSE;
+  }
+  htim = pxMBPortTimers[MB_PORT_TIMER_INDEX(pxInst)];
+  pxMBPortTimerInst[MB_PORT_TIMER_INDEX(pxInst)] = pxInst;
 
-  TIMER_MODBUS.Init.Prescaler = (HAL_RCC_GetPCLK1Freq() / 1000000) - 1;
-  TIMER_MODBUS.Init.CounterMode = TIM_COUNTERMODE_UP;
-  TIMER_MODBUS.Init.Period = 50 - 1;
+  /* One tick per microsecond and a single period of the full timeout in
+  * one-pulse mode. No interrupts occur while the timer is counting. Long
+  * timeouts at low baudrates, e.g. 128 ms at 300 baud, do not fit into a
+  * 16-bit counter with 1 us ticks, so the tick is doubled until they do.
+  * The period is rounded up, the timeout is never shorter than t3.5.
+  */
+  while (((ulTimeoutUs + ulTickUs - 1) / ulTickUs) > prvulMBPortTimerMaxPeriod(htim)) {
+    ulTickUs *= 2;
+  }
+  htim->Init.Prescaler = (prvulMBPortTimerClock(htim) / 1000000) * ulTickUs - 1;
+  htim->Init.CounterMode = TIM_COUNTERMODE_UP;
+  htim->Init.Period = (ulTimeoutUs + ulTickUs - 1) / ulTickUs - 1;
 
-  timeout = usTim1Timerout50us;
-  
-  if (HAL_TIM_Base_Init(&TIMER_MODBUS) != HAL_OK)
+  if (HAL_TIM_OnePulse_Init(htim, TIM_OPMODE_SINGLE) != HAL_OK)
   {
     return FALSE;
   }
 
   sMasterConfig.MasterOutputTrigger = TIM_TRGO_UPDATE;
   sMasterConfig.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
-  if (HAL_TIMEx_MasterConfigSynchronization(&TIMER_MODBUS, &sMasterConfig) != HAL_OK)
+  if (HAL_TIMEx_MasterConfigSynchronization(htim, &sMasterConfig) != HAL_OK)
   {
     return FALSE;
   }
 
+  /* The update event generated by the init must not count as timeout. */
+  __HAL_TIM_CLEAR_FLAG(htim, TIM_FLAG_UPDATE);
+  __HAL_TIM_ENABLE_IT(htim, TIM_IT_UPDATE);
+
   return TRUE;
 }
 
 void
-vMBPortTimersEnable(  )
+vMBPortTimersEnable( xMBInstance * pxInst )
 {
-  /* Enable the timer with the timeout passed to xMBPortTimersInit( ) */
-  downcounter = timeout;
-  HAL_TIM_Base_Start_IT(&TIMER_MODBUS);
+  /* Enable the timer with the timeout passed to xMBPortTimersInit( ).
+  * Retriggering only resets the counter, there is no HAL call per byte.
+  */
+  TIM_HandleTypeDef *htim = pxMBPortTimers[MB_PORT_TIMER_INDEX(pxInst)];
+
+  if (htim == &TIMER_MODBUS) {
+    downcounter = 1;
+  }
+  __HAL_TIM_SET_COUNTER(htim, 0);
+  __HAL_TIM_ENABLE(htim);
 }
  
 void
-vMBPortTimersDisable(  )
+vMBPortTimersDisable( xMBInstance * pxInst )
 {
   /* Disable any pending timers. */
-  HAL_TIM_Base_Stop_IT(&TIMER_MODBUS);
+  TIM_HandleTypeDef *htim = pxMBPortTimers[MB_PORT_TIMER_INDEX(pxInst)];
+
+  __HAL_TIM_DISABLE(htim);
+  __HAL_TIM_CLEAR_FLAG(htim, TIM_FLAG_UPDATE);
+}
+
+void
+vMBPortTimersIRQHandler( TIM_HandleTypeDef *htim )
+{
+  /* Update interrupt of a Modbus timer. Call it from TIMx_IRQHandler( ) of
+  * every timer used by an instance other than the default one.
+  */
+  USHORT i;
+
+  if (!__HAL_TIM_GET_FLAG(htim, TIM_FLAG_UPDATE) || !__HAL_TIM_GET_IT_SOURCE(htim, TIM_IT_UPDATE)) {
+    return;
+  }
+  __HAL_TIM_CLEAR_IT(htim, TIM_IT_UPDATE);
+  for (i = 0; i < MB_PORT_TIMER_COUNT; i++) {
+    if ((pxMBPortTimers[i] == htim) && (pxMBPortTimerInst[i] != NULL)) {
+      (void)xMBPortCBTimerExpired(pxMBPortTimerInst[i]);
+    }
+  }
 }
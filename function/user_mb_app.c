@@ -11,7 +11,11 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "mb.h"
+#include "mbconfig.h"
 #include "mbutils.h"
+#if (MB_GATEWAY_ENABLED > 0) && (MB_GATEWAY_CACHE_ENABLED > 0)
+#include "mbgateway.h"
+#endif
 #include "user_mb_app.h"
 
 /* Private typedef -----------------------------------------------------------*/
@@ -181,6 +185,30 @@ eMBErrorCode eMBRegInputCB(UCHAR* pucRegBuffer, USHORT usAddress, USHORT usNRegs
       usNRegs--;
     }
   }
+#if (MB_GATEWAY_ENABLED > 0) && (MB_GATEWAY_CACHE_ENABLED > 0)
+  else if ((usAddress >= GATEWAY_STATS_REG_START) && (usAddress + usNRegs <= GATEWAY_STATS_REG_START + GATEWAY_STATS_REG_QTY))
+  {
+    //gateway cache counters, 32 bit each, high word first
+    xMBGatewayCacheStats stStats;
+    ULONG aulCounters[GATEWAY_STATS_REG_QTY / 2];
+    USHORT usValue;
+
+    vMBGatewayCacheGetStats(&stStats);
+    aulCounters[0] = stStats.ulHits;
+    aulCounters[1] = stStats.ulMisses;
+    aulCounters[2] = stStats.ulRefreshes;
+    aulCounters[3] = stStats.ulInvalidations;
+    iRegIndex = usAddress - GATEWAY_STATS_REG_START;
+    while (usNRegs > 0)
+    {
+      usValue = (iRegIndex % 2) ? (USHORT)(aulCounters[iRegIndex / 2] & 0xFFFF) : (USHORT)(aulCounters[iRegIndex / 2] >> 16);
+      *pucRegBuffer++ = (UCHAR)(usValue >> 8);
+      *pucRegBuffer++ = (UCHAR)(usValue & 0xFF);
+      iRegIndex++;
+      usNRegs--;
+    }
+  }
+#endif
   else
   {
     eStatus = MB_ENOREG;
@@ -254,7 +282,6 @@ bool bModbus_Init(uint8_t ucSlaveAddr, uint32_t ulBaudrate, ModbusUartParity_Typ
   eCurMBParity = eParityMode;
 
   eMBDisable();
-  //do eMBTCPInit before eMBInit
   eMBTCPInit(hW5500MBTCP.u16Port);
   eMBInit(MB_RTU, ucCurSlaveAddress, RTU_UART_PORT, ulCurBaudrate, (eMBParity)eCurMBParity);
 
@@ -63,6 +63,21 @@ PR_BEGIN_EXTERN_C
  *     ...
  * }
  * \endcode
+ *
+ * Several buses can be served at the same time with one instance per bus.
+ * The functions without an instance argument operate on the default
+ * instance, the ones with the prefix eMBInst on any instance.
+ *
+ * \code
+ * xMBInstance *pxBus2 = NULL;
+ * eMBInstInit( &pxBus2, MB_RTU, 0x0B, 2, 115200, MB_PAR_NONE );
+ * eMBInstEnable( pxBus2 );
+ * for( ;; )
+ * {
+ *     eMBPoll(  );
+ *     eMBInstPoll( pxBus2 );
+ * }
+ * \endcode
  */
 
 /* ----------------------- Defines ------------------------------------------*/
@@ -72,6 +87,11 @@ PR_BEGIN_EXTERN_C
  */
 #define MB_TCP_PORT_USE_DEFAULT 0   
 
+/*! \ingroup modbus
+ * \brief Timeout for eMBPollWait( ) to wait until an event arrives.
+ */
+#define MB_POLL_WAIT_FOREVER    ( 0xFFFFFFFFUL )
+
 /* ----------------------- Type definitions ---------------------------------*/
 
 /*! \ingroup modbus
@@ -121,6 +141,25 @@ typedef enum
 } eMBErrorCode;
 
 
+/*! \ingroup modbus
+ * \brief Register callbacks of a virtual slave.
+ *
+ * The members have the same semantics as eMBRegInputCB( ), eMBRegHoldingCB( ),
+ * eMBRegCoilsCB( ) and eMBRegDiscreteCB( ). A member set to \c NULL means
+ * that the slave has no registers of this type.
+ */
+typedef struct
+{
+    eMBErrorCode( *peMBRegInputCB ) ( UCHAR * pucRegBuffer, USHORT usAddress,
+                                      USHORT usNRegs );
+    eMBErrorCode( *peMBRegHoldingCB ) ( UCHAR * pucRegBuffer, USHORT usAddress,
+                                        USHORT usNRegs, eMBRegisterMode eMode );
+    eMBErrorCode( *peMBRegCoilsCB ) ( UCHAR * pucRegBuffer, USHORT usAddress,
+                                      USHORT usNCoils, eMBRegisterMode eMode );
+    eMBErrorCode( *peMBRegDiscreteCB ) ( UCHAR * pucRegBuffer, USHORT usAddress,
+                                         USHORT usNDiscrete );
+} xMBRegisterCB;
+
 /* ----------------------- Function prototypes ------------------------------*/
 /*! \ingroup modbus
  * \brief Initialize the Modbus protocol stack.
@@ -156,6 +195,11 @@ eMBErrorCode    eMBInit( eMBMode eMode, UCHAR ucSlaveAddress,
  * This function initializes the Modbus TCP Module. Please note that
  * frame processing is still disabled until eMBEnable( ) is called.
  *
+ * Modbus TCP runs in an instance of its own with its own frame buffer and
+ * event queue. It can be initialized before or after eMBInit( ), and
+ * eMBEnable( ), eMBDisable( ), eMBClose( ) and eMBPoll( ) then handle the
+ * serial line and Modbus TCP together. No mode switching is necessary.
+ *
  * \param usTCPPort The TCP port to listen on.
  * \return If the protocol stack has been initialized correctly the function
  *   returns eMBErrorCode::MB_ENOERR. Otherwise one of the following error
@@ -219,6 +263,104 @@ eMBErrorCode    eMBDisable( void );
  */
 eMBErrorCode    eMBPoll( void );
 
+/*! \ingroup modbus
+ * \brief Wait for an event and handle it.
+ *
+ * Works like eMBPoll( ) but sleeps until the receiver, transmitter or timer
+ * posted an event instead of returning at once. On the STM32 the core waits
+ * in WFI, so the super-loop does not spin while the bus is quiet, and the
+ * event is handled as soon as the interrupt which posted it returns. Any
+ * other interrupt, the tick included, ends the wait as well, so that the
+ * super-loop can serve the peripheral which raised it. Call the function
+ * in a loop.
+ *
+ * \param ulTimeoutMs Longest time to wait in milliseconds. <code>0</code>
+ *   does not wait, MB_POLL_WAIT_FOREVER sleeps again after other
+ *   interrupts until a Modbus event arrives.
+ *
+ * \return eMBErrorCode::MB_ETIMEDOUT if the wait ended without an event.
+ *   Otherwise the same values as eMBPoll( ).
+ */
+eMBErrorCode    eMBPollWait( ULONG ulTimeoutMs );
+
+/*! \ingroup modbus
+ * \brief Initialize a Modbus protocol stack instance for a serial port.
+ *
+ * Works like eMBInit( ) but for an instance of its own. Each instance
+ * needs its own port, i.e. UART and timer, and is enabled and polled
+ * with eMBInstEnable( ) and eMBInstPoll( ).
+ *
+ * \param ppxInst If <code>*ppxInst</code> is \c NULL a free instance is
+ *   taken from the pool of MB_INSTANCES_MAX instances and returned.
+ *   Otherwise the given instance is initialized again, e.g. to change the
+ *   baudrate.
+ * \param eMode If ASCII or RTU mode should be used.
+ * \param ucSlaveAddress The slave address of this instance.
+ * \param ucPort The port to use. See the porting layer for the mapping
+ *   of port numbers to UARTs and timers.
+ * \param ulBaudRate The baudrate.
+ * \param eParity Parity used for serial transmission.
+ *
+ * \return The same error codes as eMBInit( ) or eMBErrorCode::MB_ENORES
+ *   if all instances are in use.
+ */
+eMBErrorCode    eMBInstInit( xMBInstance ** ppxInst, eMBMode eMode,
+                             UCHAR ucSlaveAddress, UCHAR ucPort,
+                             ULONG ulBaudRate, eMBParity eParity );
+
+/*! \ingroup modbus
+ * \brief Initialize a Modbus protocol stack instance for Modbus TCP.
+ *
+ * See eMBInstInit( ) for the meaning of \c ppxInst and eMBTCPInit( ) for
+ * the other arguments and the return value.
+ */
+eMBErrorCode    eMBInstTCPInit( xMBInstance ** ppxInst, USHORT usTCPPort );
+
+/*! \ingroup modbus
+ * \brief Release an instance. See eMBClose( ).
+ *
+ * Instances other than the default instance are returned to the pool.
+ */
+eMBErrorCode    eMBInstClose( xMBInstance * pxInst );
+
+/*! \ingroup modbus
+ * \brief Enable an instance. See eMBEnable( ).
+ */
+eMBErrorCode    eMBInstEnable( xMBInstance * pxInst );
+
+/*! \ingroup modbus
+ * \brief Disable an instance. See eMBDisable( ).
+ */
+eMBErrorCode    eMBInstDisable( xMBInstance * pxInst );
+
+/*! \ingroup modbus
+ * \brief The main polling function of an instance. See eMBPoll( ).
+ *
+ * All instances must be polled. Polling one instance never blocks on
+ * another one.
+ */
+eMBErrorCode    eMBInstPoll( xMBInstance * pxInst );
+
+/*! \ingroup modbus
+ * \brief Wait for an event of an instance and handle it. See eMBPollWait( ).
+ *
+ * While waiting the other instances are not polled. If several instances
+ * are served from one loop use a timeout of one tick.
+ */
+eMBErrorCode    eMBInstPollWait( xMBInstance * pxInst, ULONG ulTimeoutMs );
+
+/*! \ingroup modbus
+ * \brief Switch an instance between its serial mode and Modbus TCP. See
+ *   eMBSwitchMode( ).
+ */
+eMBErrorCode    eMBInstSwitchMode( xMBInstance * pxInst, eMBMode eMode );
+
+/*! \ingroup modbus
+ * \brief The instance used by eMBInit( ), eMBPoll( ) and the other
+ *   functions without an instance argument.
+ */
+xMBInstance    *pxMBGetDefaultInstance( void );
+
 /*! \ingroup modbus
  * \brief Configure the slave id of the device.
  *
@@ -256,14 +398,40 @@ eMBErrorCode    eMBSetSlaveID( UCHAR ucSlaveID, BOOL xIsRunning,
  *   such a frame is received. If \c NULL a previously registered function handler
  *   for this function code is removed.
  *
- * \return eMBErrorCode::MB_ENOERR if the handler has been installed. If no
- *   more resources are available it returns eMBErrorCode::MB_ENORES. In this
- *   case the values in mbconfig.h should be adjusted. If the argument was not
- *   valid it returns eMBErrorCode::MB_EINVAL.
+ * \return eMBErrorCode::MB_ENOERR if the handler has been installed. A
+ *   handler registered before for the same function code, including the
+ *   built-in ones, is replaced. If the argument was not valid it returns
+ *   eMBErrorCode::MB_EINVAL.
  */
 eMBErrorCode    eMBRegisterCB( UCHAR ucFunctionCode, 
                                pxMBFunctionHandler pxHandler );
 
+/*! \ingroup modbus
+ * \brief Serve an additional slave address with its own register map.
+ *
+ * Frames sent to \c ucSlaveAddress on the serial line, or Modbus TCP frames
+ * with this unit identifier, are processed with the callbacks in
+ * \c pxRegisterCB instead of eMBRegInputCB( ), eMBRegHoldingCB( ),
+ * eMBRegCoilsCB( ) and eMBRegDiscreteCB( ). All slaves share the function
+ * handlers registered with eMBRegisterCB( ). The address lookup is a single
+ * table access.
+ *
+ * \param ucSlaveAddress The slave address in the range 1 - 247.
+ * \param pxRegisterCB The register callbacks. The structure is copied. If
+ *   \c NULL the virtual slave is removed.
+ *
+ * \return eMBErrorCode::MB_ENOERR on success, eMBErrorCode::MB_EINVAL if
+ *   the address is not valid or eMBErrorCode::MB_ENORES if already
+ *   MB_VIRTUAL_SLAVES_MAX virtual slaves are registered.
+ */
+eMBErrorCode    eMBRegisterVirtualSlave( UCHAR ucSlaveAddress,
+                                         const xMBRegisterCB * pxRegisterCB );
+
+/*! \ingroup modbus
+ * \brief Check if an address belongs to a registered virtual slave.
+ */
+BOOL            xMBIsVirtualSlave( UCHAR ucAddress );
+
 /* ----------------------- Callback -----------------------------------------*/
 
 /*! \defgroup modbus_registers Modbus Registers
@@ -410,6 +578,13 @@ eMBErrorCode    eMBRegCoilsCB( UCHAR * pucRegBuffer, USHORT usAddress,
 eMBErrorCode    eMBRegDiscreteCB( UCHAR * pucRegBuffer, USHORT usAddress,
                                   USHORT usNDiscrete );
 
+/*! \ingroup modbus
+ * \brief Change the transport of the default instance.
+ *
+ * Only kept for compatibility. Modbus TCP is served by its own instance,
+ * see eMBTCPInit( ), so serial and TCP requests do not need to share the
+ * default instance anymore.
+ */
 eMBErrorCode    eMBSwitchMode(eMBMode eMode);
 
 #ifdef __cplusplus
@@ -35,18 +35,18 @@ PR_BEGIN_EXTERN_C
 #endif
 
 #if MB_ASCII_ENABLED > 0
-eMBErrorCode    eMBASCIIInit( UCHAR slaveAddress, UCHAR ucPort,
+eMBErrorCode    eMBASCIIInit( xMBInstance * pxInst, UCHAR slaveAddress, UCHAR ucPort,
                               ULONG ulBaudRate, eMBParity eParity );
-void            eMBASCIIStart( void );
-void            eMBASCIIStop( void );
+void            eMBASCIIStart( xMBInstance * pxInst );
+void            eMBASCIIStop( xMBInstance * pxInst );
 
-eMBErrorCode    eMBASCIIReceive( UCHAR * pucRcvAddress, UCHAR ** pucFrame,
-                                 USHORT * pusLength );
-eMBErrorCode    eMBASCIISend( UCHAR slaveAddress, const UCHAR * pucFrame,
-                              USHORT usLength );
-BOOL            xMBASCIIReceiveFSM( void );
-BOOL            xMBASCIITransmitFSM( void );
-BOOL            xMBASCIITimerT1SExpired( void );
+eMBErrorCode    eMBASCIIReceive( xMBInstance * pxInst, UCHAR * pucRcvAddress,
+                                 UCHAR ** pucFrame, USHORT * pusLength );
+eMBErrorCode    eMBASCIISend( xMBInstance * pxInst, UCHAR slaveAddress,
+                              const UCHAR * pucFrame, USHORT usLength );
+BOOL            xMBASCIIReceiveFSM( xMBInstance * pxInst );
+BOOL            xMBASCIITransmitFSM( xMBInstance * pxInst );
+BOOL            xMBASCIITimerT1SExpired( xMBInstance * pxInst );
 #endif
 
 #ifdef __cplusplus
@@ -54,6 +54,86 @@ PR_BEGIN_EXTERN_C
 /*! \brief If Modbus TCP support is enabled. */
 #define MB_TCP_ENABLED                          (  1 )
 
+/*! \brief If Modbus RTU frames are received by DMA instead of per byte.
+ *
+ * If enabled the serial port fills the RTU buffer by DMA and reports the
+ * end of a frame with the UART IDLE-line event. The protocol stack then
+ * gets one callback per frame instead of one interrupt per character. The
+ * UART used for Modbus must have a DMA receive stream assigned in CubeMX,
+ * otherwise xMBPortSerialInit( ) fails. If set to <code>0</code> the
+ * classic per-byte receiver with the t3.5 timer is used, which is also the
+ * only one with MB_RTU_LENGTH_PREDICT_ENABLED. This option can not be
+ * combined with Modbus ASCII.
+ */
+#ifndef MB_RTU_DMA_RX_ENABLED
+#define MB_RTU_DMA_RX_ENABLED                   (  0 )
+#endif
+
+/*! \brief If Modbus RTU replies are sent as one block instead of per byte.
+ *
+ * If enabled eMBRTUSend( ) passes the complete serial line PDU to the port
+ * with xMBPortSerialPutBuffer( ). The STM32 port starts a single DMA
+ * transfer and the transmit complete callback posts EV_FRAME_SENT. The UART
+ * must have a DMA transmit stream assigned in CubeMX, otherwise
+ * xMBPortSerialInit( ) fails. If set to <code>0</code> one byte is written
+ * per transmitter empty interrupt.
+ */
+#ifndef MB_RTU_DMA_TX_ENABLED
+#define MB_RTU_DMA_TX_ENABLED                   (  0 )
+#endif
+
+/*! \brief If the per-byte RTU receiver folds each byte into a running CRC.
+ *
+ * The CRC of a request is then known when its last byte has arrived and
+ * eMBRTUReceive( ) only compares it. Otherwise eMBRTUReceive( ) computes
+ * the CRC over the whole frame inside its critical section, as the stack
+ * did before. Only used if MB_RTU_DMA_RX_ENABLED is <code>0</code>, the
+ * DMA receiver computes the CRC of a frame outside of the critical section.
+ */
+#ifndef MB_RTU_CRC_RUNNING_ENABLED
+#define MB_RTU_CRC_RUNNING_ENABLED              (  1 )
+#endif
+
+/*! \brief If the RTU receiver detects the end of a request from its length.
+ *
+ * For the standard function codes the length of a request follows from
+ * the function code and the byte count field. If enabled the per-byte
+ * receiver posts EV_FRAME_RECEIVED as soon as the last CRC byte of such a
+ * frame has arrived and the CRC is valid, instead of waiting for t3.5. The
+ * reply is still held back until t3.5 has expired so that the inter-frame
+ * silence is respected. Unknown function codes use t3.5 as before. Only
+ * used if MB_RTU_DMA_RX_ENABLED is <code>0</code>: the DMA receiver has no
+ * per-byte hook and the IDLE-line event already ends a frame after one
+ * character time. Requires MB_RTU_CRC_RUNNING_ENABLED to check the CRC at
+ * the predicted end.
+ *
+ * A request predicted complete is executed at once. If a further byte
+ * arrives before t3.5 only its reply is dropped; the request, a write as
+ * well, has already taken effect. Disable the option on buses where noise
+ * or echoes follow frames.
+ */
+#ifndef MB_RTU_LENGTH_PREDICT_ENABLED
+#define MB_RTU_LENGTH_PREDICT_ENABLED           (  1 )
+#endif
+
+/*! \brief Implementations of the CRC-16 used by usMBCRC16( ).
+ *
+ * - MB_CRC_BACKEND_TABLE: two 256 byte tables, one lookup per byte.
+ * - MB_CRC_BACKEND_SLICE4: four 512 byte tables, processes 4 bytes per step.
+ * - MB_CRC_BACKEND_SLICE8: eight 512 byte tables, processes 8 bytes per step.
+ * - MB_CRC_BACKEND_NIBBLE: one 32 byte table, two lookups per byte. Use it
+ *   if flash is tight.
+ */
+#define MB_CRC_BACKEND_TABLE                    (  0 )
+#define MB_CRC_BACKEND_SLICE4                   (  1 )
+#define MB_CRC_BACKEND_SLICE8                   (  2 )
+#define MB_CRC_BACKEND_NIBBLE                   (  3 )
+
+/*! \brief The CRC-16 implementation compiled into mbcrc.c. */
+#ifndef MB_CRC_BACKEND
+#define MB_CRC_BACKEND                          MB_CRC_BACKEND_SLICE4
+#endif
+
 /*! \brief The character timeout value for Modbus ASCII.
  *
  * The character timeout value is not fixed for Modbus ASCII and is therefore
@@ -75,14 +155,92 @@ PR_BEGIN_EXTERN_C
 #define MB_ASCII_TIMEOUT_WAIT_BEFORE_SEND_MS    ( 0 )
 #endif
 
-/*! \brief Maximum number of Modbus functions codes the protocol stack
- *    should support.
+/*! \brief If the Modbus RTU master is enabled.
+ *
+ * A master instance is created with eMBMasterInit( ) on a serial port of
+ * its own. See mbmaster.h.
+ */
+#define MB_MASTER_ENABLED                       (  1 )
+
+/*! \brief Time in milliseconds the master waits for a response. */
+#define MB_MASTER_TIMEOUT_MS                    ( 100 )
+
+/*! \brief How often the master repeats a request which got no valid
+ *    response before it reports eMBErrorCode::MB_ETIMEDOUT. */
+#define MB_MASTER_RETRIES                       (  2 )
+
+/*! \brief Time in milliseconds the master waits after a broadcast before
+ *    the next request is sent. */
+#define MB_MASTER_TURNAROUND_MS                 ( 10 )
+
+/*! \brief If Modbus TCP requests can be forwarded to slaves on an RTU bus.
  *
- * The maximum number of supported Modbus functions must be greater than
- * the sum of all enabled functions in this file and custom function
- * handlers. If set to small adding more functions will fail.
+ * Requests with a unit identifier added by eMBGatewayAddRoute( ) are sent
+ * by the master instance passed to eMBGatewayInit( ) and the response is
+ * returned to the TCP client. Requires MB_TCP_ENABLED and
+ * MB_MASTER_ENABLED. See mbgateway.h.
  */
-#define MB_FUNC_HANDLERS_MAX                    ( 16 )
+#define MB_GATEWAY_ENABLED                      (  1 )
+
+/*! \brief Number of forwarded requests which can be pending at a time.
+ *
+ * Each entry holds a copy of the request and later the response, i.e.
+ * about 300 bytes.
+ */
+#define MB_GATEWAY_QUEUE_SIZE                   (  4 )
+
+/*! \brief Number of unit identifiers the gateway forwards. */
+#define MB_GATEWAY_ROUTES_MAX                   (  8 )
+
+/*! \brief If the gateway answers reads of RTU slaves from a cache.
+ *
+ * Reads with function codes 1 to 4 which fall into a range added with
+ * eMBGatewayCacheAddRange( ) are answered from a snapshot of the range if
+ * it is not older than the maximum age of the range. See mbgateway.h.
+ */
+#define MB_GATEWAY_CACHE_ENABLED                (  1 )
+
+/*! \brief Number of cached ranges. Each one needs about 280 bytes. */
+#define MB_GATEWAY_CACHE_RANGES                 (  4 )
+
+/*! \brief Number of protocol stack instances.
+ *
+ * One instance is needed per serial bus. The first instance is the default
+ * instance used by eMBInit( ), eMBTCPInit( ) and eMBPoll( ). Further
+ * instances are created with eMBInstInit( ).
+ */
+#define MB_INSTANCES_MAX                        (  2 )
+
+/*! \brief Number of events each event queue of an instance can hold.
+ *
+ * Events are posted by the interrupt handlers of the serial port and
+ * consumed by eMBPoll( ). If eMBPoll( ) is not called often enough the
+ * queue overflows and the event is counted as lost. Must be a power of two
+ * and not larger than 128.
+ */
+#define MB_EVENT_QUEUE_SIZE                     (  8 )
+
+/*! \brief Maximum number of additional slave addresses served by this device.
+ *
+ * Each virtual slave registered with eMBRegisterVirtualSlave( ) answers on
+ * its own address (or Modbus TCP unit identifier) with its own register
+ * callbacks. Set to <code>0</code> to serve only the address given to
+ * eMBInit( ).
+ */
+#define MB_VIRTUAL_SLAVES_MAX                   (  8 )
+
+/*! \brief If tracepoints along the request pipeline should be compiled in.
+ *
+ * Each tracepoint stores the stage and a time stamp of the port (the cycle
+ * counter on the target) in a ring of MB_TRACE_RING_SIZE records. See
+ * mbtrace.h. With <code>0</code> the tracepoints compile to nothing.
+ */
+#ifndef MB_TRACE_ENABLED
+#define MB_TRACE_ENABLED                        (  0 )
+#endif
+
+/*! \brief Number of records in the trace ring. Must be a power of two. */
+#define MB_TRACE_RING_SIZE                      ( 256 )
 
 /*! \brief Number of bytes which should be allocated for the <em>Report Slave ID
  *    </em>command.
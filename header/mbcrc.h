@@ -30,6 +30,29 @@
 #ifndef _MB_CRC_H
 #define _MB_CRC_H
 
+/* ----------------------- Defines ------------------------------------------*/
+#define MB_CRC16_INIT           ( 0xFFFF )      /*!< Start value of the CRC. */
+
+/* ----------------------- Function prototypes ------------------------------*/
+/*! \brief Computes the Modbus CRC-16 of a complete frame. */
 USHORT          usMBCRC16( UCHAR * pucFrame, USHORT usLen );
 
+/*! \brief Streaming interface. A frame split into several parts gives the
+ *   same result as usMBCRC16( ) over the complete frame:
+ *
+ * \code
+ * usCRC = usMBCRC16Init(  );
+ * usCRC = usMBCRC16Update( usCRC, pucHead, usHeadLen );
+ * usCRC = usMBCRC16Update( usCRC, pucTail, usTailLen );
+ * usCRC = usMBCRC16Final( usCRC );
+ * \endcode
+ */
+USHORT          usMBCRC16Init( void );
+
+USHORT          usMBCRC16Update( USHORT usCRC, const UCHAR * pucData, USHORT usLen );
+
+USHORT          usMBCRC16Final( USHORT usCRC );
+
+USHORT          usMBCRC16UpdateByte( USHORT usCRC, UCHAR ucByte );
+
 #endif
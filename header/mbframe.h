@@ -66,19 +66,21 @@ PR_BEGIN_EXTERN_C
 #define MB_PDU_DATA_OFF     1   /*!< Offset for response data in PDU. */
 
 /* ----------------------- Prototypes  0-------------------------------------*/
-typedef void    ( *pvMBFrameStart ) ( void );
+typedef void    ( *pvMBFrameStart ) ( xMBInstance * pxInst );
 
-typedef void    ( *pvMBFrameStop ) ( void );
+typedef void    ( *pvMBFrameStop ) ( xMBInstance * pxInst );
 
-typedef eMBErrorCode( *peMBFrameReceive ) ( UCHAR * pucRcvAddress,
+typedef eMBErrorCode( *peMBFrameReceive ) ( xMBInstance * pxInst,
+                                            UCHAR * pucRcvAddress,
                                             UCHAR ** pucFrame,
                                             USHORT * pusLength );
 
-typedef eMBErrorCode( *peMBFrameSend ) ( UCHAR slaveAddress,
+typedef eMBErrorCode( *peMBFrameSend ) ( xMBInstance * pxInst,
+                                         UCHAR slaveAddress,
                                          const UCHAR * pucFrame,
                                          USHORT usLength );
 
-typedef void( *pvMBFrameClose ) ( void );
+typedef void( *pvMBFrameClose ) ( xMBInstance * pxInst );
 
 #ifdef __cplusplus
 PR_END_EXTERN_C
@@ -33,6 +33,11 @@
 #ifdef __cplusplus
 PR_BEGIN_EXTERN_C
 #endif
+/* Register callbacks of the slave addressed by the frame currently being
+ * processed. Set by eMBPoll( ) before a function handler is called.
+ */
+extern const xMBRegisterCB *pxMBRegisterCBCur;
+
 #if MB_FUNC_OTHER_REP_SLAVEID_BUF > 0
     eMBException eMBFuncReportSlaveID( UCHAR * pucFrame, USHORT * usLen );
 #endif
@@ -0,0 +1,182 @@
+/* 
+ * FreeModbus Libary: A portable Modbus implementation for Modbus ASCII/RTU.
+ * Copyright (c) 2006-2018 Christian Walter <cwalter@embedded-solutions.at>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef _MB_GATEWAY_H
+#define _MB_GATEWAY_H
+
+#ifdef __cplusplus
+PR_BEGIN_EXTERN_C
+#endif
+
+/*! \defgroup modbus_gateway Modbus TCP to RTU Gateway
+ * \code #include "mbgateway.h" \endcode
+ *
+ * Requests of a Modbus TCP client whose unit identifier belongs to a slave
+ * on the RTU bus are forwarded by a master instance. The request PDU is
+ * passed on unchanged and the response, exceptions included, is returned
+ * with the MBAP header of the request, i.e. with its transaction
+ * identifier. Forwarded requests are queued in the master by the priority
+ * of their route, so the next one is sent as soon as the bus is free.
+ *
+ * If the queue is full or the request can not be sent the client gets the
+ * exception eMBException::MB_EX_GATEWAY_PATH_FAILED. If the slave does not
+ * answer within the timeout of its route after all retries it gets
+ * eMBException::MB_EX_GATEWAY_TGT_FAILED.
+ *
+ * Reads of ranges added with eMBGatewayCacheAddRange( ) are answered from
+ * a snapshot of the range without using the bus while the snapshot is not
+ * older than the maximum age of the range. A range read by a client is
+ * refreshed in the background with priority 0 once its snapshot is half
+ * its maximum age old. Writes forwarded to a slave invalidate the ranges
+ * they overlap.
+ *
+ * \code
+ * xMBInstance *pxBus = NULL;
+ * eMBMasterInit( &pxBus, 2, 115200, MB_PAR_EVEN );
+ * eMBInstEnable( pxBus );
+ * eMBGatewayInit( pxBus );
+ * eMBGatewayAddRoute( 10, 1, 50 );     // Fast slave, high priority.
+ * eMBGatewayAddRoute( 11, 0, 500 );    // Slow slave.
+ * eMBGatewayCacheAddRange( 11, MB_FUNC_READ_HOLDING_REGISTER, 0, 100, 2000 );
+ *
+ * for( ;; )
+ * {
+ *     eMBPoll( );
+ *     eMBInstPoll( pxBus );
+ * }
+ * \endcode
+ */
+
+/* ----------------------- Type definitions ---------------------------------*/
+
+/*! \ingroup modbus_gateway
+ * \brief Counters of the gateway cache.
+ */
+typedef struct
+{
+    ULONG           ulHits;             /*!< Reads answered from the cache. */
+    ULONG           ulMisses;           /*!< Reads of cached ranges forwarded to the slave. */
+    ULONG           ulRefreshes;        /*!< Ranges read in the background. */
+    ULONG           ulInvalidations;    /*!< Ranges dropped because of a write. */
+} xMBGatewayCacheStats;
+
+/* ----------------------- Function prototypes ------------------------------*/
+
+/*! \ingroup modbus_gateway
+ * \brief Forward routed requests with the given master instance.
+ *
+ * \param pxMaster A master instance, see eMBMasterInit( ). It must be
+ *   polled by the application.
+ * \return eMBErrorCode::MB_ENOERR or eMBErrorCode::MB_EINVAL if
+ *   \c pxMaster is not a master.
+ */
+eMBErrorCode    eMBGatewayInit( xMBInstance * pxMaster );
+
+/*! \ingroup modbus_gateway
+ * \brief Forward requests for a unit identifier to the RTU slave with the
+ *   same address.
+ *
+ * Adding a route again changes its priority and timeout.
+ *
+ * \param ucUnitId Unit identifier and slave address, 1 to 247.
+ * \param ucPriority Requests with higher values are sent first.
+ * \param usTimeoutMs Response timeout of the slave or 0 for
+ *   MB_MASTER_TIMEOUT_MS.
+ * \return eMBErrorCode::MB_ENOERR, eMBErrorCode::MB_EINVAL for an invalid
+ *   address or eMBErrorCode::MB_ENORES if MB_GATEWAY_ROUTES_MAX routes are
+ *   in use.
+ */
+eMBErrorCode    eMBGatewayAddRoute( UCHAR ucUnitId, UCHAR ucPriority, USHORT usTimeoutMs );
+
+/*! \ingroup modbus_gateway
+ * \brief Check if requests for a unit identifier are forwarded.
+ */
+BOOL            xMBGatewayIsRouted( UCHAR ucUnitId );
+
+/*! \ingroup modbus_gateway
+ * \brief Answer a request received by Modbus TCP from the cache or queue
+ *   it.
+ *
+ * Called by eMBPoll( ) for routed unit identifiers.
+ *
+ * \param pucFrame The request PDU. The MBAP header precedes it. If the
+ *   request was answered from the cache it holds the response.
+ * \param pusLength Length of the PDU. Set to the length of the response
+ *   or to 0 if the request was queued.
+ * \return eMBException::MB_EX_NONE on success, otherwise the exception to
+ *   answer with.
+ */
+eMBException    eMBGatewayForward( UCHAR * pucFrame, USHORT * pusLength );
+
+/*! \ingroup modbus_gateway
+ * \brief Pass finished responses to the TCP port and start refreshes of
+ *   the cache.
+ *
+ * Called by the TCP port whenever it can send. Responses are handed over
+ * with xMBTCPPortSendResponseTo( ) to the connection the request came
+ * from. If the port refuses a response it is offered again on the next
+ * call.
+ */
+void            vMBGatewayPoll( void );
+
+/*! \ingroup modbus_gateway
+ * \brief Drop the responses of a TCP connection which was closed.
+ *
+ * Requests already queued in the master are still sent but their
+ * responses are discarded.
+ */
+void            vMBGatewayReset( UCHAR ucConnection );
+
+#if MB_GATEWAY_CACHE_ENABLED > 0
+/*! \ingroup modbus_gateway
+ * \brief Cache reads of a range of a routed slave.
+ *
+ * \param ucUnitId Unit identifier added with eMBGatewayAddRoute( ).
+ * \param ucFunctionCode The read function code of the table, 1 to 4.
+ * \param usAddress First coil, input or register, starting at 0.
+ * \param usCount Number of coils or inputs (up to 2000) or registers (up
+ *   to 125).
+ * \param usMaxAgeMs Age up to which the snapshot is used.
+ * \return eMBErrorCode::MB_ENOERR, eMBErrorCode::MB_EINVAL if the unit is
+ *   not routed or the range is invalid or eMBErrorCode::MB_ENORES if
+ *   MB_GATEWAY_CACHE_RANGES ranges are in use.
+ */
+eMBErrorCode    eMBGatewayCacheAddRange( UCHAR ucUnitId, UCHAR ucFunctionCode, USHORT usAddress,
+                                         USHORT usCount, USHORT usMaxAgeMs );
+
+/*! \ingroup modbus_gateway
+ * \brief Get the counters of the cache.
+ */
+void            vMBGatewayCacheGetStats( xMBGatewayCacheStats * pxStats );
+#endif
+
+#ifdef __cplusplus
+PR_END_EXTERN_C
+#endif
+#endif
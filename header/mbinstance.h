@@ -0,0 +1,238 @@
+/* 
+ * FreeModbus Libary: A portable Modbus implementation for Modbus ASCII/RTU.
+ * Copyright (c) 2006-2018 Christian Walter <cwalter@embedded-solutions.at>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef _MB_INSTANCE_H
+#define _MB_INSTANCE_H
+
+#ifdef __cplusplus
+PR_BEGIN_EXTERN_C
+#endif
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "mb.h"
+#include "mbconfig.h"
+#include "mbframe.h"
+#include "mbport.h"
+#if MB_MASTER_ENABLED > 0
+#include "mbmaster.h"
+#endif
+
+/* ----------------------- Defines ------------------------------------------*/
+#define MB_SER_BUF_SIZE         256     /*!< Size of the serial line frame buffer. */
+
+/* ----------------------- Type definitions ---------------------------------*/
+#if MB_RTU_ENABLED > 0
+typedef enum
+{
+    STATE_RX_INIT,              /*!< Receiver is in initial state. */
+    STATE_RX_IDLE,              /*!< Receiver is in idle state. */
+    STATE_RX_RCV,               /*!< Frame is beeing received. */
+#if ( MB_RTU_LENGTH_PREDICT_ENABLED > 0 ) && ( MB_RTU_CRC_RUNNING_ENABLED > 0 ) && ( MB_RTU_DMA_RX_ENABLED == 0 )
+    STATE_RX_PREDICTED,         /*!< Frame complete by length, waiting for t3.5. */
+#endif
+    STATE_RX_ERROR,             /*!< If the frame is invalid. */
+    STATE_RX_SKIP               /*!< Frame for another slave, wait for t3.5. */
+} eMBRTURcvState;
+
+typedef enum
+{
+    STATE_TX_IDLE,              /*!< Transmitter is in idle state. */
+    STATE_TX_XMIT               /*!< Transmitter is in transfer state. */
+} eMBRTUSndState;
+
+/*! \brief State of the Modbus RTU transmission layer (mbrtu.c). */
+typedef struct
+{
+    volatile eMBRTUSndState eSndState;
+    volatile eMBRTURcvState eRcvState;
+
+    volatile UCHAR *pucSndBufferCur;
+    volatile USHORT usSndBufferCount;
+
+    volatile USHORT usRcvBufferPos;
+    volatile USHORT usRcvCRC;
+
+    UCHAR           ucRTUAddress;
+    volatile ULONG  ulSkippedFrames;
+
+    volatile USHORT usRcvExpectedLen;
+    volatile BOOL   xSndDeferred;
+#if MB_TRACE_ENABLED > 0
+    volatile ULONG  ulTraceRxStamp;     /* Time stamp of the last byte received. */
+#endif
+} xMBRTUState;
+#endif
+
+#if MB_ASCII_ENABLED > 0
+typedef enum
+{
+    STATE_ASCII_RX_IDLE,        /*!< Receiver is in idle state. */
+    STATE_ASCII_RX_RCV,         /*!< Frame is beeing received. */
+    STATE_ASCII_RX_WAIT_EOF     /*!< Wait for End of Frame. */
+} eMBASCIIRcvState;
+
+typedef enum
+{
+    STATE_ASCII_TX_IDLE,        /*!< Transmitter is in idle state. */
+    STATE_ASCII_TX_START,       /*!< Starting transmission (':' sent). */
+    STATE_ASCII_TX_DATA,        /*!< Sending of data (Address, Data, LRC). */
+    STATE_ASCII_TX_END,         /*!< End of transmission. */
+    STATE_ASCII_TX_NOTIFY       /*!< Notify sender that the frame has been sent. */
+} eMBASCIISndState;
+
+typedef enum
+{
+    BYTE_HIGH_NIBBLE,           /*!< Character for high nibble of byte. */
+    BYTE_LOW_NIBBLE             /*!< Character for low nibble of byte. */
+} eMBBytePos;
+
+/*! \brief State of the Modbus ASCII transmission layer (mbascii.c). */
+typedef struct
+{
+    volatile eMBASCIISndState eSndState;
+    volatile eMBASCIIRcvState eRcvState;
+
+    volatile USHORT usRcvBufferPos;
+    volatile eMBBytePos eBytePos;
+
+    volatile UCHAR *pucSndBufferCur;
+    volatile USHORT usSndBufferCount;
+
+    volatile UCHAR  ucMBLFCharacter;
+} xMBASCIIState;
+#endif
+
+/*! \brief Single producer, single consumer queue of events.
+ *
+ * Only the producer writes ucHead and only eMBPoll( ) writes ucTail, so no
+ * critical section is needed. The indices run freely and are masked on
+ * access. The interrupts which post to the serial queue of one instance
+ * (UART and timer) must not preempt each other.
+ */
+typedef struct
+{
+    xMBEvent        xEvents[MB_EVENT_QUEUE_SIZE];
+    volatile UCHAR  ucHead;
+    volatile UCHAR  ucTail;
+    volatile ULONG  ulOverflows;        /*!< Events lost because the queue was full. */
+} xMBEventQueue;
+
+#if MB_MASTER_ENABLED > 0
+typedef enum
+{
+    STATE_M_IDLE,               /*!< No request in progress. */
+    STATE_M_SEND_PENDING,       /*!< Receiver was busy, send on the next poll. */
+    STATE_M_SENDING,            /*!< Request is being sent. */
+    STATE_M_WAIT_REPLY,         /*!< Waiting for the response. */
+    STATE_M_TURNAROUND          /*!< Delay after a broadcast. */
+} eMBMasterState;
+
+typedef struct
+{
+    eMBMasterState  eState;
+    xMBMasterRequest *pxHead;           /*!< Request in progress, then the queued ones. */
+    UCHAR           ucTries;
+    ULONG           ulStart;            /*!< Tick at the end of the request. */
+} xMBMasterState;
+#endif
+
+typedef enum
+{
+    STATE_NOT_INITIALIZED,
+    STATE_ENABLED,
+    STATE_DISABLED
+} eMBInstanceState;
+
+/*! \brief A Modbus protocol stack instance.
+ *
+ * Everything which belongs to one bus is kept here so that several
+ * instances can run side by side. Instances are taken from a pool of
+ * MB_INSTANCES_MAX entries in mb.c. The first entry is the default instance
+ * used by the functions without an instance argument.
+ */
+struct xMBInstanceStruct
+{
+    BOOL            xInUse;
+    UCHAR           ucPort;             /*!< Port number passed to eMBInstInit( ). */
+    UCHAR           ucMBAddress;
+    UCHAR           ucMBSerialAddress;
+    eMBMode         eMBCurrentMode;
+    eMBInstanceState eMBState;
+#if MB_MASTER_ENABLED > 0
+    BOOL            xIsMaster;          /*!< Set by eMBMasterInit( ). */
+    xMBMasterState  xMaster;
+#endif
+
+    /* Functions pointer which are initialized in eMBInstInit( ). Depending
+     * on the mode (RTU, ASCII or TCP) they are set to the correct
+     * implementations.
+     */
+    peMBFrameSend   peMBFrameSendCur;
+    pvMBFrameStart  pvMBFrameStartCur;
+    pvMBFrameStop   pvMBFrameStopCur;
+    peMBFrameReceive peMBFrameReceiveCur;
+    pvMBFrameClose  pvMBFrameCloseCur;
+
+    /* Callback functions called by the porting layer through
+     * xMBPortCBByteReceived( ) and friends.
+     */
+    BOOL( *pxMBFrameCBByteReceived ) ( xMBInstance * pxInst );
+    BOOL( *pxMBFrameCBFrameReceived ) ( xMBInstance * pxInst, USHORT usLength );
+    BOOL( *pxMBFrameCBTransmitterEmpty ) ( xMBInstance * pxInst );
+    BOOL( *pxMBFrameCBTransmitComplete ) ( xMBInstance * pxInst );
+    BOOL( *pxMBPortCBTimerExpired ) ( xMBInstance * pxInst );
+
+    /* Event queues of the porting layer (portevent.c), one per transport. */
+    xMBEventQueue   xEventQueues[MB_EV_TRANSPORTS];
+
+    /* Frame currently processed by eMBInstPoll( ). */
+    UCHAR          *pucMBFrame;
+    UCHAR           ucRcvAddress;
+    USHORT          usLength;
+
+    /* Only one serial mode is active at a time. */
+    union
+    {
+#if MB_RTU_ENABLED > 0
+        xMBRTUState     xRTU;
+#endif
+#if MB_ASCII_ENABLED > 0
+        xMBASCIIState   xASCII;
+#endif
+        UCHAR           ucUnused;
+    } xSer;
+
+    /* Serial line frame buffer shared by RTU and ASCII. */
+    volatile UCHAR  ucSerBuf[MB_SER_BUF_SIZE];
+};
+
+#ifdef __cplusplus
+PR_END_EXTERN_C
+#endif
+#endif
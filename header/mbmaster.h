@@ -0,0 +1,157 @@
+/* 
+ * FreeModbus Libary: A portable Modbus implementation for Modbus ASCII/RTU.
+ * Copyright (c) 2006-2018 Christian Walter <cwalter@embedded-solutions.at>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef _MB_MASTER_H
+#define _MB_MASTER_H
+
+#ifdef __cplusplus
+PR_BEGIN_EXTERN_C
+#endif
+
+/*! \defgroup modbus_master Modbus RTU Master
+ * \code #include "mbmaster.h" \endcode
+ *
+ * A master instance sends requests to slaves on its own serial port. The
+ * application describes a transaction with an xMBMasterRequest and hands
+ * it to eMBMasterSubmit( ). Requests are queued and sent back to back by
+ * eMBMasterPoll( ), which also parses the response, handles the response
+ * timeout and retries and finally calls the completion callback. None of
+ * the functions blocks.
+ *
+ * \code
+ * static USHORT usTemperature[2];
+ * static xMBMasterRequest xReadSensor;
+ *
+ * xMBInstance *pxBus = NULL;
+ * eMBMasterInit( &pxBus, 2, 115200, MB_PAR_EVEN );
+ * eMBInstEnable( pxBus );
+ *
+ * xReadSensor.ucSlaveAddress = 10;
+ * xReadSensor.ucFunctionCode = MB_FUNC_READ_HOLDING_REGISTER;
+ * xReadSensor.usAddress = 0;
+ * xReadSensor.usCount = 2;
+ * xReadSensor.pusRegs = usTemperature;
+ * xReadSensor.pvDone = vSensorRead;
+ * eMBMasterSubmit( pxBus, &xReadSensor );
+ *
+ * for( ;; )
+ * {
+ *     eMBInstPoll( pxBus );
+ * }
+ * \endcode
+ */
+
+/* ----------------------- Type definitions ---------------------------------*/
+typedef struct xMBMasterRequestStruct xMBMasterRequest;
+
+/*! \ingroup modbus_master
+ * \brief Called by eMBMasterPoll( ) when a request has been completed.
+ *
+ * \param pxReq The request. It may be submitted again from the callback.
+ * \param eStatus eMBErrorCode::MB_ENOERR if the slave answered as
+ *   expected, eMBErrorCode::MB_ETIMEDOUT if it did not answer after all
+ *   retries and eMBErrorCode::MB_EIO if it answered with an exception
+ *   (see xMBMasterRequest::eException) or an invalid response.
+ */
+typedef void    ( *pvMBMasterDoneCB ) ( xMBMasterRequest * pxReq, eMBErrorCode eStatus );
+
+/*! \ingroup modbus_master
+ * \brief A transaction with a slave.
+ *
+ * The data buffers belong to the application and must stay valid until
+ * the request has been completed. Addresses are the protocol addresses,
+ * i.e. starting at 0. Bits are packed LSB first as in the Modbus PDU.
+ *
+ * If \c pucPDU is set the request is sent as it is and the function code
+ * and data fields are not used. The response PDU, an exception response
+ * included, is copied back to \c pucPDU. This is used to forward requests
+ * which the master does not need to understand.
+ */
+struct xMBMasterRequestStruct
+{
+    UCHAR           ucSlaveAddress;     /*!< 1 to 247 or 0 for a broadcast write. */
+    UCHAR           ucFunctionCode;     /*!< Function codes 1 to 6, 15, 16 and 23. */
+    USHORT          usAddress;          /*!< First coil, input or register. */
+    USHORT          usCount;            /*!< Number of coils, inputs or registers. */
+    USHORT          usWriteAddress;     /*!< First register written by function code 23. */
+    USHORT          usWriteCount;       /*!< Registers written by function code 23. */
+    USHORT         *pusRegs;            /*!< Registers read (3, 4, 23) or written (6, 16). */
+    USHORT         *pusWriteRegs;       /*!< Registers written by function code 23. */
+    UCHAR          *pucBits;            /*!< Bits read (1, 2) or written (5, 15). */
+    pvMBMasterDoneCB pvDone;            /*!< Completion callback or \c NULL. */
+    void           *pvArg;              /*!< Free for the application. */
+    UCHAR          *pucPDU;             /*!< Raw request and response PDU or \c NULL. */
+    USHORT          usPDULength;        /*!< Length of the raw request, then of the response. */
+    USHORT          usPDUSize;          /*!< Size of the buffer at \c pucPDU. */
+    UCHAR           ucPriority;         /*!< Requests with higher values are sent first. */
+    USHORT          usTimeoutMs;        /*!< Response timeout or 0 for MB_MASTER_TIMEOUT_MS. */
+
+    /* Set by the master. */
+    volatile BOOL   xBusy;              /*!< Queued or in progress. */
+    eMBErrorCode    eStatus;            /*!< Result once xBusy is cleared. */
+    eMBException    eException;         /*!< Exception code of the slave. */
+    xMBMasterRequest *pxNext;
+};
+
+/* ----------------------- Function prototypes ------------------------------*/
+
+/*! \ingroup modbus_master
+ * \brief Initialize a protocol stack instance as Modbus RTU master.
+ *
+ * Works like eMBInstInit( ) in RTU mode. The receiver accepts responses
+ * from all slaves. The instance is enabled with eMBInstEnable( ) and polled
+ * with eMBInstPoll( ) or eMBMasterPoll( ).
+ */
+eMBErrorCode    eMBMasterInit( xMBInstance ** ppxInst, UCHAR ucPort,
+                               ULONG ulBaudRate, eMBParity eParity );
+
+/*! \ingroup modbus_master
+ * \brief Queue a request.
+ *
+ * The request is queued behind all requests with the same or a higher
+ * priority. Must be called from the context which polls the instance.
+ *
+ * \return eMBErrorCode::MB_ENOERR if the request was queued,
+ *   eMBErrorCode::MB_EINVAL if the request is not valid or still busy and
+ *   eMBErrorCode::MB_EILLSTATE if the instance is not a master.
+ */
+eMBErrorCode    eMBMasterSubmit( xMBInstance * pxInst, xMBMasterRequest * pxReq );
+
+/*! \ingroup modbus_master
+ * \brief Run the master: handle events and timeouts and start the next
+ *   queued request as soon as the bus is free.
+ *
+ * eMBInstPoll( ) calls this function for master instances.
+ */
+eMBErrorCode    eMBMasterPoll( xMBInstance * pxInst );
+
+#ifdef __cplusplus
+PR_END_EXTERN_C
+#endif
+#endif
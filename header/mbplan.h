@@ -0,0 +1,198 @@
+/* 
+ * FreeModbus Libary: A portable Modbus implementation for Modbus ASCII/RTU.
+ * Copyright (c) 2006-2018 Christian Walter <cwalter@embedded-solutions.at>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef _MB_PLAN_H
+#define _MB_PLAN_H
+
+#ifdef __cplusplus
+PR_BEGIN_EXTERN_C
+#endif
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "mbmaster.h"
+
+/*! \defgroup modbus_plan Modbus Master Polling Plan
+ * \code #include "mbplan.h" \endcode
+ *
+ * The planner reads a list of tags from downstream slaves with as few
+ * requests as possible. Tags of the same slave and table whose addresses
+ * are at most \c usGapMax registers apart are merged into one read of up
+ * to 125 registers or 2000 bits. The registers in the gaps are read but
+ * not used, which is cheaper than the framing and the t3.5 silence of an
+ * additional request. Each block is read with the shortest period of its
+ * tags and the results are copied back to the tags.
+ *
+ * \code
+ * static xMBTag xTags[] = {
+ *     { 10, MB_TAG_HOLDING, 0, MB_TAG_REG16, 100 },
+ *     { 10, MB_TAG_HOLDING, 2, MB_TAG_REG32, 100 },
+ *     { 10, MB_TAG_COIL, 5, MB_TAG_BIT, 1000 },
+ * };
+ * static xMBPlanBlock xBlocks[4];
+ * static xMBPlan xPlan;
+ *
+ * eMBPlanInit( &xPlan, pxBus, xTags, 3, xBlocks, 4, 4 );
+ * for( ;; )
+ * {
+ *     vMBPlanPoll( &xPlan );
+ *     eMBInstPoll( pxBus );
+ * }
+ * \endcode
+ */
+
+/* ----------------------- Defines ------------------------------------------*/
+#define MB_PLAN_REGS_MAX        ( 125 )     /*!< Registers per read request. */
+#define MB_PLAN_BITS_MAX        ( 2000 )    /*!< Coils or inputs per read request. */
+
+/* ----------------------- Type definitions ---------------------------------*/
+typedef enum
+{
+    MB_TAG_COIL,                /*!< Read with function code 1. */
+    MB_TAG_DISCRETE,            /*!< Read with function code 2. */
+    MB_TAG_HOLDING,             /*!< Read with function code 3. */
+    MB_TAG_INPUT                /*!< Read with function code 4. */
+} eMBTagTable;
+
+typedef enum
+{
+    MB_TAG_BIT,                 /*!< One coil or discrete input. */
+    MB_TAG_REG16,               /*!< One register. */
+    MB_TAG_REG32,               /*!< Two registers, high word first. */
+    MB_TAG_REG32_SWAPPED        /*!< Two registers, low word first. */
+} eMBTagType;
+
+/*! \ingroup modbus_plan
+ * \brief A value polled from a slave.
+ */
+typedef struct xMBTagStruct
+{
+    UCHAR           ucSlaveAddress;
+    eMBTagTable     eTable;
+    USHORT          usAddress;          /*!< Protocol address, starting at 0. */
+    eMBTagType      eType;
+    USHORT          usPeriodMs;         /*!< Poll period, 0 for as often as possible. */
+
+    /* Set by the planner. */
+    ULONG           ulValue;            /*!< Last value read. */
+    eMBErrorCode    eStatus;            /*!< Result of the last read. */
+    ULONG           ulTimestamp;        /*!< Tick of the last successful read. */
+    USHORT          usBlock;
+    struct xMBTagStruct *pxNext;
+} xMBTag;
+
+/*! \ingroup modbus_plan
+ * \brief A read request which serves one or more tags.
+ */
+typedef struct
+{
+    UCHAR           ucSlaveAddress;
+    eMBTagTable     eTable;
+    USHORT          usAddress;
+    USHORT          usCount;
+    USHORT          usPeriodMs;
+    ULONG           ulLastStart;
+    BOOL            xStarted;
+    xMBTag         *pxTags;
+} xMBPlanBlock;
+
+typedef struct
+{
+    xMBInstance    *pxInst;
+    xMBTag         *pxTags;
+    USHORT          usTags;
+    xMBPlanBlock   *pxBlocks;
+    USHORT          usBlocks;
+    USHORT          usCurrent;
+    BOOL            xBusy;
+    xMBMasterRequest xReq;
+    union
+    {
+        USHORT          ausRegs[MB_PLAN_REGS_MAX];
+        UCHAR           aucBits[( MB_PLAN_BITS_MAX + 7 ) / 8];
+    } xBuf;
+} xMBPlan;
+
+/*! \ingroup modbus_plan
+ * \brief Bus load of one cycle over all tags, i.e. every tag read once,
+ *   and per second with each read at its period.
+ *
+ * Character times include the request, the response and the t3.5 silence
+ * before each frame. Multiply by 11 bits and divide by the baudrate to get
+ * seconds. Tags and blocks with a period of 0 are left out of the load per
+ * second.
+ */
+typedef struct
+{
+    ULONG           ulRequestsPerTag;   /*!< Requests with one read per tag. */
+    ULONG           ulCharsPerTag;
+    ULONG           ulCharsPerSecPerTag;
+    ULONG           ulRequestsMerged;   /*!< Requests of the plan. */
+    ULONG           ulCharsMerged;
+    ULONG           ulCharsPerSecMerged;
+} xMBPlanCost;
+
+/* ----------------------- Function prototypes ------------------------------*/
+
+/*! \ingroup modbus_plan
+ * \brief Merge the tags into read blocks.
+ *
+ * \param pxPlan The plan to build.
+ * \param pxInst A master instance, see eMBMasterInit( ).
+ * \param pxTags The tags. The array is not reordered.
+ * \param usTags Number of tags.
+ * \param pxBlocks Storage for the read blocks.
+ * \param usBlocksMax Number of entries in \c pxBlocks.
+ * \param usGapMax Largest number of unused registers between two tags of
+ *   one block. For coils and discrete inputs 16 bits count as one register.
+ *
+ * \return eMBErrorCode::MB_ENOERR, eMBErrorCode::MB_EINVAL for an invalid
+ *   tag or eMBErrorCode::MB_ENORES if \c usBlocksMax is too small.
+ */
+eMBErrorCode    eMBPlanInit( xMBPlan * pxPlan, xMBInstance * pxInst, xMBTag * pxTags,
+                             USHORT usTags, xMBPlanBlock * pxBlocks, USHORT usBlocksMax,
+                             USHORT usGapMax );
+
+/*! \ingroup modbus_plan
+ * \brief Start the most overdue block if no block is being read.
+ *
+ * When a block has been read the next due block is submitted right away
+ * from the completion callback, so the bus stays busy while blocks are
+ * due. Call this function together with eMBInstPoll( ).
+ */
+void            vMBPlanPoll( xMBPlan * pxPlan );
+
+/*! \ingroup modbus_plan
+ * \brief Compare the bus load of the plan with one read per tag.
+ */
+void            vMBPlanGetCost( const xMBPlan * pxPlan, xMBPlanCost * pxCost );
+
+#ifdef __cplusplus
+PR_END_EXTERN_C
+#endif
+#endif
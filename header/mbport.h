@@ -47,6 +47,29 @@ typedef enum
     EV_FRAME_SENT               /*!< Frame sent. */
 } eMBEventType;
 
+/*! \brief Transport which posted an event.
+ *
+ * Each transport has its own event queue in an instance. The serial queue is
+ * filled by the interrupt handlers of the serial port and the timer, the
+ * TCP queue by the TCP port.
+ */
+typedef enum
+{
+    MB_EV_TRANSPORT_SERIAL,     /*!< Modbus RTU or ASCII. */
+    MB_EV_TRANSPORT_TCP,        /*!< Modbus TCP. */
+    MB_EV_TRANSPORTS
+} eMBEventTransport;
+
+/*! \brief An event with the transport it was posted from and the time (in
+ *   milliseconds, see MB_PORT_GET_TICK) it was posted at.
+ */
+typedef struct
+{
+    eMBEventType    eEvent;
+    eMBEventTransport eTransport;
+    ULONG           ulTimestamp;
+} xMBEvent;
+
 /*! \ingroup modbus
  * \brief Parity used for characters in serial mode.
  *
@@ -61,36 +84,67 @@ typedef enum
     MB_PAR_EVEN                 /*!< Even parity. */
 } eMBParity;
 
+/*! \ingroup modbus
+ * \brief Handle of a Modbus protocol stack instance.
+ *
+ * Each instance has its own frame buffer, state machines and event queue and
+ * serves one serial port or the Modbus TCP port. The functions of the
+ * porting layer get the instance they work for. Its members are defined in
+ * mbinstance.h.
+ */
+typedef struct xMBInstanceStruct xMBInstance;
+
 /* ----------------------- Supporting functions -----------------------------*/
-BOOL            xMBPortEventInit( void );
+BOOL            xMBPortEventInit( xMBInstance * pxInst );
+
+BOOL            xMBPortEventPost( xMBInstance * pxInst, eMBEventType eEvent );
+
+BOOL            xMBPortEventPostTransport( xMBInstance * pxInst, eMBEventTransport eTransport,
+                                           eMBEventType eEvent );
 
-BOOL            xMBPortEventPost( eMBEventType eEvent );
+BOOL            xMBPortEventGet( xMBInstance * pxInst, /*@out@ */ xMBEvent * pxEvent );
 
-BOOL            xMBPortEventGet(  /*@out@ */ eMBEventType * eEvent );
+/*!
+ * \brief Sleep until xMBPortEventGet( ) has an event, the timeout expired or,
+ *   unless the timeout is MB_POLL_WAIT_FOREVER, any interrupt woke the core.
+ *
+ * \return <code>TRUE</code> if an event is available.
+ */
+BOOL            xMBPortEventWait( xMBInstance * pxInst, ULONG ulTimeoutMs );
+
+ULONG           ulMBPortEventOverflows( xMBInstance * pxInst );
 
 /* ----------------------- Serial port functions ----------------------------*/
 
-BOOL            xMBPortSerialInit( UCHAR ucPort, ULONG ulBaudRate,
+BOOL            xMBPortSerialInit( xMBInstance * pxInst, UCHAR ucPort, ULONG ulBaudRate,
                                    UCHAR ucDataBits, eMBParity eParity );
 
-void            vMBPortClose( void );
+void            vMBPortClose( xMBInstance * pxInst );
+
+void            xMBPortSerialClose( xMBInstance * pxInst );
+
+void            vMBPortSerialEnable( xMBInstance * pxInst, BOOL xRxEnable, BOOL xTxEnable );
 
-void            xMBPortSerialClose( void );
+BOOL            xMBPortSerialGetByte( xMBInstance * pxInst, CHAR * pucByte );
 
-void            vMBPortSerialEnable( BOOL xRxEnable, BOOL xTxEnable );
+BOOL            xMBPortSerialPutByte( xMBInstance * pxInst, UCHAR ucByte );
 
-BOOL            xMBPortSerialGetByte( CHAR * pucByte );
+BOOL            xMBPortSerialStartReceive( xMBInstance * pxInst, UCHAR * pucBuffer,
+                                           USHORT usSize );
 
-BOOL            xMBPortSerialPutByte( UCHAR ucByte );
+USHORT          usMBPortSerialRxCount( xMBInstance * pxInst );
+
+BOOL            xMBPortSerialPutBuffer( xMBInstance * pxInst, const UCHAR * pucBuffer,
+                                        USHORT usLength );
 
 /* ----------------------- Timers functions ---------------------------------*/
-BOOL            xMBPortTimersInit( USHORT usTimeOut50us );
+BOOL            xMBPortTimersInit( xMBInstance * pxInst, USHORT usTimeOut50us );
 
-void            xMBPortTimersClose( void );
+void            xMBPortTimersClose( xMBInstance * pxInst );
 
-void            vMBPortTimersEnable( void );
+void            vMBPortTimersEnable( xMBInstance * pxInst );
 
-void            vMBPortTimersDisable( void );
+void            vMBPortTimersDisable( xMBInstance * pxInst );
 
 void            vMBPortTimersDelay( USHORT usTimeOutMS );
 
@@ -108,6 +162,39 @@ void            vMBPortTimersDelay( USHORT usTimeOutMS );
  *   a new byte was received. The port implementation should wake up the
  *   tasks which are currently blocked on the eventqueue.
  */
+BOOL            xMBPortCBByteReceived( xMBInstance * pxInst );
+
+/*!
+ * \brief Callback function for the porting layer when a complete frame
+ *   has been received into the buffer passed to xMBPortSerialStartReceive().
+ *
+ * Only used if MB_RTU_DMA_RX_ENABLED is set. The port calls this function
+ * once per frame, i.e. when the receiver detected an idle line after the
+ * last character, with the number of bytes stored in the buffer.
+ *
+ * \return <code>TRUE</code> if a event was posted to the queue.
+ */
+BOOL            xMBPortCBFrameReceived( xMBInstance * pxInst, USHORT usLength );
+
+BOOL            xMBPortCBTransmitterEmpty( xMBInstance * pxInst );
+
+/*!
+ * \brief Callback function for the porting layer when the buffer passed to
+ *   xMBPortSerialPutBuffer() has been sent completely.
+ *
+ * Only used if MB_RTU_DMA_TX_ENABLED is set. The port must call it after the
+ * last character has left the transmitter.
+ *
+ * \return <code>TRUE</code> if a event was posted to the queue.
+ */
+BOOL            xMBPortCBTransmitComplete( xMBInstance * pxInst );
+
+BOOL            xMBPortCBTimerExpired( xMBInstance * pxInst );
+
+/* Callbacks of the default instance for interrupt handlers which do not
+ * know about instances. They are equal to calling the functions above with
+ * the default instance.
+ */
 extern          BOOL( *pxMBFrameCBByteReceived ) ( void );
 
 extern          BOOL( *pxMBFrameCBTransmitterEmpty ) ( void );
@@ -115,7 +202,12 @@ extern          BOOL( *pxMBFrameCBTransmitterEmpty ) ( void );
 extern          BOOL( *pxMBPortCBTimerExpired ) ( void );
 
 /* ----------------------- TCP port functions -------------------------------*/
-BOOL            xMBTCPPortInit( USHORT usTCPPort );
+/* The TCP port posts its requests to the instance passed to xMBTCPPortInit( )
+ * and polls that instance to get the response. The port may serve several
+ * clients. xMBTCPPortGetRequest( ) and xMBTCPPortSendResponse( ) work on the
+ * connection of the request in progress.
+ */
+BOOL            xMBTCPPortInit( xMBInstance * pxInst, USHORT usTCPPort );
 
 void            vMBTCPPortClose( void );
 
@@ -125,6 +217,24 @@ BOOL            xMBTCPPortGetRequest( UCHAR **ppucMBTCPFrame, USHORT * usTCPLeng
 
 BOOL            xMBTCPPortSendResponse( const UCHAR *pucMBTCPFrame, USHORT usTCPLength );
 
+/*!
+ * \brief Connection of the request returned by xMBTCPPortGetRequest( ).
+ */
+UCHAR           ucMBTCPPortGetConnection( void );
+
+/*!
+ * \brief Send a response later to the connection a request came from.
+ *
+ * The response may be sent directly from the buffer of the caller, which
+ * can reuse it once the function returned.
+ *
+ * \return <code>FALSE</code> if the connection is closed, has not sent
+ *   its previous response yet or has no room for the response. The caller
+ *   tries again later.
+ */
+BOOL            xMBTCPPortSendResponseTo( UCHAR ucConnection, const UCHAR *pucMBTCPFrame,
+                                          USHORT usTCPLength );
+
 #ifdef __cplusplus
   PR_END_EXTERN_C
 #endif
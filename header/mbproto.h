@@ -53,6 +53,7 @@ PR_BEGIN_EXTERN_C
 #define MB_FUNC_DIAG_GET_COM_EVENT_LOG        ( 12 )
 #define MB_FUNC_OTHER_REPORT_SLAVEID          ( 17 )
 #define MB_FUNC_ERROR                         ( 128 )
+#define MB_FUNC_CODE_MAX                      ( 127 )
 /* ----------------------- Type definitions ---------------------------------*/
     typedef enum
 {
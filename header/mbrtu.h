@@ -33,16 +33,21 @@
 #ifdef __cplusplus
 PR_BEGIN_EXTERN_C
 #endif
-    eMBErrorCode eMBRTUInit( UCHAR slaveAddress, UCHAR ucPort, ULONG ulBaudRate,
-                             eMBParity eParity );
-void            eMBRTUStart( void );
-void            eMBRTUStop( void );
-eMBErrorCode    eMBRTUReceive( UCHAR * pucRcvAddress, UCHAR ** pucFrame, USHORT * pusLength );
-eMBErrorCode    eMBRTUSend( UCHAR slaveAddress, const UCHAR * pucFrame, USHORT usLength );
-BOOL            xMBRTUReceiveFSM( void );
-BOOL            xMBRTUTransmitFSM( void );
-BOOL            xMBRTUTimerT15Expired( void );
-BOOL            xMBRTUTimerT35Expired( void );
+    eMBErrorCode eMBRTUInit( xMBInstance * pxInst, UCHAR slaveAddress, UCHAR ucPort,
+                             ULONG ulBaudRate, eMBParity eParity );
+void            eMBRTUStart( xMBInstance * pxInst );
+void            eMBRTUStop( xMBInstance * pxInst );
+eMBErrorCode    eMBRTUReceive( xMBInstance * pxInst, UCHAR * pucRcvAddress, UCHAR ** pucFrame,
+                               USHORT * pusLength );
+eMBErrorCode    eMBRTUSend( xMBInstance * pxInst, UCHAR slaveAddress, const UCHAR * pucFrame,
+                            USHORT usLength );
+BOOL            xMBRTUReceiveFSM( xMBInstance * pxInst );
+BOOL            xMBRTUReceiveFrame( xMBInstance * pxInst, USHORT usLength );
+BOOL            xMBRTUTransmitFSM( xMBInstance * pxInst );
+BOOL            xMBRTUTransmitComplete( xMBInstance * pxInst );
+BOOL            xMBRTUTimerT15Expired( xMBInstance * pxInst );
+BOOL            xMBRTUTimerT35Expired( xMBInstance * pxInst );
+ULONG           ulMBRTUGetSkippedFrames( xMBInstance * pxInst );
 
 #ifdef __cplusplus
 PR_END_EXTERN_C
@@ -37,14 +37,28 @@ PR_BEGIN_EXTERN_C
 /* ----------------------- Defines ------------------------------------------*/
 #define MB_TCP_PSEUDO_ADDRESS   255
 
+/* Offsets in the MBAP header, see mbtcp.c. */
+#define MB_TCP_TID          0
+#define MB_TCP_PID          2
+#define MB_TCP_LEN          4
+#define MB_TCP_UID          6
+#define MB_TCP_FUNC         7
+
+#define MB_TCP_PROTOCOL_ID  0   /* 0 = Modbus Protocol */
+
+#define MB_TCP_ADU_SIZE_MAX 260 /*!< MBAP header and the largest PDU. */
+
 /* ----------------------- Function prototypes ------------------------------*/
-eMBErrorCode    eMBTCPDoInit( USHORT ucTCPPort );
-void            eMBTCPStart( void );
-void            eMBTCPStop( void );
-eMBErrorCode    eMBTCPReceive( UCHAR * pucRcvAddress,
+eMBErrorCode    eMBTCPDoInit( xMBInstance * pxInst, USHORT ucTCPPort );
+void            eMBTCPStart( xMBInstance * pxInst );
+void            eMBTCPStop( xMBInstance * pxInst );
+void            eMBTCPClose( xMBInstance * pxInst );
+eMBErrorCode    eMBTCPReceive( xMBInstance * pxInst,
+                               UCHAR * pucRcvAddress,
                                UCHAR ** pucFrame,
                                USHORT * pusLength );
-eMBErrorCode    eMBTCPSend( UCHAR _unused,
+eMBErrorCode    eMBTCPSend( xMBInstance * pxInst,
+                            UCHAR _unused,
                             const UCHAR * pucFrame,
                             USHORT usLength );
 
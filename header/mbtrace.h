@@ -0,0 +1,158 @@
+/* 
+ * FreeModbus Libary: A portable Modbus implementation for Modbus ASCII/RTU.
+ * Copyright (c) 2006-2018 Christian Walter <cwalter@embedded-solutions.at>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef _MB_TRACE_H
+#define _MB_TRACE_H
+
+#ifdef __cplusplus
+PR_BEGIN_EXTERN_C
+#endif
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "mbconfig.h"
+
+/*! \defgroup modbus_trace Request Pipeline Tracepoints
+ * \code #include "mbtrace.h" \endcode
+ *
+ * With MB_TRACE_ENABLED the stack records a time stamp at each stage of a
+ * request, from the last byte received until the reply has been sent. The
+ * time stamps come from MB_PORT_TRACE_STAMP( ), the DWT cycle counter on
+ * the STM32 and a nanosecond clock on the host. Tracepoints are called
+ * from interrupt handlers and from eMBPoll( ). Each claims a record of the
+ * ring without a lock and the oldest records are overwritten.
+ *
+ * The ring xMBTraceBuffer can be dumped from a debugger, e.g. with
+ * <tt>dump binary value trace.bin xMBTraceBuffer</tt> in GDB, or read with
+ * xMBTraceRead( ) and written to a file prefixed by an xMBTraceHeader
+ * with \c ulSize 0. The host tool mbtrace decodes both and prints the
+ * histograms of the time spent in each stage.
+ *
+ * Stages which are not reached are not recorded. The first byte of a reply
+ * and the last byte of a request are only traced with per byte transfers,
+ * with DMA the idle line event ends the request and MB_TRACE_TX_START is
+ * the start of the DMA transfer.
+ */
+
+/* ----------------------- Defines ------------------------------------------*/
+#define MB_TRACE_MAGIC          ( 0x4D425452UL )        /*!< "MBTR" */
+
+/* ----------------------- Type definitions ---------------------------------*/
+
+/*! \ingroup modbus_trace
+ * \brief Stages of a request in the order they are passed.
+ */
+typedef enum
+{
+    MB_TRACE_RX_BYTE,           /*!< Last byte of the request received. */
+    MB_TRACE_RX_END,            /*!< End of the frame by t3.5, idle line or length. */
+    MB_TRACE_RX_CRC,            /*!< CRC checked by eMBRTUReceive( ). */
+    MB_TRACE_DISPATCH,          /*!< Function handler called by eMBPoll( ). */
+    MB_TRACE_REG_CB,            /*!< Register callback called by the handler. */
+    MB_TRACE_TX_CRC,            /*!< CRC of the reply computed by eMBRTUSend( ). */
+    MB_TRACE_TX_START,          /*!< First byte of the reply handed to the UART. */
+    MB_TRACE_FRAME_SENT,        /*!< EV_FRAME_SENT handled by eMBPoll( ). */
+    MB_TRACE_STAGES
+} eMBTraceStage;
+
+/*! \ingroup modbus_trace
+ * \brief A record of the ring.
+ *
+ * \c usSeq holds the lower bits of the position the record was written
+ * at. A record whose \c usSeq does not match its position has been
+ * overwritten or is being written.
+ */
+typedef struct
+{
+    uint32_t        ulStamp;
+    uint16_t        usSeq;
+    uint8_t         ucStage;
+    uint8_t         ucReserved;
+} xMBTraceRecord;
+
+/*! \ingroup modbus_trace
+ * \brief Start of the ring, and of a trace file.
+ */
+typedef struct
+{
+    uint32_t        ulMagic;    /*!< MB_TRACE_MAGIC once initialized. */
+    uint32_t        ulHz;       /*!< Time stamps per second. */
+    uint32_t        ulSize;     /*!< Records of the ring, 0 in a file of records. */
+    volatile uint32_t ulHead;   /*!< Records written since vMBTraceInit( ). */
+} xMBTraceHeader;
+
+typedef struct
+{
+    xMBTraceHeader  xHeader;
+    xMBTraceRecord  xRecords[MB_TRACE_RING_SIZE];
+} xMBTraceRing;
+
+/* ----------------------- Function prototypes ------------------------------*/
+#if MB_TRACE_ENABLED > 0
+
+extern xMBTraceRing xMBTraceBuffer;
+
+/*! \ingroup modbus_trace
+ * \brief Starts the time stamp counter and clears the ring. Called by
+ *   eMBInit( ) and eMBInstInit( ).
+ */
+void            vMBTraceInit( void );
+
+/*! \ingroup modbus_trace
+ * \brief Records a stage with a time stamp taken earlier.
+ */
+void            vMBTraceAt( eMBTraceStage eStage, uint32_t ulStamp );
+
+/*! \ingroup modbus_trace
+ * \brief Reads the next record after \c *pulCursor.
+ *
+ * A cursor of 0 starts at the oldest record. If the writers have overtaken
+ * the cursor it skips to the oldest record still in the ring.
+ *
+ * \param pulCursor Position of the next record, advanced by the call.
+ * \param pxRecord The record.
+ * \return FALSE if there is no new record.
+ */
+BOOL            xMBTraceRead( ULONG * pulCursor, xMBTraceRecord * pxRecord );
+
+#define MB_TRACE( eStage )              vMBTraceAt( ( eStage ), MB_PORT_TRACE_STAMP(  ) )
+#define MB_TRACE_AT( eStage, ulStamp )  vMBTraceAt( ( eStage ), ( ulStamp ) )
+#define MB_TRACE_STAMP(  )              MB_PORT_TRACE_STAMP(  )
+
+#else
+
+#define MB_TRACE( eStage )              ( ( void )0 )
+#define MB_TRACE_AT( eStage, ulStamp )  ( ( void )0 )
+#define MB_TRACE_STAMP(  )              ( 0U )
+
+#endif
+
+#ifdef __cplusplus
+PR_END_EXTERN_C
+#endif
+#endif
@@ -22,6 +22,11 @@
 #ifndef _PORT_H
 #define _PORT_H
 
+#ifdef MB_PORT_POSIX
+/* Host build, see posix/port.h. */
+#include "posix/port.h"
+#else
+
 #include <assert.h>
 #include <stdbool.h>
 #include <string.h>
@@ -35,6 +40,22 @@
 #define ENTER_CRITICAL_SECTION() (__set_PRIMASK(1))
 #define EXIT_CRITICAL_SECTION() (__set_PRIMASK(0))
 
+/* Time stamp of posted events in milliseconds. */
+#define MB_PORT_GET_TICK()          HAL_GetTick()
+/* Orders the event queue accesses between interrupt handlers and eMBPoll(). */
+#define MB_PORT_MEMORY_BARRIER()    __DMB()
+/* Sleeps until an interrupt is pending, also with interrupts masked. */
+#define MB_PORT_WAIT_FOR_INTERRUPT() __WFI()
+/* Toggled for every valid RTU frame. */
+#define MB_PORT_FRAME_INDICATE()    HAL_GPIO_TogglePin(GPIOC, GPIO_PIN_13)
+/* Time stamps of the tracepoints in CPU cycles, see mbtrace.h. */
+#define MB_PORT_TRACE_INIT()        do { CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk; \
+                                         DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk; } while (0)
+#define MB_PORT_TRACE_STAMP()       (DWT->CYCCNT)
+#define MB_PORT_TRACE_HZ()          (SystemCoreClock)
+/* Claims a record of the trace ring, also from interrupt handlers. */
+#define MB_PORT_TRACE_CLAIM(pulHead) ulMBPortTraceClaim(pulHead)
+
 typedef unsigned char UCHAR;
 typedef char CHAR;
 
@@ -54,4 +75,69 @@ typedef _Bool BOOL;
 #define FALSE false
 #endif
 
+static inline ULONG ulMBPortTraceClaim(volatile uint32_t *pulHead)
+{
+  ULONG ulPos;
+
+  do {
+    ulPos = __LDREXW(pulHead);
+  } while (__STREXW(ulPos + 1U, pulHead) != 0U);
+  return ulPos;
+}
+
+/* RS-485 bus turnaround of a serial port with a driver enable pin. The
+ * turnaround is the time from the last received byte (or the idle line
+ * event with DMA reception) until the driver is enabled for the reply.
+ */
+typedef struct
+{
+    ULONG ulLastUs;         /* Turnaround of the last reply. */
+    ULONG ulMinUs;
+    ULONG ulMaxUs;
+    ULONG ulDriveUs;        /* Time the driver was enabled for the last reply. */
+    ULONG ulCount;          /* Number of replies. */
+} xMBPortTurnaround;
+
+BOOL xMBPortSerialGetTurnaround( UCHAR ucPort, xMBPortTurnaround *pxTurnaround );
+
+/* Modbus TCP server on the W5500, see porttcp.c. Connection n is served by
+ * socket n of the chip. The chip has 16 KB each for transmit and receive
+ * which are split among its 8 sockets in KB. Valid sizes are 0, 1, 2, 4, 8
+ * and 16.
+ */
+#define MB_TCP_PORT_CONNECTIONS             4
+#define MB_TCP_PORT_TX_BUF_KB               { 4, 4, 4, 4, 0, 0, 0, 0 }
+#define MB_TCP_PORT_RX_BUF_KB               { 4, 4, 4, 4, 0, 0, 0, 0 }
+/* Connections one client (IP address) may hold at a time. */
+#define MB_TCP_PORT_CONNECTIONS_PER_CLIENT  2
+/* Connections without a request for this time are closed, 0 to keep them. */
+#define MB_TCP_PORT_IDLE_TIMEOUT_MS         60000
+/* Pipelined requests of one connection handled per poll. */
+#define MB_TCP_PORT_REQUESTS_PER_POLL       8
+/* Service the sockets on events signalled by the INTn pin of the W5500
+ * instead of reading their registers on every poll. Off by default since
+ * the pin depends on the board: to enable it define the GPIO port and pin
+ * INTn is wired to, set the pin up as EXTI input, falling edge, with a
+ * pull-up, and call vMBTCPPortIRQHandler( ) from HAL_GPIO_EXTI_Callback( ).
+ * Without an event the PHY link is read every MB_TCP_PORT_LINK_CHECK_MS and
+ * all sockets every MB_TCP_PORT_INT_SCAN_MS.
+ */
+#ifndef MB_TCP_PORT_INT_ENABLED
+#define MB_TCP_PORT_INT_ENABLED             0
+#endif
+#if ( MB_TCP_PORT_INT_ENABLED > 0 ) && !defined( MB_TCP_PORT_INT_GPIO_PIN )
+#error "MB_TCP_PORT_INT_ENABLED needs MB_TCP_PORT_INT_GPIO_PORT and MB_TCP_PORT_INT_GPIO_PIN"
+#endif
+#define MB_TCP_PORT_LINK_CHECK_MS           500
+#define MB_TCP_PORT_INT_SCAN_MS             1000
+
+/* Interrupt handlers for the UARTs and timers of all protocol stack
+ * instances. See portserial.c and porttimer.c.
+ */
+void vMBPortSerialIRQHandler( UART_HandleTypeDef *huart );
+void vMBPortTimersIRQHandler( TIM_HandleTypeDef *htim );
+/* INTn of the W5500, see porttcp.c. */
+void vMBTCPPortIRQHandler( uint16_t u16GpioPin );
+
+#endif
 #endif
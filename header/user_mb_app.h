@@ -29,6 +29,9 @@
 /* InputRegister all address */
 #define INPUT_REG_START      1
 #define INPUT_REG_QTY     2048
+/* Gateway cache hits, misses, refreshes and invalidations, read only */
+#define GATEWAY_STATS_REG_START (INPUT_REG_START + INPUT_REG_QTY)
+#define GATEWAY_STATS_REG_QTY   8
 /* HoldingRegister all address */
 #define HOLDING_REG_START    1
 #define HOLDING_REG_QTY   2048
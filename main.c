@@ -120,7 +120,7 @@ int main(void)
 		controller.eSocketError = eControllerTCPStatePoll(&hW55001);
     vFSM_EventHandler(&sensor);
 		vBackGroundRefresh();
-    eMBPoll();
+    eMBPollWait(1); //sleep until the next interrupt, e.g. a Modbus event, the W5500 or the tick
 //    vModbusTCPServerPoll(&hW5500MBTCP);
     		
 		if(u8USBRxCplt)
@@ -0,0 +1,784 @@
+/* 
+ * FreeModbus Libary: A portable Modbus implementation for Modbus ASCII/RTU.
+ * Copyright (c) 2006-2018 Christian Walter <cwalter@embedded-solutions.at>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* ----------------------- System includes ----------------------------------*/
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "mb.h"
+#include "mbconfig.h"
+#include "mbport.h"
+#include "mbcrc.h"
+#include "mbtrace.h"
+
+/* ----------------------- Defines ------------------------------------------*/
+#define BENCH_TCP_PORT          15502
+#define BENCH_SLAVE_ADDRESS     1
+#define BENCH_ADDRESS_SPAN      64      /*!< Requests walk over this many start addresses. */
+#define BENCH_CONNECTIONS_MAX   16
+#define BENCH_DEPTH_MAX         16
+#define BENCH_ADU_MAX           260
+#define BENCH_RTU_TIMEOUT_MS    1000
+#define BENCH_RTU_GAP_MARGIN_US 250     /*!< Added to t3.5 for the scheduling of the slave. */
+#define BENCH_TRACE_CHUNK       64      /*!< Trace records written at once. */
+#define BENCH_SLAVE_SETTLE_MS   20      /*!< Polled before the load starts. */
+
+/* How the RTU slave was built, reported with the results. */
+#if ( MB_RTU_CRC_RUNNING_ENABLED > 0 ) && ( MB_RTU_DMA_RX_ENABLED == 0 )
+#define BENCH_RTU_CRC           "running"
+#else
+#define BENCH_RTU_CRC           "frame"
+#endif
+#if ( MB_RTU_LENGTH_PREDICT_ENABLED > 0 ) && ( MB_RTU_CRC_RUNNING_ENABLED > 0 ) && ( MB_RTU_DMA_RX_ENABLED == 0 )
+#define BENCH_RTU_PREDICT       "true"
+#else
+#define BENCH_RTU_PREDICT       "false"
+#endif
+
+/* ----------------------- Type definitions ---------------------------------*/
+typedef struct
+{
+    UCHAR           ucFunction;
+    unsigned        uWeight;
+} xBenchMix;
+
+/* Reported by the slave when it is stopped. */
+typedef struct
+{
+    uint64_t        ullAllocs;          /* Heap allocations while serving. */
+    uint64_t        ullCpuNs;           /* User and system time while serving. */
+} xBenchSlaveStats;
+
+typedef struct
+{
+    int             iFd;
+    UCHAR           aucRx[BENCH_DEPTH_MAX * BENCH_ADU_MAX];
+    size_t          xRxLength;
+    uint64_t        aullSent[BENCH_DEPTH_MAX];  /* Send times of the outstanding requests. */
+    int             iHead;
+    int             iOutstanding;
+} xBenchConnection;
+
+/* ----------------------- Static variables ---------------------------------*/
+static const UCHAR aucAllFunctions[] = { 1, 2, 3, 4, 5, 6, 15, 16, 23 };
+
+static xBenchMix xMix[sizeof( aucAllFunctions )];
+static unsigned uMixEntries;
+static unsigned uMixTotal;
+static USHORT   usQuantity = 10;
+static uint32_t ulSeed = 1;
+
+static volatile sig_atomic_t xSlaveStop;
+/* The slave sleeps in eMBInstPollWait( ) or spins on eMBInstPoll( ). */
+static BOOL     xSlaveBusy;
+
+/* Heap allocations are counted to confirm that serving does not allocate.
+ * glibc only. */
+static volatile uint64_t ullAllocs;
+extern void    *__libc_malloc( size_t xSize );
+extern void    *__libc_calloc( size_t xCount, size_t xSize );
+extern void    *__libc_realloc( void *pvMem, size_t xSize );
+
+void           *
+malloc( size_t xSize )
+{
+    ullAllocs++;
+    return __libc_malloc( xSize );
+}
+
+void           *
+calloc( size_t xCount, size_t xSize )
+{
+    ullAllocs++;
+    return __libc_calloc( xCount, xSize );
+}
+
+void           *
+realloc( void *pvMem, size_t xSize )
+{
+    ullAllocs++;
+    return __libc_realloc( pvMem, xSize );
+}
+
+/* ----------------------- Static functions ---------------------------------*/
+static          uint64_t
+prvullNow( void )
+{
+    struct timespec xNow;
+
+    ( void )clock_gettime( CLOCK_MONOTONIC, &xNow );
+    return ( uint64_t ) xNow.tv_sec * 1000000000U + ( uint64_t ) xNow.tv_nsec;
+}
+
+static          uint64_t
+prvullCpuNs( void )
+{
+    struct rusage   xUsage;
+
+    ( void )getrusage( RUSAGE_SELF, &xUsage );
+    return ( ( uint64_t ) xUsage.ru_utime.tv_sec + ( uint64_t ) xUsage.ru_stime.tv_sec ) * 1000000000U +
+        ( ( uint64_t ) xUsage.ru_utime.tv_usec + ( uint64_t ) xUsage.ru_stime.tv_usec ) * 1000U;
+}
+
+static          BOOL
+prvxParseMix( const char *pcMix )
+{
+    /* "all" or a list of function:weight, e.g. "3:70,16:20,1:10". */
+    const char     *pc = pcMix;
+    unsigned        uFunction;
+    unsigned        uWeight;
+    unsigned        i;
+    int             iUsed;
+
+    uMixEntries = 0;
+    uMixTotal = 0;
+    if( strcmp( pcMix, "all" ) == 0 )
+    {
+        for( i = 0; i < sizeof( aucAllFunctions ); i++ )
+        {
+            xMix[i].ucFunction = aucAllFunctions[i];
+            xMix[i].uWeight = 1;
+        }
+        uMixEntries = sizeof( aucAllFunctions );
+        uMixTotal = uMixEntries;
+        return TRUE;
+    }
+    while( *pc != '\0' )
+    {
+        if( ( sscanf( pc, "%u:%u%n", &uFunction, &uWeight, &iUsed ) != 2 ) ||
+            ( memchr( aucAllFunctions, ( int )uFunction, sizeof( aucAllFunctions ) ) == NULL ) ||
+            ( uMixEntries == sizeof( aucAllFunctions ) ) )
+        {
+            return FALSE;
+        }
+        xMix[uMixEntries].ucFunction = ( UCHAR )uFunction;
+        xMix[uMixEntries].uWeight = uWeight;
+        uMixEntries++;
+        uMixTotal += uWeight;
+        pc += iUsed;
+        if( *pc == ',' )
+        {
+            pc++;
+        }
+    }
+    return uMixTotal > 0;
+}
+
+static          UCHAR
+prvucNextFunction( void )
+{
+    /* Same sequence for every run, so that results can be compared. */
+    unsigned        uPick;
+    unsigned        i;
+
+    ulSeed = ulSeed * 1103515245U + 12345U;
+    uPick = ( ulSeed >> 8 ) % uMixTotal;
+    for( i = 0; uPick >= xMix[i].uWeight; i++ )
+    {
+        uPick -= xMix[i].uWeight;
+    }
+    return xMix[i].ucFunction;
+}
+
+static          USHORT
+prvusBuildPDU( UCHAR * pucPDU, UCHAR ucFunction, USHORT usAddress )
+{
+    USHORT          usLength = 0;
+    USHORT          usBytes;
+    USHORT          i;
+
+    pucPDU[usLength++] = ucFunction;
+    pucPDU[usLength++] = ( UCHAR )( usAddress >> 8 );
+    pucPDU[usLength++] = ( UCHAR )( usAddress & 0xFF );
+    switch ( ucFunction )
+    {
+    case 5:
+        pucPDU[usLength++] = 0xFF;
+        pucPDU[usLength++] = 0x00;
+        break;
+    case 6:
+        pucPDU[usLength++] = ( UCHAR )( usAddress >> 8 );
+        pucPDU[usLength++] = ( UCHAR )( usAddress & 0xFF );
+        break;
+    case 15:
+    case 16:
+        usBytes = ( ucFunction == 15 ) ? ( USHORT )( ( usQuantity + 7 ) / 8 ) : ( USHORT )( usQuantity * 2 );
+        pucPDU[usLength++] = ( UCHAR )( usQuantity >> 8 );
+        pucPDU[usLength++] = ( UCHAR )( usQuantity & 0xFF );
+        pucPDU[usLength++] = ( UCHAR )usBytes;
+        for( i = 0; i < usBytes; i++ )
+        {
+            pucPDU[usLength++] = ( UCHAR )i;
+        }
+        break;
+    case 23:
+        /* Reads and writes the same quantity. */
+        pucPDU[usLength++] = ( UCHAR )( usQuantity >> 8 );
+        pucPDU[usLength++] = ( UCHAR )( usQuantity & 0xFF );
+        pucPDU[usLength++] = ( UCHAR )( usAddress >> 8 );
+        pucPDU[usLength++] = ( UCHAR )( usAddress & 0xFF );
+        pucPDU[usLength++] = ( UCHAR )( usQuantity >> 8 );
+        pucPDU[usLength++] = ( UCHAR )( usQuantity & 0xFF );
+        pucPDU[usLength++] = ( UCHAR )( usQuantity * 2 );
+        for( i = 0; i < usQuantity * 2; i++ )
+        {
+            pucPDU[usLength++] = ( UCHAR )i;
+        }
+        break;
+    default:
+        /* Reads. */
+        pucPDU[usLength++] = ( UCHAR )( usQuantity >> 8 );
+        pucPDU[usLength++] = ( UCHAR )( usQuantity & 0xFF );
+        break;
+    }
+    return usLength;
+}
+
+static          USHORT
+prvusResponsePDULength( UCHAR ucFunction )
+{
+    switch ( ucFunction )
+    {
+    case 1:
+    case 2:
+        return ( USHORT )( 2 + ( usQuantity + 7 ) / 8 );
+    case 3:
+    case 4:
+    case 23:
+        return ( USHORT )( 2 + usQuantity * 2 );
+    default:
+        return 5;
+    }
+}
+
+static          USHORT
+prvusNextTCPRequest( UCHAR * pucADU, USHORT usTid, unsigned long ulIndex )
+{
+    USHORT          usPDULength = prvusBuildPDU( &pucADU[7], prvucNextFunction(  ),
+                                                 ( USHORT )( ulIndex % BENCH_ADDRESS_SPAN ) );
+
+    pucADU[0] = ( UCHAR )( usTid >> 8 );
+    pucADU[1] = ( UCHAR )( usTid & 0xFF );
+    pucADU[2] = 0;
+    pucADU[3] = 0;
+    pucADU[4] = ( UCHAR )( ( usPDULength + 1 ) >> 8 );
+    pucADU[5] = ( UCHAR )( ( usPDULength + 1 ) & 0xFF );
+    pucADU[6] = BENCH_SLAVE_ADDRESS;
+    return ( USHORT )( 7 + usPDULength );
+}
+
+/* ----------------------- Slave --------------------------------------------*/
+static void
+prvvSlaveStop( int iSignal )
+{
+    ( void )iSignal;
+    xSlaveStop = 1;
+}
+
+#if MB_TRACE_ENABLED > 0
+static void
+prvvSlaveTrace( int iTraceFd, ULONG * pulCursor )
+{
+    xMBTraceRecord  xRecords[BENCH_TRACE_CHUNK];
+    size_t          xCount;
+
+    /* Drained after every poll. Records overwritten in between are lost. */
+    do
+    {
+        for( xCount = 0; ( xCount < BENCH_TRACE_CHUNK ) && xMBTraceRead( pulCursor, &xRecords[xCount] ); xCount++ )
+        {
+        }
+        ( void )write( iTraceFd, xRecords, xCount * sizeof( xMBTraceRecord ) );
+    }
+    while( xCount == BENCH_TRACE_CHUNK );
+}
+#endif
+
+static void
+prvvSlave( BOOL xRTU, const char *pcDevice, ULONG ulBaudRate, int iReportFd, int iTraceFd )
+{
+    xMBInstance    *pxInst = NULL;
+    xBenchSlaveStats xStats;
+    uint64_t        ullAllocsStart;
+    uint64_t        ullCpuStart;
+    UCHAR           ucReady = 1;
+    uint64_t        ullSettled;
+#if MB_TRACE_ENABLED > 0
+    xMBTraceHeader  xTraceHeader;
+    ULONG           ulTraceCursor;
+#else
+    ( void )iTraceFd;
+#endif
+
+    ( void )signal( SIGTERM, prvvSlaveStop );
+    if( xRTU )
+    {
+        ( void )xMBPortSerialSetDevice( 1, pcDevice );
+        if( ( eMBInit( MB_RTU, BENCH_SLAVE_ADDRESS, 1, ulBaudRate, MB_PAR_EVEN ) != MB_ENOERR ) ||
+            ( eMBEnable(  ) != MB_ENOERR ) )
+        {
+            _exit( EXIT_FAILURE );
+        }
+        pxInst = pxMBGetDefaultInstance(  );
+    }
+#if MB_TCP_ENABLED > 0
+    else if( ( eMBInstTCPInit( &pxInst, BENCH_TCP_PORT ) != MB_ENOERR ) || ( eMBInstEnable( pxInst ) != MB_ENOERR ) )
+    {
+        _exit( EXIT_FAILURE );
+    }
+#else
+    else
+    {
+        /* Rejected by main( ). */
+        _exit( EXIT_FAILURE );
+    }
+#endif
+    /* The RTU receiver takes frames once the line was silent for t3.5. */
+    ullSettled = prvullNow(  ) + BENCH_SLAVE_SETTLE_MS * 1000000U;
+    while( prvullNow(  ) < ullSettled )
+    {
+        ( void )eMBInstPollWait( pxInst, 1 );
+    }
+#if MB_TRACE_ENABLED > 0
+    if( iTraceFd >= 0 )
+    {
+        /* A file of records follows the header. */
+        xTraceHeader = xMBTraceBuffer.xHeader;
+        xTraceHeader.ulSize = 0;
+        xTraceHeader.ulHead = 0;
+        ( void )write( iTraceFd, &xTraceHeader, sizeof( xTraceHeader ) );
+    }
+    ulTraceCursor = xMBTraceBuffer.xHeader.ulHead;
+#endif
+
+    ullAllocsStart = ullAllocs;
+    ullCpuStart = prvullCpuNs(  );
+    ( void )write( iReportFd, &ucReady, 1 );
+    while( !xSlaveStop )
+    {
+        if( xSlaveBusy )
+        {
+            /* Like the super-loop before eMBPollWait( ): the descriptors
+             * are checked without blocking. */
+            vMBPortPosixWait( 0 );
+            ( void )eMBInstPoll( pxInst );
+        }
+        else
+        {
+            ( void )eMBInstPollWait( pxInst, 1 );
+        }
+#if MB_TRACE_ENABLED > 0
+        if( iTraceFd >= 0 )
+        {
+            prvvSlaveTrace( iTraceFd, &ulTraceCursor );
+        }
+#endif
+    }
+    xStats.ullAllocs = ullAllocs - ullAllocsStart;
+    xStats.ullCpuNs = prvullCpuNs(  ) - ullCpuStart;
+    ( void )write( iReportFd, &xStats, sizeof( xStats ) );
+    _exit( EXIT_SUCCESS );
+}
+
+/* ----------------------- Load ---------------------------------------------*/
+static          BOOL
+prvxRunTCP( uint64_t * pullLatency, unsigned long ulRequests, int iConnections, int iDepth,
+            unsigned long *pulErrors )
+{
+    xBenchConnection xConns[BENCH_CONNECTIONS_MAX];
+    struct pollfd   xPoll[BENCH_CONNECTIONS_MAX];
+    struct sockaddr_in xAddr;
+    UCHAR           aucADU[BENCH_ADU_MAX];
+    unsigned long   ulSent = 0;
+    unsigned long   ulDone = 0;
+    size_t          xADULength;
+    ssize_t         iRead;
+    USHORT          usLength;
+    int             iOne = 1;
+    int             i;
+
+    memset( &xAddr, 0, sizeof( xAddr ) );
+    xAddr.sin_family = AF_INET;
+    xAddr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+    xAddr.sin_port = htons( BENCH_TCP_PORT );
+    for( i = 0; i < iConnections; i++ )
+    {
+        xConns[i].iFd = socket( AF_INET, SOCK_STREAM, 0 );
+        if( ( xConns[i].iFd < 0 ) || ( connect( xConns[i].iFd, ( struct sockaddr * )&xAddr, sizeof( xAddr ) ) != 0 ) )
+        {
+            return FALSE;
+        }
+        ( void )setsockopt( xConns[i].iFd, IPPROTO_TCP, TCP_NODELAY, &iOne, sizeof( iOne ) );
+        xConns[i].xRxLength = 0;
+        xConns[i].iHead = 0;
+        xConns[i].iOutstanding = 0;
+        xPoll[i].fd = xConns[i].iFd;
+        xPoll[i].events = POLLIN;
+    }
+
+    while( ulDone < ulRequests )
+    {
+        /* Closed loop: every connection keeps iDepth requests in flight. */
+        for( i = 0; i < iConnections; i++ )
+        {
+            while( ( xConns[i].iOutstanding < iDepth ) && ( ulSent < ulRequests ) )
+            {
+                usLength = prvusNextTCPRequest( aucADU, ( USHORT )ulSent, ulSent );
+                xConns[i].aullSent[( xConns[i].iHead + xConns[i].iOutstanding ) % BENCH_DEPTH_MAX] = prvullNow(  );
+                if( write( xConns[i].iFd, aucADU, usLength ) != usLength )
+                {
+                    return FALSE;
+                }
+                xConns[i].iOutstanding++;
+                ulSent++;
+            }
+        }
+        if( poll( xPoll, ( nfds_t ) iConnections, BENCH_RTU_TIMEOUT_MS ) <= 0 )
+        {
+            return FALSE;
+        }
+        for( i = 0; i < iConnections; i++ )
+        {
+            if( !( xPoll[i].revents & POLLIN ) )
+            {
+                continue;
+            }
+            iRead = read( xConns[i].iFd, &xConns[i].aucRx[xConns[i].xRxLength],
+                          sizeof( xConns[i].aucRx ) - xConns[i].xRxLength );
+            if( iRead <= 0 )
+            {
+                return FALSE;
+            }
+            xConns[i].xRxLength += ( size_t ) iRead;
+            /* Responses of one connection arrive in order. */
+            while( ( xConns[i].xRxLength >= 7 ) &&
+                   ( xConns[i].xRxLength >= ( xADULength = 6 + ( ( size_t ) xConns[i].aucRx[4] << 8 | xConns[i].aucRx[5] ) ) ) )
+            {
+                pullLatency[ulDone++] = prvullNow(  ) - xConns[i].aullSent[xConns[i].iHead];
+                if( xConns[i].aucRx[7] & 0x80 )
+                {
+                    ( *pulErrors )++;
+                }
+                xConns[i].iHead = ( xConns[i].iHead + 1 ) % BENCH_DEPTH_MAX;
+                xConns[i].iOutstanding--;
+                memmove( xConns[i].aucRx, &xConns[i].aucRx[xADULength], xConns[i].xRxLength - xADULength );
+                xConns[i].xRxLength -= xADULength;
+            }
+        }
+    }
+    for( i = 0; i < iConnections; i++ )
+    {
+        ( void )close( xConns[i].iFd );
+    }
+    return TRUE;
+}
+
+static          BOOL
+prvxRunRTU( int iFd, ULONG ulBaudRate, uint64_t * pullLatency, unsigned long ulRequests,
+            unsigned long *pulErrors )
+{
+    struct pollfd   xPoll = { iFd, POLLIN, 0 };
+    UCHAR           aucFrame[BENCH_ADU_MAX];
+    UCHAR           aucRx[BENCH_ADU_MAX];
+    unsigned long   ulDone;
+    uint64_t        ullStart;
+    size_t          xRxLength;
+    size_t          xExpected;
+    ssize_t         iRead;
+    USHORT          usLength;
+    USHORT          usCRC;
+    uint64_t        ullGapNs;
+    uint64_t        ullIdle = 0;
+    struct timespec xIdle;
+
+    /* The slave ignores a frame that starts within t3.5 of its response,
+     * so the next request waits for the silent interval, as on the bus. */
+    ullGapNs = ( ulBaudRate > 19200 ) ? 1750000U : 35U * 11U * 100000000U / ulBaudRate;
+    ullGapNs += BENCH_RTU_GAP_MARGIN_US * 1000U;
+    for( ulDone = 0; ulDone < ulRequests; ulDone++ )
+    {
+        aucFrame[0] = BENCH_SLAVE_ADDRESS;
+        usLength = ( USHORT )( 1 + prvusBuildPDU( &aucFrame[1], prvucNextFunction(  ),
+                                                   ( USHORT )( ulDone % BENCH_ADDRESS_SPAN ) ) );
+        usCRC = usMBCRC16( aucFrame, usLength );
+        aucFrame[usLength++] = ( UCHAR )( usCRC & 0xFF );
+        aucFrame[usLength++] = ( UCHAR )( usCRC >> 8 );
+        xExpected = 1 + prvusResponsePDULength( aucFrame[1] ) + 2;
+
+        if( ullIdle != 0 )
+        {
+            xIdle.tv_sec = ( time_t )( ullIdle / 1000000000U );
+            xIdle.tv_nsec = ( long )( ullIdle % 1000000000U );
+            while( clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &xIdle, NULL ) == EINTR )
+            {
+            }
+        }
+        ullStart = prvullNow(  );
+        if( write( iFd, aucFrame, usLength ) != usLength )
+        {
+            return FALSE;
+        }
+        /* Half duplex: one request at a time. An exception is 5 bytes. */
+        xRxLength = 0;
+        while( ( xRxLength < xExpected ) && !( ( xRxLength >= 5 ) && ( aucRx[1] & 0x80 ) ) )
+        {
+            if( poll( &xPoll, 1, BENCH_RTU_TIMEOUT_MS ) <= 0 )
+            {
+                return FALSE;
+            }
+            iRead = read( iFd, &aucRx[xRxLength], sizeof( aucRx ) - xRxLength );
+            if( iRead <= 0 )
+            {
+                return FALSE;
+            }
+            xRxLength += ( size_t ) iRead;
+        }
+        ullIdle = prvullNow(  );
+        pullLatency[ulDone] = ullIdle - ullStart;
+        ullIdle += ullGapNs;
+        if( ( aucRx[1] & 0x80 ) || ( usMBCRC16( aucRx, ( USHORT )xRxLength ) != 0 ) )
+        {
+            ( *pulErrors )++;
+        }
+    }
+    return TRUE;
+}
+
+static int
+prviCompare( const void *pvA, const void *pvB )
+{
+    uint64_t        ullA = *( const uint64_t * )pvA;
+    uint64_t        ullB = *( const uint64_t * )pvB;
+
+    return ( ullA > ullB ) - ( ullA < ullB );
+}
+
+static double
+prvdPercentileUs( const uint64_t * pullSorted, unsigned long ulCount, double dPercent )
+{
+    unsigned long   ulIndex = ( unsigned long )( dPercent / 100.0 * ( double )( ulCount - 1 ) + 0.5 );
+
+    return ( double )pullSorted[ulIndex] / 1000.0;
+}
+
+/* ----------------------- Start implementation -----------------------------*/
+/* Drives a slave on the host with a mix of requests and prints one line of
+ * JSON per run: requests per second, latency percentiles from request to
+ * response, CPU time of the slave per request and the heap allocations of
+ * the slave while serving, which must be 0. The slave runs in a child
+ * process with the POSIX port, on loopback TCP or on a pseudo terminal.
+ * With -p busy the slave spins on eMBInstPoll( ) instead of sleeping in
+ * eMBInstPollWait( ), to compare CPU time and latency of both loops. The
+ * RTU results name where the CRC of a request is computed and if its end
+ * is predicted, see MB_RTU_CRC_RUNNING_ENABLED.
+ * Built with MB_TRACE_ENABLED, -T writes the tracepoints of the slave to a
+ * file for mbtrace.
+ */
+int
+main( int argc, char *argv[] )
+{
+    const char     *pcMix = "all";
+    const char     *pcTransport = "tcp";
+    const char     *pcPoll = "wait";
+    unsigned long   ulRequests = 100000;
+    unsigned long   ulWarmup;
+    unsigned long   ulErrors = 0;
+    ULONG           ulBaudRate = 115200;
+    int             iConnections = 1;
+    int             iDepth = 1;
+    int             aiReport[2];
+    int             iMaster = -1;
+    int             iTraceFd = -1;
+    BOOL            xRTU;
+    BOOL            xOk;
+    xBenchSlaveStats xStats = { 0, 0 };
+    uint64_t       *pullLatency;
+    uint64_t        ullStart;
+    uint64_t        ullElapsed;
+    struct termios  xTios;
+    UCHAR           ucReady;
+    pid_t           xSlave;
+    int             iOpt;
+
+    while( ( iOpt = getopt( argc, argv, "t:m:n:c:d:q:b:p:T:" ) ) != -1 )
+    {
+        switch ( iOpt )
+        {
+        case 't':
+            pcTransport = optarg;
+            break;
+        case 'm':
+            pcMix = optarg;
+            break;
+        case 'n':
+            ulRequests = strtoul( optarg, NULL, 10 );
+            break;
+        case 'c':
+            iConnections = atoi( optarg );
+            break;
+        case 'd':
+            iDepth = atoi( optarg );
+            break;
+        case 'q':
+            usQuantity = ( USHORT )atoi( optarg );
+            break;
+        case 'b':
+            ulBaudRate = ( ULONG )atol( optarg );
+            break;
+        case 'p':
+            pcPoll = optarg;
+            break;
+        case 'T':
+#if MB_TRACE_ENABLED > 0
+            iTraceFd = open( optarg, O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+            if( iTraceFd < 0 )
+            {
+                perror( optarg );
+                return EXIT_FAILURE;
+            }
+            break;
+#else
+            fprintf( stderr, "%s: built without MB_TRACE_ENABLED\n", argv[0] );
+            return EXIT_FAILURE;
+#endif
+        default:
+            fprintf( stderr, "usage: %s [-t tcp|rtu] [-m all|fc:weight,...] [-n requests] "
+                     "[-c connections] [-d depth] [-q quantity] [-b baudrate] [-p wait|busy] "
+                     "[-T trace.bin]\n", argv[0] );
+            return EXIT_FAILURE;
+        }
+    }
+    xRTU = ( strcmp( pcTransport, "rtu" ) == 0 );
+#if MB_TCP_ENABLED == 0
+    if( !xRTU )
+    {
+        fprintf( stderr, "%s: built without Modbus TCP, use -t rtu\n", argv[0] );
+        return EXIT_FAILURE;
+    }
+#endif
+    xSlaveBusy = ( strcmp( pcPoll, "busy" ) == 0 );
+    if( ( !xRTU && ( strcmp( pcTransport, "tcp" ) != 0 ) ) || ( !xSlaveBusy && ( strcmp( pcPoll, "wait" ) != 0 ) ) ||
+        !prvxParseMix( pcMix ) || ( ulRequests == 0 ) ||
+        ( iConnections < 1 ) || ( iConnections > BENCH_CONNECTIONS_MAX ) || ( iDepth < 1 ) ||
+        ( iDepth > BENCH_DEPTH_MAX ) || ( usQuantity < 1 ) || ( usQuantity > 121 ) )
+    {
+        fprintf( stderr, "%s: invalid arguments\n", argv[0] );
+        return EXIT_FAILURE;
+    }
+    /* A tenth of the requests, before the measurement, warms up caches and
+     * the connections. */
+    ulWarmup = ulRequests / 10;
+    pullLatency = malloc( sizeof( uint64_t ) * ( ulRequests + ulWarmup ) );
+
+    if( xRTU )
+    {
+        iMaster = posix_openpt( O_RDWR | O_NOCTTY );
+        if( ( iMaster < 0 ) || ( grantpt( iMaster ) != 0 ) || ( unlockpt( iMaster ) != 0 ) ||
+            ( tcgetattr( iMaster, &xTios ) != 0 ) )
+        {
+            fprintf( stderr, "%s: no pseudo terminal\n", argv[0] );
+            return EXIT_FAILURE;
+        }
+        cfmakeraw( &xTios );
+        ( void )tcsetattr( iMaster, TCSANOW, &xTios );
+    }
+    if( pipe( aiReport ) != 0 )
+    {
+        return EXIT_FAILURE;
+    }
+    xSlave = fork(  );
+    if( xSlave == 0 )
+    {
+        ( void )close( aiReport[0] );
+        prvvSlave( xRTU, xRTU ? ptsname( iMaster ) : NULL, ulBaudRate, aiReport[1], iTraceFd );
+    }
+    ( void )close( aiReport[1] );
+    if( ( xSlave < 0 ) || ( read( aiReport[0], &ucReady, 1 ) != 1 ) )
+    {
+        fprintf( stderr, "%s: slave did not start\n", argv[0] );
+        return EXIT_FAILURE;
+    }
+
+    ullStart = 0;
+    if( xRTU )
+    {
+        xOk = prvxRunRTU( iMaster, ulBaudRate, pullLatency, ulWarmup, &ulErrors );
+        ullStart = prvullNow(  );
+        xOk = xOk && prvxRunRTU( iMaster, ulBaudRate, pullLatency, ulRequests, &ulErrors );
+    }
+    else
+    {
+        xOk = prvxRunTCP( pullLatency, ulWarmup, iConnections, iDepth, &ulErrors );
+        ullStart = prvullNow(  );
+        xOk = xOk && prvxRunTCP( pullLatency, ulRequests, iConnections, iDepth, &ulErrors );
+    }
+    ullElapsed = prvullNow(  ) - ullStart;
+
+    ( void )kill( xSlave, SIGTERM );
+    if( read( aiReport[0], &xStats, sizeof( xStats ) ) != sizeof( xStats ) )
+    {
+        xOk = FALSE;
+    }
+    ( void )waitpid( xSlave, NULL, 0 );
+    if( !xOk )
+    {
+        fprintf( stderr, "%s: slave did not answer\n", argv[0] );
+        return EXIT_FAILURE;
+    }
+
+    /* The slave statistics include the warmup. */
+    qsort( pullLatency, ulRequests, sizeof( uint64_t ), prviCompare );
+    printf( "{\"transport\":\"%s\",\"poll\":\"%s\",\"rtu_crc\":\"%s\",\"rtu_predict\":%s,\"mix\":\"%s\",\"quantity\":%u,\"connections\":%d,\"depth\":%d,"
+            "\"requests\":%lu,\"errors\":%lu,\"seconds\":%.6f,\"requests_per_s\":%.1f,"
+            "\"p50_us\":%.1f,\"p99_us\":%.1f,\"p999_us\":%.1f,\"max_us\":%.1f,"
+            "\"slave_cpu_us_per_request\":%.3f,\"slave_allocs\":%llu}\n",
+            pcTransport, pcPoll, BENCH_RTU_CRC, BENCH_RTU_PREDICT, pcMix, usQuantity, xRTU ? 1 : iConnections, xRTU ? 1 : iDepth,
+            ulRequests, ulErrors, ( double )ullElapsed / 1e9, ( double )ulRequests * 1e9 / ( double )ullElapsed,
+            prvdPercentileUs( pullLatency, ulRequests, 50.0 ), prvdPercentileUs( pullLatency, ulRequests, 99.0 ),
+            prvdPercentileUs( pullLatency, ulRequests, 99.9 ), ( double )pullLatency[ulRequests - 1] / 1000.0,
+            ( double )xStats.ullCpuNs / 1000.0 / ( double )( ulRequests + ulWarmup ),
+            ( unsigned long long )xStats.ullAllocs );
+    free( pullLatency );
+    return ( ulErrors == 0 ) && ( xStats.ullAllocs == 0 ) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
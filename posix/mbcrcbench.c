@@ -0,0 +1,123 @@
+/* 
+ * FreeModbus Libary: A portable Modbus implementation for Modbus ASCII/RTU.
+ * Copyright (c) 2006-2018 Christian Walter <cwalter@embedded-solutions.at>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* ----------------------- System includes ----------------------------------*/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <x86intrin.h>
+#endif
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "port.h"
+#include "mbconfig.h"
+#include "mbcrc.h"
+
+/* ----------------------- Defines ------------------------------------------*/
+#define CRCBENCH_FRAME_SIZE     256     /*!< Largest RTU frame. */
+#define CRCBENCH_ROUNDS         200000
+
+#if MB_CRC_BACKEND == MB_CRC_BACKEND_TABLE
+#define CRCBENCH_BACKEND        "table"
+#elif MB_CRC_BACKEND == MB_CRC_BACKEND_SLICE4
+#define CRCBENCH_BACKEND        "slice4"
+#elif MB_CRC_BACKEND == MB_CRC_BACKEND_SLICE8
+#define CRCBENCH_BACKEND        "slice8"
+#else
+#define CRCBENCH_BACKEND        "nibble"
+#endif
+
+/* ----------------------- Static variables ---------------------------------*/
+static UCHAR    aucFrame[CRCBENCH_FRAME_SIZE];
+
+/* ----------------------- Static functions ---------------------------------*/
+static          uint64_t
+prvullNow( void )
+{
+    struct timespec xNow;
+
+    ( void )clock_gettime( CLOCK_MONOTONIC, &xNow );
+    return ( uint64_t ) xNow.tv_sec * 1000000000U + ( uint64_t ) xNow.tv_nsec;
+}
+
+static          uint64_t
+prvullCycles( void )
+{
+#if defined( __x86_64__ ) || defined( __i386__ )
+    return __rdtsc(  );
+#else
+    return 0;
+#endif
+}
+
+/* ----------------------- Start implementation -----------------------------*/
+/* Throughput of the CRC-16 backend selected by MB_CRC_BACKEND over frames
+ * of the largest RTU size. Prints one line of JSON. Cycles are counted
+ * with the time stamp counter on x86 and reported as 0 elsewhere.
+ */
+int
+main( int argc, char *argv[] )
+{
+    unsigned long   ulRounds = ( argc > 1 ) ? strtoul( argv[1], NULL, 10 ) : CRCBENCH_ROUNDS;
+    volatile USHORT usSink = 0;
+    uint64_t        ullStart;
+    uint64_t        ullCycles;
+    uint64_t        ullElapsed;
+    double          dBytes;
+    unsigned long   i;
+
+    for( i = 0; i < sizeof( aucFrame ); i++ )
+    {
+        aucFrame[i] = ( UCHAR )( i * 7 + 1 );
+    }
+    /* Warm up the tables. */
+    for( i = 0; i < 1000; i++ )
+    {
+        usSink ^= usMBCRC16( aucFrame, sizeof( aucFrame ) );
+    }
+
+    ullStart = prvullNow(  );
+    ullCycles = prvullCycles(  );
+    for( i = 0; i < ulRounds; i++ )
+    {
+        /* The result feeds the next round, so no call can be dropped. */
+        aucFrame[0] = ( UCHAR )usSink;
+        usSink = usMBCRC16( aucFrame, sizeof( aucFrame ) );
+    }
+    ullCycles = prvullCycles(  ) - ullCycles;
+    ullElapsed = prvullNow(  ) - ullStart;
+
+    dBytes = ( double )ulRounds * ( double )sizeof( aucFrame );
+    printf( "{\"crc_backend\":\"%s\",\"frame_bytes\":%u,\"rounds\":%lu,\"bytes_per_ns\":%.3f,"
+            "\"bytes_per_cycle\":%.3f}\n", CRCBENCH_BACKEND, ( unsigned )sizeof( aucFrame ), ulRounds,
+            dBytes / ( double )ullElapsed, ullCycles != 0 ? dBytes / ( double )ullCycles : 0.0 );
+    return EXIT_SUCCESS;
+}
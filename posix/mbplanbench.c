@@ -0,0 +1,114 @@
+/* 
+ * FreeModbus Libary: A portable Modbus implementation for Modbus ASCII/RTU.
+ * Copyright (c) 2006-2018 Christian Walter <cwalter@embedded-solutions.at>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* ----------------------- System includes ----------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "port.h"
+#include "mb.h"
+#include "mbplan.h"
+
+/* ----------------------- Defines ------------------------------------------*/
+#define PLANBENCH_TAGS_MAX      128
+#define PLANBENCH_BLOCKS_MAX    32
+#define PLANBENCH_BAUDRATE      19200
+#define PLANBENCH_GAP           8
+#define PLANBENCH_CHAR_BITS     11      /*!< Start, 8 data, parity and stop bit. */
+
+/* ----------------------- Static variables ---------------------------------*/
+static xMBTag   xTags[PLANBENCH_TAGS_MAX];
+static USHORT   usTags;
+static xMBPlanBlock xBlocks[PLANBENCH_BLOCKS_MAX];
+static xMBPlan  xPlan;
+
+/* ----------------------- Static functions ---------------------------------*/
+static void
+prvvAddTags( UCHAR ucSlaveAddress, eMBTagTable eTable, USHORT usAddress, USHORT usStep, USHORT usCount,
+             eMBTagType eType, USHORT usPeriodMs )
+{
+    for( ; ( usCount > 0 ) && ( usTags < PLANBENCH_TAGS_MAX ); usCount-- )
+    {
+        xTags[usTags].ucSlaveAddress = ucSlaveAddress;
+        xTags[usTags].eTable = eTable;
+        xTags[usTags].usAddress = usAddress;
+        xTags[usTags].eType = eType;
+        xTags[usTags].usPeriodMs = usPeriodMs;
+        usTags++;
+        usAddress += usStep;
+    }
+}
+
+/* ----------------------- Start implementation -----------------------------*/
+/* Bus load of the polling plan of mbplan.c for the tags of a small plant,
+ * read one request per tag and read in the merged blocks of the plan.
+ * Prints one line of JSON. The load is the share of the bus time at the
+ * baudrate with each tag or block read at its period, above 1 the bus can
+ * not keep up.
+ *
+ * usage: mbplanbench [baudrate [gap]]
+ */
+int
+main( int argc, char *argv[] )
+{
+    ULONG           ulBaudRate = ( argc > 1 ) ? strtoul( argv[1], NULL, 10 ) : PLANBENCH_BAUDRATE;
+    USHORT          usGap = ( USHORT )( ( argc > 2 ) ? strtoul( argv[2], NULL, 10 ) : PLANBENCH_GAP );
+    xMBPlanCost     xCost;
+
+    /* A drive: setpoints and states, counters, control bits. */
+    prvvAddTags( 1, MB_TAG_HOLDING, 0, 1, 10, MB_TAG_REG16, 100 );
+    prvvAddTags( 1, MB_TAG_HOLDING, 20, 2, 10, MB_TAG_REG16, 100 );
+    prvvAddTags( 1, MB_TAG_HOLDING, 100, 2, 4, MB_TAG_REG32, 1000 );
+    prvvAddTags( 1, MB_TAG_COIL, 0, 1, 16, MB_TAG_BIT, 200 );
+    /* An I/O module: analog and digital inputs. */
+    prvvAddTags( 2, MB_TAG_INPUT, 0, 1, 4, MB_TAG_REG16, 250 );
+    prvvAddTags( 2, MB_TAG_INPUT, 10, 1, 2, MB_TAG_REG16, 250 );
+    prvvAddTags( 2, MB_TAG_INPUT, 50, 1, 2, MB_TAG_REG16, 250 );
+    prvvAddTags( 2, MB_TAG_DISCRETE, 0, 1, 8, MB_TAG_BIT, 500 );
+    /* An energy meter. */
+    prvvAddTags( 3, MB_TAG_HOLDING, 200, 2, 3, MB_TAG_REG32_SWAPPED, 1000 );
+    prvvAddTags( 3, MB_TAG_HOLDING, 300, 1, 1, MB_TAG_REG16, 1000 );
+
+    if( ( ulBaudRate == 0 ) || ( eMBPlanInit( &xPlan, NULL, xTags, usTags, xBlocks, PLANBENCH_BLOCKS_MAX, usGap ) != MB_ENOERR ) )
+    {
+        fprintf( stderr, "%s: invalid arguments\n", argv[0] );
+        return EXIT_FAILURE;
+    }
+    vMBPlanGetCost( &xPlan, &xCost );
+    printf( "{\"plan_tags\":%u,\"gap\":%u,\"baudrate\":%lu,"
+            "\"requests_per_tag\":%lu,\"chars_per_tag\":%lu,\"load_per_tag\":%.3f,"
+            "\"requests_merged\":%lu,\"chars_merged\":%lu,\"load_merged\":%.3f}\n",
+            ( unsigned )usTags, ( unsigned )usGap, ( unsigned long )ulBaudRate,
+            ( unsigned long )xCost.ulRequestsPerTag, ( unsigned long )xCost.ulCharsPerTag,
+            ( double )xCost.ulCharsPerSecPerTag * PLANBENCH_CHAR_BITS / ( double )ulBaudRate,
+            ( unsigned long )xCost.ulRequestsMerged, ( unsigned long )xCost.ulCharsMerged,
+            ( double )xCost.ulCharsPerSecMerged * PLANBENCH_CHAR_BITS / ( double )ulBaudRate );
+    return EXIT_SUCCESS;
+}
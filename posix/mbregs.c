@@ -0,0 +1,146 @@
+/* 
+ * FreeModbus Libary: A portable Modbus implementation for Modbus ASCII/RTU.
+ * Copyright (c) 2006-2018 Christian Walter <cwalter@embedded-solutions.at>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "mb.h"
+#include "mbutils.h"
+
+/* ----------------------- Defines ------------------------------------------*/
+#define REG_INPUT_START     1
+#define REG_INPUT_NREGS     2048
+#define REG_HOLDING_START   1
+#define REG_HOLDING_NREGS   2048
+#define REG_COILS_START     1
+#define REG_COILS_SIZE      2048
+#define REG_DISCRETE_START  1
+#define REG_DISCRETE_SIZE   2048
+
+/* ----------------------- Static variables ---------------------------------*/
+static USHORT   usRegHoldingBuf[REG_HOLDING_NREGS];
+static UCHAR    ucRegCoilsBuf[REG_COILS_SIZE / 8];
+static UCHAR    ucRegDiscreteBuf[REG_DISCRETE_SIZE / 8];
+
+/* ----------------------- Start implementation -----------------------------*/
+/* Registers of the slaves on the host, mbserver and mbbench. The input
+ * registers hold their own address.
+ */
+eMBErrorCode
+eMBRegInputCB( UCHAR * pucRegBuffer, USHORT usAddress, USHORT usNRegs )
+{
+    int             iRegIndex;
+
+    if( ( usAddress < REG_INPUT_START ) || ( usAddress + usNRegs > REG_INPUT_START + REG_INPUT_NREGS ) )
+    {
+        return MB_ENOREG;
+    }
+    iRegIndex = ( int )( usAddress - REG_INPUT_START );
+    while( usNRegs-- > 0 )
+    {
+        *pucRegBuffer++ = ( UCHAR )( iRegIndex >> 8 );
+        *pucRegBuffer++ = ( UCHAR )( iRegIndex & 0xFF );
+        iRegIndex++;
+    }
+    return MB_ENOERR;
+}
+
+eMBErrorCode
+eMBRegHoldingCB( UCHAR * pucRegBuffer, USHORT usAddress, USHORT usNRegs, eMBRegisterMode eMode )
+{
+    int             iRegIndex;
+
+    if( ( usAddress < REG_HOLDING_START ) || ( usAddress + usNRegs > REG_HOLDING_START + REG_HOLDING_NREGS ) )
+    {
+        return MB_ENOREG;
+    }
+    iRegIndex = ( int )( usAddress - REG_HOLDING_START );
+    while( usNRegs-- > 0 )
+    {
+        if( eMode == MB_REG_READ )
+        {
+            *pucRegBuffer++ = ( UCHAR )( usRegHoldingBuf[iRegIndex] >> 8 );
+            *pucRegBuffer++ = ( UCHAR )( usRegHoldingBuf[iRegIndex] & 0xFF );
+        }
+        else
+        {
+            usRegHoldingBuf[iRegIndex] = ( USHORT )( pucRegBuffer[0] << 8 | pucRegBuffer[1] );
+            pucRegBuffer += 2;
+        }
+        iRegIndex++;
+    }
+    return MB_ENOERR;
+}
+
+eMBErrorCode
+eMBRegCoilsCB( UCHAR * pucRegBuffer, USHORT usAddress, USHORT usNCoils, eMBRegisterMode eMode )
+{
+    USHORT          usBitOffset;
+    UCHAR           ucBits;
+
+    if( ( usAddress < REG_COILS_START ) || ( usAddress + usNCoils > REG_COILS_START + REG_COILS_SIZE ) )
+    {
+        return MB_ENOREG;
+    }
+    usBitOffset = ( USHORT )( usAddress - REG_COILS_START );
+    while( usNCoils > 0 )
+    {
+        ucBits = ( UCHAR )( usNCoils > 8 ? 8 : usNCoils );
+        if( eMode == MB_REG_READ )
+        {
+            *pucRegBuffer++ = xMBUtilGetBits( ucRegCoilsBuf, usBitOffset, ucBits );
+        }
+        else
+        {
+            xMBUtilSetBits( ucRegCoilsBuf, usBitOffset, ucBits, *pucRegBuffer++ );
+        }
+        usBitOffset += ucBits;
+        usNCoils -= ucBits;
+    }
+    return MB_ENOERR;
+}
+
+eMBErrorCode
+eMBRegDiscreteCB( UCHAR * pucRegBuffer, USHORT usAddress, USHORT usNDiscrete )
+{
+    USHORT          usBitOffset;
+    UCHAR           ucBits;
+
+    if( ( usAddress < REG_DISCRETE_START ) || ( usAddress + usNDiscrete > REG_DISCRETE_START + REG_DISCRETE_SIZE ) )
+    {
+        return MB_ENOREG;
+    }
+    usBitOffset = ( USHORT )( usAddress - REG_DISCRETE_START );
+    while( usNDiscrete > 0 )
+    {
+        ucBits = ( UCHAR )( usNDiscrete > 8 ? 8 : usNDiscrete );
+        *pucRegBuffer++ = xMBUtilGetBits( ucRegDiscreteBuf, usBitOffset, ucBits );
+        usBitOffset += ucBits;
+        usNDiscrete -= ucBits;
+    }
+    return MB_ENOERR;
+}
@@ -0,0 +1,112 @@
+/* 
+ * FreeModbus Libary: A portable Modbus implementation for Modbus ASCII/RTU.
+ * Copyright (c) 2006-2018 Christian Walter <cwalter@embedded-solutions.at>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* ----------------------- System includes ----------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "mb.h"
+#include "mbconfig.h"
+#include "mbport.h"
+
+/* ----------------------- Start implementation -----------------------------*/
+/* Slave on the host with the POSIX port, for load tests and profiling of
+ * the protocol stack. Serves Modbus TCP and optionally Modbus RTU on a
+ * serial device, e.g. the slave side of a pseudo terminal.
+ */
+int
+main( int argc, char *argv[] )
+{
+    xMBInstance    *pxTCPInst = NULL;
+    const char     *pcDevice = NULL;
+    ULONG           ulBaudRate = 19200;
+    USHORT          usTCPPort = 502;
+    UCHAR           ucAddress = 1;
+    int             iOpt;
+
+    while( ( iOpt = getopt( argc, argv, "p:d:b:a:" ) ) != -1 )
+    {
+        switch ( iOpt )
+        {
+        case 'p':
+            usTCPPort = ( USHORT )atoi( optarg );
+            break;
+        case 'd':
+            pcDevice = optarg;
+            break;
+        case 'b':
+            ulBaudRate = ( ULONG )atol( optarg );
+            break;
+        case 'a':
+            ucAddress = ( UCHAR )atoi( optarg );
+            break;
+        default:
+            fprintf( stderr, "usage: %s [-p tcp-port] [-d serial-device [-b baudrate] [-a address]]\n", argv[0] );
+            return EXIT_FAILURE;
+        }
+    }
+#if MB_TCP_ENABLED > 0
+    if( ( eMBInstTCPInit( &pxTCPInst, usTCPPort ) != MB_ENOERR ) || ( eMBInstEnable( pxTCPInst ) != MB_ENOERR ) )
+    {
+        fprintf( stderr, "%s: can not listen on TCP port %u\n", argv[0], usTCPPort );
+        return EXIT_FAILURE;
+    }
+#else
+    if( pcDevice == NULL )
+    {
+        fprintf( stderr, "%s: built without Modbus TCP, a serial device is required\n", argv[0] );
+        return EXIT_FAILURE;
+    }
+#endif
+    if( pcDevice != NULL )
+    {
+        ( void )xMBPortSerialSetDevice( 1, pcDevice );
+        if( ( eMBInit( MB_RTU, ucAddress, 1, ulBaudRate, MB_PAR_EVEN ) != MB_ENOERR ) ||
+            ( eMBEnable(  ) != MB_ENOERR ) )
+        {
+            fprintf( stderr, "%s: can not open %s\n", argv[0], pcDevice );
+            return EXIT_FAILURE;
+        }
+    }
+
+    /* TCP requests are handled while waiting for events of the serial line. */
+    for( ;; )
+    {
+        if( pcDevice != NULL )
+        {
+            ( void )eMBPollWait( MB_POLL_WAIT_FOREVER );
+        }
+        else
+        {
+            ( void )eMBInstPollWait( pxTCPInst, MB_POLL_WAIT_FOREVER );
+        }
+    }
+}
@@ -0,0 +1,236 @@
+/* 
+ * FreeModbus Libary: A portable Modbus implementation for Modbus ASCII/RTU.
+ * Copyright (c) 2006-2018 Christian Walter <cwalter@embedded-solutions.at>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* ----------------------- System includes ----------------------------------*/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "port.h"
+#include "mbconfig.h"
+#include "mbtrace.h"
+
+/* ----------------------- Defines ------------------------------------------*/
+#define TRACE_BUCKETS           32      /*!< Powers of two of nanoseconds. */
+#define TRACE_BAR_WIDTH         40
+#define TRACE_TOTAL             MB_TRACE_STAGES
+
+/* ----------------------- Type definitions ---------------------------------*/
+typedef struct
+{
+    unsigned long   ulCount;
+    double          dMinNs;
+    double          dMaxNs;
+    double          dSumNs;
+    unsigned long   aulBuckets[TRACE_BUCKETS];
+} xTraceHistogram;
+
+/* ----------------------- Static variables ---------------------------------*/
+static const char *const apcStageNames[MB_TRACE_STAGES + 1] = {
+    "rx_byte", "rx_end", "rx_crc", "dispatch", "reg_cb", "tx_crc", "tx_start", "frame_sent", "total"
+};
+
+/* Index MB_TRACE_STAGES is the time from the first to the last stage. */
+static xTraceHistogram xHistograms[MB_TRACE_STAGES + 1];
+static double   dNsPerStamp;
+
+static int      iChainStage = -1;
+static uint32_t ulChainFirst;
+static uint32_t ulChainLast;
+
+/* ----------------------- Static functions ---------------------------------*/
+static void
+prvvAdd( xTraceHistogram * pxHistogram, uint32_t ulStamps )
+{
+    double          dNs = ( double )ulStamps * dNsPerStamp;
+    int             iBucket = 0;
+
+    while( ( iBucket < TRACE_BUCKETS - 1 ) && ( dNs >= ( double )( 2UL << iBucket ) ) )
+    {
+        iBucket++;
+    }
+    if( ( pxHistogram->ulCount == 0 ) || ( dNs < pxHistogram->dMinNs ) )
+    {
+        pxHistogram->dMinNs = dNs;
+    }
+    if( dNs > pxHistogram->dMaxNs )
+    {
+        pxHistogram->dMaxNs = dNs;
+    }
+    pxHistogram->dSumNs += dNs;
+    pxHistogram->aulBuckets[iBucket]++;
+    pxHistogram->ulCount++;
+}
+
+static void
+prvvRecord( const xMBTraceRecord * pxRecord )
+{
+    int             iStage = pxRecord->ucStage;
+
+    if( iStage >= MB_TRACE_STAGES )
+    {
+        return;
+    }
+    /* A request passes the stages in ascending order. A stage which is not
+     * after the last one starts the next request. A repeated stage, like
+     * the second register callback of a read/write request, is ignored. */
+    if( iStage == iChainStage )
+    {
+        return;
+    }
+    if( ( iChainStage < 0 ) || ( iStage < iChainStage ) )
+    {
+        ulChainFirst = pxRecord->ulStamp;
+    }
+    else
+    {
+        prvvAdd( &xHistograms[iStage], pxRecord->ulStamp - ulChainLast );
+    }
+    iChainStage = iStage;
+    ulChainLast = pxRecord->ulStamp;
+    if( iStage == MB_TRACE_FRAME_SENT )
+    {
+        prvvAdd( &xHistograms[TRACE_TOTAL], ulChainLast - ulChainFirst );
+        iChainStage = -1;
+    }
+}
+
+static void
+prvvPrint( void )
+{
+    const xTraceHistogram *pxHistogram;
+    unsigned long   ulPeak;
+    int             iFirst;
+    int             iLast;
+    int             iStage;
+    int             i;
+
+    printf( "%-11s %9s %10s %10s %10s   (time since the previous stage)\n", "stage", "count", "min_us",
+            "mean_us", "max_us" );
+    for( iStage = 0; iStage <= MB_TRACE_STAGES; iStage++ )
+    {
+        pxHistogram = &xHistograms[iStage];
+        if( pxHistogram->ulCount == 0 )
+        {
+            continue;
+        }
+        printf( "%-11s %9lu %10.3f %10.3f %10.3f\n", apcStageNames[iStage], pxHistogram->ulCount,
+                pxHistogram->dMinNs / 1000.0, pxHistogram->dSumNs / 1000.0 / ( double )pxHistogram->ulCount,
+                pxHistogram->dMaxNs / 1000.0 );
+        iFirst = 0;
+        iLast = TRACE_BUCKETS - 1;
+        ulPeak = 0;
+        while( pxHistogram->aulBuckets[iFirst] == 0 )
+        {
+            iFirst++;
+        }
+        while( pxHistogram->aulBuckets[iLast] == 0 )
+        {
+            iLast--;
+        }
+        for( i = iFirst; i <= iLast; i++ )
+        {
+            ulPeak = pxHistogram->aulBuckets[i] > ulPeak ? pxHistogram->aulBuckets[i] : ulPeak;
+        }
+        for( i = iFirst; i <= iLast; i++ )
+        {
+            printf( "    %10.3f - %10.3f us |%-*.*s %lu\n", i == 0 ? 0.0 : ( double )( 1UL << i ) / 1000.0,
+                    ( double )( 2UL << i ) / 1000.0, TRACE_BAR_WIDTH,
+                    ( int )( pxHistogram->aulBuckets[i] * TRACE_BAR_WIDTH / ulPeak ),
+                    "########################################", pxHistogram->aulBuckets[i] );
+        }
+    }
+}
+
+/* ----------------------- Start implementation -----------------------------*/
+/* Prints the histograms of the time spent in each stage of the requests in
+ * a trace. The trace is either an image of xMBTraceBuffer dumped from the
+ * target or a file of records written by "mbbench -T".
+ */
+int
+main( int argc, char *argv[] )
+{
+    xMBTraceHeader  xHeader;
+    xMBTraceRecord  xRecord;
+    xMBTraceRecord *pxRing;
+    uint32_t        ulPos;
+    FILE           *pxFile;
+
+    if( argc != 2 )
+    {
+        fprintf( stderr, "usage: %s trace.bin\n", argv[0] );
+        return EXIT_FAILURE;
+    }
+    pxFile = fopen( argv[1], "rb" );
+    if( pxFile == NULL )
+    {
+        perror( argv[1] );
+        return EXIT_FAILURE;
+    }
+    if( ( fread( &xHeader, sizeof( xHeader ), 1, pxFile ) != 1 ) || ( xHeader.ulMagic != MB_TRACE_MAGIC ) ||
+        ( xHeader.ulHz == 0 ) || ( ( xHeader.ulSize & ( xHeader.ulSize - 1 ) ) != 0 ) )
+    {
+        fprintf( stderr, "%s: not a trace\n", argv[1] );
+        return EXIT_FAILURE;
+    }
+    dNsPerStamp = 1e9 / ( double )xHeader.ulHz;
+
+    if( xHeader.ulSize == 0 )
+    {
+        while( fread( &xRecord, sizeof( xRecord ), 1, pxFile ) == 1 )
+        {
+            prvvRecord( &xRecord );
+        }
+    }
+    else
+    {
+        /* Image of the ring. Records are taken from the oldest to the
+         * newest, those which were being written are skipped. */
+        pxRing = calloc( xHeader.ulSize, sizeof( xMBTraceRecord ) );
+        if( ( pxRing == NULL ) || ( fread( pxRing, sizeof( xMBTraceRecord ), xHeader.ulSize, pxFile ) != xHeader.ulSize ) )
+        {
+            fprintf( stderr, "%s: ring is truncated\n", argv[1] );
+            return EXIT_FAILURE;
+        }
+        ulPos = ( xHeader.ulHead > xHeader.ulSize ) ? xHeader.ulHead - xHeader.ulSize : 0;
+        for( ; ulPos != xHeader.ulHead; ulPos++ )
+        {
+            if( pxRing[ulPos & ( xHeader.ulSize - 1 )].usSeq == ( uint16_t )ulPos )
+            {
+                prvvRecord( &pxRing[ulPos & ( xHeader.ulSize - 1 )] );
+            }
+        }
+        free( pxRing );
+    }
+    ( void )fclose( pxFile );
+    prvvPrint(  );
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,134 @@
+/* 
+ * FreeModbus Libary: A portable Modbus implementation for Modbus ASCII/RTU.
+ * Copyright (c) 2006-2018 Christian Walter <cwalter@embedded-solutions.at>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef _PORT_POSIX_H
+#define _PORT_POSIX_H
+
+/* ----------------------- System includes ----------------------------------*/
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+/* ----------------------- Defines ------------------------------------------*/
+#define INLINE                      inline
+#define PR_BEGIN_EXTERN_C           extern "C" {
+#define PR_END_EXTERN_C             }
+
+/* The serial, timer and TCP handlers run in the thread which polls the
+ * protocol stack, from vMBPortPosixWait( ). There is nothing to lock.
+ */
+#define ENTER_CRITICAL_SECTION( )   ( ( void )0 )
+#define EXIT_CRITICAL_SECTION( )    ( ( void )0 )
+
+#define MB_PORT_HAS_CLOSE           1
+
+/* Time stamp of posted events in milliseconds. */
+#define MB_PORT_GET_TICK()          ulMBPortPosixGetTick( )
+#define MB_PORT_MEMORY_BARRIER()    __atomic_thread_fence( __ATOMIC_SEQ_CST )
+/* Handles the descriptors which became ready, waits at most one tick. */
+#define MB_PORT_WAIT_FOR_INTERRUPT() vMBPortPosixWait( MB_PORT_POSIX_TICK_MS )
+/* No frame indicator on the host. */
+#define MB_PORT_FRAME_INDICATE()    ( ( void )0 )
+/* Time stamps of the tracepoints in nanoseconds, see mbtrace.h. */
+#define MB_PORT_TRACE_INIT()        ( ( void )0 )
+#define MB_PORT_TRACE_STAMP()       ulMBPortPosixTraceStamp( )
+#define MB_PORT_TRACE_HZ()          ( 1000000000UL )
+#define MB_PORT_TRACE_CLAIM( pulHead ) __atomic_fetch_add( ( pulHead ), 1U, __ATOMIC_RELAXED )
+
+/* Longest time vMBPortPosixWait( ) blocks when called from xMBPortEventWait( ). */
+#define MB_PORT_POSIX_TICK_MS       1
+/* Serial ports which can be given to eMBInit( ) and eMBInstInit( ). */
+#define MB_PORT_POSIX_SERIAL_PORTS  4
+
+/* Modbus TCP server, see posix/porttcp.c. */
+#define MB_TCP_PORT_CONNECTIONS             16
+/* Connections without a request for this time are closed, 0 to keep them. */
+#define MB_TCP_PORT_IDLE_TIMEOUT_MS         60000
+/* Pipelined requests of one connection handled per wakeup. */
+#define MB_TCP_PORT_REQUESTS_PER_POLL       8
+
+/* ----------------------- Type definitions ---------------------------------*/
+typedef unsigned char UCHAR;
+typedef char CHAR;
+
+typedef uint16_t USHORT;
+typedef int16_t SHORT;
+
+typedef uint32_t ULONG;
+typedef int32_t LONG;
+
+typedef _Bool BOOL;
+
+#ifndef TRUE
+#define TRUE true
+#endif
+
+#ifndef FALSE
+#define FALSE false
+#endif
+
+/* A descriptor watched by vMBPortPosixWait( ) and the handler called when
+ * it is ready. Sources without a descriptor (iFd < 0) are called on every
+ * pass. Any source can be pended to be called on the next pass, which
+ * replaces the interrupt that a call like vMBPortSerialEnable( ) would
+ * trigger on a microcontroller.
+ */
+typedef struct xMBPortPosixSourceStruct xMBPortPosixSource;
+struct xMBPortPosixSourceStruct
+{
+    int             iFd;
+    void            ( *pvHandler ) ( xMBPortPosixSource * pxSource, ULONG ulEvents );
+    void           *pvArg;
+    BOOL            xPended;
+    xMBPortPosixSource *pxNext;
+};
+
+/* ----------------------- Function prototypes ------------------------------*/
+/* Dispatcher, see posix/portposix.c. ulEvents are EPOLL* flags, 0 for a
+ * pended source.
+ */
+BOOL            xMBPortPosixAdd( xMBPortPosixSource * pxSource, ULONG ulEvents );
+BOOL            xMBPortPosixModify( xMBPortPosixSource * pxSource, ULONG ulEvents );
+void            vMBPortPosixRemove( xMBPortPosixSource * pxSource );
+void            vMBPortPosixPend( xMBPortPosixSource * pxSource );
+void            vMBPortPosixWait( int iTimeoutMs );
+/* Ends a wait in vMBPortPosixWait( ). The only function which may be
+ * called from another thread.
+ */
+void            vMBPortPosixWakeup( void );
+ULONG           ulMBPortPosixGetTick( void );
+ULONG           ulMBPortPosixTraceStamp( void );
+
+/* Device of a serial port, e.g. /dev/ttyUSB0 or the slave side of a
+ * pseudo terminal. Must be set before the port is initialized.
+ */
+BOOL            xMBPortSerialSetDevice( UCHAR ucPort, const CHAR * pcDevice );
+
+#endif
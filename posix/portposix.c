@@ -0,0 +1,233 @@
+/* 
+ * FreeModbus Libary: A portable Modbus implementation for Modbus ASCII/RTU.
+ * Copyright (c) 2006-2018 Christian Walter <cwalter@embedded-solutions.at>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* ----------------------- System includes ----------------------------------*/
+#include <errno.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+/* ----------------------- Platform includes --------------------------------*/
+#include "port.h"
+
+/* ----------------------- Defines ------------------------------------------*/
+#define MB_PORT_POSIX_EVENTS_MAX    16  /*!< Descriptors handled per epoll_wait( ). */
+
+/* ----------------------- Static variables ---------------------------------*/
+static int      iEpollFd = -1;
+static int      iWakeupFd = -1;
+static xMBPortPosixSource *pxSourcesAlways;     /* Sources without a descriptor. */
+static xMBPortPosixSource *pxSourcesPended;
+
+/* ----------------------- Static functions ---------------------------------*/
+static          BOOL
+prvxMBPortPosixInit( void )
+{
+    struct epoll_event xEvent;
+
+    if( iEpollFd >= 0 )
+    {
+        return TRUE;
+    }
+    iEpollFd = epoll_create1( EPOLL_CLOEXEC );
+    iWakeupFd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+    if( ( iEpollFd < 0 ) || ( iWakeupFd < 0 ) )
+    {
+        return FALSE;
+    }
+    /* The wakeup descriptor is the only one without a source. */
+    xEvent.events = EPOLLIN;
+    xEvent.data.ptr = NULL;
+    return epoll_ctl( iEpollFd, EPOLL_CTL_ADD, iWakeupFd, &xEvent ) == 0;
+}
+
+static void
+prvvMBPortPosixRunPended( void )
+{
+    xMBPortPosixSource *pxSource;
+
+    /* Sources pended by the handlers run on the next pass. */
+    while( pxSourcesPended != NULL )
+    {
+        pxSource = pxSourcesPended;
+        pxSourcesPended = pxSource->pxNext;
+        pxSource->pxNext = NULL;
+        pxSource->xPended = FALSE;
+        pxSource->pvHandler( pxSource, 0 );
+    }
+}
+
+/* ----------------------- Start implementation -----------------------------*/
+BOOL
+xMBPortPosixAdd( xMBPortPosixSource * pxSource, ULONG ulEvents )
+{
+    struct epoll_event xEvent;
+
+    if( !prvxMBPortPosixInit(  ) )
+    {
+        return FALSE;
+    }
+    pxSource->xPended = FALSE;
+    pxSource->pxNext = NULL;
+    if( pxSource->iFd < 0 )
+    {
+        pxSource->pxNext = pxSourcesAlways;
+        pxSourcesAlways = pxSource;
+        return TRUE;
+    }
+    xEvent.events = ulEvents;
+    xEvent.data.ptr = pxSource;
+    return epoll_ctl( iEpollFd, EPOLL_CTL_ADD, pxSource->iFd, &xEvent ) == 0;
+}
+
+BOOL
+xMBPortPosixModify( xMBPortPosixSource * pxSource, ULONG ulEvents )
+{
+    struct epoll_event xEvent;
+
+    xEvent.events = ulEvents;
+    xEvent.data.ptr = pxSource;
+    return epoll_ctl( iEpollFd, EPOLL_CTL_MOD, pxSource->iFd, &xEvent ) == 0;
+}
+
+void
+vMBPortPosixRemove( xMBPortPosixSource * pxSource )
+{
+    xMBPortPosixSource **ppxLink = NULL;
+
+    /* A source is in at most one of the lists. */
+    if( pxSource->iFd < 0 )
+    {
+        ppxLink = &pxSourcesAlways;
+    }
+    else
+    {
+        ( void )epoll_ctl( iEpollFd, EPOLL_CTL_DEL, pxSource->iFd, NULL );
+        if( pxSource->xPended )
+        {
+            ppxLink = &pxSourcesPended;
+        }
+    }
+    while( ( ppxLink != NULL ) && ( *ppxLink != NULL ) )
+    {
+        if( *ppxLink == pxSource )
+        {
+            *ppxLink = pxSource->pxNext;
+            break;
+        }
+        ppxLink = &( *ppxLink )->pxNext;
+    }
+    pxSource->xPended = FALSE;
+    pxSource->pxNext = NULL;
+}
+
+void
+vMBPortPosixPend( xMBPortPosixSource * pxSource )
+{
+    /* Only for sources with a descriptor, the others run anyway. */
+    if( ( pxSource->iFd >= 0 ) && !pxSource->xPended )
+    {
+        pxSource->xPended = TRUE;
+        pxSource->pxNext = pxSourcesPended;
+        pxSourcesPended = pxSource;
+    }
+}
+
+void
+vMBPortPosixWait( int iTimeoutMs )
+{
+    struct epoll_event xEvents[MB_PORT_POSIX_EVENTS_MAX];
+    xMBPortPosixSource *pxSource;
+    xMBPortPosixSource *pxNext;
+    uint64_t        ullCount;
+    int             iReady;
+    int             i;
+
+    if( !prvxMBPortPosixInit(  ) )
+    {
+        return;
+    }
+    for( pxSource = pxSourcesAlways; pxSource != NULL; pxSource = pxNext )
+    {
+        pxNext = pxSource->pxNext;
+        pxSource->pvHandler( pxSource, 0 );
+    }
+    if( pxSourcesPended != NULL )
+    {
+        iTimeoutMs = 0;
+    }
+
+    iReady = epoll_wait( iEpollFd, xEvents, MB_PORT_POSIX_EVENTS_MAX, iTimeoutMs );
+    for( i = 0; i < iReady; i++ )
+    {
+        pxSource = ( xMBPortPosixSource * ) xEvents[i].data.ptr;
+        if( pxSource == NULL )
+        {
+            ( void )read( iWakeupFd, &ullCount, sizeof( ullCount ) );
+        }
+        else
+        {
+            pxSource->pvHandler( pxSource, xEvents[i].events );
+        }
+    }
+    prvvMBPortPosixRunPended(  );
+}
+
+void
+vMBPortPosixWakeup( void )
+{
+    uint64_t        ullOne = 1;
+
+    if( iWakeupFd >= 0 )
+    {
+        ( void )write( iWakeupFd, &ullOne, sizeof( ullOne ) );
+    }
+}
+
+ULONG
+ulMBPortPosixGetTick( void )
+{
+    struct timespec xNow;
+
+    /* Wraps around like the tick of the microcontroller. */
+    ( void )clock_gettime( CLOCK_MONOTONIC, &xNow );
+    return ( ULONG )( ( uint64_t ) xNow.tv_sec * 1000U + ( uint64_t ) xNow.tv_nsec / 1000000U );
+}
+
+ULONG
+ulMBPortPosixTraceStamp( void )
+{
+    struct timespec xNow;
+
+    /* Nanoseconds, wraps around after about 4 s. Only differences are used. */
+    ( void )clock_gettime( CLOCK_MONOTONIC, &xNow );
+    return ( ULONG )( ( uint64_t ) xNow.tv_sec * 1000000000U + ( uint64_t ) xNow.tv_nsec );
+}
@@ -0,0 +1,469 @@
+/* 
+ * FreeModbus Libary: A portable Modbus implementation for Modbus ASCII/RTU.
+ * Copyright (c) 2006-2018 Christian Walter <cwalter@embedded-solutions.at>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* ----------------------- System includes ----------------------------------*/
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "mbport.h"
+#include "mbconfig.h"
+#include "mbinstance.h"
+
+#if ( MB_RTU_DMA_RX_ENABLED > 0 ) && ( MB_ASCII_ENABLED > 0 )
+#error "MB_RTU_DMA_RX_ENABLED can not be used together with Modbus ASCII"
+#endif
+
+/* ----------------------- Defines ------------------------------------------*/
+#define MB_PORT_SERIAL_TX_SIZE      520 /*!< Largest Modbus ASCII frame. */
+#define MB_PORT_SERIAL_RX_CHUNK     256 /*!< Bytes read from the device at once. */
+
+/* ----------------------- Type definitions ---------------------------------*/
+typedef struct
+{
+    xMBPortPosixSource xSource;         /* The device. */
+    const CHAR     *pcDevice;
+    xMBInstance    *pxInst;
+    BOOL            xRxEnabled;
+    BOOL            xTxEnabled;         /* Per-byte transmission in progress. */
+    UCHAR           ucRxByte;           /* Byte returned by xMBPortSerialGetByte( ). */
+    UCHAR           aucTxBuffer[MB_PORT_SERIAL_TX_SIZE];
+    USHORT          usTxLength;
+    USHORT          usTxSent;
+#if MB_RTU_DMA_TX_ENABLED > 0
+    BOOL            xTxComplete;        /* Report the end of xMBPortSerialPutBuffer( ). */
+#endif
+#if MB_RTU_DMA_RX_ENABLED > 0
+    xMBPortPosixSource xIdle;           /* Idle line after a frame. */
+    ULONG           ulIdleUs;
+    UCHAR          *pucRxBuffer;
+    USHORT          usRxBufferSize;
+    USHORT          usRxCount;
+#endif
+} xMBPortSerial;
+
+/* ----------------------- Static variables ---------------------------------*/
+/* Port n is xMBPortSerials[n - 1], port 0 is an alias for port 1 as on the
+ * microcontroller.
+ */
+static xMBPortSerial xMBPortSerials[MB_PORT_POSIX_SERIAL_PORTS];
+
+#define MB_PORT_SERIAL_GET( pxInst ) ( &xMBPortSerials[( pxInst )->ucPort > 0 ? ( pxInst )->ucPort - 1 : 0] )
+
+/* ----------------------- Static functions ---------------------------------*/
+static          speed_t
+prvxMBPortSerialSpeed( ULONG ulBaudRate )
+{
+    switch ( ulBaudRate )
+    {
+    case 1200:
+        return B1200;
+    case 2400:
+        return B2400;
+    case 4800:
+        return B4800;
+    case 9600:
+        return B9600;
+    case 19200:
+        return B19200;
+    case 38400:
+        return B38400;
+    case 57600:
+        return B57600;
+    case 115200:
+        return B115200;
+    case 230400:
+        return B230400;
+    default:
+        return B0;
+    }
+}
+
+static void
+prvvMBPortSerialFlush( xMBPortSerial * pxPort )
+{
+    ssize_t         iWritten;
+
+    /* Bytes the device did not take are written once it is writable. */
+    while( pxPort->usTxSent < pxPort->usTxLength )
+    {
+        iWritten = write( pxPort->xSource.iFd, &pxPort->aucTxBuffer[pxPort->usTxSent],
+                          pxPort->usTxLength - pxPort->usTxSent );
+        if( iWritten <= 0 )
+        {
+            if( ( iWritten < 0 ) && ( errno == EAGAIN ) )
+            {
+                ( void )xMBPortPosixModify( &pxPort->xSource, EPOLLIN | EPOLLOUT );
+                return;
+            }
+            /* Device gone, the frame is lost. */
+            break;
+        }
+        pxPort->usTxSent += ( USHORT ) iWritten;
+    }
+    if( pxPort->usTxLength > 0 )
+    {
+        pxPort->usTxLength = 0;
+        pxPort->usTxSent = 0;
+        ( void )xMBPortPosixModify( &pxPort->xSource, EPOLLIN );
+    }
+#if MB_RTU_DMA_TX_ENABLED > 0
+    if( pxPort->xTxComplete )
+    {
+        pxPort->xTxComplete = FALSE;
+        ( void )xMBPortCBTransmitComplete( pxPort->pxInst );
+    }
+#endif
+}
+
+#if MB_RTU_DMA_RX_ENABLED > 0
+static void
+prvvMBPortSerialSetIdle( xMBPortSerial * pxPort, ULONG ulTimeoutUs )
+{
+    struct itimerspec xTime = { { 0, 0 }, { 0, 0 } };
+
+    xTime.it_value.tv_sec = ulTimeoutUs / 1000000U;
+    xTime.it_value.tv_nsec = ( long )( ulTimeoutUs % 1000000U ) * 1000L;
+    ( void )timerfd_settime( pxPort->xIdle.iFd, 0, &xTime, NULL );
+}
+
+static void
+prvvMBPortSerialFrameEnd( xMBPortSerial * pxPort )
+{
+    /* Reception stops with the frame, as with the idle line event of the
+     * UART. xMBPortCBFrameReceived( ) enables the receiver again. */
+    prvvMBPortSerialSetIdle( pxPort, 0 );
+    pxPort->xRxEnabled = FALSE;
+    ( void )xMBPortCBFrameReceived( pxPort->pxInst, pxPort->usRxCount );
+}
+
+static void
+prvvMBPortSerialIdle( xMBPortPosixSource * pxSource, ULONG ulEvents )
+{
+    xMBPortSerial  *pxPort = ( xMBPortSerial * ) pxSource->pvArg;
+    uint64_t        ullExpirations;
+
+    if( ( read( pxSource->iFd, &ullExpirations, sizeof( ullExpirations ) ) == sizeof( ullExpirations ) ) &&
+        pxPort->xRxEnabled && ( pxPort->usRxCount > 0 ) )
+    {
+        prvvMBPortSerialFrameEnd( pxPort );
+    }
+}
+#endif
+
+static void
+prvvMBPortSerialReceive( xMBPortSerial * pxPort )
+{
+    UCHAR           aucChunk[MB_PORT_SERIAL_RX_CHUNK];
+    ssize_t         iRead;
+    ssize_t         i;
+
+    iRead = read( pxPort->xSource.iFd, aucChunk, sizeof( aucChunk ) );
+    /* Bytes received while the receiver is disabled are lost. */
+    if( ( iRead <= 0 ) || !pxPort->xRxEnabled )
+    {
+        return;
+    }
+#if MB_RTU_DMA_RX_ENABLED > 0
+    for( i = 0; ( i < iRead ) && ( pxPort->usRxCount < pxPort->usRxBufferSize ); i++ )
+    {
+        pxPort->pucRxBuffer[pxPort->usRxCount++] = aucChunk[i];
+    }
+    if( pxPort->usRxCount == pxPort->usRxBufferSize )
+    {
+        prvvMBPortSerialFrameEnd( pxPort );
+    }
+    else
+    {
+        prvvMBPortSerialSetIdle( pxPort, pxPort->ulIdleUs );
+    }
+#else
+    for( i = 0; ( i < iRead ) && pxPort->xRxEnabled; i++ )
+    {
+        pxPort->ucRxByte = aucChunk[i];
+        ( void )xMBPortCBByteReceived( pxPort->pxInst );
+    }
+#endif
+}
+
+static void
+prvvMBPortSerialHandler( xMBPortPosixSource * pxSource, ULONG ulEvents )
+{
+    xMBPortSerial  *pxPort = ( xMBPortSerial * ) pxSource->pvArg;
+
+    if( ulEvents & EPOLLIN )
+    {
+        prvvMBPortSerialReceive( pxPort );
+    }
+    /* Pended by vMBPortSerialEnable( ) or xMBPortSerialPutBuffer( ), or
+     * the device has room again. The stack puts the bytes of a per-byte
+     * transmission one by one until it disables the transmitter. */
+    while( pxPort->xTxEnabled && ( pxPort->usTxLength < MB_PORT_SERIAL_TX_SIZE ) )
+    {
+        ( void )xMBPortCBTransmitterEmpty( pxPort->pxInst );
+    }
+    prvvMBPortSerialFlush( pxPort );
+}
+
+/* ----------------------- Start implementation -----------------------------*/
+BOOL
+xMBPortSerialSetDevice( UCHAR ucPort, const CHAR * pcDevice )
+{
+    if( ucPort > MB_PORT_POSIX_SERIAL_PORTS )
+    {
+        return FALSE;
+    }
+    xMBPortSerials[ucPort > 0 ? ucPort - 1 : 0].pcDevice = pcDevice;
+    return TRUE;
+}
+
+void
+vMBPortSerialEnable( xMBInstance * pxInst, BOOL xRxEnable, BOOL xTxEnable )
+{
+    xMBPortSerial  *pxPort = MB_PORT_SERIAL_GET( pxInst );
+
+#if MB_RTU_DMA_RX_ENABLED > 0
+    /* Enabling rearms the frame buffer, unless it is already receiving. */
+    if( xRxEnable && !pxPort->xRxEnabled )
+    {
+        pxPort->usRxCount = 0;
+    }
+    if( !xRxEnable )
+    {
+        prvvMBPortSerialSetIdle( pxPort, 0 );
+    }
+#endif
+    pxPort->xRxEnabled = xRxEnable;
+    pxPort->xTxEnabled = xTxEnable;
+    if( xTxEnable )
+    {
+        /* The transmitter empty callbacks follow on the next pass. */
+        vMBPortPosixPend( &pxPort->xSource );
+    }
+}
+
+BOOL
+xMBPortSerialInit( xMBInstance * pxInst, UCHAR ucPort, ULONG ulBaudRate, UCHAR ucDataBits,
+                   eMBParity eParity )
+{
+    xMBPortSerial  *pxPort;
+    struct termios  xTios;
+    speed_t         xSpeed = prvxMBPortSerialSpeed( ulBaudRate );
+    int             iFd;
+
+    if( ( ucPort > MB_PORT_POSIX_SERIAL_PORTS ) || ( xSpeed == B0 ) )
+    {
+        return FALSE;
+    }
+    pxPort = &xMBPortSerials[ucPort > 0 ? ucPort - 1 : 0];
+    if( pxPort->pcDevice == NULL )
+    {
+        return FALSE;
+    }
+    iFd = open( pxPort->pcDevice, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC );
+    if( iFd < 0 )
+    {
+        return FALSE;
+    }
+
+    /* Raw mode, every byte is returned as soon as it arrives. Modbus wants
+     * two stop bits without parity. */
+    if( tcgetattr( iFd, &xTios ) != 0 )
+    {
+        ( void )close( iFd );
+        return FALSE;
+    }
+    cfmakeraw( &xTios );
+    xTios.c_cflag |= CREAD | CLOCAL;
+    xTios.c_cflag &= ~( CSIZE | PARENB | PARODD | CSTOPB );
+    xTios.c_cflag |= ( ucDataBits == 7 ) ? CS7 : CS8;
+    switch ( eParity )
+    {
+    case MB_PAR_NONE:
+        xTios.c_cflag |= CSTOPB;
+        break;
+    case MB_PAR_ODD:
+        xTios.c_cflag |= PARENB | PARODD;
+        break;
+    case MB_PAR_EVEN:
+        xTios.c_cflag |= PARENB;
+        break;
+    }
+    xTios.c_cc[VMIN] = 0;
+    xTios.c_cc[VTIME] = 0;
+    ( void )cfsetispeed( &xTios, xSpeed );
+    ( void )cfsetospeed( &xTios, xSpeed );
+    if( tcsetattr( iFd, TCSANOW, &xTios ) != 0 )
+    {
+        ( void )close( iFd );
+        return FALSE;
+    }
+    ( void )tcflush( iFd, TCIOFLUSH );
+
+    pxPort->pxInst = pxInst;
+    pxPort->xRxEnabled = FALSE;
+    pxPort->xTxEnabled = FALSE;
+    pxPort->usTxLength = 0;
+    pxPort->usTxSent = 0;
+    pxPort->xSource.iFd = iFd;
+    pxPort->xSource.pvHandler = prvvMBPortSerialHandler;
+    pxPort->xSource.pvArg = pxPort;
+    if( !xMBPortPosixAdd( &pxPort->xSource, EPOLLIN ) )
+    {
+        ( void )close( iFd );
+        return FALSE;
+    }
+#if MB_RTU_DMA_TX_ENABLED > 0
+    pxPort->xTxComplete = FALSE;
+#endif
+#if MB_RTU_DMA_RX_ENABLED > 0
+    /* The end of a frame is detected after t3.5, which also covers the
+     * latency of USB serial adapters. */
+    pxPort->ulIdleUs = ( ulBaudRate > 19200 ) ? 1750U : ( 7U * 11U * 1000000U ) / ( 2U * ulBaudRate );
+    pxPort->pucRxBuffer = NULL;
+    pxPort->usRxCount = 0;
+    pxPort->xIdle.iFd = timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC );
+    pxPort->xIdle.pvHandler = prvvMBPortSerialIdle;
+    pxPort->xIdle.pvArg = pxPort;
+    if( ( pxPort->xIdle.iFd < 0 ) || !xMBPortPosixAdd( &pxPort->xIdle, EPOLLIN ) )
+    {
+        xMBPortSerialClose( pxInst );
+        return FALSE;
+    }
+#endif
+    return TRUE;
+}
+
+void
+xMBPortSerialClose( xMBInstance * pxInst )
+{
+    xMBPortSerial  *pxPort = MB_PORT_SERIAL_GET( pxInst );
+
+    if( pxPort->pxInst == NULL )
+    {
+        return;
+    }
+    vMBPortPosixRemove( &pxPort->xSource );
+    ( void )close( pxPort->xSource.iFd );
+#if MB_RTU_DMA_RX_ENABLED > 0
+    if( pxPort->xIdle.iFd >= 0 )
+    {
+        vMBPortPosixRemove( &pxPort->xIdle );
+        ( void )close( pxPort->xIdle.iFd );
+    }
+#endif
+    pxPort->pxInst = NULL;
+}
+
+void
+vMBPortClose( xMBInstance * pxInst )
+{
+    xMBPortSerialClose( pxInst );
+    xMBPortTimersClose( pxInst );
+}
+
+BOOL
+xMBPortSerialPutByte( xMBInstance * pxInst, UCHAR ucByte )
+{
+    /* Collected and written once the stack disabled the transmitter. */
+    xMBPortSerial  *pxPort = MB_PORT_SERIAL_GET( pxInst );
+
+    pxPort->aucTxBuffer[pxPort->usTxLength++] = ucByte;
+    return TRUE;
+}
+
+BOOL
+xMBPortSerialGetByte( xMBInstance * pxInst, CHAR * pucByte )
+{
+    *pucByte = ( CHAR )MB_PORT_SERIAL_GET( pxInst )->ucRxByte;
+    return TRUE;
+}
+
+#if MB_RTU_DMA_TX_ENABLED > 0
+BOOL
+xMBPortSerialPutBuffer( xMBInstance * pxInst, const UCHAR * pucBuffer, USHORT usLength )
+{
+    /* Written from the buffer of the stack. Only a rest the device does not
+     * take at once is copied. The end is reported on the next pass. */
+    xMBPortSerial  *pxPort = MB_PORT_SERIAL_GET( pxInst );
+    ssize_t         iWritten;
+
+    if( usLength > MB_PORT_SERIAL_TX_SIZE )
+    {
+        return FALSE;
+    }
+    iWritten = write( pxPort->xSource.iFd, pucBuffer, usLength );
+    if( iWritten < 0 )
+    {
+        if( errno != EAGAIN )
+        {
+            return FALSE;
+        }
+        iWritten = 0;
+    }
+    if( iWritten < usLength )
+    {
+        pxPort->usTxLength = ( USHORT )( usLength - iWritten );
+        pxPort->usTxSent = 0;
+        memcpy( pxPort->aucTxBuffer, &pucBuffer[iWritten], pxPort->usTxLength );
+    }
+    pxPort->xTxComplete = TRUE;
+    vMBPortPosixPend( &pxPort->xSource );
+    return TRUE;
+}
+#endif
+
+#if MB_RTU_DMA_RX_ENABLED > 0
+BOOL
+xMBPortSerialStartReceive( xMBInstance * pxInst, UCHAR * pucBuffer, USHORT usSize )
+{
+    xMBPortSerial  *pxPort = MB_PORT_SERIAL_GET( pxInst );
+
+    pxPort->pucRxBuffer = pucBuffer;
+    pxPort->usRxBufferSize = usSize;
+    pxPort->usRxCount = 0;
+    pxPort->xRxEnabled = TRUE;
+    return TRUE;
+}
+
+USHORT
+usMBPortSerialRxCount( xMBInstance * pxInst )
+{
+    /* Number of bytes stored since the receiver was armed. */
+    xMBPortSerial  *pxPort = MB_PORT_SERIAL_GET( pxInst );
+
+    return pxPort->xRxEnabled ? pxPort->usRxCount : 0;
+}
+#endif
@@ -0,0 +1,439 @@
+/* 
+ * FreeModbus Libary: A portable Modbus implementation for Modbus ASCII/RTU.
+ * Copyright (c) 2006-2018 Christian Walter <cwalter@embedded-solutions.at>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* ----------------------- System includes ----------------------------------*/
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "mb.h"
+#include "mbconfig.h"
+#include "mbport.h"
+#include "mbtcp.h"
+#if MB_GATEWAY_ENABLED > 0
+#include "mbgateway.h"
+#endif
+
+#if MB_TCP_ENABLED > 0
+
+/* ----------------------- Defines ------------------------------------------*/
+#define MB_TCP_DEFAULT_PORT     502
+#define MB_TCP_LEN_MIN          2       /*!< Unit identifier and function code. */
+#define MB_TCP_LEN_MAX          ( MB_TCP_ADU_SIZE_MAX - MB_TCP_UID )
+#define MB_TCP_STREAM_SIZE      ( 4 * MB_TCP_ADU_SIZE_MAX )     /*!< Received, not yet handled. */
+#define MB_TCP_TX_SIZE          ( 4 * MB_TCP_ADU_SIZE_MAX )     /*!< Sent, not yet taken by the socket. */
+
+/* ----------------------- Type definitions ---------------------------------*/
+typedef struct
+{
+    xMBPortPosixSource xSource;
+    BOOL            xIsConnected;
+    ULONG           ulLastRequest;      /* Tick of the last request, for the idle timeout. */
+    UCHAR           aucStream[MB_TCP_STREAM_SIZE];
+    USHORT          usStreamStart;
+    USHORT          usStreamLength;
+    UCHAR           aucFrame[MB_TCP_ADU_SIZE_MAX];      /* Request, the response is built in place. */
+    USHORT          usFrameLength;
+    UCHAR           aucTxBuffer[MB_TCP_TX_SIZE];
+    USHORT          usTxLength;
+    ULONG           ulWatched;          /* Events registered with the dispatcher. */
+} xMBTCPConnection;
+
+/* ----------------------- Static variables ---------------------------------*/
+static xMBInstance *pxMBTCPInstance;
+static xMBPortPosixSource xMBTCPListen = { -1 };
+static xMBPortPosixSource xMBTCPTimer = { -1 };         /* Idle timeouts and gateway. */
+static xMBTCPConnection xMBTCPConnections[MB_TCP_PORT_CONNECTIONS];
+static UCHAR    ucMBTCPCurConnection;   /* Connection of the request in progress. */
+
+/* ----------------------- Static functions ---------------------------------*/
+static void     prvvMBTCPPortHandler( xMBPortPosixSource * pxSource, ULONG ulEvents );
+
+static void
+prvvMBTCPPortDrop( xMBTCPConnection * pxConn )
+{
+    /* Responses for a closed connection are not sent. */
+    vMBPortPosixRemove( &pxConn->xSource );
+    ( void )close( pxConn->xSource.iFd );
+    pxConn->xSource.iFd = -1;
+    pxConn->xIsConnected = FALSE;
+#if MB_GATEWAY_ENABLED > 0
+    vMBGatewayReset( ( UCHAR )( pxConn - xMBTCPConnections ) );
+#endif
+}
+
+static void
+prvvMBTCPPortWatch( xMBTCPConnection * pxConn )
+{
+    ULONG           ulEvents = 0;
+
+    /* While the stream is full the socket is not read. Further requests
+     * wait in the socket buffer and TCP flow control holds the client. */
+    if( pxConn->usStreamLength < MB_TCP_STREAM_SIZE )
+    {
+        ulEvents |= EPOLLIN | EPOLLRDHUP;
+    }
+    if( pxConn->usTxLength > 0 )
+    {
+        ulEvents |= EPOLLOUT;
+    }
+    if( ulEvents != pxConn->ulWatched )
+    {
+        ( void )xMBPortPosixModify( &pxConn->xSource, ulEvents );
+        pxConn->ulWatched = ulEvents;
+    }
+}
+
+static void
+prvvMBTCPPortAccept( xMBPortPosixSource * pxSource, ULONG ulEvents )
+{
+    xMBTCPConnection *pxConn;
+    int             iFd;
+    int             iOne = 1;
+    int             i;
+
+    while( ( iFd = accept4( pxSource->iFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC ) ) >= 0 )
+    {
+        pxConn = NULL;
+        for( i = 0; ( i < MB_TCP_PORT_CONNECTIONS ) && ( pxConn == NULL ); i++ )
+        {
+            if( !xMBTCPConnections[i].xIsConnected )
+            {
+                pxConn = &xMBTCPConnections[i];
+            }
+        }
+        if( pxConn == NULL )
+        {
+            /* All connections in use. */
+            ( void )close( iFd );
+            continue;
+        }
+        ( void )setsockopt( iFd, IPPROTO_TCP, TCP_NODELAY, &iOne, sizeof( iOne ) );
+        pxConn->xSource.iFd = iFd;
+        pxConn->xSource.pvHandler = prvvMBTCPPortHandler;
+        pxConn->xSource.pvArg = pxConn;
+        pxConn->usStreamStart = 0;
+        pxConn->usStreamLength = 0;
+        pxConn->usTxLength = 0;
+        pxConn->ulLastRequest = ulMBPortPosixGetTick(  );
+        pxConn->ulWatched = EPOLLIN | EPOLLRDHUP;
+        if( !xMBPortPosixAdd( &pxConn->xSource, pxConn->ulWatched ) )
+        {
+            ( void )close( iFd );
+            continue;
+        }
+        pxConn->xIsConnected = TRUE;
+    }
+}
+
+static          BOOL
+prvxMBTCPPortSend( xMBTCPConnection * pxConn, const UCHAR * pucData, USHORT usLength )
+{
+    ssize_t         iSent = 0;
+
+    /* Sent from the buffer of the caller. Only a rest the socket does not
+     * take is copied and sent when it is writable again. */
+    if( pxConn->usTxLength == 0 )
+    {
+        iSent = send( pxConn->xSource.iFd, pucData, usLength, MSG_NOSIGNAL );
+        if( iSent < 0 )
+        {
+            if( ( errno != EAGAIN ) && ( errno != EWOULDBLOCK ) )
+            {
+                return FALSE;
+            }
+            iSent = 0;
+        }
+    }
+    if( iSent < usLength )
+    {
+        if( ( usLength - iSent ) > ( MB_TCP_TX_SIZE - pxConn->usTxLength ) )
+        {
+            return FALSE;
+        }
+        memcpy( &pxConn->aucTxBuffer[pxConn->usTxLength], &pucData[iSent], usLength - iSent );
+        pxConn->usTxLength += ( USHORT )( usLength - iSent );
+        prvvMBTCPPortWatch( pxConn );
+    }
+    return TRUE;
+}
+
+static          BOOL
+prvxMBTCPPortFlush( xMBTCPConnection * pxConn )
+{
+    ssize_t         iSent;
+
+    if( pxConn->usTxLength == 0 )
+    {
+        return TRUE;
+    }
+    iSent = send( pxConn->xSource.iFd, pxConn->aucTxBuffer, pxConn->usTxLength, MSG_NOSIGNAL );
+    if( iSent < 0 )
+    {
+        return ( errno == EAGAIN ) || ( errno == EWOULDBLOCK );
+    }
+    memmove( pxConn->aucTxBuffer, &pxConn->aucTxBuffer[iSent], pxConn->usTxLength - ( size_t ) iSent );
+    pxConn->usTxLength -= ( USHORT ) iSent;
+    prvvMBTCPPortWatch( pxConn );
+    return TRUE;
+}
+
+static          BOOL
+prvxMBTCPPortNextRequest( xMBTCPConnection * pxConn, BOOL * pxComplete )
+{
+    /* TCP is a stream: a request may arrive in several segments and several
+     * requests in one. The length field of the MBAP header gives the end. */
+    const UCHAR    *pucADU = &pxConn->aucStream[pxConn->usStreamStart];
+    USHORT          usLen;
+
+    *pxComplete = FALSE;
+    if( pxConn->usStreamLength < MB_TCP_FUNC )
+    {
+        return TRUE;
+    }
+    usLen = ( USHORT )( ( pucADU[MB_TCP_LEN] << 8 ) | pucADU[MB_TCP_LEN + 1] );
+    if( ( pucADU[MB_TCP_PID] != 0 ) || ( pucADU[MB_TCP_PID + 1] != MB_TCP_PROTOCOL_ID ) ||
+        ( usLen < MB_TCP_LEN_MIN ) || ( usLen > MB_TCP_LEN_MAX ) )
+    {
+        /* Not Modbus or out of step, the stream can not be resynchronized. */
+        return FALSE;
+    }
+    if( pxConn->usStreamLength < MB_TCP_UID + usLen )
+    {
+        return TRUE;
+    }
+    pxConn->usFrameLength = ( USHORT )( MB_TCP_UID + usLen );
+    memcpy( pxConn->aucFrame, pucADU, pxConn->usFrameLength );
+    pxConn->usStreamStart += pxConn->usFrameLength;
+    pxConn->usStreamLength -= pxConn->usFrameLength;
+    *pxComplete = TRUE;
+    return TRUE;
+}
+
+static void
+prvvMBTCPPortHandler( xMBPortPosixSource * pxSource, ULONG ulEvents )
+{
+    xMBTCPConnection *pxConn = ( xMBTCPConnection * ) pxSource->pvArg;
+    ssize_t         iRead;
+    BOOL            xComplete = FALSE;
+    int             iRequests;
+
+    if( ( ulEvents & ( EPOLLERR | EPOLLHUP ) ) || ( ( ulEvents & EPOLLOUT ) && !prvxMBTCPPortFlush( pxConn ) ) )
+    {
+        prvvMBTCPPortDrop( pxConn );
+        return;
+    }
+    if( ( ulEvents & EPOLLIN ) && ( pxConn->usStreamLength < MB_TCP_STREAM_SIZE ) )
+    {
+        /* The rest of the previous batch is moved to the front first. The
+         * stream is not read while it is full: a read of zero bytes would
+         * return 0 as if the client had closed the connection. */
+        if( pxConn->usStreamStart > 0 )
+        {
+            memmove( pxConn->aucStream, &pxConn->aucStream[pxConn->usStreamStart], pxConn->usStreamLength );
+            pxConn->usStreamStart = 0;
+        }
+        iRead = recv( pxSource->iFd, &pxConn->aucStream[pxConn->usStreamLength],
+                      MB_TCP_STREAM_SIZE - pxConn->usStreamLength, 0 );
+        if( ( iRead == 0 ) || ( ( iRead < 0 ) && ( errno != EAGAIN ) && ( errno != EWOULDBLOCK ) ) )
+        {
+            prvvMBTCPPortDrop( pxConn );
+            return;
+        }
+        if( iRead > 0 )
+        {
+            pxConn->usStreamLength += ( USHORT ) iRead;
+            pxConn->ulLastRequest = ulMBPortPosixGetTick(  );
+        }
+    }
+
+    /* All complete requests of a client which pipelines its requests, as
+     * long as the responses can be sent. */
+    for( iRequests = 0; ( iRequests < MB_TCP_PORT_REQUESTS_PER_POLL ) && ( pxConn->usTxLength == 0 ); iRequests++ )
+    {
+        if( !prvxMBTCPPortNextRequest( pxConn, &xComplete ) )
+        {
+            prvvMBTCPPortDrop( pxConn );
+            return;
+        }
+        if( !xComplete || ( pxMBTCPInstance == NULL ) )
+        {
+            break;
+        }
+        ucMBTCPCurConnection = ( UCHAR )( pxConn - xMBTCPConnections );
+        ( void )xMBPortEventPostTransport( pxMBTCPInstance, MB_EV_TRANSPORT_TCP, EV_FRAME_RECEIVED );
+        ( void )eMBInstPoll( pxMBTCPInstance );
+    }
+    /* More requests are left, the other connections go first. */
+    if( xComplete && ( pxConn->usTxLength == 0 ) )
+    {
+        vMBPortPosixPend( &pxConn->xSource );
+    }
+    prvvMBTCPPortWatch( pxConn );
+}
+
+static void
+prvvMBTCPPortTimer( xMBPortPosixSource * pxSource, ULONG ulEvents )
+{
+    ULONG           ulNow = ulMBPortPosixGetTick(  );
+    int             i;
+
+    for( i = 0; i < MB_TCP_PORT_CONNECTIONS; i++ )
+    {
+        if( xMBTCPConnections[i].xIsConnected && ( MB_TCP_PORT_IDLE_TIMEOUT_MS > 0 ) &&
+            ( ( ulNow - xMBTCPConnections[i].ulLastRequest ) >= MB_TCP_PORT_IDLE_TIMEOUT_MS ) )
+        {
+            /* Make room for other clients. */
+            prvvMBTCPPortDrop( &xMBTCPConnections[i] );
+        }
+    }
+#if MB_GATEWAY_ENABLED > 0
+    /* Responses of RTU slaves behind the gateway. */
+    vMBGatewayPoll(  );
+#endif
+}
+
+/* ----------------------- Start implementation -----------------------------*/
+BOOL
+xMBTCPPortInit( xMBInstance * pxInst, USHORT usTCPPort )
+{
+    struct sockaddr_in xAddr;
+    int             iFd;
+    int             iOne = 1;
+    int             i;
+
+    pxMBTCPInstance = pxInst;
+    if( xMBTCPListen.iFd >= 0 )
+    {
+        return TRUE;
+    }
+    for( i = 0; i < MB_TCP_PORT_CONNECTIONS; i++ )
+    {
+        xMBTCPConnections[i].xSource.iFd = -1;
+        xMBTCPConnections[i].xIsConnected = FALSE;
+    }
+
+    iFd = socket( AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+    if( iFd < 0 )
+    {
+        return FALSE;
+    }
+    ( void )setsockopt( iFd, SOL_SOCKET, SO_REUSEADDR, &iOne, sizeof( iOne ) );
+    memset( &xAddr, 0, sizeof( xAddr ) );
+    xAddr.sin_family = AF_INET;
+    xAddr.sin_addr.s_addr = htonl( INADDR_ANY );
+    xAddr.sin_port = htons( ( usTCPPort == 0 ) ? MB_TCP_DEFAULT_PORT : usTCPPort );
+    if( ( bind( iFd, ( struct sockaddr * )&xAddr, sizeof( xAddr ) ) != 0 ) ||
+        ( listen( iFd, MB_TCP_PORT_CONNECTIONS ) != 0 ) )
+    {
+        ( void )close( iFd );
+        return FALSE;
+    }
+    xMBTCPListen.iFd = iFd;
+    xMBTCPListen.pvHandler = prvvMBTCPPortAccept;
+    xMBTCPTimer.iFd = -1;
+    xMBTCPTimer.pvHandler = prvvMBTCPPortTimer;
+    if( !xMBPortPosixAdd( &xMBTCPListen, EPOLLIN ) || !xMBPortPosixAdd( &xMBTCPTimer, 0 ) )
+    {
+        vMBTCPPortClose(  );
+        return FALSE;
+    }
+    return TRUE;
+}
+
+void
+vMBTCPPortClose( void )
+{
+    vMBTCPPortDisable(  );
+    if( xMBTCPListen.iFd >= 0 )
+    {
+        vMBPortPosixRemove( &xMBTCPListen );
+        vMBPortPosixRemove( &xMBTCPTimer );
+        ( void )close( xMBTCPListen.iFd );
+        xMBTCPListen.iFd = -1;
+    }
+}
+
+void
+vMBTCPPortDisable( void )
+{
+    int             i;
+
+    for( i = 0; i < MB_TCP_PORT_CONNECTIONS; i++ )
+    {
+        if( xMBTCPConnections[i].xIsConnected )
+        {
+            prvvMBTCPPortDrop( &xMBTCPConnections[i] );
+        }
+    }
+}
+
+BOOL
+xMBTCPPortGetRequest( UCHAR ** ppucMBTCPFrame, USHORT * usTCPLength )
+{
+    *ppucMBTCPFrame = xMBTCPConnections[ucMBTCPCurConnection].aucFrame;
+    *usTCPLength = xMBTCPConnections[ucMBTCPCurConnection].usFrameLength;
+    return TRUE;
+}
+
+UCHAR
+ucMBTCPPortGetConnection( void )
+{
+    return ucMBTCPCurConnection;
+}
+
+BOOL
+xMBTCPPortSendResponse( const UCHAR * pucMBTCPFrame, USHORT usTCPLength )
+{
+    return xMBTCPPortSendResponseTo( ucMBTCPCurConnection, pucMBTCPFrame, usTCPLength );
+}
+
+BOOL
+xMBTCPPortSendResponseTo( UCHAR ucConnection, const UCHAR * pucMBTCPFrame, USHORT usTCPLength )
+{
+    xMBTCPConnection *pxConn;
+
+    if( ucConnection >= MB_TCP_PORT_CONNECTIONS )
+    {
+        return FALSE;
+    }
+    pxConn = &xMBTCPConnections[ucConnection];
+    if( !pxConn->xIsConnected )
+    {
+        return FALSE;
+    }
+    return prvxMBTCPPortSend( pxConn, pucMBTCPFrame, usTCPLength );
+}
+
+#endif
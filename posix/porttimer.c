@@ -0,0 +1,142 @@
+/* 
+ * FreeModbus Libary: A portable Modbus implementation for Modbus ASCII/RTU.
+ * Copyright (c) 2006-2018 Christian Walter <cwalter@embedded-solutions.at>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* ----------------------- System includes ----------------------------------*/
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "mbport.h"
+#include "mbinstance.h"
+
+/* ----------------------- Type definitions ---------------------------------*/
+/* One timerfd per serial port, in the same order as in portserial.c. */
+typedef struct
+{
+    xMBPortPosixSource xSource;
+    xMBInstance    *pxInst;
+    ULONG           ulTimeoutUs;
+} xMBPortTimer;
+
+/* ----------------------- Static variables ---------------------------------*/
+static xMBPortTimer xMBPortTimers[MB_PORT_POSIX_SERIAL_PORTS];
+
+#define MB_PORT_TIMER_GET( pxInst ) ( &xMBPortTimers[( pxInst )->ucPort > 0 ? ( pxInst )->ucPort - 1 : 0] )
+
+/* ----------------------- Static functions ---------------------------------*/
+static void
+prvvMBPortTimerExpired( xMBPortPosixSource * pxSource, ULONG ulEvents )
+{
+    xMBPortTimer   *pxTimer = ( xMBPortTimer * ) pxSource->pvArg;
+    uint64_t        ullExpirations;
+
+    /* Disarmed in the meantime if nothing can be read. */
+    if( read( pxSource->iFd, &ullExpirations, sizeof( ullExpirations ) ) == sizeof( ullExpirations ) )
+    {
+        ( void )xMBPortCBTimerExpired( pxTimer->pxInst );
+    }
+}
+
+static void
+prvvMBPortTimerSet( xMBPortTimer * pxTimer, ULONG ulTimeoutUs )
+{
+    struct itimerspec xTime = { { 0, 0 }, { 0, 0 } };
+
+    /* One shot, a timeout of 0 disarms the timer. */
+    xTime.it_value.tv_sec = ulTimeoutUs / 1000000U;
+    xTime.it_value.tv_nsec = ( long )( ulTimeoutUs % 1000000U ) * 1000L;
+    ( void )timerfd_settime( pxTimer->xSource.iFd, 0, &xTime, NULL );
+}
+
+/* ----------------------- Start implementation -----------------------------*/
+BOOL
+xMBPortTimersInit( xMBInstance * pxInst, USHORT usTim1Timerout50us )
+{
+    xMBPortTimer   *pxTimer;
+
+    if( pxInst->ucPort > MB_PORT_POSIX_SERIAL_PORTS )
+    {
+        return FALSE;
+    }
+    pxTimer = MB_PORT_TIMER_GET( pxInst );
+    if( pxTimer->pxInst == NULL )
+    {
+        pxTimer->xSource.iFd = timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC );
+        pxTimer->xSource.pvHandler = prvvMBPortTimerExpired;
+        pxTimer->xSource.pvArg = pxTimer;
+        if( ( pxTimer->xSource.iFd < 0 ) || !xMBPortPosixAdd( &pxTimer->xSource, EPOLLIN ) )
+        {
+            return FALSE;
+        }
+    }
+    pxTimer->pxInst = pxInst;
+    pxTimer->ulTimeoutUs = ( ULONG ) usTim1Timerout50us * 50U;
+    return TRUE;
+}
+
+void
+xMBPortTimersClose( xMBInstance * pxInst )
+{
+    xMBPortTimer   *pxTimer = MB_PORT_TIMER_GET( pxInst );
+
+    if( pxTimer->pxInst != NULL )
+    {
+        vMBPortPosixRemove( &pxTimer->xSource );
+        ( void )close( pxTimer->xSource.iFd );
+        pxTimer->pxInst = NULL;
+    }
+}
+
+void
+vMBPortTimersEnable( xMBInstance * pxInst )
+{
+    /* Restarts the timeout, also if it is already running. */
+    xMBPortTimer   *pxTimer = MB_PORT_TIMER_GET( pxInst );
+
+    prvvMBPortTimerSet( pxTimer, pxTimer->ulTimeoutUs );
+}
+
+void
+vMBPortTimersDisable( xMBInstance * pxInst )
+{
+    prvvMBPortTimerSet( MB_PORT_TIMER_GET( pxInst ), 0 );
+}
+
+void
+vMBPortTimersDelay( USHORT usTimeOutMS )
+{
+    struct timespec xDelay;
+
+    xDelay.tv_sec = usTimeOutMS / 1000U;
+    xDelay.tv_nsec = ( long )( usTimeOutMS % 1000U ) * 1000000L;
+    ( void )nanosleep( &xDelay, NULL );
+}
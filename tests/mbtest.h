@@ -0,0 +1,66 @@
+/* 
+ * FreeModbus Libary: A portable Modbus implementation for Modbus ASCII/RTU.
+ * Copyright (c) 2006-2018 Christian Walter <cwalter@embedded-solutions.at>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef _MB_TEST_H
+#define _MB_TEST_H
+
+/* ----------------------- System includes ----------------------------------*/
+#include <stdio.h>
+
+/* Host tests of the protocol stack. Each test program runs its cases with
+ * MB_TEST_RUN( ) and returns MB_TEST_RESULT( ) from main( ), which is
+ * non-zero if a check failed. A failed check prints its location and the
+ * case goes on.
+ */
+
+/* ----------------------- Static variables ---------------------------------*/
+static int      iMBTestFailures;
+
+/* ----------------------- Defines ------------------------------------------*/
+#define MB_TEST_CHECK( xCondition ) \
+    do \
+    { \
+        if( !( xCondition ) ) \
+        { \
+            fprintf( stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #xCondition ); \
+            iMBTestFailures++; \
+        } \
+    } while( 0 )
+
+#define MB_TEST_RUN( pvCase ) \
+    do \
+    { \
+        int iFailuresBefore = iMBTestFailures; \
+        pvCase(  ); \
+        printf( "%-48s %s\n", #pvCase, iMBTestFailures == iFailuresBefore ? "ok" : "FAILED" ); \
+    } while( 0 )
+
+#define MB_TEST_RESULT(  )  ( iMBTestFailures == 0 ? 0 : 1 )
+
+#endif
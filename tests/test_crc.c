@@ -0,0 +1,157 @@
+/* 
+ * FreeModbus Libary: A portable Modbus implementation for Modbus ASCII/RTU.
+ * Copyright (c) 2006-2018 Christian Walter <cwalter@embedded-solutions.at>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* ----------------------- System includes ----------------------------------*/
+#include <string.h>
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "port.h"
+#include "mbconfig.h"
+#include "mbcrc.h"
+#include "mbtest.h"
+
+/* Tests of the CRC-16 in function/mbcrc.c. The program is built once per
+ * MB_CRC_BACKEND and compares the backend with a bitwise implementation.
+ */
+
+/* ----------------------- Defines ------------------------------------------*/
+#define TEST_DATA_SIZE          300     /*!< More than the largest RTU frame. */
+
+/* ----------------------- Static variables ---------------------------------*/
+static UCHAR    aucData[TEST_DATA_SIZE + 8];
+
+/* ----------------------- Static functions ---------------------------------*/
+static          USHORT
+prvusReference( const UCHAR * pucData, USHORT usLen )
+{
+    USHORT          usCRC = MB_CRC16_INIT;
+    int             i;
+
+    while( usLen-- )
+    {
+        usCRC ^= *( pucData++ );
+        for( i = 0; i < 8; i++ )
+        {
+            usCRC = ( usCRC & 0x0001 ) ? ( USHORT )( ( usCRC >> 1 ) ^ 0xA001 ) : ( USHORT )( usCRC >> 1 );
+        }
+    }
+    return usCRC;
+}
+
+static void
+prvvFill( void )
+{
+    ULONG           ulSeed = 1;
+    size_t          i;
+
+    for( i = 0; i < sizeof( aucData ); i++ )
+    {
+        ulSeed = ulSeed * 1103515245U + 12345U;
+        aucData[i] = ( UCHAR )( ulSeed >> 16 );
+    }
+}
+
+/* ----------------------- Test cases ---------------------------------------*/
+static void
+prvvTestCheckValue( void )
+{
+    UCHAR           aucCheck[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+    /* Read holding register 0 of slave 1, sent as 0x84 0x0A. */
+    UCHAR           aucFrame[] = { 0x01, 0x03, 0x00, 0x00, 0x00, 0x01 };
+
+    MB_TEST_CHECK( usMBCRC16( aucCheck, sizeof( aucCheck ) ) == 0x4B37 );
+    MB_TEST_CHECK( usMBCRC16( aucFrame, sizeof( aucFrame ) ) == 0x0A84 );
+    MB_TEST_CHECK( usMBCRC16( aucFrame, 0 ) == MB_CRC16_INIT );
+}
+
+static void
+prvvTestLengths( void )
+{
+    USHORT          usLen;
+    USHORT          usOffset;
+
+    /* All lengths, at every alignment the slices can see. */
+    for( usOffset = 0; usOffset < 8; usOffset++ )
+    {
+        for( usLen = 0; usLen <= TEST_DATA_SIZE; usLen++ )
+        {
+            MB_TEST_CHECK( usMBCRC16( &aucData[usOffset], usLen ) == prvusReference( &aucData[usOffset], usLen ) );
+        }
+    }
+}
+
+static void
+prvvTestStreaming( void )
+{
+    USHORT          usExpected = prvusReference( aucData, 256 );
+    USHORT          usCRC;
+    USHORT          usSplit;
+    USHORT          i;
+
+    for( usSplit = 0; usSplit <= 256; usSplit++ )
+    {
+        usCRC = usMBCRC16Init(  );
+        usCRC = usMBCRC16Update( usCRC, aucData, usSplit );
+        usCRC = usMBCRC16Update( usCRC, &aucData[usSplit], ( USHORT )( 256 - usSplit ) );
+        MB_TEST_CHECK( usMBCRC16Final( usCRC ) == usExpected );
+    }
+    /* Byte by byte, like the RTU receiver. */
+    usCRC = MB_CRC16_INIT;
+    for( i = 0; i < 256; i++ )
+    {
+        usCRC = usMBCRC16UpdateByte( usCRC, aucData[i] );
+    }
+    MB_TEST_CHECK( usCRC == usExpected );
+}
+
+static void
+prvvTestResidue( void )
+{
+    UCHAR           aucFrame[TEST_DATA_SIZE];
+    USHORT          usCRC;
+
+    /* A frame followed by its CRC, low byte first, checks to 0. */
+    memcpy( aucFrame, aucData, 254 );
+    usCRC = usMBCRC16( aucFrame, 254 );
+    aucFrame[254] = ( UCHAR )( usCRC & 0xFF );
+    aucFrame[255] = ( UCHAR )( usCRC >> 8 );
+    MB_TEST_CHECK( usMBCRC16( aucFrame, 256 ) == 0 );
+}
+
+/* ----------------------- Start implementation -----------------------------*/
+int
+main( void )
+{
+    prvvFill(  );
+    MB_TEST_RUN( prvvTestCheckValue );
+    MB_TEST_RUN( prvvTestLengths );
+    MB_TEST_RUN( prvvTestStreaming );
+    MB_TEST_RUN( prvvTestResidue );
+    return MB_TEST_RESULT(  );
+}
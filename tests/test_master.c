@@ -0,0 +1,257 @@
+/* 
+ * FreeModbus Libary: A portable Modbus implementation for Modbus ASCII/RTU.
+ * Copyright (c) 2006-2018 Christian Walter <cwalter@embedded-solutions.at>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* ----------------------- System includes ----------------------------------*/
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "mb.h"
+#include "mbport.h"
+#include "mbcrc.h"
+#include "mbinstance.h"
+#include "mbmaster.h"
+#include "mbtest.h"
+
+/* Tests of the retries of the Modbus RTU master in function/mbmaster.c. The
+ * master runs on the POSIX port with the slave side of a pseudo terminal,
+ * the test plays the slave on the other side and answers as each case
+ * scripts it.
+ */
+
+/* ----------------------- Defines ------------------------------------------*/
+#define TEST_BAUDRATE           1200    /*!< t1.5 is 13.75 ms, slow enough for a byte-wise reply. */
+#define TEST_SLAVE_ADDRESS      10
+#define TEST_TIMEOUT_MS         100
+#define TEST_REQUEST_SIZE       8       /*!< Read holding registers. */
+#define TEST_TURNAROUND_MS      5       /*!< Until the slave replies. */
+#define TEST_BYTE_GAP_MS        4       /*!< Between the bytes of a late reply. */
+#define TEST_LATE_LEAD_MS       12      /*!< A late reply starts this long before the timeout. */
+#define TEST_RUN_MAX_MS         3000
+#define TEST_SETTLE_MS          100     /*!< Longer than t3.5. */
+
+/* ----------------------- Type definitions ---------------------------------*/
+typedef enum
+{
+    SLAVE_ANSWER,               /*!< Replies at once. */
+    SLAVE_SILENT,               /*!< Does not reply. */
+    SLAVE_LATE                  /*!< Reply spans the response timeout. */
+} eTestSlaveAction;
+
+/* ----------------------- Static variables ---------------------------------*/
+static xMBInstance *pxMaster;
+static int      iPty = -1;
+static eTestSlaveAction eFirstAction;  /* For the first request. */
+static eTestSlaveAction eNextAction;    /* For the retries. */
+static unsigned uRequests;
+static UCHAR    aucRx[TEST_REQUEST_SIZE];
+static unsigned uRxLength;
+static UCHAR    aucReply[16];
+static unsigned uReplyLength;
+static unsigned uReplySent;
+static ULONG    ulReplyNext;            /* Tick of the reply or of its next byte. */
+static BOOL     xByteWise;
+
+/* ----------------------- Static functions ---------------------------------*/
+static void
+prvvSlaveReply( void )
+{
+    USHORT          usCRC16;
+
+    aucReply[0] = TEST_SLAVE_ADDRESS;
+    aucReply[1] = MB_FUNC_READ_HOLDING_REGISTER;
+    aucReply[2] = 2;
+    aucReply[3] = 0x12;
+    aucReply[4] = 0x34;
+    usCRC16 = usMBCRC16( aucReply, 5 );
+    aucReply[5] = ( UCHAR )( usCRC16 & 0xFF );
+    aucReply[6] = ( UCHAR )( usCRC16 >> 8 );
+    uReplyLength = 7;
+    uReplySent = 0;
+}
+
+static void
+prvvSlaveService( void )
+{
+    eTestSlaveAction eAction;
+    UCHAR           ucByte;
+    unsigned        uCount;
+
+    while( read( iPty, &ucByte, 1 ) == 1 )
+    {
+        aucRx[uRxLength++] = ucByte;
+        if( uRxLength < TEST_REQUEST_SIZE )
+        {
+            continue;
+        }
+        uRxLength = 0;
+        eAction = ( uRequests == 0 ) ? eFirstAction : eNextAction;
+        uRequests++;
+        if( eAction == SLAVE_ANSWER )
+        {
+            prvvSlaveReply(  );
+            ulReplyNext = MB_PORT_GET_TICK(  ) + TEST_TURNAROUND_MS;
+            xByteWise = FALSE;
+        }
+        else if( eAction == SLAVE_LATE )
+        {
+            prvvSlaveReply(  );
+            ulReplyNext = MB_PORT_GET_TICK(  ) + TEST_TIMEOUT_MS - TEST_LATE_LEAD_MS;
+            xByteWise = TRUE;
+        }
+    }
+    /* A late reply goes out byte by byte, so that the receiver of the master
+     * is busy when the response timeout expires. */
+    if( ( uReplySent < uReplyLength ) && ( ( LONG )( MB_PORT_GET_TICK(  ) - ulReplyNext ) >= 0 ) )
+    {
+        uCount = xByteWise ? 1 : uReplyLength - uReplySent;
+        ( void )write( iPty, &aucReply[uReplySent], uCount );
+        uReplySent += uCount;
+        ulReplyNext += TEST_BYTE_GAP_MS;
+    }
+}
+
+static void
+prvvSetup( eTestSlaveAction eFirst, eTestSlaveAction eNext )
+{
+    eFirstAction = eFirst;
+    eNextAction = eNext;
+    uRequests = 0;
+    uRxLength = 0;
+    uReplyLength = 0;
+    uReplySent = 0;
+}
+
+static void
+prvvRun( xMBMasterRequest * pxReq )
+{
+    USHORT          usValue = 0;
+    ULONG           ulStart = MB_PORT_GET_TICK(  );
+
+    memset( pxReq, 0, sizeof( *pxReq ) );
+    pxReq->ucSlaveAddress = TEST_SLAVE_ADDRESS;
+    pxReq->ucFunctionCode = MB_FUNC_READ_HOLDING_REGISTER;
+    pxReq->usAddress = 0;
+    pxReq->usCount = 1;
+    pxReq->pusRegs = &usValue;
+    pxReq->usTimeoutMs = TEST_TIMEOUT_MS;
+    MB_TEST_CHECK( eMBMasterSubmit( pxMaster, pxReq ) == MB_ENOERR );
+    while( pxReq->xBusy && ( ( MB_PORT_GET_TICK(  ) - ulStart ) < TEST_RUN_MAX_MS ) )
+    {
+        ( void )eMBInstPollWait( pxMaster, 1 );
+        prvvSlaveService(  );
+    }
+    MB_TEST_CHECK( !pxReq->xBusy );
+    if( !pxReq->xBusy && ( pxReq->eStatus == MB_ENOERR ) )
+    {
+        MB_TEST_CHECK( usValue == 0x1234 );
+    }
+    /* A late reply ends and the line becomes idle before the next case. */
+    ulStart = MB_PORT_GET_TICK(  );
+    while( ( uReplySent < uReplyLength ) || ( ( MB_PORT_GET_TICK(  ) - ulStart ) < TEST_SETTLE_MS ) )
+    {
+        ( void )eMBInstPollWait( pxMaster, 1 );
+        prvvSlaveService(  );
+    }
+}
+
+/* ----------------------- Test cases ---------------------------------------*/
+static void
+prvvTestAnswered( void )
+{
+    xMBMasterRequest xReq;
+
+    prvvSetup( SLAVE_ANSWER, SLAVE_ANSWER );
+    prvvRun( &xReq );
+    MB_TEST_CHECK( xReq.eStatus == MB_ENOERR );
+    MB_TEST_CHECK( uRequests == 1 );
+}
+
+static void
+prvvTestRetried( void )
+{
+    xMBMasterRequest xReq;
+
+    prvvSetup( SLAVE_SILENT, SLAVE_ANSWER );
+    prvvRun( &xReq );
+    MB_TEST_CHECK( xReq.eStatus == MB_ENOERR );
+    MB_TEST_CHECK( uRequests == 2 );
+}
+
+static void
+prvvTestSilent( void )
+{
+    xMBMasterRequest xReq;
+
+    prvvSetup( SLAVE_SILENT, SLAVE_SILENT );
+    prvvRun( &xReq );
+    MB_TEST_CHECK( xReq.eStatus == MB_ETIMEDOUT );
+    MB_TEST_CHECK( uRequests == 1 + MB_MASTER_RETRIES );
+}
+
+static void
+prvvTestLate( void )
+{
+    xMBMasterRequest xReq;
+
+    /* Each retry finds the receiver busy with the late reply to the try
+     * before. This must not start the count of the tries again. */
+    prvvSetup( SLAVE_LATE, SLAVE_LATE );
+    prvvRun( &xReq );
+    MB_TEST_CHECK( xReq.eStatus == MB_ETIMEDOUT );
+    MB_TEST_CHECK( uRequests == 1 + MB_MASTER_RETRIES );
+}
+
+/* ----------------------- Start implementation -----------------------------*/
+int
+main( void )
+{
+    iPty = posix_openpt( O_RDWR | O_NOCTTY );
+    if( ( iPty < 0 ) || ( grantpt( iPty ) != 0 ) || ( unlockpt( iPty ) != 0 ) ||
+        ( fcntl( iPty, F_SETFL, O_NONBLOCK ) != 0 ) )
+    {
+        fprintf( stderr, "no pseudo terminal\n" );
+        return 1;
+    }
+    ( void )xMBPortSerialSetDevice( 1, ptsname( iPty ) );
+    if( ( eMBMasterInit( &pxMaster, 1, TEST_BAUDRATE, MB_PAR_EVEN ) != MB_ENOERR ) ||
+        ( eMBInstEnable( pxMaster ) != MB_ENOERR ) )
+    {
+        fprintf( stderr, "master not initialized\n" );
+        return 1;
+    }
+
+    MB_TEST_RUN( prvvTestAnswered );
+    MB_TEST_RUN( prvvTestRetried );
+    MB_TEST_RUN( prvvTestSilent );
+    MB_TEST_RUN( prvvTestLate );
+    return MB_TEST_RESULT(  );
+}
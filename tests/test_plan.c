@@ -0,0 +1,476 @@
+/* 
+ * FreeModbus Libary: A portable Modbus implementation for Modbus ASCII/RTU.
+ * Copyright (c) 2006-2018 Christian Walter <cwalter@embedded-solutions.at>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* ----------------------- System includes ----------------------------------*/
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "mb.h"
+#include "mbport.h"
+#include "mbcrc.h"
+#include "mbinstance.h"
+#include "mbmaster.h"
+#include "mbplan.h"
+#include "mbtest.h"
+
+/* Tests of the polling plan in function/mbplan.c. The merging and splitting
+ * of the tags into blocks is checked on the plan alone. For the periods and
+ * the scatter of the results to the tags the plan runs on a master with the
+ * POSIX port, the test plays the slaves on the other side of a pseudo
+ * terminal and answers every read with values derived from the addresses.
+ */
+
+/* ----------------------- Defines ------------------------------------------*/
+#define TEST_BAUDRATE           38400
+#define TEST_SLAVE_ADDRESS      10
+#define TEST_FAULTY_ADDRESS     12      /*!< Answers with an exception. */
+#define TEST_REQUEST_SIZE       8       /*!< All reads. */
+#define TEST_REPLY_SIZE         256
+#define TEST_TURNAROUND_MS      5       /*!< Until the slave replies. */
+#define TEST_SETTLE_MS          20      /*!< Longer than t3.5. */
+#define TEST_RUN_MAX_MS         3000
+#define TEST_LOG_SIZE           256
+#define TEST_TAGS_MAX           130
+#define TEST_BLOCKS_MAX         8
+#define TEST_PERIOD_IDLE        0xFFFF  /*!< Not due again within a case. */
+
+/* ----------------------- Type definitions ---------------------------------*/
+typedef struct
+{
+    UCHAR           ucSlaveAddress;
+    UCHAR           ucFunctionCode;
+    USHORT          usAddress;
+    USHORT          usCount;
+} xTestRead;
+
+/* ----------------------- Static variables ---------------------------------*/
+static xMBInstance *pxMaster;
+static int      iPty = -1;
+static UCHAR    aucRx[TEST_REQUEST_SIZE];
+static unsigned uRxLength;
+static UCHAR    aucReply[TEST_REPLY_SIZE];
+static unsigned uReplyLength;
+static ULONG    ulReplyAt;
+static xTestRead xLog[TEST_LOG_SIZE];
+static unsigned uLogLength;
+
+static xMBTag   xTags[TEST_TAGS_MAX];
+static xMBPlanBlock xBlocks[TEST_BLOCKS_MAX];
+static xMBPlan  xPlan;
+
+/* ----------------------- Static functions ---------------------------------*/
+static          USHORT
+prvusSlaveRegister( UCHAR ucFunctionCode, USHORT usAddress )
+{
+    return ( USHORT )( usAddress * 7 + ( ucFunctionCode == MB_FUNC_READ_INPUT_REGISTER ? 0x8000 : 1 ) );
+}
+
+static          UCHAR
+prvucSlaveBit( UCHAR ucFunctionCode, USHORT usAddress )
+{
+    return ( UCHAR )( ucFunctionCode == MB_FUNC_READ_COILS ? usAddress % 3 == 0 : usAddress % 5 == 0 );
+}
+
+static void
+prvvSlaveReply( void )
+{
+    UCHAR           ucFunctionCode = aucRx[1];
+    USHORT          usAddress = ( USHORT )( ( aucRx[2] << 8 ) | aucRx[3] );
+    USHORT          usCount = ( USHORT )( ( aucRx[4] << 8 ) | aucRx[5] );
+    USHORT          usCRC16;
+    USHORT          usValue;
+    USHORT          i;
+
+    if( uLogLength < TEST_LOG_SIZE )
+    {
+        xLog[uLogLength].ucSlaveAddress = aucRx[0];
+        xLog[uLogLength].ucFunctionCode = ucFunctionCode;
+        xLog[uLogLength].usAddress = usAddress;
+        xLog[uLogLength].usCount = usCount;
+        uLogLength++;
+    }
+
+    aucReply[0] = aucRx[0];
+    aucReply[1] = ucFunctionCode;
+    if( aucRx[0] == TEST_FAULTY_ADDRESS )
+    {
+        aucReply[1] |= MB_FUNC_ERROR;
+        aucReply[2] = MB_EX_ILLEGAL_DATA_ADDRESS;
+        uReplyLength = 3;
+    }
+    else if( ( ucFunctionCode == MB_FUNC_READ_COILS ) || ( ucFunctionCode == MB_FUNC_READ_DISCRETE_INPUTS ) )
+    {
+        aucReply[2] = ( UCHAR )( ( usCount + 7 ) / 8 );
+        memset( &aucReply[3], 0, aucReply[2] );
+        for( i = 0; i < usCount; i++ )
+        {
+            aucReply[3 + i / 8] |= ( UCHAR )( prvucSlaveBit( ucFunctionCode, ( USHORT )( usAddress + i ) ) << ( i % 8 ) );
+        }
+        uReplyLength = 3 + aucReply[2];
+    }
+    else
+    {
+        aucReply[2] = ( UCHAR )( usCount * 2 );
+        for( i = 0; i < usCount; i++ )
+        {
+            usValue = prvusSlaveRegister( ucFunctionCode, ( USHORT )( usAddress + i ) );
+            aucReply[3 + 2 * i] = ( UCHAR )( usValue >> 8 );
+            aucReply[4 + 2 * i] = ( UCHAR )( usValue & 0xFF );
+        }
+        uReplyLength = 3 + aucReply[2];
+    }
+    usCRC16 = usMBCRC16( aucReply, ( USHORT ) uReplyLength );
+    aucReply[uReplyLength++] = ( UCHAR )( usCRC16 & 0xFF );
+    aucReply[uReplyLength++] = ( UCHAR )( usCRC16 >> 8 );
+    ulReplyAt = MB_PORT_GET_TICK(  ) + TEST_TURNAROUND_MS;
+}
+
+static void
+prvvSlaveService( void )
+{
+    UCHAR           ucByte;
+
+    while( read( iPty, &ucByte, 1 ) == 1 )
+    {
+        aucRx[uRxLength++] = ucByte;
+        if( uRxLength == TEST_REQUEST_SIZE )
+        {
+            uRxLength = 0;
+            prvvSlaveReply(  );
+        }
+    }
+    if( ( uReplyLength > 0 ) && ( ( LONG )( MB_PORT_GET_TICK(  ) - ulReplyAt ) >= 0 ) )
+    {
+        ( void )write( iPty, aucReply, uReplyLength );
+        uReplyLength = 0;
+    }
+}
+
+static void
+prvvPoll( void )
+{
+    vMBPlanPoll( &xPlan );
+    ( void )eMBInstPollWait( pxMaster, 1 );
+    prvvSlaveService(  );
+}
+
+static void
+prvvSetTag( xMBTag * pxTag, UCHAR ucSlaveAddress, eMBTagTable eTable, USHORT usAddress,
+            eMBTagType eType, USHORT usPeriodMs )
+{
+    memset( pxTag, 0, sizeof( xMBTag ) );
+    pxTag->ucSlaveAddress = ucSlaveAddress;
+    pxTag->eTable = eTable;
+    pxTag->usAddress = usAddress;
+    pxTag->eType = eType;
+    pxTag->usPeriodMs = usPeriodMs;
+}
+
+static          eMBErrorCode
+prveInit( USHORT usTags, USHORT usGapMax )
+{
+    uLogLength = 0;
+    return eMBPlanInit( &xPlan, pxMaster, xTags, usTags, xBlocks, TEST_BLOCKS_MAX, usGapMax );
+}
+
+static void
+prvvRun( ULONG ulMs )
+{
+    ULONG           ulStart = MB_PORT_GET_TICK(  );
+    USHORT          i;
+
+    while( ( MB_PORT_GET_TICK(  ) - ulStart ) < ulMs )
+    {
+        prvvPoll(  );
+    }
+    /* The read in progress ends and the line becomes idle before the plan
+     * is built again for the next case. */
+    for( i = 0; i < xPlan.usBlocks; i++ )
+    {
+        xBlocks[i].usPeriodMs = TEST_PERIOD_IDLE;
+    }
+    ulStart = MB_PORT_GET_TICK(  );
+    while( ( xPlan.xBusy || ( uReplyLength > 0 ) ) && ( ( MB_PORT_GET_TICK(  ) - ulStart ) < TEST_RUN_MAX_MS ) )
+    {
+        prvvPoll(  );
+    }
+    MB_TEST_CHECK( !xPlan.xBusy );
+    ulStart = MB_PORT_GET_TICK(  );
+    while( ( MB_PORT_GET_TICK(  ) - ulStart ) < TEST_SETTLE_MS )
+    {
+        prvvPoll(  );
+    }
+}
+
+static          unsigned
+prvuReads( UCHAR ucFunctionCode, USHORT usAddress, USHORT usCount )
+{
+    unsigned        uReads = 0;
+    unsigned        i;
+
+    for( i = 0; i < uLogLength; i++ )
+    {
+        if( ( xLog[i].ucFunctionCode == ucFunctionCode ) && ( xLog[i].usAddress == usAddress ) &&
+            ( xLog[i].usCount == usCount ) )
+        {
+            uReads++;
+        }
+    }
+    return uReads;
+}
+
+/* ----------------------- Test cases ---------------------------------------*/
+static void
+prvvTestMerge( void )
+{
+    /* Tags closer than the gap share a block with the shortest period of
+     * its tags. Other slaves and tables get their own blocks. */
+    prvvSetTag( &xTags[0], TEST_SLAVE_ADDRESS, MB_TAG_HOLDING, 20, MB_TAG_REG16, 100 );
+    prvvSetTag( &xTags[1], TEST_SLAVE_ADDRESS, MB_TAG_HOLDING, 5, MB_TAG_REG16, 100 );
+    prvvSetTag( &xTags[2], TEST_SLAVE_ADDRESS, MB_TAG_HOLDING, 0, MB_TAG_REG16, 100 );
+    prvvSetTag( &xTags[3], TEST_SLAVE_ADDRESS, MB_TAG_HOLDING, 2, MB_TAG_REG32, 30 );
+    prvvSetTag( &xTags[4], TEST_SLAVE_ADDRESS, MB_TAG_INPUT, 1, MB_TAG_REG16, 100 );
+    prvvSetTag( &xTags[5], TEST_SLAVE_ADDRESS + 1, MB_TAG_HOLDING, 0, MB_TAG_REG16, 100 );
+    MB_TEST_CHECK( prveInit( 6, 1 ) == MB_ENOERR );
+    MB_TEST_CHECK( xPlan.usBlocks == 4 );
+
+    MB_TEST_CHECK( ( xBlocks[0].eTable == MB_TAG_HOLDING ) && ( xBlocks[0].usAddress == 0 ) );
+    MB_TEST_CHECK( ( xBlocks[0].usCount == 6 ) && ( xBlocks[0].usPeriodMs == 30 ) );
+    MB_TEST_CHECK( ( xTags[2].usBlock == 0 ) && ( xTags[3].usBlock == 0 ) && ( xTags[1].usBlock == 0 ) );
+    MB_TEST_CHECK( ( xBlocks[1].usAddress == 20 ) && ( xBlocks[1].usCount == 1 ) );
+    MB_TEST_CHECK( ( xBlocks[1].usPeriodMs == 100 ) && ( xTags[0].usBlock == 1 ) );
+    MB_TEST_CHECK( ( xBlocks[2].eTable == MB_TAG_INPUT ) && ( xTags[4].usBlock == 2 ) );
+    MB_TEST_CHECK( ( xBlocks[3].ucSlaveAddress == TEST_SLAVE_ADDRESS + 1 ) && ( xTags[5].usBlock == 3 ) );
+    /* The tags are not reordered. */
+    MB_TEST_CHECK( xTags[0].usAddress == 20 );
+
+    /* Without a gap the tags are only merged if they are adjacent. */
+    MB_TEST_CHECK( prveInit( 6, 0 ) == MB_ENOERR );
+    MB_TEST_CHECK( xPlan.usBlocks == 6 );
+}
+
+static void
+prvvTestGapBits( void )
+{
+    /* For coils and discrete inputs the gap counts 16 bits per register. */
+    prvvSetTag( &xTags[0], TEST_SLAVE_ADDRESS, MB_TAG_COIL, 0, MB_TAG_BIT, 100 );
+    prvvSetTag( &xTags[1], TEST_SLAVE_ADDRESS, MB_TAG_COIL, 17, MB_TAG_BIT, 100 );
+    MB_TEST_CHECK( prveInit( 2, 1 ) == MB_ENOERR );
+    MB_TEST_CHECK( ( xPlan.usBlocks == 1 ) && ( xBlocks[0].usCount == 18 ) );
+    xTags[1].usAddress = 18;
+    MB_TEST_CHECK( prveInit( 2, 1 ) == MB_ENOERR );
+    MB_TEST_CHECK( xPlan.usBlocks == 2 );
+
+    /* A gap of 4096 registers is 65536 bits. */
+    xTags[1].usAddress = 1000;
+    MB_TEST_CHECK( prveInit( 2, 4096 ) == MB_ENOERR );
+    MB_TEST_CHECK( ( xPlan.usBlocks == 1 ) && ( xBlocks[0].usCount == 1001 ) );
+}
+
+static void
+prvvTestSplitRegisters( void )
+{
+    USHORT          i;
+
+    /* 130 adjacent registers need two reads. */
+    for( i = 0; i < 130; i++ )
+    {
+        prvvSetTag( &xTags[i], TEST_SLAVE_ADDRESS, MB_TAG_HOLDING, i, MB_TAG_REG16, 1000 );
+    }
+    MB_TEST_CHECK( prveInit( 130, 0 ) == MB_ENOERR );
+    MB_TEST_CHECK( xPlan.usBlocks == 2 );
+    MB_TEST_CHECK( ( xBlocks[0].usAddress == 0 ) && ( xBlocks[0].usCount == MB_PLAN_REGS_MAX ) );
+    MB_TEST_CHECK( ( xBlocks[1].usAddress == 125 ) && ( xBlocks[1].usCount == 5 ) );
+
+    /* Both reads on the bus, every register ends up in its tag. */
+    prvvRun( 300 );
+    MB_TEST_CHECK( prvuReads( MB_FUNC_READ_HOLDING_REGISTER, 0, MB_PLAN_REGS_MAX ) == 1 );
+    MB_TEST_CHECK( prvuReads( MB_FUNC_READ_HOLDING_REGISTER, 125, 5 ) == 1 );
+    for( i = 0; i < 130; i++ )
+    {
+        MB_TEST_CHECK( xTags[i].eStatus == MB_ENOERR );
+        MB_TEST_CHECK( xTags[i].ulValue == prvusSlaveRegister( MB_FUNC_READ_HOLDING_REGISTER, i ) );
+    }
+
+    /* A 32 bit value is not split across two reads. */
+    prvvSetTag( &xTags[124], TEST_SLAVE_ADDRESS, MB_TAG_HOLDING, 124, MB_TAG_REG32, 1000 );
+    MB_TEST_CHECK( prveInit( 125, 0 ) == MB_ENOERR );
+    MB_TEST_CHECK( xPlan.usBlocks == 2 );
+    MB_TEST_CHECK( ( xBlocks[0].usCount == 124 ) && ( xBlocks[1].usAddress == 124 ) );
+    MB_TEST_CHECK( xBlocks[1].usCount == 2 );
+}
+
+static void
+prvvTestSplitBits( void )
+{
+    prvvSetTag( &xTags[0], TEST_SLAVE_ADDRESS, MB_TAG_COIL, 0, MB_TAG_BIT, 1000 );
+    prvvSetTag( &xTags[1], TEST_SLAVE_ADDRESS, MB_TAG_COIL, 1999, MB_TAG_BIT, 1000 );
+    prvvSetTag( &xTags[2], TEST_SLAVE_ADDRESS, MB_TAG_COIL, 2000, MB_TAG_BIT, 1000 );
+    MB_TEST_CHECK( prveInit( 3, 200 ) == MB_ENOERR );
+    MB_TEST_CHECK( xPlan.usBlocks == 2 );
+    MB_TEST_CHECK( ( xBlocks[0].usCount == MB_PLAN_BITS_MAX ) && ( xTags[1].usBlock == 0 ) );
+    MB_TEST_CHECK( ( xBlocks[1].usAddress == 2000 ) && ( xTags[2].usBlock == 1 ) );
+
+    prvvRun( 300 );
+    MB_TEST_CHECK( prvuReads( MB_FUNC_READ_COILS, 0, MB_PLAN_BITS_MAX ) == 1 );
+    MB_TEST_CHECK( prvuReads( MB_FUNC_READ_COILS, 2000, 1 ) == 1 );
+    MB_TEST_CHECK( ( xTags[0].eStatus == MB_ENOERR ) && ( xTags[0].ulValue == 1 ) );
+    MB_TEST_CHECK( ( xTags[1].eStatus == MB_ENOERR ) && ( xTags[1].ulValue == 0 ) );
+    MB_TEST_CHECK( ( xTags[2].eStatus == MB_ENOERR ) && ( xTags[2].ulValue == 0 ) );
+}
+
+static void
+prvvTestScatter( void )
+{
+    USHORT          i;
+
+    prvvSetTag( &xTags[0], TEST_SLAVE_ADDRESS, MB_TAG_HOLDING, 3, MB_TAG_REG16, 1000 );
+    prvvSetTag( &xTags[1], TEST_SLAVE_ADDRESS, MB_TAG_HOLDING, 5, MB_TAG_REG32, 1000 );
+    prvvSetTag( &xTags[2], TEST_SLAVE_ADDRESS, MB_TAG_HOLDING, 8, MB_TAG_REG32_SWAPPED, 1000 );
+    prvvSetTag( &xTags[3], TEST_SLAVE_ADDRESS, MB_TAG_INPUT, 4, MB_TAG_REG16, 1000 );
+    prvvSetTag( &xTags[4], TEST_SLAVE_ADDRESS, MB_TAG_COIL, 3, MB_TAG_BIT, 1000 );
+    prvvSetTag( &xTags[5], TEST_SLAVE_ADDRESS, MB_TAG_COIL, 7, MB_TAG_BIT, 1000 );
+    prvvSetTag( &xTags[6], TEST_SLAVE_ADDRESS, MB_TAG_COIL, 9, MB_TAG_BIT, 1000 );
+    prvvSetTag( &xTags[7], TEST_SLAVE_ADDRESS, MB_TAG_DISCRETE, 10, MB_TAG_BIT, 1000 );
+    prvvSetTag( &xTags[8], TEST_FAULTY_ADDRESS, MB_TAG_HOLDING, 0, MB_TAG_REG16, 1000 );
+    xTags[8].ulValue = 0xDEAD;
+    MB_TEST_CHECK( prveInit( 9, 4 ) == MB_ENOERR );
+    MB_TEST_CHECK( xPlan.usBlocks == 5 );
+
+    prvvRun( 300 );
+    MB_TEST_CHECK( uLogLength == 5 );
+    MB_TEST_CHECK( prvuReads( MB_FUNC_READ_COILS, 3, 7 ) == 1 );
+    MB_TEST_CHECK( prvuReads( MB_FUNC_READ_DISCRETE_INPUTS, 10, 1 ) == 1 );
+    MB_TEST_CHECK( prvuReads( MB_FUNC_READ_HOLDING_REGISTER, 3, 7 ) == 1 );
+    MB_TEST_CHECK( prvuReads( MB_FUNC_READ_INPUT_REGISTER, 4, 1 ) == 1 );
+    for( i = 0; i < 8; i++ )
+    {
+        MB_TEST_CHECK( xTags[i].eStatus == MB_ENOERR );
+        MB_TEST_CHECK( xTags[i].ulTimestamp != 0 );
+    }
+    MB_TEST_CHECK( xTags[0].ulValue == prvusSlaveRegister( MB_FUNC_READ_HOLDING_REGISTER, 3 ) );
+    MB_TEST_CHECK( xTags[1].ulValue == ( ( ( ULONG ) prvusSlaveRegister( MB_FUNC_READ_HOLDING_REGISTER, 5 ) << 16 ) |
+                                         prvusSlaveRegister( MB_FUNC_READ_HOLDING_REGISTER, 6 ) ) );
+    MB_TEST_CHECK( xTags[2].ulValue == ( ( ( ULONG ) prvusSlaveRegister( MB_FUNC_READ_HOLDING_REGISTER, 9 ) << 16 ) |
+                                         prvusSlaveRegister( MB_FUNC_READ_HOLDING_REGISTER, 8 ) ) );
+    MB_TEST_CHECK( xTags[3].ulValue == prvusSlaveRegister( MB_FUNC_READ_INPUT_REGISTER, 4 ) );
+    MB_TEST_CHECK( xTags[4].ulValue == prvucSlaveBit( MB_FUNC_READ_COILS, 3 ) );
+    MB_TEST_CHECK( xTags[5].ulValue == prvucSlaveBit( MB_FUNC_READ_COILS, 7 ) );
+    MB_TEST_CHECK( xTags[6].ulValue == prvucSlaveBit( MB_FUNC_READ_COILS, 9 ) );
+    MB_TEST_CHECK( xTags[7].ulValue == prvucSlaveBit( MB_FUNC_READ_DISCRETE_INPUTS, 10 ) );
+
+    /* An exception keeps the last value. */
+    MB_TEST_CHECK( xTags[8].eStatus == MB_EIO );
+    MB_TEST_CHECK( ( xTags[8].ulValue == 0xDEAD ) && ( xTags[8].ulTimestamp == 0 ) );
+}
+
+static void
+prvvTestPeriods( void )
+{
+    unsigned        uFast;
+    unsigned        uSlow;
+
+    /* Each block is read with its own period. */
+    prvvSetTag( &xTags[0], TEST_SLAVE_ADDRESS, MB_TAG_HOLDING, 0, MB_TAG_REG16, 50 );
+    prvvSetTag( &xTags[1], TEST_SLAVE_ADDRESS, MB_TAG_HOLDING, 100, MB_TAG_REG16, 400 );
+    MB_TEST_CHECK( prveInit( 2, 0 ) == MB_ENOERR );
+    MB_TEST_CHECK( xPlan.usBlocks == 2 );
+    prvvRun( 1000 );
+    uFast = prvuReads( MB_FUNC_READ_HOLDING_REGISTER, 0, 1 );
+    uSlow = prvuReads( MB_FUNC_READ_HOLDING_REGISTER, 100, 1 );
+    printf( "reads in 1000 ms: %u every 50 ms, %u every 400 ms\n", uFast, uSlow );
+    MB_TEST_CHECK( ( uFast >= 12 ) && ( uFast <= 21 ) );
+    MB_TEST_CHECK( ( uSlow >= 2 ) && ( uSlow <= 3 ) );
+}
+
+static void
+prvvTestCost( void )
+{
+    xMBPlanCost     xCost;
+
+    /* A read of n registers is 21 + 2n characters including the t3.5
+     * silences, see prvulMBPlanTransactionChars( ). */
+    prvvSetTag( &xTags[0], TEST_SLAVE_ADDRESS, MB_TAG_HOLDING, 0, MB_TAG_REG16, 100 );
+    prvvSetTag( &xTags[1], TEST_SLAVE_ADDRESS, MB_TAG_HOLDING, 1, MB_TAG_REG16, 100 );
+    prvvSetTag( &xTags[2], TEST_SLAVE_ADDRESS, MB_TAG_HOLDING, 2, MB_TAG_REG16, 100 );
+    prvvSetTag( &xTags[3], TEST_SLAVE_ADDRESS, MB_TAG_COIL, 0, MB_TAG_BIT, 0 );
+    MB_TEST_CHECK( prveInit( 4, 0 ) == MB_ENOERR );
+    vMBPlanGetCost( &xPlan, &xCost );
+    MB_TEST_CHECK( ( xCost.ulRequestsPerTag == 4 ) && ( xCost.ulCharsPerTag == 3 * 23 + 22 ) );
+    MB_TEST_CHECK( xCost.ulCharsPerSecPerTag == 3 * 23 * 10 );
+    MB_TEST_CHECK( ( xCost.ulRequestsMerged == 2 ) && ( xCost.ulCharsMerged == 27 + 22 ) );
+    MB_TEST_CHECK( xCost.ulCharsPerSecMerged == 27 * 10 );
+}
+
+static void
+prvvTestInvalid( void )
+{
+    prvvSetTag( &xTags[0], TEST_SLAVE_ADDRESS, MB_TAG_COIL, 0, MB_TAG_REG16, 100 );
+    MB_TEST_CHECK( prveInit( 1, 0 ) == MB_EINVAL );
+    prvvSetTag( &xTags[0], MB_ADDRESS_BROADCAST, MB_TAG_HOLDING, 0, MB_TAG_REG16, 100 );
+    MB_TEST_CHECK( prveInit( 1, 0 ) == MB_EINVAL );
+    prvvSetTag( &xTags[0], TEST_SLAVE_ADDRESS, MB_TAG_HOLDING, 0xFFFF, MB_TAG_REG32, 100 );
+    MB_TEST_CHECK( prveInit( 1, 0 ) == MB_EINVAL );
+    MB_TEST_CHECK( eMBPlanInit( &xPlan, pxMaster, xTags, 0, xBlocks, 0, 0 ) == MB_ENOERR );
+    prvvSetTag( &xTags[0], TEST_SLAVE_ADDRESS, MB_TAG_HOLDING, 0, MB_TAG_REG16, 100 );
+    MB_TEST_CHECK( eMBPlanInit( &xPlan, pxMaster, xTags, 1, xBlocks, 0, 0 ) == MB_ENORES );
+}
+
+/* ----------------------- Start implementation -----------------------------*/
+int
+main( void )
+{
+    iPty = posix_openpt( O_RDWR | O_NOCTTY );
+    if( ( iPty < 0 ) || ( grantpt( iPty ) != 0 ) || ( unlockpt( iPty ) != 0 ) ||
+        ( fcntl( iPty, F_SETFL, O_NONBLOCK ) != 0 ) )
+    {
+        fprintf( stderr, "no pseudo terminal\n" );
+        return 1;
+    }
+    ( void )xMBPortSerialSetDevice( 1, ptsname( iPty ) );
+    if( ( eMBMasterInit( &pxMaster, 1, TEST_BAUDRATE, MB_PAR_EVEN ) != MB_ENOERR ) ||
+        ( eMBInstEnable( pxMaster ) != MB_ENOERR ) )
+    {
+        fprintf( stderr, "master not initialized\n" );
+        return 1;
+    }
+
+    MB_TEST_RUN( prvvTestMerge );
+    MB_TEST_RUN( prvvTestGapBits );
+    MB_TEST_RUN( prvvTestSplitRegisters );
+    MB_TEST_RUN( prvvTestSplitBits );
+    MB_TEST_RUN( prvvTestScatter );
+    MB_TEST_RUN( prvvTestPeriods );
+    MB_TEST_RUN( prvvTestCost );
+    MB_TEST_RUN( prvvTestInvalid );
+    return MB_TEST_RESULT(  );
+}
@@ -0,0 +1,369 @@
+/* 
+ * FreeModbus Libary: A portable Modbus implementation for Modbus ASCII/RTU.
+ * Copyright (c) 2006-2018 Christian Walter <cwalter@embedded-solutions.at>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* ----------------------- System includes ----------------------------------*/
+#include <string.h>
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "mb.h"
+#include "mbport.h"
+#include "mbinstance.h"
+#include "mbtcp.h"
+#include "mbgateway.h"
+#include "network.h"
+#include "w5500sim.h"
+#include "mbtest.h"
+
+/* Tests of the Modbus TCP server of the W5500 in function/porttcp.c against
+ * the register simulator in w5500/. The protocol stack is replaced by a
+ * slave which echoes every request.
+ */
+
+/* ----------------------- Defines ------------------------------------------*/
+#define TEST_REQUEST_SIZE       12
+#define TEST_POLLS              4
+/* SPI transactions from the RECV interrupt of a request to its response. */
+#define TEST_SPI_PER_REQUEST_MAX 32
+
+/* ----------------------- Function prototypes ------------------------------*/
+extern W5500TcpSocket_TypeDef hW5500MBTCP;
+void            vModbusTCPServerPoll( W5500TcpSocket_TypeDef * stMBW5500TcpSocket );
+
+/* ----------------------- Static variables ---------------------------------*/
+static const uint8_t au8Client[4] = { 192, 168, 1, 10 };
+static xMBInstance xInstance;
+static unsigned uRequests;
+static unsigned uSendFailures;
+
+/* ----------------------- Protocol stack -----------------------------------*/
+BOOL
+xMBPortEventPostTransport( xMBInstance * pxInst, eMBEventTransport eTransport, eMBEventType eEvent )
+{
+    ( void )pxInst;
+    ( void )eTransport;
+    ( void )eEvent;
+    return TRUE;
+}
+
+eMBErrorCode
+eMBInstPoll( xMBInstance * pxInst )
+{
+    UCHAR          *pucFrame;
+    USHORT          usLength;
+
+    ( void )pxInst;
+    ( void )xMBTCPPortGetRequest( &pucFrame, &usLength );
+    uRequests++;
+    /* The response is built in place, like mbtcp.c does. */
+    if( !xMBTCPPortSendResponse( pucFrame, usLength ) )
+    {
+        uSendFailures++;
+    }
+    return MB_ENOERR;
+}
+
+void
+vMBGatewayPoll( void )
+{
+}
+
+void
+vMBGatewayReset( UCHAR ucConnection )
+{
+    ( void )ucConnection;
+}
+
+/* ----------------------- Static functions ---------------------------------*/
+static void
+prvvPoll( int iPolls )
+{
+    while( iPolls-- > 0 )
+    {
+        vModbusTCPServerPoll( &hW5500MBTCP );
+    }
+}
+
+static void
+prvvSetup( void )
+{
+    vW5500SimReset(  );
+#if MB_TCP_PORT_INT_ENABLED > 0
+    vW5500SimSetIRQHandler( vMBTCPPortIRQHandler );
+#endif
+    ( void )xMBTCPPortInit( &xInstance, 502 );
+    /* The first poll initializes the chip, the next ones open the sockets. */
+    hW5500MBTCP.eSpiPort = W5500SPI_NONE;
+    prvvPoll( TEST_POLLS );
+    uRequests = 0;
+    uSendFailures = 0;
+}
+
+static          uint16_t
+prvusRequest( uint8_t * pu8Adu, uint16_t u16Tid )
+{
+    const uint8_t   au8Request[TEST_REQUEST_SIZE] = {
+        ( uint8_t )( u16Tid >> 8 ), ( uint8_t )u16Tid, 0, 0, 0, 6, 1, 3, 0, 0, 0, 10
+    };
+
+    memcpy( pu8Adu, au8Request, sizeof( au8Request ) );
+    return sizeof( au8Request );
+}
+
+static void
+prvvSendRequest( uint8_t u8Socket, uint16_t u16Tid )
+{
+    uint8_t         au8Adu[TEST_REQUEST_SIZE];
+
+    vW5500SimClientSend( u8Socket, au8Adu, prvusRequest( au8Adu, u16Tid ) );
+}
+
+/* Reads one response and returns its transaction identifier, -1 if there
+ * is none. */
+static int
+prviReadResponse( uint8_t u8Socket )
+{
+    uint8_t         au8Adu[TEST_REQUEST_SIZE];
+
+    if( usW5500SimClientRead( u8Socket, au8Adu, sizeof( au8Adu ) ) != sizeof( au8Adu ) )
+    {
+        return -1;
+    }
+    return ( au8Adu[MB_TCP_TID] << 8 ) | au8Adu[MB_TCP_TID + 1];
+}
+
+/* ----------------------- Test cases ---------------------------------------*/
+static void
+prvvTestSockets( void )
+{
+    uint8_t         i;
+
+    prvvSetup(  );
+    for( i = 0; i < MB_TCP_PORT_CONNECTIONS; i++ )
+    {
+        MB_TEST_CHECK( u8W5500SimGetState( i ) == SOCK_LISTEN );
+    }
+    MB_TEST_CHECK( xW5500SimConnect( 0, au8Client ) );
+    prvvPoll( TEST_POLLS );
+    MB_TEST_CHECK( hW5500MBTCP.bIsSocketConnected );
+}
+
+static void
+prvvTestResponses( void )
+{
+    uint16_t        u16Tid;
+
+    /* send( ) of the ioLibrary only sends again after it has seen SEND_OK
+     * of the previous response, which the port must not clear. */
+    prvvSetup(  );
+    MB_TEST_CHECK( xW5500SimConnect( 0, au8Client ) );
+    prvvPoll( TEST_POLLS );
+    for( u16Tid = 1; u16Tid <= 5; u16Tid++ )
+    {
+        prvvSendRequest( 0, u16Tid );
+        prvvPoll( TEST_POLLS );
+        MB_TEST_CHECK( prviReadResponse( 0 ) == u16Tid );
+        vW5500SimTransmit(  );
+        prvvPoll( TEST_POLLS );
+    }
+    MB_TEST_CHECK( uRequests == 5 );
+    MB_TEST_CHECK( uSendFailures == 0 );
+}
+
+static void
+prvvTestTxBufferFull( void )
+{
+    /* A response which does not fit into the socket buffer is held and no
+     * further request is taken until it is sent. */
+    prvvSetup(  );
+    MB_TEST_CHECK( xW5500SimConnect( 0, au8Client ) );
+    prvvPoll( TEST_POLLS );
+    vW5500SimSetTxFree( 0, 0 );
+    prvvSendRequest( 0, 1 );
+    prvvSendRequest( 0, 2 );
+    prvvPoll( TEST_POLLS );
+    MB_TEST_CHECK( prviReadResponse( 0 ) == -1 );
+    MB_TEST_CHECK( uRequests == 1 );
+    vW5500SimSetTxFree( 0, W5500_SIM_BUF_SIZE );
+    prvvPoll( 1 );
+    MB_TEST_CHECK( prviReadResponse( 0 ) == 1 );
+    vW5500SimTransmit(  );
+    prvvPoll( TEST_POLLS );
+    MB_TEST_CHECK( prviReadResponse( 0 ) == 2 );
+    MB_TEST_CHECK( uRequests == 2 );
+}
+
+static void
+prvvServe( int iCycles )
+{
+    /* The chip completes each SEND before the next response is sent. */
+    while( iCycles-- > 0 )
+    {
+        prvvPoll( 1 );
+        vW5500SimTransmit(  );
+    }
+}
+
+static void
+prvvTestFragmented( void )
+{
+    uint8_t         au8Adu[TEST_REQUEST_SIZE];
+    uint16_t        u16Len;
+    uint16_t        i;
+
+    /* A request which arrives byte by byte is served once it is complete. */
+    prvvSetup(  );
+    MB_TEST_CHECK( xW5500SimConnect( 0, au8Client ) );
+    prvvPoll( TEST_POLLS );
+    u16Len = prvusRequest( au8Adu, 7 );
+    for( i = 0; i < u16Len; i++ )
+    {
+        MB_TEST_CHECK( uRequests == 0 );
+        vW5500SimClientSend( 0, &au8Adu[i], 1 );
+        prvvPoll( 1 );
+    }
+    MB_TEST_CHECK( uRequests == 1 );
+    MB_TEST_CHECK( prviReadResponse( 0 ) == 7 );
+
+    /* The header of the next request in the same segment as the rest of
+     * the previous one. */
+    vW5500SimTransmit(  );
+    prvvPoll( TEST_POLLS );
+    vW5500SimClientSend( 0, au8Adu, 5 );
+    prvvPoll( 1 );
+    vW5500SimClientSend( 0, &au8Adu[5], TEST_REQUEST_SIZE - 5 );
+    ( void )prvusRequest( au8Adu, 8 );
+    vW5500SimClientSend( 0, au8Adu, 3 );
+    prvvServe( TEST_POLLS );
+    vW5500SimClientSend( 0, &au8Adu[3], TEST_REQUEST_SIZE - 3 );
+    prvvServe( TEST_POLLS );
+    MB_TEST_CHECK( uRequests == 3 );
+    MB_TEST_CHECK( prviReadResponse( 0 ) == 7 );
+    MB_TEST_CHECK( prviReadResponse( 0 ) == 8 );
+    MB_TEST_CHECK( u32W5500SimGetDisconnects( 0 ) == 0 );
+}
+
+static void
+prvvTestPipelined( void )
+{
+    uint16_t        u16Tid;
+
+    /* More requests in one segment than are served by one poll. Each is
+     * answered, in order. */
+    prvvSetup(  );
+    MB_TEST_CHECK( xW5500SimConnect( 0, au8Client ) );
+    prvvPoll( TEST_POLLS );
+    for( u16Tid = 1; u16Tid <= MB_TCP_PORT_REQUESTS_PER_POLL + 2; u16Tid++ )
+    {
+        prvvSendRequest( 0, u16Tid );
+    }
+    prvvServe( 2 * ( MB_TCP_PORT_REQUESTS_PER_POLL + 2 ) );
+    for( u16Tid = 1; u16Tid <= MB_TCP_PORT_REQUESTS_PER_POLL + 2; u16Tid++ )
+    {
+        MB_TEST_CHECK( prviReadResponse( 0 ) == u16Tid );
+    }
+    MB_TEST_CHECK( prviReadResponse( 0 ) == -1 );
+    MB_TEST_CHECK( uRequests == MB_TCP_PORT_REQUESTS_PER_POLL + 2 );
+}
+
+static void
+prvvTestInvalidHeader( void )
+{
+    static const uint8_t au8BadProtocol[] = { 0, 1, 0, 1, 0, 6, 1, 3, 0, 0, 0, 10 };
+    static const uint8_t au8ShortLength[] = { 0, 1, 0, 0, 0, 1, 1 };
+    static const uint8_t au8LongLength[] = { 0, 1, 0, 0, 0x01, 0x00, 1 };
+    const uint8_t  *apu8Headers[] = { au8BadProtocol, au8ShortLength, au8LongLength };
+    const uint16_t  au16Lengths[] = { sizeof( au8BadProtocol ), sizeof( au8ShortLength ), sizeof( au8LongLength ) };
+    uint32_t        u32Disconnects;
+    int             i;
+
+    /* A stream which is not Modbus can not be resynchronized, the
+     * connection is closed without a response. */
+    prvvSetup(  );
+    for( i = 0; i < 3; i++ )
+    {
+        MB_TEST_CHECK( xW5500SimConnect( 0, au8Client ) );
+        prvvPoll( TEST_POLLS );
+        u32Disconnects = u32W5500SimGetDisconnects( 0 );
+        vW5500SimClientSend( 0, apu8Headers[i], au16Lengths[i] );
+        prvvPoll( TEST_POLLS );
+        MB_TEST_CHECK( u32W5500SimGetDisconnects( 0 ) == u32Disconnects + 1 );
+        MB_TEST_CHECK( prviReadResponse( 0 ) == -1 );
+        MB_TEST_CHECK( u8W5500SimGetState( 0 ) == SOCK_LISTEN );
+    }
+    MB_TEST_CHECK( uRequests == 0 );
+}
+
+#if MB_TCP_PORT_INT_ENABLED > 0
+static void
+prvvTestSpiTransactions( void )
+{
+    uint32_t        u32Start;
+    uint32_t        u32PerRequest;
+
+    /* Sockets without an event are not read. */
+    prvvSetup(  );
+    MB_TEST_CHECK( xW5500SimConnect( 0, au8Client ) );
+    prvvPoll( TEST_POLLS );
+    u32Start = u32W5500SimGetSpiTransactions(  );
+    prvvPoll( 100 );
+    MB_TEST_CHECK( u32W5500SimGetSpiTransactions(  ) == u32Start );
+
+    u32Start = u32W5500SimGetSpiTransactions(  );
+    prvvSendRequest( 0, 1 );
+    prvvPoll( 1 );
+    vW5500SimTransmit(  );
+    prvvPoll( TEST_POLLS );
+    u32PerRequest = u32W5500SimGetSpiTransactions(  ) - u32Start;
+    MB_TEST_CHECK( prviReadResponse( 0 ) == 1 );
+    printf( "SPI transactions per request: %u\n", ( unsigned )u32PerRequest );
+    MB_TEST_CHECK( u32PerRequest <= TEST_SPI_PER_REQUEST_MAX );
+
+    /* The link is read every MB_TCP_PORT_LINK_CHECK_MS. */
+    u32Start = u32W5500SimGetSpiTransactions(  );
+    vW5500SimAdvance( MB_TCP_PORT_LINK_CHECK_MS );
+    prvvPoll( 100 );
+    MB_TEST_CHECK( u32W5500SimGetSpiTransactions(  ) - u32Start == 1 );
+}
+#endif
+
+/* ----------------------- Start implementation -----------------------------*/
+int
+main( void )
+{
+    MB_TEST_RUN( prvvTestSockets );
+    MB_TEST_RUN( prvvTestResponses );
+    MB_TEST_RUN( prvvTestTxBufferFull );
+    MB_TEST_RUN( prvvTestFragmented );
+    MB_TEST_RUN( prvvTestPipelined );
+    MB_TEST_RUN( prvvTestInvalidHeader );
+#if MB_TCP_PORT_INT_ENABLED > 0
+    MB_TEST_RUN( prvvTestSpiTransactions );
+#endif
+    return MB_TEST_RESULT(  );
+}
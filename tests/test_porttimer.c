@@ -0,0 +1,198 @@
+/* 
+ * FreeModbus Libary: A portable Modbus implementation for Modbus ASCII/RTU.
+ * Copyright (c) 2006-2018 Christian Walter <cwalter@embedded-solutions.at>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* ----------------------- System includes ----------------------------------*/
+#include <string.h>
+#include <time.h>
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "mb.h"
+#include "mbport.h"
+#include "mbinstance.h"
+#include "mbtest.h"
+
+/* Tests of the t3.5 timer of the POSIX port in posix/porttimer.c. The timer
+ * is a one-shot timerfd, like the one-pulse timer of the STM32 port, and is
+ * restarted on every received byte. The protocol stack is replaced by a
+ * callback which records the expirations.
+ */
+
+/* ----------------------- Defines ------------------------------------------*/
+#define TEST_T35_FAST_50US      35      /*!< Fixed t3.5 above 19200 baud, 1750 us. */
+#define TEST_T35_9600_50US      80      /*!< ( 7 * 220000 ) / ( 2 * 9600 ). */
+#define TEST_T35_300_50US       2566    /*!< 128 ms, more than a 16-bit timer with 1 us ticks. */
+#define TEST_SLACK_US           20000   /*!< Scheduling delay allowed on the host. */
+
+/* ----------------------- Static variables ---------------------------------*/
+static xMBInstance xInstances[2];
+static unsigned uExpired[2];
+static unsigned long long ullExpiredNs[2];
+
+/* ----------------------- Protocol stack -----------------------------------*/
+BOOL
+xMBPortCBTimerExpired( xMBInstance * pxInst )
+{
+    struct timespec xNow;
+    int             i = ( pxInst == &xInstances[0] ) ? 0 : 1;
+
+    ( void )clock_gettime( CLOCK_MONOTONIC, &xNow );
+    ullExpiredNs[i] = ( unsigned long long )xNow.tv_sec * 1000000000ULL + ( unsigned long long )xNow.tv_nsec;
+    uExpired[i]++;
+    return FALSE;
+}
+
+/* ----------------------- Static functions ---------------------------------*/
+static unsigned long long
+prvullNow( void )
+{
+    struct timespec xNow;
+
+    ( void )clock_gettime( CLOCK_MONOTONIC, &xNow );
+    return ( unsigned long long )xNow.tv_sec * 1000000000ULL + ( unsigned long long )xNow.tv_nsec;
+}
+
+static void
+prvvRunUs( unsigned long ulUs )
+{
+    unsigned long long ullEnd = prvullNow(  ) + ( unsigned long long )ulUs * 1000ULL;
+
+    while( prvullNow(  ) < ullEnd )
+    {
+        vMBPortPosixWait( 1 );
+    }
+}
+
+static void
+prvvSetup( int i, USHORT usTimeout50us )
+{
+    xInstances[i].ucPort = ( UCHAR )( i + 1 );
+    MB_TEST_CHECK( xMBPortTimersInit( &xInstances[i], usTimeout50us ) );
+    uExpired[i] = 0;
+}
+
+static void
+prvvCheckTimeout( USHORT usTimeout50us )
+{
+    unsigned long long ullStart;
+    unsigned long long ullElapsedUs;
+
+    prvvSetup( 0, usTimeout50us );
+    ullStart = prvullNow(  );
+    vMBPortTimersEnable( &xInstances[0] );
+    prvvRunUs( ( unsigned long )usTimeout50us * 50U + TEST_SLACK_US );
+    MB_TEST_CHECK( uExpired[0] == 1 );
+    ullElapsedUs = ( ullExpiredNs[0] - ullStart ) / 1000ULL;
+    MB_TEST_CHECK( ullElapsedUs >= ( unsigned long long )usTimeout50us * 50U );
+    MB_TEST_CHECK( ullElapsedUs < ( unsigned long long )usTimeout50us * 50U + TEST_SLACK_US );
+}
+
+/* ----------------------- Test cases ---------------------------------------*/
+static void
+prvvTestFast( void )
+{
+    prvvCheckTimeout( TEST_T35_FAST_50US );
+}
+
+static void
+prvvTest9600( void )
+{
+    prvvCheckTimeout( TEST_T35_9600_50US );
+}
+
+static void
+prvvTest300( void )
+{
+    prvvCheckTimeout( TEST_T35_300_50US );
+}
+
+static void
+prvvTestRetrigger( void )
+{
+    unsigned long long ullLast = 0;
+    int             i;
+
+    /* Bytes every 1 ms keep the timeout from expiring, it expires one
+     * timeout after the last one. The long timeout of 300 baud leaves room
+     * for the scheduling of the host. */
+    prvvSetup( 0, TEST_T35_300_50US );
+    for( i = 0; i < 10; i++ )
+    {
+        ullLast = prvullNow(  );
+        vMBPortTimersEnable( &xInstances[0] );
+        prvvRunUs( 1000 );
+    }
+    MB_TEST_CHECK( uExpired[0] == 0 );
+    prvvRunUs( TEST_T35_300_50US * 50U + TEST_SLACK_US );
+    MB_TEST_CHECK( uExpired[0] == 1 );
+    MB_TEST_CHECK( ( ullExpiredNs[0] - ullLast ) / 1000ULL >= TEST_T35_300_50US * 50U );
+}
+
+static void
+prvvTestDisable( void )
+{
+    prvvSetup( 0, TEST_T35_FAST_50US );
+    vMBPortTimersEnable( &xInstances[0] );
+    vMBPortTimersDisable( &xInstances[0] );
+    prvvRunUs( TEST_T35_FAST_50US * 50U + TEST_SLACK_US );
+    MB_TEST_CHECK( uExpired[0] == 0 );
+}
+
+static void
+prvvTestTwoPorts( void )
+{
+    unsigned long long ullStart;
+
+    /* Each port has a timer of its own with its own timeout. */
+    prvvSetup( 0, TEST_T35_FAST_50US );
+    prvvSetup( 1, TEST_T35_9600_50US );
+    ullStart = prvullNow(  );
+    vMBPortTimersEnable( &xInstances[0] );
+    vMBPortTimersEnable( &xInstances[1] );
+    prvvRunUs( TEST_T35_9600_50US * 50U + TEST_SLACK_US );
+    MB_TEST_CHECK( uExpired[0] == 1 );
+    MB_TEST_CHECK( uExpired[1] == 1 );
+    MB_TEST_CHECK( ( ullExpiredNs[0] - ullStart ) / 1000ULL >= TEST_T35_FAST_50US * 50U );
+    MB_TEST_CHECK( ( ullExpiredNs[1] - ullStart ) / 1000ULL >= TEST_T35_9600_50US * 50U );
+    MB_TEST_CHECK( ullExpiredNs[0] < ullExpiredNs[1] );
+    xMBPortTimersClose( &xInstances[1] );
+}
+
+/* ----------------------- Start implementation -----------------------------*/
+int
+main( void )
+{
+    MB_TEST_RUN( prvvTestFast );
+    MB_TEST_RUN( prvvTest9600 );
+    MB_TEST_RUN( prvvTest300 );
+    MB_TEST_RUN( prvvTestRetrigger );
+    MB_TEST_RUN( prvvTestDisable );
+    MB_TEST_RUN( prvvTestTwoPorts );
+    xMBPortTimersClose( &xInstances[0] );
+    return MB_TEST_RESULT(  );
+}
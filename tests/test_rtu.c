@@ -0,0 +1,341 @@
+/* 
+ * FreeModbus Libary: A portable Modbus implementation for Modbus ASCII/RTU.
+ * Copyright (c) 2006-2018 Christian Walter <cwalter@embedded-solutions.at>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* ----------------------- System includes ----------------------------------*/
+#include <string.h>
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "mb.h"
+#include "mbport.h"
+#include "mbcrc.h"
+#include "mbproto.h"
+#include "mbinstance.h"
+#include "mbrtu.h"
+#include "mbtest.h"
+
+/* Tests of the RTU receiver in function/mbrtu.c which ends a request by its
+ * length instead of waiting for t3.5 (MB_RTU_LENGTH_PREDICT_ENABLED). The
+ * bytes are fed to xMBRTUReceiveFSM( ) one by one and t3.5 is expired by
+ * the test. The port is replaced by stubs which record the events. Built
+ * with and without the prediction to compare it against t3.5 framing.
+ */
+
+#if MB_RTU_DMA_RX_ENABLED > 0
+#error "The tests require the per-byte receiver"
+#endif
+
+/* ----------------------- Defines ------------------------------------------*/
+#define TEST_ADDRESS            1
+#define TEST_FRAME_SIZE         64
+
+/* Bytes after which a frame of usLength bytes is complete, 0 for t3.5. */
+#if MB_RTU_LENGTH_PREDICT_ENABLED > 0
+#define TEST_END( usLength )    ( usLength )
+#else
+#define TEST_END( usLength )    0
+#endif
+
+/* ----------------------- Static variables ---------------------------------*/
+static xMBInstance xInst;
+static UCHAR    ucRxByte;
+static unsigned uFramesReceived;
+static unsigned uTxStarts;
+
+/* ----------------------- Port ---------------------------------------------*/
+BOOL
+xMBPortSerialGetByte( xMBInstance * pxInst, CHAR * pucByte )
+{
+    *pucByte = ( CHAR )ucRxByte;
+    return TRUE;
+}
+
+BOOL
+xMBPortSerialPutByte( xMBInstance * pxInst, UCHAR ucByte )
+{
+    return TRUE;
+}
+
+void
+vMBPortSerialEnable( xMBInstance * pxInst, BOOL xRxEnable, BOOL xTxEnable )
+{
+    if( xTxEnable )
+    {
+        uTxStarts++;
+    }
+}
+
+BOOL
+xMBPortSerialInit( xMBInstance * pxInst, UCHAR ucPort, ULONG ulBaudRate, UCHAR ucDataBits, eMBParity eParity )
+{
+    return TRUE;
+}
+
+BOOL
+xMBPortTimersInit( xMBInstance * pxInst, USHORT usTimeOut50us )
+{
+    return TRUE;
+}
+
+void
+vMBPortTimersEnable( xMBInstance * pxInst )
+{
+}
+
+void
+vMBPortTimersDisable( xMBInstance * pxInst )
+{
+}
+
+BOOL
+xMBPortEventPost( xMBInstance * pxInst, eMBEventType eEvent )
+{
+    if( eEvent == EV_FRAME_RECEIVED )
+    {
+        uFramesReceived++;
+    }
+    return TRUE;
+}
+
+BOOL
+xMBIsVirtualSlave( UCHAR ucAddress )
+{
+    return FALSE;
+}
+
+/* ----------------------- Static functions ---------------------------------*/
+static void
+prvvSetup( BOOL xIsMaster )
+{
+    memset( &xInst, 0, sizeof( xInst ) );
+    xInst.xIsMaster = xIsMaster;
+    xInst.xSer.xRTU.ucRTUAddress = TEST_ADDRESS;
+    xInst.xSer.xRTU.eRcvState = STATE_RX_IDLE;
+    xInst.xSer.xRTU.eSndState = STATE_TX_IDLE;
+    uFramesReceived = 0;
+    uTxStarts = 0;
+}
+
+static          USHORT
+prvusFrame( UCHAR * pucFrame, const UCHAR * pucPDU, USHORT usPDULength )
+{
+    USHORT          usCRC;
+
+    pucFrame[0] = TEST_ADDRESS;
+    memcpy( &pucFrame[1], pucPDU, usPDULength );
+    usCRC = usMBCRC16( pucFrame, ( USHORT )( 1 + usPDULength ) );
+    pucFrame[1 + usPDULength] = ( UCHAR )( usCRC & 0xFF );
+    pucFrame[2 + usPDULength] = ( UCHAR )( usCRC >> 8 );
+    return ( USHORT )( usPDULength + 3 );
+}
+
+static          USHORT
+prvusReceive( const UCHAR * pucFrame, USHORT usLength )
+{
+    /* Returns the number of bytes after which the frame was complete, 0 if
+     * it was not before t3.5. */
+    USHORT          usEnd = 0;
+    USHORT          i;
+
+    for( i = 0; i < usLength; i++ )
+    {
+        ucRxByte = pucFrame[i];
+        ( void )xMBRTUReceiveFSM( &xInst );
+        if( ( usEnd == 0 ) && ( uFramesReceived > 0 ) )
+        {
+            usEnd = ( USHORT )( i + 1 );
+        }
+    }
+    return usEnd;
+}
+
+static          USHORT
+prvusPredicted( const UCHAR * pucPDU, USHORT usPDULength )
+{
+    UCHAR           aucFrame[TEST_FRAME_SIZE];
+    USHORT          usLength = prvusFrame( aucFrame, pucPDU, usPDULength );
+    USHORT          usEnd;
+
+    prvvSetup( FALSE );
+    usEnd = prvusReceive( aucFrame, usLength );
+    ( void )xMBRTUTimerT35Expired( &xInst );
+    /* The frame is passed on once, by its length or by t3.5. */
+    MB_TEST_CHECK( uFramesReceived == 1 );
+    MB_TEST_CHECK( xInst.xSer.xRTU.eRcvState == STATE_RX_IDLE );
+    return usEnd;
+}
+
+/* ----------------------- Test cases ---------------------------------------*/
+static void
+prvvTestFixedLength( void )
+{
+    const UCHAR     aucRead[] = { MB_FUNC_READ_HOLDING_REGISTER, 0x00, 0x10, 0x00, 0x02 };
+    const UCHAR     aucWrite[] = { MB_FUNC_WRITE_SINGLE_COIL, 0x00, 0x01, 0xFF, 0x00 };
+    const UCHAR     aucDiag[] = { MB_FUNC_DIAG_DIAGNOSTIC, 0x00, 0x00, 0x12, 0x34 };
+    const UCHAR     aucSlaveID[] = { MB_FUNC_OTHER_REPORT_SLAVEID };
+
+    MB_TEST_CHECK( prvusPredicted( aucRead, sizeof( aucRead ) ) == TEST_END( 8 ) );
+    MB_TEST_CHECK( prvusPredicted( aucWrite, sizeof( aucWrite ) ) == TEST_END( 8 ) );
+    MB_TEST_CHECK( prvusPredicted( aucDiag, sizeof( aucDiag ) ) == TEST_END( 8 ) );
+    MB_TEST_CHECK( prvusPredicted( aucSlaveID, sizeof( aucSlaveID ) ) == TEST_END( 4 ) );
+}
+
+static void
+prvvTestByteCount( void )
+{
+    const UCHAR     aucCoils[] = { MB_FUNC_WRITE_MULTIPLE_COILS, 0x00, 0x00, 0x00, 0x0A, 0x02, 0xFF, 0x03 };
+    const UCHAR     aucRegs[] = { MB_FUNC_WRITE_MULTIPLE_REGISTERS, 0x00, 0x00, 0x00, 0x02, 0x04,
+        0x00, 0x0A, 0x01, 0x02
+    };
+    const UCHAR     aucReadWrite[] = { MB_FUNC_READWRITE_MULTIPLE_REGISTERS, 0x00, 0x00, 0x00, 0x01,
+        0x00, 0x10, 0x00, 0x01, 0x02, 0x12, 0x34
+    };
+
+    MB_TEST_CHECK( prvusPredicted( aucCoils, sizeof( aucCoils ) ) == TEST_END( 11 ) );
+    MB_TEST_CHECK( prvusPredicted( aucRegs, sizeof( aucRegs ) ) == TEST_END( 13 ) );
+    MB_TEST_CHECK( prvusPredicted( aucReadWrite, sizeof( aucReadWrite ) ) == TEST_END( 15 ) );
+}
+
+static void
+prvvTestUnknown( void )
+{
+    /* A custom function code ends with t3.5. */
+    const UCHAR     aucCustom[] = { 0x41, 0x01, 0x02 };
+
+    MB_TEST_CHECK( prvusPredicted( aucCustom, sizeof( aucCustom ) ) == 0 );
+}
+
+static void
+prvvTestBadCRC( void )
+{
+    const UCHAR     aucRead[] = { MB_FUNC_READ_HOLDING_REGISTER, 0x00, 0x10, 0x00, 0x02 };
+    UCHAR           aucFrame[TEST_FRAME_SIZE];
+    USHORT          usLength = prvusFrame( aucFrame, aucRead, sizeof( aucRead ) );
+    UCHAR           ucAddress;
+    UCHAR          *pucPDU;
+    USHORT          usPDULength;
+
+    /* Not complete by its length, t3.5 hands it on and the CRC check
+     * drops it. */
+    aucFrame[usLength - 1] ^= 0x01;
+    prvvSetup( FALSE );
+    MB_TEST_CHECK( prvusReceive( aucFrame, usLength ) == 0 );
+    ( void )xMBRTUTimerT35Expired( &xInst );
+    MB_TEST_CHECK( uFramesReceived == 1 );
+    MB_TEST_CHECK( eMBRTUReceive( &xInst, &ucAddress, &pucPDU, &usPDULength ) == MB_EIO );
+}
+
+static void
+prvvTestDeferredReply( void )
+{
+    const UCHAR     aucRead[] = { MB_FUNC_READ_HOLDING_REGISTER, 0x00, 0x10, 0x00, 0x02 };
+    UCHAR           aucFrame[TEST_FRAME_SIZE];
+    USHORT          usLength = prvusFrame( aucFrame, aucRead, sizeof( aucRead ) );
+    UCHAR           ucAddress;
+    UCHAR          *pucPDU;
+    USHORT          usPDULength;
+
+    prvvSetup( FALSE );
+    MB_TEST_CHECK( prvusReceive( aucFrame, usLength ) == TEST_END( usLength ) );
+#if MB_RTU_LENGTH_PREDICT_ENABLED > 0
+    /* The reply is ready before t3.5 but only sent after it. */
+    MB_TEST_CHECK( eMBRTUReceive( &xInst, &ucAddress, &pucPDU, &usPDULength ) == MB_ENOERR );
+    MB_TEST_CHECK( ( ucAddress == TEST_ADDRESS ) && ( usPDULength == sizeof( aucRead ) ) );
+    MB_TEST_CHECK( eMBRTUSend( &xInst, TEST_ADDRESS, pucPDU, usPDULength ) == MB_ENOERR );
+    MB_TEST_CHECK( uTxStarts == 0 );
+    ( void )xMBRTUTimerT35Expired( &xInst );
+    MB_TEST_CHECK( uTxStarts == 1 );
+#else
+    /* The request is handed on after t3.5 and the reply sent at once. */
+    ( void )xMBRTUTimerT35Expired( &xInst );
+    MB_TEST_CHECK( eMBRTUReceive( &xInst, &ucAddress, &pucPDU, &usPDULength ) == MB_ENOERR );
+    MB_TEST_CHECK( ( ucAddress == TEST_ADDRESS ) && ( usPDULength == sizeof( aucRead ) ) );
+    MB_TEST_CHECK( eMBRTUSend( &xInst, TEST_ADDRESS, pucPDU, usPDULength ) == MB_ENOERR );
+    MB_TEST_CHECK( uTxStarts == 1 );
+#endif
+}
+
+static void
+prvvTestTrailingByte( void )
+{
+    const UCHAR     aucRead[] = { MB_FUNC_READ_HOLDING_REGISTER, 0x00, 0x10, 0x00, 0x02 };
+    UCHAR           aucFrame[TEST_FRAME_SIZE];
+    USHORT          usLength = prvusFrame( aucFrame, aucRead, sizeof( aucRead ) );
+    UCHAR           ucAddress;
+    UCHAR          *pucPDU;
+    USHORT          usPDULength;
+
+    aucFrame[usLength] = 0x55;
+    prvvSetup( FALSE );
+#if MB_RTU_LENGTH_PREDICT_ENABLED > 0
+    /* The frame did not end where predicted. The request was executed but
+     * the deferred reply is dropped. */
+    MB_TEST_CHECK( prvusReceive( aucFrame, usLength ) == usLength );
+    MB_TEST_CHECK( eMBRTUReceive( &xInst, &ucAddress, &pucPDU, &usPDULength ) == MB_ENOERR );
+    MB_TEST_CHECK( eMBRTUSend( &xInst, TEST_ADDRESS, pucPDU, usPDULength ) == MB_ENOERR );
+    ( void )prvusReceive( &aucFrame[usLength], 1 );
+    ( void )xMBRTUTimerT35Expired( &xInst );
+    MB_TEST_CHECK( uTxStarts == 0 );
+#else
+    /* The trailing byte is part of the frame and its CRC check fails, the
+     * request is never executed. */
+    MB_TEST_CHECK( prvusReceive( aucFrame, ( USHORT )( usLength + 1 ) ) == 0 );
+    ( void )xMBRTUTimerT35Expired( &xInst );
+    MB_TEST_CHECK( eMBRTUReceive( &xInst, &ucAddress, &pucPDU, &usPDULength ) == MB_EIO );
+#endif
+    MB_TEST_CHECK( uFramesReceived == 1 );
+    MB_TEST_CHECK( xInst.xSer.xRTU.eRcvState == STATE_RX_IDLE );
+}
+
+static void
+prvvTestMaster( void )
+{
+    const UCHAR     aucResponse[] = { MB_FUNC_READ_HOLDING_REGISTER, 0x02, 0x12, 0x34 };
+    UCHAR           aucFrame[TEST_FRAME_SIZE];
+    USHORT          usLength = prvusFrame( aucFrame, aucResponse, sizeof( aucResponse ) );
+
+    /* Responses are not predicted, a master waits for t3.5. */
+    prvvSetup( TRUE );
+    MB_TEST_CHECK( prvusReceive( aucFrame, usLength ) == 0 );
+    ( void )xMBRTUTimerT35Expired( &xInst );
+    MB_TEST_CHECK( uFramesReceived == 1 );
+}
+
+/* ----------------------- Start implementation -----------------------------*/
+int
+main( void )
+{
+    MB_TEST_RUN( prvvTestFixedLength );
+    MB_TEST_RUN( prvvTestByteCount );
+    MB_TEST_RUN( prvvTestUnknown );
+    MB_TEST_RUN( prvvTestBadCRC );
+    MB_TEST_RUN( prvvTestDeferredReply );
+    MB_TEST_RUN( prvvTestTrailingByte );
+    MB_TEST_RUN( prvvTestMaster );
+    return MB_TEST_RESULT(  );
+}
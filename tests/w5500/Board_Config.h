@@ -0,0 +1,74 @@
+/* 
+ * FreeModbus Libary: A portable Modbus implementation for Modbus ASCII/RTU.
+ * Copyright (c) 2006-2018 Christian Walter <cwalter@embedded-solutions.at>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef _BOARD_CONFIG_H
+#define _BOARD_CONFIG_H
+
+/* Board of the W5500 simulator: the parts of the STM32 HAL which the
+ * target port headers and function/porttcp.c use. The tick and the INTn
+ * pin are driven by w5500sim.c.
+ */
+
+/* ----------------------- System includes ----------------------------------*/
+#include <stdint.h>
+#include <stddef.h>
+
+/* ----------------------- Type definitions ---------------------------------*/
+typedef enum
+{
+    GPIO_PIN_RESET,
+    GPIO_PIN_SET
+} GPIO_PinState;
+
+typedef struct
+{
+    int             iUnused;
+} GPIO_TypeDef, UART_HandleTypeDef, TIM_HandleTypeDef;
+
+/* ----------------------- Defines ------------------------------------------*/
+extern GPIO_TypeDef xW5500SimGPIOB;
+extern GPIO_TypeDef xW5500SimGPIOC;
+
+#define GPIOB                   ( &xW5500SimGPIOB )
+#define GPIOC                   ( &xW5500SimGPIOC )
+#define GPIO_PIN_0              ( ( uint16_t )0x0001 )
+#define GPIO_PIN_13             ( ( uint16_t )0x2000 )
+
+#define __set_PRIMASK( x )      ( ( void )( x ) )
+#define __DMB(  )               __atomic_thread_fence( __ATOMIC_SEQ_CST )
+#define __WFI(  )               ( ( void )0 )
+#define __LDREXW( p )           ( *( p ) )
+#define __STREXW( v, p )        ( *( p ) = ( v ), 0U )
+
+/* ----------------------- Function prototypes ------------------------------*/
+uint32_t        HAL_GetTick( void );
+GPIO_PinState   HAL_GPIO_ReadPin( GPIO_TypeDef * GPIOx, uint16_t GPIO_Pin );
+void            HAL_GPIO_TogglePin( GPIO_TypeDef * GPIOx, uint16_t GPIO_Pin );
+
+#endif
@@ -0,0 +1,159 @@
+/* 
+ * FreeModbus Libary: A portable Modbus implementation for Modbus ASCII/RTU.
+ * Copyright (c) 2006-2018 Christian Walter <cwalter@embedded-solutions.at>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef _NETWORK_H
+#define _NETWORK_H
+
+/* Network layer of the board as seen by function/porttcp.c: the socket API
+ * of the WIZnet ioLibrary and the W5500 register accessors it uses. All of
+ * it is implemented by the register simulator in w5500sim.c.
+ */
+
+/* ----------------------- System includes ----------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+
+/* ----------------------- Defines ------------------------------------------*/
+/* The names of the ioLibrary clash with the socket API of the host. */
+#define socket                  w5500_socket
+#define listen                  w5500_listen
+#define disconnect              w5500_disconnect
+#define close                   w5500_close
+#define send                    w5500_send
+#define recv                    w5500_recv
+#define sendto                  w5500_sendto
+
+#define SOCK_OK                 1
+#define SOCK_BUSY               0
+#define SOCKERR_SOCKSTATUS      ( -7 )
+#define SOCKERR_TIMEOUT         ( -13 )
+
+#define Sn_MR_TCP               0x01
+#define SF_IO_NONBLOCK          0x01
+#define SF_TCP_NODELAY          0x20
+
+#define Sn_IR_CON               0x01
+#define Sn_IR_DISCON            0x02
+#define Sn_IR_RECV              0x04
+#define Sn_IR_TIMEOUT           0x08
+#define Sn_IR_SEND_OK           0x10
+
+#define PHYCFGR_LNK_ON          0x01
+
+#define CW_INIT_WIZCHIP         0
+#define CN_SET_NETINFO          0
+#define CN_GET_NETINFO          1
+
+#define NETINFO_STATIC          1
+
+/* ----------------------- Type definitions ---------------------------------*/
+typedef enum
+{
+    W5500SPI_NONE,
+    W5500SPIMBTCP
+} W5500SpiPort_TypeDef;
+
+typedef enum
+{
+    NOERR,
+    INITIAL_ERR
+} W5500TcpSocketErr_TypeDef;
+
+typedef enum
+{
+    CLOSED = 0x00,
+    SOCK_CLOSED = 0x00,
+    SOCK_INIT = 0x13,
+    SOCK_LISTEN = 0x14,
+    SOCK_ESTABLISHED = 0x17,
+    SOCK_CLOSE_WAIT = 0x1C
+} SocketState_TypeDef;
+
+typedef struct
+{
+    uint8_t         mac[6];
+    uint8_t         ip[4];
+    uint8_t         sn[4];
+    uint8_t         gw[4];
+    uint8_t         dns[4];
+    uint8_t         dhcp;
+} wiz_NetInfo;
+
+typedef struct
+{
+    uint8_t         retry_cnt;
+    uint16_t        time_100us;
+} wiz_NetTimeout;
+
+typedef struct
+{
+    W5500SpiPort_TypeDef eSpiPort;
+    wiz_NetInfo     stWizNetinfo;
+    uint16_t        u16Port;
+    bool            bIsPhyConnected;
+    SocketState_TypeDef eSockState;
+    bool            bIsSocketConnected;
+    bool            bIsSocketTxEnable;
+    bool            bIsSocketTxSent;
+    bool            bIsSocketRxEnable;
+    bool            bIsSocketRxReceived;
+    uint8_t        *pu8TxData;
+    uint16_t        u16TxSize;
+    uint8_t        *pu8RxData;
+    uint16_t        u16RxSize;
+} W5500TcpSocket_TypeDef;
+
+/* ----------------------- Function prototypes ------------------------------*/
+void            vSetCurSpiPort( W5500SpiPort_TypeDef eSpiPort );
+W5500SpiPort_TypeDef eGetCurSpiPort( void );
+
+void            wizchip_settimeout( wiz_NetTimeout * nettime );
+int8_t          ctlwizchip( int cwtype, void *arg );
+int8_t          ctlnetwork( int cntype, void *arg );
+
+int8_t          socket( uint8_t sn, uint8_t protocol, uint16_t port, uint8_t flag );
+int8_t          listen( uint8_t sn );
+int8_t          disconnect( uint8_t sn );
+int8_t          close( uint8_t sn );
+int32_t         send( uint8_t sn, uint8_t * buf, uint16_t len );
+int32_t         recv( uint8_t sn, uint8_t * buf, uint16_t len );
+int32_t         sendto( uint8_t sn, uint8_t * buf, uint16_t len, uint8_t * addr, uint16_t port );
+
+uint8_t         getPHYCFGR( void );
+uint8_t         getSIR( void );
+void            setSIMR( uint8_t simr );
+uint8_t         getSn_SR( uint8_t sn );
+uint8_t         getSn_IR( uint8_t sn );
+void            setSn_IR( uint8_t sn, uint8_t ir );
+void            setSn_IMR( uint8_t sn, uint8_t imr );
+uint16_t        getSn_RX_RSR( uint8_t sn );
+void            setSn_KPALVTR( uint8_t sn, uint8_t kpalvt );
+void            getSn_DIPR( uint8_t sn, uint8_t * dipr );
+
+#endif
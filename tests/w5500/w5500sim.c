@@ -0,0 +1,503 @@
+/* 
+ * FreeModbus Libary: A portable Modbus implementation for Modbus ASCII/RTU.
+ * Copyright (c) 2006-2018 Christian Walter <cwalter@embedded-solutions.at>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* ----------------------- System includes ----------------------------------*/
+#include <string.h>
+
+/* ----------------------- Platform includes --------------------------------*/
+#include "Board_Config.h"
+#include "network.h"
+#include "w5500sim.h"
+
+/* ----------------------- Defines ------------------------------------------*/
+/* SPI transactions of the ioLibrary for each call. A register of one byte
+ * is one transaction, Sn_RX_RSR and Sn_TX_FSR are read until two reads
+ * agree. */
+#define W5500_SIM_SPI_REG       1
+#define W5500_SIM_SPI_RSR       2
+#define W5500_SIM_SPI_RECV      ( W5500_SIM_SPI_RSR + 5 )       /* RD pointer, data, RD pointer, CR, CR */
+#define W5500_SIM_SPI_SEND      ( 1 + W5500_SIM_SPI_RSR + 5 )   /* SR, FSR, WR pointer, data, WR pointer, CR, CR */
+#define W5500_SIM_SPI_SOCKET    6
+#define W5500_SIM_SPI_COMMAND   2                               /* CR, CR */
+
+/* ----------------------- Type definitions ---------------------------------*/
+typedef struct
+{
+    uint8_t         u8SR;
+    uint8_t         u8IR;
+    uint8_t         u8IMR;
+    uint8_t         au8Peer[4];
+    bool            bIsSending;         /* sock_is_sending of the ioLibrary */
+    bool            bIsSendInProgress;  /* SEND command not completed by the chip */
+    uint8_t         au8Rx[W5500_SIM_BUF_SIZE];
+    uint16_t        u16RxLen;
+    uint8_t         au8Tx[W5500_SIM_BUF_SIZE];
+    uint16_t        u16TxLen;
+    uint16_t        u16TxFree;
+    uint32_t        u32Disconnects;
+} W5500SimSocket_TypeDef;
+
+/* ----------------------- Static variables ---------------------------------*/
+GPIO_TypeDef    xW5500SimGPIOB;
+GPIO_TypeDef    xW5500SimGPIOC;
+
+static W5500SimSocket_TypeDef astSockets[W5500_SIM_SOCKETS];
+static uint8_t  u8SIMR;
+static bool     bLinkUp;
+static bool     bIntLow;
+static uint32_t u32Tick;
+static uint32_t u32SpiTransactions;
+static wiz_NetInfo stNetInfo;
+static W5500SpiPort_TypeDef eSpiPort;
+static void     ( *pvIRQHandler ) ( uint16_t u16GpioPin );
+
+/* ----------------------- Static functions ---------------------------------*/
+static uint8_t
+u8W5500SimSIR( void )
+{
+    uint8_t         u8SIR = 0;
+    uint8_t         i;
+
+    for( i = 0; i < W5500_SIM_SOCKETS; i++ )
+    {
+        if( astSockets[i].u8IR & astSockets[i].u8IMR )
+        {
+            u8SIR |= ( uint8_t )( 1 << i );
+        }
+    }
+    return u8SIR;
+}
+
+static void
+vW5500SimUpdateInt( void )
+{
+    bool            bLow = ( u8W5500SimSIR(  ) & u8SIMR ) != 0;
+
+    if( bLow && !bIntLow && ( pvIRQHandler != NULL ) )
+    {
+        bIntLow = bLow;
+        pvIRQHandler( GPIO_PIN_0 );
+    }
+    bIntLow = bLow;
+}
+
+static void
+vW5500SimRaise( uint8_t u8Socket, uint8_t u8Flags )
+{
+    astSockets[u8Socket].u8IR |= u8Flags;
+    vW5500SimUpdateInt(  );
+}
+
+static void
+vW5500SimClose( W5500SimSocket_TypeDef * pstSocket )
+{
+    pstSocket->u8SR = SOCK_CLOSED;
+    pstSocket->bIsSending = false;
+    pstSocket->bIsSendInProgress = false;
+    pstSocket->u16RxLen = 0;
+}
+
+/* ----------------------- Simulator control --------------------------------*/
+void
+vW5500SimReset( void )
+{
+    uint8_t         i;
+
+    memset( astSockets, 0, sizeof( astSockets ) );
+    for( i = 0; i < W5500_SIM_SOCKETS; i++ )
+    {
+        astSockets[i].u16TxFree = W5500_SIM_BUF_SIZE;
+    }
+    u8SIMR = 0;
+    bLinkUp = true;
+    bIntLow = false;
+    u32Tick = 0;
+    u32SpiTransactions = 0;
+    eSpiPort = W5500SPI_NONE;
+    pvIRQHandler = NULL;
+}
+
+void
+vW5500SimSetIRQHandler( void ( *pvHandler ) ( uint16_t u16GpioPin ) )
+{
+    pvIRQHandler = pvHandler;
+}
+
+void
+vW5500SimAdvance( uint32_t u32Ms )
+{
+    u32Tick += u32Ms;
+}
+
+void
+vW5500SimSetLink( bool bUp )
+{
+    bLinkUp = bUp;
+}
+
+bool
+xW5500SimConnect( uint8_t u8Socket, const uint8_t au8Ip[4] )
+{
+    if( astSockets[u8Socket].u8SR != SOCK_LISTEN )
+    {
+        return false;
+    }
+    memcpy( astSockets[u8Socket].au8Peer, au8Ip, 4 );
+    astSockets[u8Socket].u8SR = SOCK_ESTABLISHED;
+    vW5500SimRaise( u8Socket, Sn_IR_CON );
+    return true;
+}
+
+void
+vW5500SimClientSend( uint8_t u8Socket, const uint8_t * pu8Data, uint16_t u16Len )
+{
+    W5500SimSocket_TypeDef *pstSocket = &astSockets[u8Socket];
+
+    if( ( pstSocket->u8SR != SOCK_ESTABLISHED ) || ( u16Len > W5500_SIM_BUF_SIZE - pstSocket->u16RxLen ) )
+    {
+        return;
+    }
+    memcpy( &pstSocket->au8Rx[pstSocket->u16RxLen], pu8Data, u16Len );
+    pstSocket->u16RxLen += u16Len;
+    vW5500SimRaise( u8Socket, Sn_IR_RECV );
+}
+
+void
+vW5500SimClientClose( uint8_t u8Socket )
+{
+    if( astSockets[u8Socket].u8SR == SOCK_ESTABLISHED )
+    {
+        astSockets[u8Socket].u8SR = SOCK_CLOSE_WAIT;
+        vW5500SimRaise( u8Socket, Sn_IR_DISCON );
+    }
+}
+
+uint16_t
+usW5500SimClientRead( uint8_t u8Socket, uint8_t * pu8Data, uint16_t u16Max )
+{
+    W5500SimSocket_TypeDef *pstSocket = &astSockets[u8Socket];
+    uint16_t        u16Len = ( pstSocket->u16TxLen < u16Max ) ? pstSocket->u16TxLen : u16Max;
+
+    memcpy( pu8Data, pstSocket->au8Tx, u16Len );
+    memmove( pstSocket->au8Tx, &pstSocket->au8Tx[u16Len], pstSocket->u16TxLen - u16Len );
+    pstSocket->u16TxLen -= u16Len;
+    return u16Len;
+}
+
+void
+vW5500SimTransmit( void )
+{
+    uint8_t         i;
+
+    for( i = 0; i < W5500_SIM_SOCKETS; i++ )
+    {
+        if( astSockets[i].bIsSendInProgress )
+        {
+            astSockets[i].bIsSendInProgress = false;
+            vW5500SimRaise( i, Sn_IR_SEND_OK );
+        }
+    }
+}
+
+void
+vW5500SimSetTxFree( uint8_t u8Socket, uint16_t u16Free )
+{
+    astSockets[u8Socket].u16TxFree = u16Free;
+}
+
+uint8_t
+u8W5500SimGetState( uint8_t u8Socket )
+{
+    return astSockets[u8Socket].u8SR;
+}
+
+uint32_t
+u32W5500SimGetDisconnects( uint8_t u8Socket )
+{
+    return astSockets[u8Socket].u32Disconnects;
+}
+
+uint32_t
+u32W5500SimGetSpiTransactions( void )
+{
+    return u32SpiTransactions;
+}
+
+/* ----------------------- Board --------------------------------------------*/
+uint32_t
+HAL_GetTick( void )
+{
+    return u32Tick;
+}
+
+GPIO_PinState
+HAL_GPIO_ReadPin( GPIO_TypeDef * GPIOx, uint16_t GPIO_Pin )
+{
+    ( void )GPIOx;
+    ( void )GPIO_Pin;
+    return bIntLow ? GPIO_PIN_RESET : GPIO_PIN_SET;
+}
+
+void
+HAL_GPIO_TogglePin( GPIO_TypeDef * GPIOx, uint16_t GPIO_Pin )
+{
+    ( void )GPIOx;
+    ( void )GPIO_Pin;
+}
+
+void
+vSetCurSpiPort( W5500SpiPort_TypeDef eNewSpiPort )
+{
+    eSpiPort = eNewSpiPort;
+}
+
+W5500SpiPort_TypeDef
+eGetCurSpiPort( void )
+{
+    return eSpiPort;
+}
+
+/* ----------------------- ioLibrary ----------------------------------------*/
+void
+wizchip_settimeout( wiz_NetTimeout * nettime )
+{
+    ( void )nettime;
+    u32SpiTransactions += 2 * W5500_SIM_SPI_REG;
+}
+
+int8_t
+ctlwizchip( int cwtype, void *arg )
+{
+    ( void )cwtype;
+    ( void )arg;
+    u32SpiTransactions += 2 * W5500_SIM_SOCKETS * W5500_SIM_SPI_REG;
+    return 0;
+}
+
+int8_t
+ctlnetwork( int cntype, void *arg )
+{
+    if( cntype == CN_SET_NETINFO )
+    {
+        memcpy( &stNetInfo, arg, sizeof( stNetInfo ) );
+    }
+    else
+    {
+        memcpy( arg, &stNetInfo, sizeof( stNetInfo ) );
+    }
+    u32SpiTransactions += 4 * W5500_SIM_SPI_REG;
+    return 0;
+}
+
+int8_t
+socket( uint8_t sn, uint8_t protocol, uint16_t port, uint8_t flag )
+{
+    ( void )protocol;
+    ( void )port;
+    ( void )flag;
+    vW5500SimClose( &astSockets[sn] );
+    astSockets[sn].u8SR = SOCK_INIT;
+    u32SpiTransactions += W5500_SIM_SPI_SOCKET;
+    return ( int8_t )sn;
+}
+
+int8_t
+listen( uint8_t sn )
+{
+    if( astSockets[sn].u8SR != SOCK_INIT )
+    {
+        return SOCKERR_SOCKSTATUS;
+    }
+    astSockets[sn].u8SR = SOCK_LISTEN;
+    u32SpiTransactions += W5500_SIM_SPI_REG + W5500_SIM_SPI_COMMAND;
+    return SOCK_OK;
+}
+
+int8_t
+disconnect( uint8_t sn )
+{
+    /* The peer acknowledges the FIN at once. */
+    astSockets[sn].u32Disconnects++;
+    vW5500SimClose( &astSockets[sn] );
+    u32SpiTransactions += W5500_SIM_SPI_COMMAND;
+    return SOCK_OK;
+}
+
+int8_t
+close( uint8_t sn )
+{
+    vW5500SimClose( &astSockets[sn] );
+    astSockets[sn].u8IR = 0;
+    vW5500SimUpdateInt(  );
+    u32SpiTransactions += W5500_SIM_SPI_COMMAND + W5500_SIM_SPI_REG;
+    return SOCK_OK;
+}
+
+int32_t
+send( uint8_t sn, uint8_t * buf, uint16_t len )
+{
+    W5500SimSocket_TypeDef *pstSocket = &astSockets[sn];
+
+    /* Non-blocking send( ) of the ioLibrary. */
+    if( pstSocket->bIsSending )
+    {
+        u32SpiTransactions += W5500_SIM_SPI_REG;
+        if( pstSocket->u8IR & Sn_IR_SEND_OK )
+        {
+            pstSocket->u8IR &= ( uint8_t )~Sn_IR_SEND_OK;
+            pstSocket->bIsSending = false;
+            u32SpiTransactions += W5500_SIM_SPI_REG;
+            vW5500SimUpdateInt(  );
+        }
+        else
+        {
+            return SOCK_BUSY;
+        }
+    }
+    u32SpiTransactions += W5500_SIM_SPI_SEND;
+    if( pstSocket->u8SR != SOCK_ESTABLISHED )
+    {
+        return SOCKERR_SOCKSTATUS;
+    }
+    if( ( len > pstSocket->u16TxFree ) || ( len > W5500_SIM_BUF_SIZE - pstSocket->u16TxLen ) )
+    {
+        return SOCK_BUSY;
+    }
+    memcpy( &pstSocket->au8Tx[pstSocket->u16TxLen], buf, len );
+    pstSocket->u16TxLen += len;
+    pstSocket->bIsSending = true;
+    pstSocket->bIsSendInProgress = true;
+    return len;
+}
+
+int32_t
+recv( uint8_t sn, uint8_t * buf, uint16_t len )
+{
+    W5500SimSocket_TypeDef *pstSocket = &astSockets[sn];
+
+    u32SpiTransactions += W5500_SIM_SPI_RECV;
+    if( pstSocket->u16RxLen == 0 )
+    {
+        return SOCK_BUSY;
+    }
+    if( len > pstSocket->u16RxLen )
+    {
+        len = pstSocket->u16RxLen;
+    }
+    memcpy( buf, pstSocket->au8Rx, len );
+    memmove( pstSocket->au8Rx, &pstSocket->au8Rx[len], pstSocket->u16RxLen - len );
+    pstSocket->u16RxLen -= len;
+    return len;
+}
+
+int32_t
+sendto( uint8_t sn, uint8_t * buf, uint16_t len, uint8_t * addr, uint16_t port )
+{
+    ( void )sn;
+    ( void )buf;
+    ( void )addr;
+    ( void )port;
+    u32SpiTransactions += W5500_SIM_SPI_SEND;
+    return len;
+}
+
+uint8_t
+getPHYCFGR( void )
+{
+    u32SpiTransactions += W5500_SIM_SPI_REG;
+    return bLinkUp ? PHYCFGR_LNK_ON : 0;
+}
+
+uint8_t
+getSIR( void )
+{
+    u32SpiTransactions += W5500_SIM_SPI_REG;
+    return u8W5500SimSIR(  );
+}
+
+void
+setSIMR( uint8_t simr )
+{
+    u32SpiTransactions += W5500_SIM_SPI_REG;
+    u8SIMR = simr;
+    vW5500SimUpdateInt(  );
+}
+
+uint8_t
+getSn_SR( uint8_t sn )
+{
+    u32SpiTransactions += W5500_SIM_SPI_REG;
+    return astSockets[sn].u8SR;
+}
+
+uint8_t
+getSn_IR( uint8_t sn )
+{
+    u32SpiTransactions += W5500_SIM_SPI_REG;
+    return astSockets[sn].u8IR;
+}
+
+void
+setSn_IR( uint8_t sn, uint8_t ir )
+{
+    /* Writing 1 clears the flag. */
+    u32SpiTransactions += W5500_SIM_SPI_REG;
+    astSockets[sn].u8IR &= ( uint8_t )~ir;
+    vW5500SimUpdateInt(  );
+}
+
+void
+setSn_IMR( uint8_t sn, uint8_t imr )
+{
+    u32SpiTransactions += W5500_SIM_SPI_REG;
+    astSockets[sn].u8IMR = imr;
+    vW5500SimUpdateInt(  );
+}
+
+uint16_t
+getSn_RX_RSR( uint8_t sn )
+{
+    u32SpiTransactions += W5500_SIM_SPI_RSR;
+    return astSockets[sn].u16RxLen;
+}
+
+void
+setSn_KPALVTR( uint8_t sn, uint8_t kpalvt )
+{
+    ( void )sn;
+    ( void )kpalvt;
+    u32SpiTransactions += W5500_SIM_SPI_REG;
+}
+
+void
+getSn_DIPR( uint8_t sn, uint8_t * dipr )
+{
+    u32SpiTransactions += W5500_SIM_SPI_REG;
+    memcpy( dipr, astSockets[sn].au8Peer, 4 );
+}
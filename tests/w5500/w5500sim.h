@@ -0,0 +1,80 @@
+/* 
+ * FreeModbus Libary: A portable Modbus implementation for Modbus ASCII/RTU.
+ * Copyright (c) 2006-2018 Christian Walter <cwalter@embedded-solutions.at>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef _W5500_SIM_H
+#define _W5500_SIM_H
+
+/* ----------------------- System includes ----------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Register level simulator of the W5500 and of the ioLibrary socket API
+ * on top of it, for host tests of function/porttcp.c.
+ *
+ * - Sn_IR, Sn_IMR, SIR and SIMR behave like the registers of the chip. SIR
+ *   shows the sockets with a flag pending which is enabled in Sn_IMR, INTn
+ *   is low while one of them is enabled in SIMR. The handler set with
+ *   vW5500SimSetIRQHandler( ) is called on the falling edge of INTn, like
+ *   the EXTI callback on the board.
+ * - send( ) in non-blocking mode keeps the busy flag of the ioLibrary: once
+ *   a SEND command was issued, the next send( ) returns SOCK_BUSY until it
+ *   finds SEND_OK in Sn_IR and clears it. vW5500SimTransmit( ) completes
+ *   the SEND commands in progress.
+ * - Every register access through the API counts the SPI transactions the
+ *   ioLibrary needs for it.
+ *
+ * A socket accepts a client with xW5500SimConnect( ) once it listens. The
+ * bytes the client sends and receives are passed with
+ * vW5500SimClientSend( ) and usW5500SimClientRead( ).
+ */
+
+/* ----------------------- Defines ------------------------------------------*/
+#define W5500_SIM_SOCKETS       8
+#define W5500_SIM_BUF_SIZE      2048
+
+/* ----------------------- Function prototypes ------------------------------*/
+void            vW5500SimReset( void );
+void            vW5500SimSetIRQHandler( void ( *pvHandler ) ( uint16_t u16GpioPin ) );
+
+void            vW5500SimAdvance( uint32_t u32Ms );
+void            vW5500SimSetLink( bool bUp );
+
+bool            xW5500SimConnect( uint8_t u8Socket, const uint8_t au8Ip[4] );
+void            vW5500SimClientSend( uint8_t u8Socket, const uint8_t * pu8Data, uint16_t u16Len );
+void            vW5500SimClientClose( uint8_t u8Socket );
+uint16_t        usW5500SimClientRead( uint8_t u8Socket, uint8_t * pu8Data, uint16_t u16Max );
+
+void            vW5500SimTransmit( void );
+void            vW5500SimSetTxFree( uint8_t u8Socket, uint16_t u16Free );
+
+uint8_t         u8W5500SimGetState( uint8_t u8Socket );
+uint32_t        u32W5500SimGetDisconnects( uint8_t u8Socket );
+uint32_t        u32W5500SimGetSpiTransactions( void );
+
+#endif